@@ -0,0 +1,176 @@
+#include <QtCore/QByteArray>
+#include <QtCore/QByteArrayMatcher>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTextStream>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bineditmatcher.h"
+
+// BinEdit searches its data block by block.
+static const int BlockSize = 4096;
+static const int DefaultSizeMB = 1024;
+
+static QTextStream out(stdout);
+
+// The search BinEdit had before BinEditMatcher, see BinEdit::dataIndexOf().
+static void lower(QByteArray &ba)
+{
+    char *data = ba.data();
+    char *end = data + ba.size();
+    while (data != end) {
+        if (*data >= 0x41 && *data <= 0x5A)
+            *data += 0x20;
+        ++data;
+    }
+}
+
+static qint64 oldIndexOf(const QByteArray &data, const QByteArray &needle, bool caseSensitive)
+{
+    QByteArray pattern = needle;
+    const int trailing = pattern.size();
+    if (!caseSensitive)
+        lower(pattern);
+
+    QByteArray buffer(BlockSize + trailing, '\0');
+    char *b = buffer.data();
+    const QByteArrayMatcher matcher(pattern);
+
+    qint64 from = 0;
+    for (qint64 block = 0; block * BlockSize < data.size(); ++block) {
+        ::memcpy(b, b + BlockSize, size_t(trailing));
+        ::memcpy(b + trailing, data.constData() + block * BlockSize, BlockSize);
+        if (!caseSensitive)
+            lower(buffer);
+
+        const int pos = matcher.indexIn(buffer, int(from - block * BlockSize) + trailing);
+        if (pos >= 0)
+            return pos + block * BlockSize - trailing;
+        from = (block + 1) * BlockSize - trailing;
+    }
+    return -1;
+}
+
+static qint64 oldLastIndexOf(const QByteArray &data, const QByteArray &needle, bool caseSensitive)
+{
+    QByteArray pattern = needle;
+    const int trailing = pattern.size();
+    if (!caseSensitive)
+        lower(pattern);
+
+    QByteArray buffer(BlockSize + trailing, '\0');
+    char *b = buffer.data();
+
+    qint64 from = data.size() - 1;
+    for (qint64 block = (data.size() - 1) / BlockSize; block >= 0; --block) {
+        ::memcpy(b + BlockSize, b, size_t(trailing));
+        ::memcpy(b, data.constData() + block * BlockSize, BlockSize);
+        if (!caseSensitive)
+            lower(buffer);
+
+        const int pos = buffer.lastIndexOf(pattern, int(from - block * BlockSize));
+        if (pos >= 0)
+            return pos + block * BlockSize;
+        from = (block - 1) * BlockSize + (BlockSize - 1) + trailing;
+    }
+    return -1;
+}
+
+/*
+    BinEditMatcher on views of the blocks. The data is contiguous here, so
+    a match crossing into the next block is found by letting the view run
+    over it by the pattern size, which is what BinEdit's seam buffer does.
+*/
+static qint64 newIndexOf(const QByteArray &data, const QByteArray &pattern, bool caseSensitive)
+{
+    const BinEditMatcher matcher(pattern, caseSensitive);
+    for (qint64 start = 0; start < data.size(); start += BlockSize) {
+        const int length = int(qMin<qint64>(BlockSize + pattern.size() - 1, data.size() - start));
+        const int pos = matcher.indexIn(data.constData() + start, length);
+        if (pos >= 0)
+            return start + pos;
+    }
+    return -1;
+}
+
+static qint64 newLastIndexOf(const QByteArray &data, const QByteArray &pattern, bool caseSensitive)
+{
+    const BinEditMatcher matcher(pattern, caseSensitive);
+    for (qint64 start = (data.size() - 1) / BlockSize * BlockSize; start >= 0; start -= BlockSize) {
+        const int length = int(qMin<qint64>(BlockSize + pattern.size() - 1, data.size() - start));
+        const int pos = matcher.lastIndexIn(data.constData() + start, length);
+        if (pos >= 0)
+            return start + pos;
+    }
+    return -1;
+}
+
+typedef qint64 (*Search)(const QByteArray &, const QByteArray &, bool);
+
+static qint64 run(const char *name, Search search, const QByteArray &data,
+                  const QByteArray &pattern, bool caseSensitive)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 found = search(data, pattern, caseSensitive);
+    const qint64 ms = qMax<qint64>(1, timer.elapsed());
+    const qint64 megabytes = data.size() / 1024 / 1024;
+    out << QString::fromLatin1("%1 %2 ms %3 MB/s, found at %4")
+           .arg(QString::fromLatin1(name), -36)
+           .arg(ms, 6)
+           .arg(megabytes * 1000 / ms, 6)
+           .arg(found)
+        << endl;
+    return found;
+}
+
+/*
+    Usage: bineditmatcherbenchmark [megabytes]
+
+    Searches a buffer of text-like bytes for patterns that are only found
+    at its far ends, so every search reads all of it. Each search is run
+    the old and the new way, they have to find the same positions.
+*/
+int main(int argc, char *argv[])
+{
+    const int sizeMB = argc > 1 ? atoi(argv[1]) : DefaultSizeMB;
+    if (sizeMB <= 0 || sizeMB > 1536) {
+        out << "The size must be between 1 and 1536 MB." << endl;
+        return 1;
+    }
+
+    // Lower case letters, some upper case and zeroes, so the anchor bytes
+    // of the pattern turn up often.
+    QByteArray data(sizeMB * 1024 * 1024, '\0');
+    quint32 seed = 1;
+    for (int i = 0; i < data.size(); ++i) {
+        seed = seed * 1103515245 + 12345;
+        const quint32 r = (seed >> 16) & 0xff;
+        data[i] = r < 16 ? '\0' : char((r < 64 ? 'A' : 'a') + r % 26);
+    }
+
+    // Long enough not to turn up in the random letters by chance.
+    const QByteArray last("Andromeda");
+    const QByteArray first("Triangulum");
+    ::memcpy(data.data() + data.size() - last.size(), last.constData(), size_t(last.size()));
+    ::memcpy(data.data(), first.constData(), size_t(first.size()));
+
+    out << "Searching " << sizeMB << " MB in blocks of " << BlockSize << " bytes" << endl;
+
+    bool ok = true;
+    qint64 found = run("QByteArrayMatcher, forward", oldIndexOf, data, last, true);
+    ok &= run("BinEditMatcher, forward", newIndexOf, data, last, true) == found;
+    found = run("lowered copy, forward, no case", oldIndexOf, data, last, false);
+    ok &= run("BinEditMatcher, forward, no case", newIndexOf, data, last, false) == found;
+    found = run("QByteArray::lastIndexOf, backward", oldLastIndexOf, data, first, true);
+    ok &= run("BinEditMatcher, backward", newLastIndexOf, data, first, true) == found;
+    found = run("lowered copy, backward, no case", oldLastIndexOf, data, first, false);
+    ok &= run("BinEditMatcher, backward, no case", newLastIndexOf, data, first, false) == found;
+
+    if (!ok) {
+        out << "The searches disagree." << endl;
+        return 1;
+    }
+    return 0;
+}
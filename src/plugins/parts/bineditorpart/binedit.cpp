@@ -31,36 +31,119 @@
 **************************************************************************/
 
 #include "binedit.h"
+#include "bineditblockreader.h"
+#if defined(BINEDITOR_HAVE_DECOMPRESSION)
+#include "bineditcompressedfile.h"
+#include "bineditcompressedindex.h"
+#endif
+#include "bineditexport.h"
+#include "bineditmatcher.h"
+#include "bineditmimedata.h"
+#include "bineditoverview.h"
+#include "bineditoverviewstrip.h"
+#include "bineditprocessmemory.h"
+#include "bineditsearch.h"
 
-#include <QByteArrayMatcher>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QTemporaryFile>
 #include <QVariant>
 
 #include <QApplication>
 #include <QAction>
 #include <QClipboard>
+#include <QFileDialog>
 #include <QFontMetrics>
 #include <QHelpEvent>
+#include <QInputDialog>
+#include <QLineEdit>
 #include <QMenu>
 #include <QMessageBox>
 #include <QPainter>
+#include <QProgressDialog>
 #include <QScrollBar>
 #include <QToolTip>
 #include <QWheelEvent>
 
-// QByteArray::toLower() is broken, it stops at the first \0
-static void lower(QByteArray &ba)
+#if defined(Q_OS_UNIX)
+#include <stdio.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#include <windows.h>
+#endif
+
+// QScrollBar works with ints, files with more lines than this are mapped
+// proportionally onto the scroll bar range.
+static const int MaxScrollBarRange = 1 << 30;
+
+// Read-ahead window around the viewport, in pages and at least in bytes.
+static const int ReadAheadPages = 4;
+static const int ReadBehindPages = 1;
+static const qint64 ReadAheadMinimum = 256 * 1024;
+
+// Amount of data collected before writing it out while saving a copy.
+static const int SaveBufferSize = 1024 * 1024;
+
+// Edited blocks composed from pieces that are kept for painting.
+static const int EditedBlockCacheSize = 256;
+
+static bool syncFile(QFile *file)
+{
+#if defined(Q_OS_UNIX)
+    return ::fsync(file->handle()) == 0;
+#elif defined(Q_OS_WIN)
+    return ::_commit(file->handle()) == 0;
+#else
+    Q_UNUSED(file);
+    return true;
+#endif
+}
+
+static bool replaceFile(const QString &source, const QString &target)
 {
-    char *data = ba.data();
-    char *end = data + ba.size();
-    while (data != end) {
-        if (*data >= 0x41 && *data <= 0x5A)
-            *data += 0x20;
-        ++data;
-    }
+#if defined(Q_OS_UNIX)
+    return ::rename(QFile::encodeName(source).constData(),
+                    QFile::encodeName(target).constData()) == 0;
+#elif defined(Q_OS_WIN)
+    return ::MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(source).utf16()),
+                         reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(target).utf16()),
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    if (QFile::exists(target) && !QFile::remove(target))
+        return false;
+    return QFile::rename(source, target);
+#endif
+}
+
+static bool writeData(QFile *file, const QByteArray &data)
+{
+    return file->write(data) == data.size();
+}
+
+/*
+    Returns matchers for \a pattern as text and, if it is one, as a hex
+    pattern with wildcards and alternatives.
+*/
+static QVector<BinEditMatcher> patternMatchers(const QByteArray &pattern, bool caseSensitive)
+{
+    QVector<BinEditMatcher> matchers;
+    if (pattern.isEmpty())
+        return matchers;
+    matchers.append(BinEditMatcher(pattern, caseSensitive));
+    matchers += BinEditMatcher::fromHexPattern(pattern);
+    return matchers;
+}
+
+static int maxPatternSize(const QVector<BinEditMatcher> &matchers)
+{
+    int size = 0;
+    foreach (const BinEditMatcher &matcher, matchers)
+        size = qMax(size, matcher.size());
+    return size;
 }
 
 static QByteArray calculateHexPattern(const QByteArray &pattern)
@@ -85,21 +168,32 @@ BinEdit::BinEdit(QWidget *parent) :
     QAbstractScrollArea(parent)
 {
     m_device = 0;
+    m_watcher = 0;
+    m_data = 0;
+    m_pieces = 0;
+    m_journal = 0;
+    setSharedFile(BinEditSharedFile::create());
     m_bytesPerLine = 16;
     m_baseAddr = 0;
     m_blockSize = 4096;
     m_size = 0;
+    m_topLine = 0;
+    m_pendingTopLine = -1;
+    m_readAheadDirection = 1;
     m_addressBytes = 4;
     init();
-    m_unmodifiedState = 0;
     m_readOnly = false;
     m_hexCursor = true;
     m_cursorPosition = 0;
     m_anchorPosition = 0;
     m_lowNibble = false;
+    m_overwriteMode = true;
     m_cursorVisible = false;
-    m_caseSensitiveSearch = false;
     m_canRequestNewWindow = false;
+    m_refreshInterval = 0;
+    m_decompress = true;
+    m_searchCaseSensitive = false;
+    m_diffSide = BinEditDiff::Left;
     setFocusPolicy(Qt::WheelFocus);
     setFrameStyle(QFrame::Plain);
 
@@ -111,6 +205,45 @@ BinEdit::BinEdit(QWidget *parent) :
         SLOT(handleStartOfFileRequested()));
     connect(this, SIGNAL(endOfFileRequested()), this,
         SLOT(handleEndOfFileRequested()));
+    connect(verticalScrollBar(), SIGNAL(actionTriggered(int)),
+        this, SLOT(handleScrollAction(int)));
+
+    qRegisterMetaType<qint64>("qint64");
+    m_reader = new BinEditBlockReader(&m_provider, this);
+    connect(m_reader, SIGNAL(blockRead(qint64,QByteArray,int)),
+        this, SLOT(handleBlockRead(qint64,QByteArray,int)));
+    m_reader->start(QThread::LowPriority);
+
+    m_search = new BinEditSearch(&m_provider, this);
+    m_strings = new BinEditStrings(&m_provider, this);
+    m_checksum = new BinEditChecksum(&m_provider, this);
+
+    m_export = new BinEditExport(&m_provider, this);
+    connect(m_export, SIGNAL(progressChanged(int,int)),
+        this, SLOT(handleExportProgress(int,int)));
+    connect(m_export, SIGNAL(finished(bool)), this, SLOT(handleExportFinished(bool)));
+
+    // Indexing reads the compressed file on its own, it only stops when
+    // another file is opened.
+#if defined(BINEDITOR_HAVE_DECOMPRESSION)
+    m_compressedIndex = new BinEditCompressedIndex(this);
+    connect(m_compressedIndex, SIGNAL(progressChanged(int,int)),
+        this, SLOT(handleCompressedIndexProgress(int,int)));
+    connect(m_compressedIndex, SIGNAL(finished(bool)), this, SLOT(handleCompressedIndexFinished(bool)));
+#else
+    m_compressedIndex = 0;
+#endif
+
+    // The overview reads the file on its own, it stops with the other
+    // readers of m_provider. The strip sits in a margin right of the
+    // viewport.
+    m_overview = new BinEditOverview(&m_provider, this);
+    connect(this, SIGNAL(sourceAboutToChange()), m_overview, SLOT(cancel()));
+    m_overviewStrip = new BinEditOverviewStrip(m_overview, this);
+    connect(m_overviewStrip, SIGNAL(positionRequested(qint64)),
+        this, SLOT(handleOverviewPositionRequested(qint64)));
+    connect(this, SIGNAL(topPositionChanged(qint64)), SLOT(updateOverviewRange()));
+    setViewportMargins(0, 0, m_overviewStrip->sizeHint().width(), 0);
 
     //open a file
     //QString fileName = "/path/to/file";
@@ -119,6 +252,25 @@ BinEdit::BinEdit(QWidget *parent) :
 
 BinEdit::~BinEdit()
 {
+    // The reader thread, search, strings and export tasks use m_provider,
+    // stop them before members go away. Data on the clipboard may outlive
+    // the editor, comparisons with it are stopped by their owner.
+    emit sourceAboutToChange();
+    detachClipboardData();
+    delete m_overviewStrip;
+    delete m_overview;
+    delete m_compressedIndex;
+    delete m_export;
+    delete m_checksum;
+    delete m_strings;
+    delete m_search;
+    delete m_reader;
+    // Mapped blocks point into m_provider, other editors of the file keep
+    // the rest.
+    m_data->removeOwnedBy(&m_provider);
+    m_data->removePinnedRange(this);
+    m_sharedFile->disconnect(this);
+    m_sharedFile->removeView();
 }
 
 QIODevice *BinEdit::device() const
@@ -131,23 +283,257 @@ void BinEdit::setDevice(QIODevice *device, const QString &fileName)
     if (m_device == device)
         return;
 
+    const bool wasModified = isModified();
+    const bool hadUndo = isUndoAvailable();
+    const bool hadRedo = isRedoAvailable();
+    attachDevice(device, fileName);
+    // Editable views of a file share its blocks and edits with the other
+    // editors showing it. Read-only views, such as the other side of a
+    // comparison, show the file as saved.
+    QFile *file = qobject_cast<QFile *>(m_device);
+    if (file && !m_fileName.isEmpty() && !m_readOnly)
+        setSharedFile(BinEditSharedFile::instance(file));
+    else
+        setSharedFile(BinEditSharedFile::create());
+    // setSizes() keeps edits if the new file has the same size, they belong
+    // to the old one.
+    if (!m_sharedFile->isShared()) {
+        m_journal->clear();
+        m_pieces->reset(m_size);
+    }
+    emitUndoState(wasModified, hadUndo, hadRedo);
+    setOffset();
+}
+
+/*!
+    Makes the editor show the blocks and edits of \a file. The cache keeps
+    the larger size of this editor and the others showing the file.
+*/
+void BinEdit::setSharedFile(const QSharedPointer<BinEditSharedFile> &file)
+{
+    if (m_sharedFile == file)
+        return;
+
+    const qint64 cacheSize = m_data ? m_data->maxCost() : 0;
+    const qint64 undoLimit = m_journal ? m_journal->limit() : 0;
+    if (m_sharedFile) {
+        m_data->removeOwnedBy(&m_provider);
+        m_data->removePinnedRange(this);
+        m_sharedFile->disconnect(this);
+        m_sharedFile->removeView();
+    }
+
+    m_sharedFile = file;
+    m_data = file->cache();
+    m_pieces = file->pieces();
+    m_journal = file->journal();
+    if (cacheSize > m_data->maxCost())
+        m_data->setMaxCost(cacheSize);
+    if (undoLimit && !file->viewCount())
+        m_journal->setLimit(undoLimit);
+    file->addView();
+
+    connect(file.data(), SIGNAL(contentsChanged(QObject*,qint64,qint64,qint64)),
+        this, SLOT(handleSharedContentsChanged(QObject*,qint64,qint64,qint64)));
+    connect(file.data(), SIGNAL(stateChanged(QObject*)),
+        this, SLOT(handleSharedStateChanged(QObject*)));
+    connect(file.data(), SIGNAL(reopened(QObject*,QString)),
+        this, SLOT(handleSharedFileReopened(QObject*,QString)));
+}
+
+void BinEdit::attachDevice(QIODevice *device, const QString &fileName)
+{
+    emit sourceAboutToChange();
+    m_search->cancel();
+    m_strings->cancel();
+    m_checksum->cancel();
+    m_export->cancel();
+    detachClipboardData();
+    m_reader->reset();
+    invalidateLines();
+    // Mapped blocks go away with the mapping, copies stay for other editors
+    // of the file.
+    m_data->removeOwnedBy(&m_provider);
+    if (!m_sharedFile->isShared())
+        m_data->clear();
+    m_oldData.clear();
+    m_editedBlocks.clear();
+    m_requests.clear();
+    m_diffRanges.clear();
+    m_refreshTimer.stop();
+    m_provider.close();
+
+    if (m_watcher && !m_watcher->files().isEmpty())
+        m_watcher->removePaths(m_watcher->files());
+
     m_device = device;
     m_fileName = fileName;
-    setOffset();
+
+    if (m_device && !m_provider.open(m_device)) {
+        raiseError(openErrorString(m_provider.errorString()));
+        m_device = 0;
+    }
+
+    if (m_device && !m_fileName.isEmpty()) {
+        if (!m_watcher) {
+            m_watcher = new QFileSystemWatcher(this);
+            connect(m_watcher, SIGNAL(fileChanged(QString)), SLOT(handleFileChanged()));
+        }
+        m_watcher->addPath(m_fileName);
+    }
+    startOverview();
 }
 
 void BinEdit::open(const QString &filePath)
 {
-    if (m_device && m_device->parent() == this)
-        delete m_device;
+    QIODevice *oldDevice = m_device;
+    setDevice(0);
+    if (oldDevice && oldDevice->parent() == this)
+        delete oldDevice;
 
-    if (filePath.isEmpty()) {
-        setDevice(0);
+#if defined(BINEDITOR_HAVE_DECOMPRESSION)
+    if (m_compressedIndex->isRunning() && m_compressedIndex->fileName() != filePath)
+        m_compressedIndex->cancel();
+#endif
+
+    if (filePath.isEmpty())
+        return;
+
+    if (m_decompress && openCompressed(filePath))
         return;
-    }
 
     QFile *file = new QFile(filePath, this);
-    setDevice(file/*, filePath*/);
+    setDevice(file, filePath);
+}
+
+/*!
+    Shows the decompressed data of the gzip or xz file \a filePath. gzip
+    files are indexed first, the compressed bytes are shown until the index
+    is complete; the index is kept in the cache directory so that the file
+    opens at once the next time. Returns false if the file is shown as is,
+    which it always is in builds without zlib and liblzma.
+*/
+bool BinEdit::openCompressed(const QString &filePath)
+{
+#if defined(BINEDITOR_HAVE_DECOMPRESSION)
+    const BinEditCompressedFile::Format format = BinEditCompressedFile::detectFormat(filePath);
+    if (format == BinEditCompressedFile::Uncompressed)
+        return false;
+
+    BinEditCompressedFile *file = new BinEditCompressedFile(filePath, this);
+    if (file->open(QIODevice::ReadOnly)) {
+        setDevice(file, filePath);
+        return true;
+    }
+    delete file;
+
+    if (format == BinEditCompressedFile::Gzip && !m_compressedIndex->isRunning()) {
+        m_compressedIndexProgress = new QProgressDialog(tr("Indexing %1...")
+                                                        .arg(QDir::toNativeSeparators(filePath)),
+                                                        tr("Cancel"), 0, 0, this);
+        m_compressedIndexProgress->setWindowTitle(tr("Decompress"));
+        m_compressedIndexProgress->setAutoClose(false);
+        m_compressedIndexProgress->setAutoReset(false);
+        m_compressedIndexProgress->setMinimumDuration(500);
+        connect(m_compressedIndexProgress, SIGNAL(canceled()), m_compressedIndex, SLOT(cancel()));
+        m_compressedIndex->start(filePath);
+    }
+#else
+    Q_UNUSED(filePath);
+#endif
+    return false;
+}
+
+/*!
+    Returns the device of a decompressed view, or 0 if the data is shown
+    as it is stored.
+*/
+BinEditCompressedFile *BinEdit::compressedFile() const
+{
+#if defined(BINEDITOR_HAVE_DECOMPRESSION)
+    return qobject_cast<BinEditCompressedFile *>(m_device);
+#else
+    return 0;
+#endif
+}
+
+/*!
+    Sets whether gzip and xz files are shown decompressed and opens the
+    shown file again the other way.
+*/
+void BinEdit::setDecompressionEnabled(bool enabled)
+{
+    if (m_decompress == enabled)
+        return;
+
+    m_decompress = enabled;
+#if defined(BINEDITOR_HAVE_DECOMPRESSION)
+    if (!enabled)
+        m_compressedIndex->cancel();
+
+    // Edits of the compressed bytes would be lost.
+    const bool shownCompressed = m_device && !processMemory() && !isModified()
+            && BinEditCompressedFile::detectFormat(m_fileName) != BinEditCompressedFile::Uncompressed;
+    if (shownCompressed) {
+        const QString fileName = m_fileName; // open() clears m_fileName.
+        open(fileName);
+    }
+#endif
+}
+
+/*!
+    Shows the memory of the local process \a pid read-only, starting with
+    the mapping that contains \a address. Jumping to an address in another
+    mapping, or scrolling into one that directly follows, shows that one.
+*/
+bool BinEdit::openProcess(qint64 pid, quint64 address)
+{
+    QIODevice *oldDevice = m_device;
+    setDevice(0);
+    if (oldDevice && oldDevice->parent() == this)
+        delete oldDevice;
+
+    BinEditProcessMemory *memory = new BinEditProcessMemory(pid, this);
+    if (!memory->open(QIODevice::ReadOnly)) {
+        raiseError(tr("Cannot read the memory of process %1: %2").arg(pid).arg(memory->errorString()));
+        delete memory;
+        return false;
+    }
+
+    // setDevice() would show the whole address space.
+    attachDevice(memory, QString());
+    if (!m_device) {
+        delete memory;
+        return false;
+    }
+
+    const int index = memory->findMapping(address);
+    const BinEditProcessMemory::Mapping mapping = memory->mappings().at(qMax(0, index));
+    showMapping(mapping.start, mapping.size(), index >= 0 ? address : mapping.start);
+    setRefreshInterval(m_refreshInterval);
+    return true;
+}
+
+/*!
+    Returns the process shown by a memory view, or 0 if a file is shown.
+*/
+BinEditProcessMemory *BinEdit::processMemory() const
+{
+    return qobject_cast<BinEditProcessMemory *>(m_device);
+}
+
+/*!
+    Reads the visible part of a process memory view again every \a msec
+    milliseconds and highlights the bytes that changed. 0 turns refreshing
+    off.
+*/
+void BinEdit::setRefreshInterval(int msec)
+{
+    m_refreshInterval = qMax(0, msec);
+    if (m_refreshInterval > 0 && processMemory())
+        m_refreshTimer.start(m_refreshInterval, this);
+    else
+        m_refreshTimer.stop();
 }
 
 void BinEdit::init()
@@ -191,11 +577,13 @@ void BinEdit::init()
             : fm.width("MMMM:MMMM:MMMM:MMMM");
     }
 
+    if (m_glyphs.setFont(font(), m_columnWidth, pixelRatio()))
+        invalidateLines();
+
     horizontalScrollBar()->setRange(0, 2 * m_margin + m_bytesPerLine * m_columnWidth
                                     + m_labelWidth + m_textWidth - viewport()->width());
     horizontalScrollBar()->setPageStep(viewport()->width());
-    verticalScrollBar()->setRange(0, m_numLines - m_numVisibleLines);
-    verticalScrollBar()->setPageStep(m_numVisibleLines);
+    updateScrollBar();
     ensureCursorVisible();
 }
 
@@ -204,24 +592,67 @@ void BinEdit::addData(quint64 block, const QByteArray &data)
     Q_ASSERT(data.size() == m_blockSize);
     const quint64 addr = block * m_blockSize;
     if (addr >= m_baseAddr && addr <= m_baseAddr + m_size - 1) {
-        if (m_data.size() * m_blockSize >= 64 * 1024 * 1024)
-            m_data.clear();
-        const int translatedBlock = (addr - m_baseAddr) / m_blockSize;
-        m_data.insert(translatedBlock, data);
+        const qint64 translatedBlock = (addr - m_baseAddr) / m_blockSize;
+        // Blocks read from a mapping must not outlive it.
+        m_data->insert(translatedBlock, data, m_provider.isMapped() ? &m_provider : 0);
         m_requests.remove(translatedBlock);
-        viewport()->update();
+        updateLines(translatedBlock * m_blockSize, (translatedBlock + 1) * m_blockSize - 1);
     }
 }
 
-bool BinEdit::requestDataAt(int pos) const
+void BinEdit::setCacheSize(qint64 bytes)
 {
-    int block = pos / m_blockSize;
-    BlockMap::const_iterator it = m_modifiedData.find(block);
-    if (it != m_modifiedData.constEnd())
+    m_data->setMaxCost(qMax<qint64>(bytes, m_blockSize));
+}
+
+bool BinEdit::requestDataAt(qint64 pos, bool synchronous) const
+{
+    const qint64 block = pos / m_blockSize;
+    if (m_editedBlocks.contains(block))
         return true;
-    it = m_data.find(block);
-    if (it != m_data.end())
+
+    bool available = true;
+    foreach (qint64 sourceBlock, sourceBlocks(block))
+        available = requestSourceBlock(sourceBlock, synchronous) && available;
+    return available;
+}
+
+/*!
+    Returns the blocks of the original data that \a block of the edited data
+    is composed of.
+*/
+QList<qint64> BinEdit::sourceBlocks(qint64 block) const
+{
+    QList<qint64> blocks;
+    if (m_pieces->isIdentity()) {
+        blocks.append(block);
+        return blocks;
+    }
+
+    foreach (const BinEditPieceTable::Piece &piece, m_pieces->pieces(block * m_blockSize, m_blockSize)) {
+        if (piece.source != BinEditPieceTable::Original)
+            continue;
+        const qint64 last = (piece.start + piece.length - 1) / m_blockSize;
+        for (qint64 sourceBlock = piece.start / m_blockSize; sourceBlock <= last; ++sourceBlock) {
+            if (blocks.isEmpty() || blocks.last() != sourceBlock)
+                blocks.append(sourceBlock);
+        }
+    }
+    return blocks;
+}
+
+bool BinEdit::requestSourceBlock(qint64 block, bool synchronous) const
+{
+    if (m_data->lookup(block))
         return true;
+    if (m_provider.isOpen()) {
+        // Asynchronous requests are served by scheduleReadAhead().
+        if (!synchronous)
+            return false;
+        const quint64 fileBlock = m_baseAddr / m_blockSize + block;
+        const_cast<BinEdit*>(this)->addData(fileBlock, m_provider.block(fileBlock, m_blockSize));
+        return true;
+    }
     if (!m_requests.contains(block)) {
         m_requests.insert(block);
         emit const_cast<BinEdit*>(this)->
@@ -231,41 +662,75 @@ bool BinEdit::requestDataAt(int pos) const
     return false;
 }
 
-bool BinEdit::requestOldDataAt(int pos) const
+bool BinEdit::requestOldDataAt(qint64 pos) const
 {
-    int block = pos / m_blockSize;
+    qint64 block = pos / m_blockSize;
     BlockMap::const_iterator it = m_oldData.find(block);
     return it != m_oldData.end();
 }
 
-char BinEdit::dataAt(int pos, bool old) const
+char BinEdit::dataAt(qint64 pos, bool old) const
 {
-    int block = pos / m_blockSize;
-    return blockData(block, old).at(pos - block*m_blockSize);
+    qint64 block = pos / m_blockSize;
+    return blockData(block, old).at(int(pos - block*m_blockSize));
 }
 
-void BinEdit::changeDataAt(int pos, char c)
+/*!
+    Returns up to \a length bytes at \a from, reading blocks that are not
+    cached yet.
+*/
+QByteArray BinEdit::contents(qint64 from, int length) const
 {
-    int block = pos / m_blockSize;
-    BlockMap::iterator it = m_modifiedData.find(block);
-    if (it != m_modifiedData.end()) {
-        it.value()[pos - (block*m_blockSize)] = c;
-    } else {
-        it = m_data.find(block);
-        if (it != m_data.end()) {
-            QByteArray data = it.value();
-            data[pos - (block*m_blockSize)] = c;
-            m_modifiedData.insert(block, data);
-        }
+    from = qBound<qint64>(0, from, m_size);
+    length = int(qMin<qint64>(length, m_size - from));
+    if (length <= 0)
+        return QByteArray();
+
+    for (qint64 block = from / m_blockSize; block * m_blockSize < from + length; ++block) {
+        if (!requestDataAt(block * m_blockSize))
+            return QByteArray();
     }
+    return dataMid(from, length);
+}
+
+/*!
+    Returns a snapshot of the data for comparing it on another thread with
+    BinEditDiff, which must be canceled on sourceAboutToChange().
+*/
+BinEditDiff::Source BinEdit::diffSource() const
+{
+    BinEditDiff::Source source;
+    source.provider = m_provider.isOpen() ? &m_provider : 0;
+    source.baseAddress = m_baseAddr;
+    source.pieces = m_pieces->pieces();
+    source.addBuffer = m_pieces->addBuffer();
+    source.size = source.provider ? m_pieces->size() : 0;
+    return source;
+}
 
-    emit dataChanged(m_baseAddr + pos, QByteArray(1, c));
+/*!
+    Highlights the differing \a ranges of a comparison in which this editor
+    shows \a side.
+*/
+void BinEdit::setDiffRanges(const BinEditDiff::RangeList &ranges, BinEditDiff::Side side)
+{
+    m_diffRanges = ranges;
+    m_diffSide = side;
+    viewport()->update();
 }
 
-QByteArray BinEdit::dataMid(int from, int length, bool old) const
+/*!
+    Scrolls so that the line containing \a position is the top line.
+*/
+void BinEdit::setTopPosition(qint64 position)
 {
-    int end = from + length;
-    int block = from / m_blockSize;
+    setTopLine(position / m_bytesPerLine);
+}
+
+QByteArray BinEdit::dataMid(qint64 from, int length, bool old) const
+{
+    qint64 end = from + length;
+    qint64 block = from / m_blockSize;
 
     QByteArray data;
     data.reserve(length);
@@ -273,19 +738,80 @@ QByteArray BinEdit::dataMid(int from, int length, bool old) const
         data += blockData(block++, old);
     } while (block * m_blockSize < end);
 
-    return data.mid(from - ((from / m_blockSize) * m_blockSize), length);
+    return data.mid(int(from - ((from / m_blockSize) * m_blockSize)), length);
 }
 
-QByteArray BinEdit::blockData(int block, bool old) const
+/*!
+    Returns \a block of the edited data, or of the data before the last
+    updateContents() if \a old is true. Blocks that were edited are composed
+    from their pieces and cached once all original data they need is there.
+*/
+QByteArray BinEdit::blockData(qint64 block, bool old) const
 {
     if (old) {
-        BlockMap::const_iterator it = m_modifiedData.find(block);
-        return it != m_modifiedData.constEnd()
-                ? it.value() : m_oldData.value(block, m_emptyBlock);
+        // Edits are not shown as changes against the previous contents.
+        if (!isBlockEdited(block))
+            return m_oldData.value(block, m_emptyBlock);
+    } else if (m_pieces->isIdentity()) {
+        return m_data->value(block, m_emptyBlock);
+    }
+
+    QHash<qint64, QByteArray>::const_iterator it = m_editedBlocks.constFind(block);
+    if (it != m_editedBlocks.constEnd())
+        return it.value();
+
+    QByteArray data(m_blockSize, '\0');
+    bool complete = true;
+    const qint64 blockStart = block * m_blockSize;
+    foreach (const BinEditPieceTable::Piece &piece, m_pieces->pieces(blockStart, m_blockSize)) {
+        char *target = data.data() + (piece.position - blockStart);
+        switch (piece.source) {
+        case BinEditPieceTable::Original: {
+            qint64 from = piece.start;
+            const qint64 to = piece.start + piece.length;
+            while (from < to) {
+                const qint64 sourceBlock = from / m_blockSize;
+                const int offset = int(from - sourceBlock * m_blockSize);
+                const int length = int(qMin<qint64>(m_blockSize - offset, to - from));
+                const QByteArray source = m_data->value(sourceBlock);
+                if (source.size() == m_blockSize)
+                    ::memcpy(target, source.constData() + offset, size_t(length));
+                else
+                    complete = false;
+                target += length;
+                from += length;
+            }
+            break;
+        }
+        case BinEditPieceTable::Added:
+            m_pieces->addBuffer()->copy(target, piece.start, int(piece.length));
+            break;
+        case BinEditPieceTable::Fill:
+            ::memset(target, int(piece.start), size_t(piece.length));
+            break;
+        }
+    }
+
+    if (complete) {
+        if (m_editedBlocks.size() >= EditedBlockCacheSize)
+            m_editedBlocks.clear();
+        m_editedBlocks.insert(block, data);
     }
-    BlockMap::const_iterator it = m_modifiedData.find(block);
-    return it != m_modifiedData.constEnd()
-            ? it.value() : m_data.value(block, m_emptyBlock);
+    return data;
+}
+
+/*!
+    Returns true if \a block differs from the original data by edits.
+*/
+bool BinEdit::isBlockEdited(qint64 block) const
+{
+    if (m_pieces->isIdentity())
+        return false;
+    const BinEditPieceTable::PieceList pieces = m_pieces->pieces(block * m_blockSize, m_blockSize);
+    if (pieces.size() != 1)
+        return true;
+    const BinEditPieceTable::Piece &piece = pieces.first();
+    return piece.source != BinEditPieceTable::Original || piece.start != piece.position;
 }
 
 /*void BinEditor::setFontSettings(const TextEditor::FontSettings &fs)
@@ -346,6 +872,9 @@ void BinEdit::timerEvent(QTimerEvent *e)
     } else if (e->timerId() == m_cursorBlinkTimer.timerId()) {
         m_cursorVisible = !m_cursorVisible;
         updateLines();
+    } else if (e->timerId() == m_refreshTimer.timerId()) {
+        if (isVisible())
+            refreshContents();
     }
     QAbstractScrollArea::timerEvent(e);
 }
@@ -353,16 +882,17 @@ void BinEdit::timerEvent(QTimerEvent *e)
 
 void BinEdit::setModified(bool modified)
 {
-    int unmodifiedState = modified ? -1 : m_undoStack.size();
-    if (unmodifiedState == m_unmodifiedState)
-        return;
-    m_unmodifiedState = unmodifiedState;
-    emit modificationChanged(m_undoStack.size() != m_unmodifiedState);
+    const bool wasModified = isModified();
+    m_journal->setClean(!modified);
+    if (isModified() != wasModified) {
+        emit modificationChanged(isModified());
+        m_sharedFile->notifyStateChanged(this);
+    }
 }
 
 bool BinEdit::isModified() const
 {
-    return (m_undoStack.size() != m_unmodifiedState);
+    return !m_journal->isClean();
 }
 
 void BinEdit::setReadOnly(bool readOnly)
@@ -372,53 +902,212 @@ void BinEdit::setReadOnly(bool readOnly)
 
 bool BinEdit::isReadOnly() const
 {
-    return m_readOnly;
+    return m_readOnly || processMemory() || compressedFile();
 }
 
-bool BinEdit::save(QString * /*errorString*/, const QString &oldFileName, const QString &newFileName)
+bool BinEdit::save(QString *errorString, const QString &oldFileName, const QString &newFileName)
 {
-    if (oldFileName != newFileName) {
-        QString tmpName;
-        {
-            QTemporaryFile tmp(newFileName + QLatin1String("_XXXXXX.new"));
-            if (!tmp.open())
-                return false;
-            tmpName = tmp.fileName();
-        }
-        if (!QFile::copy(oldFileName, tmpName))
-            return false;
-        if (QFile::exists(newFileName) && !QFile::remove(newFileName))
-            return false;
-        if (!QFile::rename(tmpName, newFileName))
-            return false;
+    if (!m_provider.isOpen() || processMemory()) {
+        if (errorString)
+            *errorString = tr("There is no file to save.");
+        return false;
     }
-    /*Utils::FileSaver saver(newFileName, QIODevice::ReadWrite); // QtBug: WriteOnly truncates.
-    if (!saver.hasError()) {
-        QFile *output = saver.file();
-        const qint64 size = output->size();
-        for (BlockMap::const_iterator it = m_modifiedData.constBegin();
-            it != m_modifiedData.constEnd(); ++it) {
-            if (!saver.setResult(output->seek(it.key() * m_blockSize)))
-                break;
-            if (!saver.write(it.value()))
-                break;
-            if (!saver.setResult(output->flush()))
+    if (compressedFile()) {
+        if (errorString)
+            *errorString = tr("Decompressed data cannot be saved.");
+        return false;
+    }
+
+    // Exports, data on the clipboard and undo steps keep referring to the
+    // data that is about to be overwritten, they need their own copy of it.
+    // Comparisons just read it, they are stopped.
+    emit sourceAboutToChange();
+    m_export->cancel();
+    detachClipboardData();
+    const bool hadUndo = isUndoAvailable();
+    const bool hadRedo = isRedoAvailable();
+    if (!m_journal->detach(&m_provider, m_baseAddr, m_pieces->addBuffer().data()))
+        qWarning() << "BinEditor::save" << "Dropped undo steps:" << m_pieces->addBuffer()->errorString();
+    emitUndoState(isModified(), hadUndo, hadRedo);
+
+    // Overwritten bytes can be patched in place, anything that moves data is
+    // written to a temporary file that replaces the target once it is complete.
+    const bool inPlace = oldFileName == newFileName
+            && QFileInfo(newFileName).size() == m_provider.size()
+            && m_pieces->size() == m_pieces->originalSize()
+            && !m_pieces->hasMovedData();
+    const bool ok = inPlace ? saveInPlace(errorString, newFileName)
+                            : saveCopy(errorString, newFileName);
+    if (!ok)
+        return false;
+
+    setModified(false);
+    return true;
+}
+
+bool BinEdit::saveInPlace(QString *errorString, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadWrite)) { // WriteOnly truncates.
+        if (errorString)
+            *errorString = writeErrorString(fileName, file.errorString());
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    const BinEditPieceTable::PieceList pieces = m_pieces->pieces();
+    foreach (const BinEditPieceTable::Piece &piece, pieces) {
+        if (piece.source == BinEditPieceTable::Original)
+            continue;
+        const BinEditPieceTable::PieceList written = BinEditPieceTable::PieceList() << piece;
+        for (qint64 from = piece.position; from < piece.position + piece.length; from += SaveBufferSize) {
+            const qint64 offset = m_baseAddr + from;
+            const int length = int(qMin<qint64>(qMin<qint64>(SaveBufferSize, piece.position + piece.length - from),
+                                                fileSize - offset));
+            if (length <= 0)
                 break;
+            const QByteArray data = BinEditPieceTable::read(written, m_pieces->addBuffer().data(), 0, 0, from, length);
+            if (!file.seek(offset) || !writeData(&file, data)) {
+                if (errorString)
+                    *errorString = writeErrorString(fileName, file.errorString());
+                return false;
+            }
         }
+    }
 
-        // We may have padded the displayed data, so we have to make sure
-        // changes to that area are not actually written back to disk.
-        if (!saver.hasError())
-            saver.setResult(output->resize(size));
+    if (!file.flush() || !syncFile(&file)) {
+        if (errorString)
+            *errorString = writeErrorString(fileName, file.errorString());
+        return false;
     }
-    if (!saver.finalize(errorString))
-        return false;*/
+    file.close();
 
-    setModified(false);
+    // Saved bytes are on disk now, read them from the file again.
+    m_reader->reset();
+    foreach (const BinEditPieceTable::Piece &piece, pieces) {
+        if (piece.source == BinEditPieceTable::Original)
+            continue;
+        const qint64 last = (piece.position + piece.length - 1) / m_blockSize;
+        for (qint64 block = piece.position / m_blockSize; block <= last; ++block)
+            m_data->remove(block);
+    }
+    resetEdits();
+    startOverview();
+    return true;
+}
+
+bool BinEdit::saveCopy(QString *errorString, const QString &fileName)
+{
+    const QFileInfo info(fileName);
+    QTemporaryFile file(info.absolutePath() + QLatin1String("/.")
+                        + info.fileName() + QLatin1String(".XXXXXX"));
+    if (!file.open()) {
+        if (errorString)
+            *errorString = writeErrorString(fileName, file.errorString());
+        return false;
+    }
+
+    // The file is written as data before the edited range, the edited range
+    // composed from its pieces and data after it.
+    const qint64 fileSize = m_provider.size();
+    const qint64 rangeEnd = qMin<qint64>(m_baseAddr + m_pieces->originalSize(), fileSize);
+    const BinEditPieceTable::PieceList pieces = m_pieces->pieces();
+    bool ok = true;
+    for (qint64 offset = 0; ok && offset < qint64(m_baseAddr); offset += SaveBufferSize) {
+        const int length = int(qMin<qint64>(SaveBufferSize, m_baseAddr - offset));
+        ok = writeData(&file, m_provider.read(offset, length));
+    }
+    for (qint64 from = 0; ok && from < m_pieces->size(); from += SaveBufferSize) {
+        const int length = int(qMin<qint64>(SaveBufferSize, m_pieces->size() - from));
+        ok = writeData(&file, BinEditPieceTable::read(pieces, m_pieces->addBuffer().data(),
+                                                      &m_provider, m_baseAddr, from, length));
+    }
+    for (qint64 offset = rangeEnd; ok && offset < fileSize; offset += SaveBufferSize) {
+        const int length = int(qMin<qint64>(SaveBufferSize, fileSize - offset));
+        ok = writeData(&file, m_provider.read(offset, length));
+    }
+
+    if (!ok || !file.flush() || !syncFile(&file)) {
+        if (errorString)
+            *errorString = writeErrorString(fileName, file.errorString());
+        return false;
+    }
+
+    const QString sourceName = info.exists() ? fileName : m_fileName;
+    if (!sourceName.isEmpty())
+        file.setPermissions(QFile::permissions(sourceName));
+    file.close();
+
+    if (!replaceFile(file.fileName(), fileName)) {
+        if (errorString)
+            *errorString = writeErrorString(fileName, tr("Cannot replace the file."));
+        return false;
+    }
+    file.setAutoRemove(false);
+
+    // The new file has all the changes, continue editing it.
+    reopen(fileName);
     return true;
 }
 
-void BinEdit::setSizes(quint64 startAddr, int range, int blockSize)
+void BinEdit::reopen(const QString &fileName)
+{
+    QIODevice *oldDevice = m_device;
+    // Other editors of a file saved under another name keep showing the old
+    // file with their edits, the editor that saved it continues alone.
+    const bool renamed = fileName != m_fileName;
+    if (renamed && m_sharedFile->isShared())
+        setSharedFile(BinEditSharedFile::create());
+
+    attachDevice(new QFile(fileName, this), fileName);
+    if (oldDevice && oldDevice->parent() == this)
+        delete oldDevice;
+    // Blocks of other editors still show the file before it was replaced.
+    m_data->clear();
+    if (QFile *file = qobject_cast<QFile *>(m_device))
+        m_sharedFile->setFile(file);
+    resetEdits();
+    if (!renamed)
+        m_sharedFile->notifyReopened(this, fileName);
+}
+
+// The overview describes the file on disk, it is recomputed whenever the
+// file is opened, saved or changed by others. It would describe the
+// compressed bytes of decompressed views.
+void BinEdit::startOverview()
+{
+    if (m_provider.isOpen() && !m_fileName.isEmpty() && !compressedFile())
+        m_overview->start(m_fileName, m_provider.size());
+    else
+        m_overview->clear();
+    updateOverviewRange();
+}
+
+/*!
+    Makes the current contents the original data after they were saved.
+    The add buffer is kept for the undo steps.
+*/
+void BinEdit::resetEdits()
+{
+    m_pieces->rebase(m_size);
+    m_editedBlocks.clear();
+    invalidateLines();
+    viewport()->update();
+    m_sharedFile->notifyStateChanged(this);
+}
+
+/*!
+    Makes data this editor put on the clipboard independent of the original
+    data, which is about to change or go away.
+*/
+void BinEdit::detachClipboardData()
+{
+    if (m_clipboardData && !m_clipboardData->detach())
+        qWarning() << "BinEditor::detachClipboardData" << "Cannot keep clipboard data:"
+                   << m_clipboardData->addBuffer()->errorString();
+}
+
+void BinEdit::setSizes(quint64 startAddr, qint64 range, int blockSize)
 {
     int newBlockSize = blockSize;
     if ((blockSize/m_bytesPerLine) * m_bytesPerLine != blockSize) {
@@ -431,8 +1120,11 @@ void BinEdit::setSizes(quint64 startAddr, int range, int blockSize)
     newBaseAddr = (newBaseAddr / blockSize) * blockSize;
 
     const quint64 maxRange = Q_UINT64_C(0xffffffffffffffff) - newBaseAddr + 1;
-    int newSize = newBaseAddr != 0 && quint64(range) >= maxRange
+    qint64 newSize = newBaseAddr != 0 && quint64(range) >= maxRange
               ? maxRange : range;
+    // Files are never shown past their end, edits may change the size.
+    if (m_provider.isOpen())
+        newSize = qBound<qint64>(0, m_provider.size() - qint64(newBaseAddr), newSize);
     int newAddressBytes = (newBaseAddr + newSize < quint64(1) << 32
                    && newBaseAddr + newSize >= newBaseAddr) ? 4 : 8;
 
@@ -444,18 +1136,34 @@ void BinEdit::setSizes(quint64 startAddr, int range, int blockSize)
             && newAddressBytes == m_addressBytes)
         return;
 
+    const bool wasModified = isModified();
+    const bool hadUndo = isUndoAvailable();
+    const bool hadRedo = isRedoAvailable();
+    // Blocks and edits of a shared file are relative to its start.
+    if (newBaseAddr != 0 && !m_sharedFile->key().isEmpty())
+        setSharedFile(BinEditSharedFile::create());
+    // Another editor of the file may have edits of it already.
+    const bool keepEdits = m_sharedFile->isShared() && blockSize == m_blockSize
+            && m_pieces->originalSize() == newSize;
+    m_reader->reset();
+    invalidateLines();
     m_blockSize = blockSize;
     m_emptyBlock = QByteArray(blockSize, '\0');
-    m_modifiedData.clear();
+    if (!keepEdits)
+        m_pieces->reset(newSize);
+    m_editedBlocks.clear();
     m_requests.clear();
 
     m_baseAddr = newBaseAddr;
-    m_size = newSize;
+    m_size = keepEdits ? m_pieces->size() : newSize;
     m_addressBytes = newAddressBytes;
 
-    m_unmodifiedState = 0;
-    m_undoStack.clear();
-    m_redoStack.clear();
+    if (!keepEdits) {
+        m_journal->clear();
+        if (m_sharedFile->isShared())
+            m_sharedFile->notifyStateChanged(this);
+    }
+    emitUndoState(wasModified, hadUndo, hadRedo);
     init();
 
     setCursorPosition(startAddr - m_baseAddr);
@@ -465,22 +1173,163 @@ void BinEdit::setSizes(quint64 startAddr, int range, int blockSize)
 void BinEdit::resizeEvent(QResizeEvent *)
 {
     init();
+    const QRect viewportRect = viewport()->geometry();
+    m_overviewStrip->setGeometry(viewportRect.right() + 1, viewportRect.top(),
+                                 m_overviewStrip->sizeHint().width(), viewportRect.height());
+    updateOverviewRange();
 }
 
 void BinEdit::scrollContentsBy(int dx, int dy)
 {
-    viewport()->scroll(isRightToLeft() ? -dx : dx, dy * m_lineHeight);
-    const QScrollBar * const scrollBar = verticalScrollBar();
-    const int scrollPos = scrollBar->value();
-    if (dy <= 0 && scrollPos == scrollBar->maximum())
+    const qint64 oldTopLine = m_topLine;
+    if (m_pendingTopLine >= 0) {
+        m_topLine = m_pendingTopLine;
+        m_pendingTopLine = -1;
+    } else if (dy != 0) {
+        m_topLine = lineForScrollValue(verticalScrollBar()->value());
+    }
+
+    const qint64 lines = oldTopLine - m_topLine;
+    if (lines != 0)
+        m_readAheadDirection = lines < 0 ? 1 : -1;
+    if (qAbs(lines) <= m_numVisibleLines)
+        viewport()->scroll(isRightToLeft() ? -dx : dx, int(lines) * m_lineHeight);
+    else
+        viewport()->update();
+    if (lines != 0)
+        emit topPositionChanged(topPosition());
+
+    if (dy == 0)
+        return;
+    if (lines <= 0 && m_topLine == maxTopLine())
         emit newRangeRequested(baseAddress() + m_size);
-    else if (dy >= 0 && scrollPos == scrollBar->minimum())
+    else if (lines >= 0 && m_topLine == 0)
         emit newRangeRequested( baseAddress());
 }
 
+qint64 BinEdit::maxTopLine() const
+{
+    return qMax<qint64>(0, m_numLines - m_numVisibleLines);
+}
+
+bool BinEdit::isScrollBarScaled() const
+{
+    return maxTopLine() > MaxScrollBarRange;
+}
+
+qint64 BinEdit::lineForScrollValue(int value) const
+{
+    const qint64 maxLine = maxTopLine();
+    if (!isScrollBarScaled())
+        return value;
+
+    // Exact floor(maxLine * value / MaxScrollBarRange) without overflowing.
+    const qint64 quotient = maxLine / MaxScrollBarRange;
+    const qint64 remainder = maxLine % MaxScrollBarRange;
+    return quotient * value + remainder * value / MaxScrollBarRange;
+}
+
+int BinEdit::scrollValueForLine(qint64 line) const
+{
+    const qint64 maxLine = maxTopLine();
+    if (!isScrollBarScaled())
+        return int(line);
+
+    // Smallest value v with lineForScrollValue(v) >= line, so that mapping
+    // back and forth is stable.
+    int low = 0;
+    int high = MaxScrollBarRange;
+    line = qBound<qint64>(0, line, maxLine);
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (lineForScrollValue(middle) < line)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+void BinEdit::setTopLine(qint64 line)
+{
+    line = qBound<qint64>(0, line, maxTopLine());
+    m_pendingTopLine = line;
+    verticalScrollBar()->setValue(scrollValueForLine(line));
+    if (m_pendingTopLine >= 0) {
+        // Value didn't change, scrollContentsBy() was not called.
+        m_pendingTopLine = -1;
+        moveTopLine(line);
+    }
+}
+
+// Moves the top line without the scroll bar, which didn't change.
+void BinEdit::moveTopLine(qint64 line)
+{
+    if (m_topLine == line)
+        return;
+
+    m_topLine = line;
+    viewport()->update();
+    emit topPositionChanged(topPosition());
+}
+
+void BinEdit::updateScrollBar()
+{
+    QScrollBar *scrollBar = verticalScrollBar();
+    const qint64 line = qBound<qint64>(0, m_topLine, maxTopLine());
+
+    m_pendingTopLine = line;
+    if (isScrollBarScaled()) {
+        scrollBar->setRange(0, MaxScrollBarRange);
+        scrollBar->setPageStep(int(qMax<qint64>(1, qint64(m_numVisibleLines) * MaxScrollBarRange / m_numLines)));
+    } else {
+        scrollBar->setRange(0, int(maxTopLine()));
+        scrollBar->setPageStep(m_numVisibleLines);
+    }
+    m_pendingTopLine = line;
+    scrollBar->setValue(scrollValueForLine(line));
+    m_pendingTopLine = -1;
+    moveTopLine(line);
+}
+
+void BinEdit::handleScrollAction(int action)
+{
+    if (!isScrollBarScaled())
+        return;
+
+    // A single scroll bar step covers many lines when the scroll bar is
+    // scaled, step by exact line counts instead.
+    qint64 line = m_topLine;
+    switch (action) {
+    case QAbstractSlider::SliderSingleStepAdd: line += 1; break;
+    case QAbstractSlider::SliderSingleStepSub: line -= 1; break;
+    case QAbstractSlider::SliderPageStepAdd: line += m_numVisibleLines; break;
+    case QAbstractSlider::SliderPageStepSub: line -= m_numVisibleLines; break;
+    case QAbstractSlider::SliderToMinimum: line = 0; break;
+    case QAbstractSlider::SliderToMaximum: line = maxTopLine(); break;
+    default:
+        return;
+    }
+
+    line = qBound<qint64>(0, line, maxTopLine());
+    QScrollBar *scrollBar = verticalScrollBar();
+    const int value = scrollValueForLine(line);
+    if (value == scrollBar->value()) {
+        scrollBar->setSliderPosition(value);
+        moveTopLine(line);
+    } else {
+        m_pendingTopLine = line;
+        scrollBar->setSliderPosition(value);
+    }
+}
+
 void BinEdit::changeEvent(QEvent *e)
 {
     QAbstractScrollArea::changeEvent(e);
+    if (e->type() == QEvent::PaletteChange) {
+        m_glyphs.clear();
+        invalidateLines();
+    }
     if (e->type() == QEvent::ActivationChange) {
         if (!isActiveWindow())
             m_autoScrollTimer.stop();
@@ -500,6 +1349,11 @@ void BinEdit::wheelEvent(QWheelEvent *e)
             zoomIn();
         return;
     }
+    if (isScrollBarScaled() && e->orientation() == Qt::Vertical) {
+        e->accept();
+        setTopLine(m_topLine - e->delta() * QApplication::wheelScrollLines() / 120);
+        return;
+    }
     QAbstractScrollArea::wheelEvent(e);
 }
 
@@ -507,11 +1361,10 @@ void BinEdit::wheelEvent(QWheelEvent *e)
 
 QRect BinEdit::cursorRect() const
 {
-    int topLine = verticalScrollBar()->value();
-    int line = m_cursorPosition / m_bytesPerLine;
-    int y = (line - topLine) * m_lineHeight;
+    const qint64 line = m_cursorPosition / m_bytesPerLine;
+    int y = int(qBound<qint64>(-1, line - m_topLine, m_numVisibleLines + 1)) * m_lineHeight;
     int xoffset = horizontalScrollBar()->value();
-    int column = m_cursorPosition % m_bytesPerLine;
+    int column = int(m_cursorPosition % m_bytesPerLine);
     int x = m_hexCursor
             ? (-xoffset + m_margin + m_labelWidth + column * m_columnWidth)
             : (-xoffset + m_margin + m_labelWidth + m_bytesPerLine * m_columnWidth
@@ -520,19 +1373,19 @@ QRect BinEdit::cursorRect() const
     return QRect(x, y, w, m_lineHeight);
 }
 
-int BinEdit::posAt(const QPoint &pos) const
+qint64 BinEdit::posAt(const QPoint &pos) const
 {
     int xoffset = horizontalScrollBar()->value();
     int x = xoffset + pos.x() - m_margin - m_labelWidth;
     int column = qMin(15, qMax(0,x) / m_columnWidth);
-    int topLine = verticalScrollBar()->value();
+    qint64 topLine = m_topLine;
     int line = pos.y() / m_lineHeight;
 
 
     if (x > m_bytesPerLine * m_columnWidth + m_charWidth/2) {
         x -= m_bytesPerLine * m_columnWidth + m_charWidth;
         for (column = 0; column < 15; ++column) {
-            int dataPos = (topLine + line) * m_bytesPerLine + column;
+            qint64 dataPos = (topLine + line) * m_bytesPerLine + column;
             if (dataPos < 0 || dataPos >= m_size)
                 break;
             QChar qc(QLatin1Char(dataAt(dataPos)));
@@ -544,7 +1397,7 @@ int BinEdit::posAt(const QPoint &pos) const
         }
     }
 
-    return qMin(m_size, qMin(m_numLines, topLine + line) * m_bytesPerLine) + column;
+    return qMin(m_size, qMin<qint64>(m_numLines, topLine + line) * m_bytesPerLine) + column;
 }
 
 bool BinEdit::inTextArea(const QPoint &pos) const
@@ -559,44 +1412,32 @@ void BinEdit::updateLines()
     updateLines(m_cursorPosition, m_cursorPosition);
 }
 
-void BinEdit::updateLines(int fromPosition, int toPosition)
+void BinEdit::updateLines(qint64 fromPosition, qint64 toPosition)
 {
-    int topLine = verticalScrollBar()->value();
-    int firstLine = qMin(fromPosition, toPosition) / m_bytesPerLine;
-    int lastLine = qMax(fromPosition, toPosition) / m_bytesPerLine;
-    int y = (firstLine - topLine) * m_lineHeight;
-    int h = (lastLine - firstLine + 1 ) * m_lineHeight;
+    const qint64 firstLine = qMax(m_topLine, qMin(fromPosition, toPosition) / m_bytesPerLine);
+    const qint64 lastLine = qMin<qint64>(m_topLine + m_numVisibleLines,
+                                         qMax(fromPosition, toPosition) / m_bytesPerLine);
+    if (firstLine > lastLine)
+        return;
+
+    int y = int(firstLine - m_topLine) * m_lineHeight;
+    int h = int(lastLine - firstLine + 1) * m_lineHeight;
 
     viewport()->update(0, y, viewport()->width(), h);
 }
 
 bool BinEdit::setOffset(/*QString *errorString,*/ /*const QString &fileName,*/ quint64 offset)
 {
-    if (m_device == 0) {
+    if (m_device == 0 || m_provider.size() == 0) {
         setSizes(0, 0);
         return true;
     }
 
-    if (offset >= static_cast<quint64>(m_device->size()))
+    if (offset >= static_cast<quint64>(m_provider.size()))
         return false;
 
-    if (m_device->open(QIODevice::ReadOnly)) {
-        m_device->close();
-        setSizes(offset, m_device->size());
-        return true;
-    }
-
-    QString errStr;
-    if (m_fileName.isEmpty()) {
-        errStr = tr("Cannot open device: %2").arg(m_device->errorString());
-    } else {
-        errStr = tr("Cannot open %1: %2").
-                arg(QDir::toNativeSeparators(m_fileName)).
-                arg(m_device->errorString());
-    }
-    raiseError(errStr);
-
-    return false;
+    setSizes(offset, m_provider.size());
+    return true;
 //    QFile file(fileName);
 //    if (offset >= static_cast<quint64>(file.size()))
 //        return false;
@@ -618,154 +1459,187 @@ bool BinEdit::setOffset(/*QString *errorString,*/ /*const QString &fileName,*/ q
 //    return false;
 }
 
-int BinEdit::dataIndexOf(const QByteArray &pattern, int from, bool caseSensitive) const
+/*!
+    Returns the first position at or after \a from where one of \a matchers
+    matches and stores the index of that matcher in \a matcherIndex.
+    Returns -2 if nothing was found within SearchStride bytes.
+*/
+qint64 BinEdit::dataIndexOf(const QVector<BinEditMatcher> &matchers, qint64 from,
+                            int *matcherIndex) const
 {
-    int trailing = pattern.size();
-    if (trailing > m_blockSize)
-        return -1;
-
-    QByteArray buffer;
-    buffer.resize(m_blockSize + trailing);
-    char *b = buffer.data();
-    QByteArrayMatcher matcher(pattern);
-
-    int block = from / m_blockSize;
-    const int end =
-        qMin<qint64>(static_cast<qint64>(from) + SearchStride, m_size);
-    while (from < end) {
+    QByteArray previous;
+    qint64 block = from / m_blockSize;
+    const qint64 end = qMin<qint64>(from + SearchStride, m_size);
+    for (; block * m_blockSize < end; ++block) {
         if (!requestDataAt(block * m_blockSize))
             return -1;
-        QByteArray data = blockData(block);
-        ::memcpy(b, b + m_blockSize, trailing);
-        ::memcpy(b + trailing, data.constData(), m_blockSize);
-
-        if (!caseSensitive)
-            ::lower(buffer);
-
-        int pos = matcher.indexIn(buffer, from - (block * m_blockSize) + trailing);
-        if (pos >= 0)
-            return pos + block * m_blockSize - trailing;
-        ++block;
-        from = block * m_blockSize - trailing;
+        const QByteArray data = blockData(block);
+        const qint64 blockStart = block * m_blockSize;
+
+        qint64 found = -1;
+        for (int i = 0; i < matchers.size(); ++i) {
+            const BinEditMatcher &matcher = matchers.at(i);
+            const int trailing = matcher.size() - 1;
+            if (trailing >= m_blockSize)
+                continue;
+
+            qint64 pos = -1;
+            // Matches crossing the boundary to the previous block start before
+            // anything found in this block.
+            if (!previous.isEmpty() && trailing > 0) {
+                const QByteArray seam = previous.right(trailing) + data.left(trailing);
+                const qint64 seamStart = blockStart - trailing;
+                const int index = matcher.indexIn(seam, int(qMax<qint64>(0, from - seamStart)));
+                if (index >= 0)
+                    pos = seamStart + index;
+            }
+            if (pos < 0) {
+                const int index = matcher.indexIn(data, int(qMax(from, blockStart) - blockStart));
+                if (index >= 0)
+                    pos = blockStart + index;
+            }
+            if (pos >= 0 && (found < 0 || pos < found)) {
+                found = pos;
+                if (matcherIndex)
+                    *matcherIndex = i;
+            }
+        }
+        if (found >= 0)
+            return found;
+        previous = data;
     }
     return end == m_size ? -1 : -2;
 }
 
-int BinEdit::dataLastIndexOf(const QByteArray &pattern, int from, bool caseSensitive) const
-{
-    int trailing = pattern.size();
-    if (trailing > m_blockSize)
-        return -1;
-
-    QByteArray buffer;
-    buffer.resize(m_blockSize + trailing);
-    char *b = buffer.data();
-
-    int block = from / m_blockSize;
-    const int lowerBound = qMax(0, from - SearchStride);
-    while (from > lowerBound) {
+/*!
+    Returns the last position at or before \a from where one of \a matchers
+    matches and stores the index of that matcher in \a matcherIndex.
+    Returns -2 if nothing was found within SearchStride bytes.
+*/
+qint64 BinEdit::dataLastIndexOf(const QVector<BinEditMatcher> &matchers, qint64 from,
+                                int *matcherIndex) const
+{
+    QByteArray next;
+    qint64 block = from / m_blockSize;
+    if ((block + 1) * m_blockSize < m_size && requestDataAt((block + 1) * m_blockSize))
+        next = blockData(block + 1);
+    const qint64 lowerBound = qMax<qint64>(0, from - SearchStride);
+    for (; block >= 0 && (block + 1) * m_blockSize > lowerBound; --block) {
         if (!requestDataAt(block * m_blockSize))
             return -1;
-        QByteArray data = blockData(block);
-        ::memcpy(b + m_blockSize, b, trailing);
-        ::memcpy(b, data.constData(), m_blockSize);
-
-        if (!caseSensitive)
-            ::lower(buffer);
-
-        int pos = buffer.lastIndexOf(pattern, from - (block * m_blockSize));
-        if (pos >= 0)
-            return pos + block * m_blockSize;
-        --block;
-        from = block * m_blockSize + (m_blockSize-1) + trailing;
+        const QByteArray data = blockData(block);
+        const qint64 blockStart = block * m_blockSize;
+
+        qint64 found = -1;
+        for (int i = 0; i < matchers.size(); ++i) {
+            const BinEditMatcher &matcher = matchers.at(i);
+            const int trailing = matcher.size() - 1;
+            if (trailing >= m_blockSize)
+                continue;
+
+            qint64 pos = -1;
+            // Matches crossing the boundary to the next block start after
+            // anything found in this block.
+            if (!next.isEmpty() && trailing > 0) {
+                const QByteArray seam = data.right(trailing) + next.left(trailing);
+                const qint64 seamStart = blockStart + m_blockSize - trailing;
+                if (from >= seamStart) {
+                    const int index = matcher.lastIndexIn(seam, int(qMin<qint64>(from - seamStart, trailing)));
+                    if (index >= 0)
+                        pos = seamStart + index;
+                }
+            }
+            if (pos < 0) {
+                const int index = matcher.lastIndexIn(data, int(qMin<qint64>(from - blockStart, m_blockSize - 1)));
+                if (index >= 0)
+                    pos = blockStart + index;
+            }
+            if (pos > found) {
+                found = pos;
+                if (matcherIndex)
+                    *matcherIndex = i;
+            }
+        }
+        if (found >= 0)
+            return found;
+        next = data;
     }
     return lowerBound == 0 ? -1 : -2;
 }
 
 
-int BinEdit::find(const QByteArray &pattern_arg, int from,
+qint64 BinEdit::find(const QByteArray &pattern, qint64 from,
                     QTextDocument::FindFlags findFlags)
 {
-    if (pattern_arg.isEmpty())
+    if (pattern.isEmpty())
         return 0;
 
-    QByteArray pattern = pattern_arg;
-
-    bool caseSensitiveSearch = (findFlags & QTextDocument::FindCaseSensitively);
-
-    if (!caseSensitiveSearch)
-        ::lower(pattern);
-
-    bool backwards = (findFlags & QTextDocument::FindBackward);
-    int found = backwards ? dataLastIndexOf(pattern, from, caseSensitiveSearch)
-                : dataIndexOf(pattern, from, caseSensitiveSearch);
+    // Text and hex interpretations of the pattern are searched in one pass.
+    const QVector<BinEditMatcher> matchers =
+            patternMatchers(pattern, findFlags & QTextDocument::FindCaseSensitively);
 
-    int foundHex = -1;
-    QByteArray hexPattern = calculateHexPattern(pattern_arg);
-    if (!hexPattern.isEmpty()) {
-        foundHex = backwards ? dataLastIndexOf(hexPattern, from)
-                   : dataIndexOf(hexPattern, from);
-    }
-
-    int pos = foundHex == -1 || (found >= 0 && (foundHex == -2 || found < foundHex))
-              ? found : foundHex;
+    int matcherIndex = 0;
+    qint64 pos = (findFlags & QTextDocument::FindBackward)
+            ? dataLastIndexOf(matchers, from, &matcherIndex)
+            : dataIndexOf(matchers, from, &matcherIndex);
 
     if (pos >= m_size)
         pos = -1;
 
     if (pos >= 0) {
         setCursorPosition(pos);
-        setCursorPosition(pos + (found == pos ? pattern.size() : hexPattern.size()), KeepAnchor);
+        setCursorPosition(pos + matchers.at(matcherIndex).size(), KeepAnchor);
     }
     return pos;
 }
 
-int BinEdit::findPattern(const QByteArray &data, const QByteArray &dataHex,
-    int from, int offset, int *match)
+/*!
+    Searches the whole file for \a pattern in the background, matches are
+    reported by search().
+*/
+void BinEdit::findAll(const QByteArray &pattern, QTextDocument::FindFlags findFlags)
 {
-    if (m_searchPattern.isEmpty())
-        return -1;
-    int normal = m_searchPattern.isEmpty()
-        ? -1 : data.indexOf(m_searchPattern, from - offset);
-    int hex = m_searchPatternHex.isEmpty()
-        ? -1 : dataHex.indexOf(m_searchPatternHex, from - offset);
-
-    if (normal >= 0 && (hex < 0 || normal < hex)) {
-        if (match)
-            *match = m_searchPattern.length();
-        return normal + offset;
-    }
-    if (hex >= 0) {
-        if (match)
-            *match = m_searchPatternHex.length();
-        return hex + offset;
-    }
-
-    return -1;
+    m_search->start(patternMatchers(pattern, findFlags & QTextDocument::FindCaseSensitively),
+                    m_baseAddr, m_pieces->pieces(), m_pieces->addBuffer());
 }
 
+/*!
+    Extracts the strings of at least \a minLength characters in \a
+    encodings from the whole file in the background, they are reported by
+    strings().
+*/
+void BinEdit::extractStrings(int minLength, BinEditStrings::Encodings encodings)
+{
+    m_strings->start(minLength, encodings, m_baseAddr, m_pieces->pieces(), m_pieces->addBuffer());
+}
 
-void BinEdit::drawItems(QPainter *painter, int x, int y, const QString &itemString)
+/*!
+    Computes \a algorithms over the selection if \a selectionOnly is true
+    and there is one, over all data otherwise.
+*/
+void BinEdit::calculateChecksums(BinEditChecksum::Algorithms algorithms, bool selectionOnly)
 {
-    if (m_isMonospacedFont) {
-        painter->drawText(x, y, itemString);
-    } else {
-        for (int i = 0; i < m_bytesPerLine; ++i)
-            painter->drawText(x + i*m_columnWidth, y, itemString.mid(i*3, 2));
-    }
+    const bool selection = selectionOnly && hasSelection();
+    const qint64 from = selection ? selectionStart() : 0;
+    const qint64 length = selection ? selectionEnd() - selectionStart() : m_size;
+    m_checksum->start(algorithms, m_baseAddr, m_pieces->pieces(), m_pieces->addBuffer(), from, length);
 }
 
-void BinEdit::drawChanges(QPainter *painter, int x, int y, const char *changes)
+qint64 BinEdit::findPattern(const QByteArray &data, qint64 from, qint64 offset, int *match)
 {
-    const QBrush red(QColor(250, 150, 150));
-    for (int i = 0; i < m_bytesPerLine; ++i) {
-        if (changes[i]) {
-            painter->fillRect(x + i*m_columnWidth, y - m_ascent,
-                2*m_charWidth, m_lineHeight, red);
+    int found = -1;
+    foreach (const BinEditMatcher &matcher, m_searchMatchers) {
+        const int pos = matcher.indexIn(data, int(from - offset));
+        if (pos >= 0 && (found < 0 || pos < found)) {
+            found = pos;
+            if (match)
+                *match = matcher.size();
         }
     }
+    return found >= 0 ? found + offset : -1;
 }
 
+
 QString BinEdit::addressString(quint64 address)
 {
     QChar *addressStringData = m_addressString.data();
@@ -782,13 +1656,114 @@ QString BinEdit::addressString(quint64 address)
         addressStringData[indices[2*m_addressBytes - 2 - b*2]] =
             hex[(address >> (8*b + 4)) & 0xf];
     }
-    return m_addressString;
+    return m_addressString;
+}
+
+qreal BinEdit::pixelRatio() const
+{
+#if QT_VERSION >= 0x050100
+    return devicePixelRatio();
+#else
+    return 1.0;
+#endif
+}
+
+/*!
+    Drops all cached line pixmaps, used when more than a few blocks change.
+*/
+void BinEdit::invalidateLines()
+{
+    m_lineCache.clear();
+    m_blockGenerations.clear();
+}
+
+/*!
+    Renders \a line into \a pixmap: the address, hex and text columns with
+    selection, search matches, differences and changes. The cursor is not
+    part of the pixmap, it blinks and is drawn on top.
+*/
+void BinEdit::renderLine(QPixmap *pixmap, qint64 line, const LineKey &key)
+{
+    const int hexX = m_margin + m_labelWidth;
+    const int textX = hexX + m_bytesPerLine * m_columnWidth + m_charWidth;
+    const QSize size(textX + m_bytesPerLine * m_glyphs.maxCharWidth(), m_lineHeight);
+    const qreal ratio = pixelRatio();
+    if (pixmap->isNull() || pixmap->size() != size * ratio) {
+        *pixmap = QPixmap(size * ratio);
+#if QT_VERSION >= 0x050100
+        pixmap->setDevicePixelRatio(ratio);
+#endif
+    }
+    pixmap->fill(Qt::transparent);
+
+    QPainter painter(pixmap);
+#if QT_VERSION < 0x050100
+    painter.scale(ratio, ratio);
+#endif
+    painter.setFont(font());
+    painter.setPen(palette().text().color());
+
+    const qint64 lineStart = line * m_bytesPerLine;
+    painter.drawText(0, m_ascent, addressString(m_baseAddr + quint64(lineStart)));
+
+    if (!key.hasData && !key.hasOldData) {
+        // Data is still being read, show placeholder cells.
+        painter.setPen(palette().color(QPalette::Disabled, QPalette::Text));
+        for (int c = 0; c < m_bytesPerLine && lineStart + c < m_size; ++c)
+            painter.drawText(hexX + c * m_columnWidth, m_ascent, QLatin1String("??"));
+        return;
+    }
+
+    const bool isOld = key.hasOldData && !key.hasData;
+    const QColor textColor = palette().text().color();
+    const QColor highlightedTextColor = palette().highlightedText().color();
+    const QBrush highlight = palette().highlight();
+    const QColor matchColor(0xffef0b);
+    const QColor changedColor(250, 150, 150);
+
+    int printableX = textX;
+    for (int c = 0; c < m_bytesPerLine; ++c) {
+        const qint64 pos = lineStart + c;
+        if (pos >= m_size)
+            break;
+
+        const uchar value = uchar(dataAt(pos, isOld));
+        const int itemX = hexX + c * m_columnWidth;
+        const int charWidth = m_glyphs.charWidth(value);
+        const bool selected = c >= key.selectionStart && c < key.selectionEnd;
+
+        if (selected) {
+            painter.fillRect(itemX, 0, m_columnWidth, m_lineHeight, highlight);
+            painter.fillRect(printableX, 0, charWidth, m_lineHeight, highlight);
+        } else {
+            const char highlights = key.highlights.at(c);
+            if (highlights & MatchHighlight) {
+                painter.fillRect(itemX, 0, m_columnWidth, m_lineHeight, matchColor);
+                painter.fillRect(printableX, 0, charWidth, m_lineHeight, matchColor);
+            } else if (highlights & DifferenceHighlight) {
+                painter.fillRect(itemX, 0, m_columnWidth, m_lineHeight, changedColor);
+                painter.fillRect(printableX, 0, charWidth, m_lineHeight, changedColor);
+            }
+            if (key.hasOldData && !isOld && value != uchar(dataAt(pos, true)))
+                painter.fillRect(itemX, 0, 2 * m_charWidth, m_lineHeight, changedColor);
+        }
+
+        const QColor &color = selected ? highlightedTextColor : textColor;
+        m_glyphs.drawHex(&painter, itemX, 0, value, color);
+        m_glyphs.drawChar(&painter, printableX, 0, value, color);
+        printableX += charWidth;
+    }
 }
 
 void BinEdit::paintEvent(QPaintEvent *e)
 {
     QPainter painter(viewport());
-    const int topLine = verticalScrollBar()->value();
+    const qint64 topLine = m_topLine;
+
+    // Keep the blocks behind the viewport while painting requests more.
+    m_data->setPinnedRange(this, topLine * m_bytesPerLine / m_blockSize,
+                           (topLine + m_numVisibleLines + 1) * m_bytesPerLine / m_blockSize);
+    scheduleReadAhead();
     const int xoffset = horizontalScrollBar()->value();
     const int x1 = -xoffset + m_margin + m_labelWidth - m_charWidth/2;
     const int x2 = -xoffset + m_margin + m_labelWidth + m_bytesPerLine * m_columnWidth + m_charWidth/2;
@@ -804,18 +1779,14 @@ void BinEdit::paintEvent(QPaintEvent *e)
 
     int matchLength = 0;
 
-    QByteArray patternData, patternDataHex;
-    int patternOffset = qMax(0, topLine*m_bytesPerLine - m_searchPattern.size());
-    if (!m_searchPattern.isEmpty()) {
-        patternData = dataMid(patternOffset, m_numVisibleLines * m_bytesPerLine + (topLine*m_bytesPerLine - patternOffset));
-        patternDataHex = patternData;
-        if (!m_caseSensitiveSearch)
-            ::lower(patternData);
-    }
+    QByteArray patternData;
+    qint64 patternOffset = qMax<qint64>(0, topLine*m_bytesPerLine - maxPatternSize(m_searchMatchers));
+    if (!m_searchMatchers.isEmpty())
+        patternData = dataMid(patternOffset, m_numVisibleLines * m_bytesPerLine + int(topLine*m_bytesPerLine - patternOffset));
 
-    int foundPatternAt = findPattern(patternData, patternDataHex, patternOffset, patternOffset, &matchLength);
+    qint64 foundPatternAt = findPattern(patternData, patternOffset, patternOffset, &matchLength);
 
-    int selStart, selEnd;
+    qint64 selStart, selEnd;
     if (m_cursorPosition >= m_anchorPosition) {
         selStart = m_anchorPosition;
         selEnd = m_cursorPosition;
@@ -824,206 +1795,130 @@ void BinEdit::paintEvent(QPaintEvent *e)
         selEnd = m_anchorPosition + 1;
     }
 
-    QString itemString(m_bytesPerLine*3, QLatin1Char(' '));
-    QChar *itemStringData = itemString.data();
-    char changedString[160] = { false };
-
-    if ( !((size_t)m_bytesPerLine < sizeof(changedString)) ) {
-        qWarning() << "BinEditor::paintEvent" << "!((size_t)m_bytesPerLine < sizeof(changedString))";
-        return;
-    }
+    const int x = -xoffset + m_margin + m_labelWidth;
+    const int text_x = x + m_bytesPerLine * m_columnWidth + m_charWidth;
+    const bool cursorWanted = m_cursorPosition == m_anchorPosition;
+    const QFontMetrics &fm = painter.fontMetrics();
     const char *hex = "0123456789abcdef";
 
-    painter.setPen(palette().text().color());
-    const QFontMetrics &fm = painter.fontMetrics();
     for (int i = 0; i <= m_numVisibleLines; ++i) {
-        int line = topLine + i;
+        qint64 line = topLine + i;
         if (line >= m_numLines)
             break;
 
-        const quint64 lineAddress = m_baseAddr + uint(line) * m_bytesPerLine;
-        int y = i * m_lineHeight + m_ascent;
-        if (y - m_ascent > e->rect().bottom())
+        const int y = i * m_lineHeight;
+        if (y > e->rect().bottom())
             break;
-        if (y + m_descent < e->rect().top())
+        if (y + m_lineHeight < e->rect().top())
             continue;
 
-        painter.drawText(-xoffset, i * m_lineHeight + m_ascent,
-                         addressString(lineAddress));
-
-        int cursor = -1;
-        if (line * m_bytesPerLine <= m_cursorPosition
-                && m_cursorPosition < line * m_bytesPerLine + m_bytesPerLine)
-            cursor = m_cursorPosition - line * m_bytesPerLine;
-
-        bool hasData = requestDataAt(line * m_bytesPerLine);
-        bool hasOldData = requestOldDataAt(line * m_bytesPerLine);
-        bool isOld = hasOldData && !hasData;
-
-        QString printable;
-
-        if (hasData || hasOldData) {
-            for (int c = 0; c < m_bytesPerLine; ++c) {
-                int pos = line * m_bytesPerLine + c;
-                if (pos >= m_size)
-                    break;
-                QChar qc(QLatin1Char(dataAt(pos, isOld)));
-                if (qc.unicode() >= 127 || !qc.isPrint())
-                    qc = 0xB7;
-                printable += qc;
-            }
-        } else {
-            printable = QString(m_bytesPerLine, QLatin1Char(' '));
+        const qint64 lineStart = line * m_bytesPerLine;
+
+        LineKey key;
+        key.hasData = requestDataAt(lineStart, false);
+        key.hasOldData = requestOldDataAt(lineStart);
+        key.firstGeneration = m_blockGenerations.value(lineStart / m_blockSize);
+        key.lastGeneration = m_blockGenerations.value((lineStart + m_bytesPerLine - 1) / m_blockSize);
+        key.selectionStart = key.selectionEnd = 0;
+        if (selStart < selEnd) {
+            key.selectionStart = int(qBound(lineStart, selStart, lineStart + m_bytesPerLine) - lineStart);
+            key.selectionEnd = int(qBound(lineStart, selEnd, lineStart + m_bytesPerLine) - lineStart);
         }
-
-        QRect selectionRect;
-        QRect printableSelectionRect;
-
-        bool isFullySelected = (selStart < selEnd && selStart <= line*m_bytesPerLine && (line+1)*m_bytesPerLine <= selEnd);
-        bool somethingChanged = false;
-
-        if (hasData || hasOldData) {
-            for (int c = 0; c < m_bytesPerLine; ++c) {
-                int pos = line * m_bytesPerLine + c;
-                if (pos >= m_size) {
-                    while (c < m_bytesPerLine) {
-                        itemStringData[c*3] = itemStringData[c*3+1] = ' ';
-                        ++c;
-                    }
-                    break;
-                }
+        key.highlights = QByteArray(m_bytesPerLine, '\0');
+        if (key.hasData || key.hasOldData) {
+            for (int c = 0; c < m_bytesPerLine && lineStart + c < m_size; ++c) {
+                const qint64 pos = lineStart + c;
                 if (foundPatternAt >= 0 && pos >= foundPatternAt + matchLength)
-                    foundPatternAt = findPattern(patternData, patternDataHex, foundPatternAt + matchLength, patternOffset, &matchLength);
-
-
-                const uchar value = uchar(dataAt(pos, isOld));
-                itemStringData[c*3] = hex[value >> 4];
-                itemStringData[c*3+1] = hex[value & 0xf];
-                if (hasOldData && !isOld && value != uchar(dataAt(pos, true))) {
-                    changedString[c] = true;
-                    somethingChanged = true;
-                }
-
-                int item_x = -xoffset +  m_margin + c * m_columnWidth + m_labelWidth;
-
-                QColor color;
+                    foundPatternAt = findPattern(patternData, foundPatternAt + matchLength, patternOffset, &matchLength);
                 if (foundPatternAt >= 0 && pos >= foundPatternAt && pos < foundPatternAt + matchLength)
-                    color = QColor(0xffef0b);
-
-                if (color.isValid()) {
-                    painter.fillRect(item_x, y-m_ascent, m_columnWidth, m_lineHeight, color);
-                    int printable_item_x = -xoffset + m_margin + m_labelWidth + m_bytesPerLine * m_columnWidth + m_charWidth
-                                           + fm.width(printable.left(c));
-                    painter.fillRect(printable_item_x, y-m_ascent,
-                                     fm.width(printable.at(c)),
-                                     m_lineHeight, color);
-                }
-
-                if (selStart < selEnd && !isFullySelected && pos >= selStart && pos < selEnd) {
-                    selectionRect |= QRect(item_x, y-m_ascent, m_columnWidth, m_lineHeight);
-                    int printable_item_x = -xoffset + m_margin + m_labelWidth + m_bytesPerLine * m_columnWidth + m_charWidth
-                                           + fm.width(printable.left(c));
-                    printableSelectionRect |= QRect(printable_item_x, y-m_ascent,
-                                                    fm.width(printable.at(c)),
-                                                    m_lineHeight);
-                }
+                    key.highlights[c] = char(MatchHighlight);
             }
         }
+        const qint64 lineEnd = qMin(lineStart + m_bytesPerLine, m_size);
+        for (int r = BinEditDiff::findRange(m_diffRanges, m_diffSide, lineStart);
+             r < m_diffRanges.size() && m_diffRanges.at(r).position(m_diffSide) < lineEnd; ++r) {
+            const BinEditDiff::Range &range = m_diffRanges.at(r);
+            const qint64 from = qMax(lineStart, range.position(m_diffSide));
+            const qint64 to = qMin(lineEnd, range.position(m_diffSide) + range.length(m_diffSide));
+            for (int c = int(from - lineStart); c < int(to - lineStart); ++c)
+                key.highlights[c] = char(key.highlights.at(c) | DifferenceHighlight);
+        }
 
-        int x = -xoffset +  m_margin + m_labelWidth;
-        bool cursorWanted = m_cursorPosition == m_anchorPosition;
-
-        if (isFullySelected) {
-            painter.save();
-            painter.fillRect(x, y-m_ascent, m_bytesPerLine*m_columnWidth, m_lineHeight, palette().highlight());
-            painter.setPen(palette().highlightedText().color());
-            drawItems(&painter, x, y, itemString);
-            painter.restore();
-        } else {
-            if (somethingChanged)
-                drawChanges(&painter, x, y, changedString);
-            drawItems(&painter, x, y, itemString);
-            if (!selectionRect.isEmpty()) {
-                painter.save();
-                painter.fillRect(selectionRect, palette().highlight());
-                painter.setPen(palette().highlightedText().color());
-                painter.setClipRect(selectionRect);
-                drawItems(&painter, x, y, itemString);
-                painter.restore();
-            }
+        // Lines are only rendered again when their data, selection or
+        // search matches changed, scrolling just blits cached pixmaps.
+        CachedLine &cached = m_lineCache[line];
+        if (cached.pixmap.isNull() || !(cached.key == key)) {
+            renderLine(&cached.pixmap, line, key);
+            cached.key = key;
         }
+        painter.drawPixmap(-xoffset, y, cached.pixmap);
 
+        if (!cursorWanted || m_cursorPosition < lineStart || m_cursorPosition >= lineStart + m_bytesPerLine)
+            continue;
 
-        if (cursor >= 0 && cursorWanted) {
-            int w = fm.boundingRect(itemString.mid(cursor*3, 2)).width();
-            QRect cursorRect(x + cursor * m_columnWidth, y - m_ascent, w + 1, m_lineHeight);
+        const int cursor = int(m_cursorPosition - lineStart);
+        const bool hasValue = key.hasData || key.hasOldData;
+        const bool isOld = key.hasOldData && !key.hasData;
+        const uchar value = hasValue ? uchar(dataAt(m_cursorPosition, isOld)) : 0;
+
+        QRect cursorRect(x + cursor * m_columnWidth, y, m_glyphs.hexWidth() + 1, m_lineHeight);
+        painter.save();
+        painter.setPen(Qt::red);
+        painter.drawRect(cursorRect.adjusted(0, 0, 0, -1));
+        painter.restore();
+        const bool insertCursor = !m_overwriteMode && canResize() && !m_lowNibble;
+        if (m_hexCursor && m_cursorVisible && insertCursor) {
+            painter.fillRect(cursorRect.x(), y, 2, m_lineHeight, Qt::red);
+        } else if (m_hexCursor && m_cursorVisible && hasValue) {
+            if (m_lowNibble)
+                cursorRect.adjust(fm.width(QLatin1Char(hex[value >> 4])), 0, 0, 0);
+            painter.fillRect(cursorRect, Qt::red);
             painter.save();
-            painter.setPen(Qt::red);
-            painter.drawRect(cursorRect.adjusted(0, 0, 0, -1));
+            painter.setClipRect(cursorRect);
+            m_glyphs.drawHex(&painter, x + cursor * m_columnWidth, y, value, Qt::white);
             painter.restore();
-            if (m_hexCursor && m_cursorVisible) {
-                if (m_lowNibble)
-                    cursorRect.adjust(fm.width(itemString.left(1)), 0, 0, 0);
-                painter.fillRect(cursorRect, Qt::red);
-                painter.save();
-                painter.setClipRect(cursorRect);
-                painter.setPen(Qt::white);
-                drawItems(&painter, x, y, itemString);
-                painter.restore();
-            }
         }
 
-        int text_x = -xoffset + m_margin + m_labelWidth + m_bytesPerLine * m_columnWidth + m_charWidth;
-
-        if (isFullySelected) {
-                painter.save();
-                painter.fillRect(text_x, y-m_ascent, fm.width(printable), m_lineHeight,
-                                 palette().highlight());
-                painter.setPen(palette().highlightedText().color());
-                painter.drawText(text_x, y, printable);
-                painter.restore();
+        int printableOffset = 0;
+        for (int c = 0; c < cursor; ++c)
+            printableOffset += hasValue ? m_glyphs.charWidth(uchar(dataAt(lineStart + c, isOld))) : m_charWidth;
+        const QRect printableRect(text_x + printableOffset, y,
+                                  hasValue ? m_glyphs.charWidth(value) : m_charWidth, m_lineHeight);
+        painter.save();
+        if (m_hexCursor || !m_cursorVisible || !hasValue) {
+            painter.setPen(Qt::red);
+            painter.drawRect(printableRect.adjusted(0, 0, 0, -1));
+        } else if (insertCursor) {
+            painter.fillRect(printableRect.x(), y, 2, m_lineHeight, Qt::red);
         } else {
-            painter.drawText(text_x, y, printable);
-            if (!printableSelectionRect.isEmpty()) {
-                painter.save();
-                painter.fillRect(printableSelectionRect, palette().highlight());
-                painter.setPen(palette().highlightedText().color());
-                painter.setClipRect(printableSelectionRect);
-                painter.drawText(text_x, y, printable);
-                painter.restore();
-            }
+            painter.fillRect(printableRect, Qt::red);
+            m_glyphs.drawChar(&painter, printableRect.x(), y, value, Qt::white);
         }
+        painter.restore();
+    }
 
-        if (cursor >= 0 && !printable.isEmpty() && cursorWanted) {
-            QRect cursorRect(text_x + fm.width(printable.left(cursor)),
-                             y-m_ascent,
-                             fm.width(printable.at(cursor)),
-                             m_lineHeight);
-            painter.save();
-            if (m_hexCursor || !m_cursorVisible) {
-                painter.setPen(Qt::red);
-                painter.drawRect(cursorRect.adjusted(0, 0, 0, -1));
-            } else {
-                painter.setClipRect(cursorRect);
-                painter.fillRect(cursorRect, Qt::red);
-                painter.setPen(Qt::white);
-                painter.drawText(text_x, y, printable);
-            }
-            painter.restore();
-        }
+    // Forget lines that scrolled far out of view.
+    QHash<qint64, CachedLine>::iterator it = m_lineCache.begin();
+    while (it != m_lineCache.end()) {
+        if (it.key() < topLine - m_numVisibleLines || it.key() > topLine + 2 * m_numVisibleLines)
+            it = m_lineCache.erase(it);
+        else
+            ++it;
     }
 }
 
 
-int BinEdit::cursorPosition() const
+qint64 BinEdit::cursorPosition() const
 {
     return m_cursorPosition;
 }
 
-void BinEdit::setCursorPosition(int pos, MoveMode moveMode)
+void BinEdit::setCursorPosition(qint64 pos, MoveMode moveMode)
 {
-    pos = qMin(m_size-1, qMax(0, pos));
-    int oldCursorPosition = m_cursorPosition;
+    // In insert mode the cursor can be put behind the last byte to append.
+    const qint64 lastPosition = (m_overwriteMode || !canResize()) ? m_size - 1 : m_size;
+    pos = qMax<qint64>(0, qMin(lastPosition, pos));
+    qint64 oldCursorPosition = m_cursorPosition;
 
     bool hasSelection = m_anchorPosition != m_cursorPosition;
     m_lowNibble = false;
@@ -1051,9 +1946,9 @@ void BinEdit::ensureCursorVisible()
     QRect vr = viewport()->rect();
     if (!vr.contains(cr)) {
         if (cr.top() < vr.top())
-            verticalScrollBar()->setValue(m_cursorPosition / m_bytesPerLine);
+            setTopLine(m_cursorPosition / m_bytesPerLine);
         else if (cr.bottom() > vr.bottom())
-            verticalScrollBar()->setValue(m_cursorPosition / m_bytesPerLine - m_numVisibleLines + 1);
+            setTopLine(m_cursorPosition / m_bytesPerLine - m_numVisibleLines + 1);
     }
 }
 
@@ -1095,21 +1990,29 @@ void BinEdit::mouseReleaseEvent(QMouseEvent *)
 
 void BinEdit::clear()
 {
+    const bool wasModified = isModified();
+    const bool hadUndo = isUndoAvailable();
+    const bool hadRedo = isRedoAvailable();
+    // Other editors of the file keep showing it.
+    if (m_sharedFile->isShared())
+        setSharedFile(BinEditSharedFile::create());
+
     m_baseAddr = 0;
-    m_data.clear();
+    invalidateLines();
+    m_data->clear();
     m_oldData.clear();
-    m_modifiedData.clear();
+    m_pieces->reset(0);
+    m_editedBlocks.clear();
     m_requests.clear();
     m_size = 0;
     m_addressBytes = 4;
 
-    m_unmodifiedState = 0;
-    m_undoStack.clear();
-    m_redoStack.clear();
+    m_journal->clear();
+    emitUndoState(wasModified, hadUndo, hadRedo);
 
     init();
     m_cursorPosition = 0;
-    verticalScrollBar()->setValue(0);
+    setTopLine(0);
 
     emit cursorPositionChanged(m_cursorPosition);
     viewport()->update();
@@ -1128,8 +2031,7 @@ bool BinEdit::event(QEvent *e)
             e->accept();
             return true;
         case Qt::Key_Down: {
-            const QScrollBar * const scrollBar = verticalScrollBar();
-            if (scrollBar->value() >= scrollBar->maximum() - 1) {
+            if (m_topLine >= maxTopLine() - 1) {
                 emit newRangeRequested( baseAddress() + m_size);
                 return true;
             }
@@ -1159,9 +2061,9 @@ bool BinEdit::event(QEvent *e)
 QString BinEdit::toolTip(const QHelpEvent *helpEvent) const
 {
     // Selection if mouse is in, else 1 byte at cursor
-    int selStart = selectionStart();
-    int selEnd = selectionEnd();
-    int byteCount = selEnd - selStart;
+    qint64 selStart = selectionStart();
+    qint64 selEnd = selectionEnd();
+    qint64 byteCount = selEnd - selStart;
     if (byteCount <= 0) {
         selStart = posAt(helpEvent->pos());
         selEnd = selStart + 1;
@@ -1180,8 +2082,8 @@ QString BinEdit::toolTip(const QHelpEvent *helpEvent) const
 
     quint64 bigEndianValue, littleEndianValue;
     quint64 bigEndianValueOld, littleEndianValueOld;
-    asIntegers(selStart, byteCount, bigEndianValue, littleEndianValue);
-    asIntegers(selStart, byteCount, bigEndianValueOld, littleEndianValueOld, true);
+    asIntegers(selStart, int(byteCount), bigEndianValue, littleEndianValue);
+    asIntegers(selStart, int(byteCount), bigEndianValueOld, littleEndianValueOld, true);
     QString littleEndianSigned;
     QString bigEndianSigned;
     QString littleEndianSignedOld;
@@ -1333,6 +2235,23 @@ QString BinEdit::toolTip(const QHelpEvent *helpEvent) const
     return msg;
 }
 
+QString BinEdit::writeErrorString(const QString &fileName, const QString &reason) const
+{
+    return tr("Cannot write %1: %2").
+            arg(QDir::toNativeSeparators(fileName)).
+            arg(reason);
+}
+
+QString BinEdit::openErrorString(const QString &reason) const
+{
+    if (m_fileName.isEmpty())
+        return tr("Cannot open device: %1").arg(reason);
+
+    return tr("Cannot open %1: %2").
+            arg(QDir::toNativeSeparators(m_fileName)).
+            arg(reason);
+}
+
 void BinEdit::raiseError(const QString &errorString)
 {
     QMessageBox::critical(this, tr("Bin Edtor error"), errorString);
@@ -1357,6 +2276,10 @@ void BinEdit::keyPressEvent(QKeyEvent *e)
         e->accept();
         redo();
         return;
+    } else if (e == QKeySequence::Paste) {
+        e->accept();
+        paste();
+        return;
     }
 
 
@@ -1376,10 +2299,10 @@ void BinEdit::keyPressEvent(QKeyEvent *e)
         break;
     case Qt::Key_PageUp:
     case Qt::Key_PageDown: {
-        int line = qMax(0, m_cursorPosition / m_bytesPerLine - verticalScrollBar()->value());
+        qint64 line = qMax<qint64>(0, m_cursorPosition / m_bytesPerLine - m_topLine);
         verticalScrollBar()->triggerAction(e->key() == Qt::Key_PageUp ?
                                            QScrollBar::SliderPageStepSub : QScrollBar::SliderPageStepAdd);
-        setCursorPosition((verticalScrollBar()->value() + line) * m_bytesPerLine + m_cursorPosition % m_bytesPerLine, moveMode);
+        setCursorPosition((m_topLine + line) * m_bytesPerLine + m_cursorPosition % m_bytesPerLine, moveMode);
     } break;
 
     case Qt::Key_Home:
@@ -1396,8 +2319,23 @@ void BinEdit::keyPressEvent(QKeyEvent *e)
             setCursorPosition(m_cursorPosition/m_bytesPerLine * m_bytesPerLine + 15, moveMode);
         }
         break;
+    case Qt::Key_Insert:
+        if (e->modifiers() == Qt::NoModifier && canResize())
+            setOverwriteMode(!m_overwriteMode);
+        break;
+    case Qt::Key_Delete:
+    case Qt::Key_Backspace:
+        if (isReadOnly() || !canResize())
+            break;
+        if (hasSelection())
+            removeData(selectionStart(), selectionEnd() - selectionStart());
+        else if (e->key() == Qt::Key_Delete)
+            removeData(m_cursorPosition, 1);
+        else if (m_cursorPosition > 0)
+            removeData(m_cursorPosition - 1, 1);
+        break;
     default:
-        if (m_readOnly)
+        if (isReadOnly())
             break;
         {
         QString text = e->text();
@@ -1412,19 +2350,28 @@ void BinEdit::keyPressEvent(QKeyEvent *e)
                     nibble = c.unicode() - '0';
                 if (nibble < 0)
                     continue;
-                if (m_lowNibble) {
+                if (!m_lowNibble && !m_overwriteMode && canResize()) {
+                    // The new byte is completed by the low nibble, the
+                    // journal merges both into one step.
+                    editData(m_cursorPosition, 0, QByteArray(1, char(nibble << 4)), true);
+                    m_lowNibble = true;
+                    updateLines();
+                } else if (m_lowNibble) {
                     changeData(m_cursorPosition, nibble + (dataAt(m_cursorPosition) & 0xf0));
                     m_lowNibble = false;
                     setCursorPosition(m_cursorPosition + 1);
                 } else {
-                    changeData(m_cursorPosition, (nibble << 4) + (dataAt(m_cursorPosition) & 0x0f), true);
+                    changeData(m_cursorPosition, (nibble << 4) + (dataAt(m_cursorPosition) & 0x0f));
                     m_lowNibble = true;
                     updateLines();
                 }
             } else {
                 if (c.unicode() >= 128 || !c.isPrint())
                     continue;
-                changeData(m_cursorPosition, c.unicode(), m_cursorPosition + 1);
+                if (!m_overwriteMode && canResize())
+                    editData(m_cursorPosition, 0, QByteArray(1, char(c.unicode())), true);
+                else
+                    changeData(m_cursorPosition, c.unicode());
                 setCursorPosition(m_cursorPosition + 1);
             }
             setBlinkingCursorEnabled(true);
@@ -1452,18 +2399,36 @@ void BinEdit::zoomOut(int range)
 
 void BinEdit::copy(bool raw)
 {
-    int selStart = selectionStart();
-    int selEnd = selectionEnd();
+    qint64 selStart = selectionStart();
+    qint64 selEnd = selectionEnd();
     if (selStart >= selEnd)
         qSwap(selStart, selEnd);
 
-    const int selectionLength = selEnd - selStart;
+    const qint64 selectionLength = selEnd - selStart;
+
+    // Files are put on the clipboard as a snapshot that is only read when the
+    // data is pasted, memory views don't have a provider to read from later.
+    if (m_provider.isOpen()) {
+        if (selectionLength > MaxClipboardSize) {
+            QMessageBox::warning(this, tr("Copying Failed"),
+                                 tr("You cannot copy more than 256 MB of binary data. "
+                                    "Export the selection to a file instead."));
+            return;
+        }
+        BinEditMimeData *mimeData = new BinEditMimeData(raw, &m_provider, m_baseAddr,
+                                                        m_pieces->pieces(selStart, selectionLength),
+                                                        m_pieces->addBuffer());
+        QApplication::clipboard()->setMimeData(mimeData);
+        m_clipboardData = mimeData;
+        return;
+    }
+
     if (selectionLength >> 22) {
         QMessageBox::warning(this, tr("Copying Failed"),
                              tr("You cannot copy more than 4 MB of binary data."));
         return;
     }
-    const QByteArray &data = dataMid(selStart, selectionLength);
+    const QByteArray &data = dataMid(selStart, int(selectionLength));
     if (raw) {
         QApplication::clipboard()->setText(data);
         return;
@@ -1479,43 +2444,222 @@ void BinEdit::copy(bool raw)
     QApplication::clipboard()->setText(hexString);
 }
 
+/*!
+    Inserts the clipboard contents at the cursor, replacing the selection or,
+    in overwrite mode, as many bytes as are pasted. Hex values are pasted as
+    bytes if the hex column has the cursor.
+*/
+void BinEdit::paste()
+{
+    if (isReadOnly() || !canResize())
+        return;
+
+    // Data copied from this editor is pasted as its pieces, however large.
+    const BinEditMimeData *mimeData =
+            qobject_cast<const BinEditMimeData *>(QApplication::clipboard()->mimeData());
+    const bool ownData = mimeData && mimeData->addBuffer() == m_pieces->addBuffer();
+
+    QByteArray data;
+    if (!ownData) {
+        const QString text = QApplication::clipboard()->text();
+        if (text.isEmpty())
+            return;
+        if (m_hexCursor)
+            data = calculateHexPattern(text.simplified().remove(QLatin1Char(' ')).toLatin1());
+        if (data.isEmpty())
+            data = text.toLatin1();
+    }
+    const qint64 size = ownData ? mimeData->length() : data.size();
+    if (size == 0)
+        return;
+
+    const qint64 position = hasSelection() ? selectionStart() : m_cursorPosition;
+    qint64 length = 0;
+    if (hasSelection())
+        length = selectionEnd() - position;
+    else if (m_overwriteMode)
+        length = qMin<qint64>(size, m_size - position);
+    if (ownData)
+        replacePieces(position, length, mimeData->pieces());
+    else
+        replaceData(position, length, data);
+    setCursorPosition(position + size);
+}
+
+/*!
+    Asks for a byte value and sets all selected bytes to it.
+*/
+void BinEdit::fillSelection()
+{
+    if (isReadOnly() || !canResize() || !hasSelection())
+        return;
+
+    bool ok = false;
+    const QString value = QInputDialog::getText(this, tr("Fill Selection"),
+                                                tr("Byte value (hex):"), QLineEdit::Normal,
+                                                QLatin1String("00"), &ok);
+    if (!ok)
+        return;
+    const uint byte = value.trimmed().toUInt(&ok, 16);
+    if (!ok || byte > 0xff) {
+        QMessageBox::warning(this, tr("Fill Selection"),
+                             tr("\"%1\" is not a byte value.").arg(value));
+        return;
+    }
+
+    const qint64 position = selectionStart();
+    fillData(position, selectionEnd() - position, char(byte));
+    viewport()->update();
+}
+
+/*!
+    Asks for a file and a format and writes the selection to it in the
+    background.
+*/
+void BinEdit::exportSelection()
+{
+    if (!m_provider.isOpen() || !hasSelection())
+        return;
+
+    const QStringList filters = QStringList()
+            << tr("Raw Data (*)")
+            << tr("Hex Dump (*.txt)")
+            << tr("C Array (*.c *.h)")
+            << tr("Base64 (*.b64 *.txt)");
+    QString filter = filters.first();
+    const QString fileName = QFileDialog::getSaveFileName(this, tr("Export Selection"), QString(),
+                                                          filters.join(QLatin1String(";;")),
+                                                          &filter);
+    if (fileName.isEmpty())
+        return;
+
+    // Canceling a running export closes its progress dialog.
+    m_export->cancel();
+    m_exportProgress = new QProgressDialog(tr("Exporting to %1...")
+                                           .arg(QDir::toNativeSeparators(fileName)),
+                                           tr("Cancel"), 0, 0, this);
+    m_exportProgress->setWindowTitle(tr("Export Selection"));
+    m_exportProgress->setAutoClose(false);
+    m_exportProgress->setAutoReset(false);
+    m_exportProgress->setMinimumDuration(500);
+    connect(m_exportProgress, SIGNAL(canceled()), m_export, SLOT(cancel()));
+
+    const qint64 position = selectionStart();
+    const qint64 length = selectionEnd() - position;
+    m_export->start(fileName, BinEditExport::Format(qMax(0, filters.indexOf(filter))),
+                    m_baseAddr, m_pieces->pieces(position, length), m_pieces->addBuffer(),
+                    position, length);
+}
+
+void BinEdit::handleExportProgress(int value, int maximum)
+{
+    if (!m_exportProgress)
+        return;
+    m_exportProgress->setMaximum(maximum);
+    m_exportProgress->setValue(value);
+}
+
+void BinEdit::handleExportFinished(bool ok)
+{
+    if (m_exportProgress)
+        m_exportProgress->deleteLater();
+    if (!ok && !m_export->errorString().isEmpty())
+        QMessageBox::warning(this, tr("Export Failed"),
+                             tr("The selection could not be exported: %1")
+                             .arg(m_export->errorString()));
+}
+
+void BinEdit::handleCompressedIndexProgress(int value, int maximum)
+{
+    if (!m_compressedIndexProgress)
+        return;
+    m_compressedIndexProgress->setMaximum(maximum);
+    m_compressedIndexProgress->setValue(value);
+}
+
+void BinEdit::handleCompressedIndexFinished(bool ok)
+{
+    if (m_compressedIndexProgress)
+        m_compressedIndexProgress->deleteLater();
+#if defined(BINEDITOR_HAVE_DECOMPRESSION)
+    if (!ok) {
+        if (!m_compressedIndex->errorString().isEmpty())
+            QMessageBox::warning(this, tr("Decompression Failed"),
+                                 tr("The file could not be indexed: %1")
+                                 .arg(m_compressedIndex->errorString()));
+        return;
+    }
+
+    // Switch to the decompressed data unless the compressed bytes were edited.
+    if (m_decompress && m_fileName == m_compressedIndex->fileName() && !compressedFile() && !isModified())
+        open(m_compressedIndex->fileName());
+#else
+    Q_UNUSED(ok);
+#endif
+}
+
+// Centers the file offset \a position clicked in the overview strip.
+void BinEdit::handleOverviewPositionRequested(qint64 position)
+{
+    const quint64 address = quint64(position);
+    if (address < m_baseAddr || address >= m_baseAddr + m_size) {
+        emit newRangeRequested(address);
+        return;
+    }
+    const qint64 visibleBytes = qint64(m_numVisibleLines) * m_bytesPerLine;
+    setTopPosition(qMax<qint64>(0, qint64(address - m_baseAddr) - visibleBytes / 2));
+}
+
+void BinEdit::updateOverviewRange()
+{
+    const qint64 from = qint64(m_baseAddr) + topPosition();
+    m_overviewStrip->setVisibleRange(from, from + qint64(m_numVisibleLines) * m_bytesPerLine);
+}
+
 void BinEdit::undo()
 {
-    if (m_undoStack.isEmpty())
+    if (!m_journal->canUndo())
         return;
-    bool emitModificationChanged = (m_undoStack.size() == m_unmodifiedState);
-    BinEditorEditCommand cmd = m_undoStack.pop();
-    emitModificationChanged |= (m_undoStack.size() == m_unmodifiedState);
-    uchar c = dataAt(cmd.position);
-    changeDataAt(cmd.position, (char)cmd.character);
-    cmd.character = c;
-    m_redoStack.push(cmd);
-    setCursorPosition(cmd.position);
-    if (emitModificationChanged)
-        emit modificationChanged(m_undoStack.size() != m_unmodifiedState);
-    if (!m_undoStack.size())
-        emit undoAvailable(false);
-    if (m_redoStack.size() == 1)
-        emit redoAvailable(true);
+    const bool wasModified = isModified();
+    const bool hadRedo = isRedoAvailable();
+    const BinEditUndoJournal::Change change = m_journal->undo(m_pieces);
+    contentsChanged(change.position, change.oldLength, change.newLength);
+    setCursorPosition(change.position);
+    emitUndoState(wasModified, true, hadRedo);
+    m_sharedFile->notifyContentsChanged(this, change.position, change.oldLength, change.newLength);
 }
 
 void BinEdit::redo()
 {
-    if (m_redoStack.isEmpty())
+    if (!m_journal->canRedo())
         return;
-    BinEditorEditCommand cmd = m_redoStack.pop();
-    uchar c = dataAt(cmd.position);
-    changeDataAt(cmd.position, (char)cmd.character);
-    cmd.character = c;
-    bool emitModificationChanged = (m_undoStack.size() == m_unmodifiedState);
-    m_undoStack.push(cmd);
-    setCursorPosition(cmd.position + 1);
-    if (emitModificationChanged)
-        emit modificationChanged(m_undoStack.size() != m_unmodifiedState);
-    if (m_undoStack.size() == 1)
-        emit undoAvailable(true);
-    if (!m_redoStack.size())
-        emit redoAvailable(false);
+    const bool wasModified = isModified();
+    const bool hadUndo = isUndoAvailable();
+    const BinEditUndoJournal::Change change = m_journal->redo(m_pieces);
+    contentsChanged(change.position, change.oldLength, change.newLength);
+    setCursorPosition(change.position + change.newLength);
+    emitUndoState(wasModified, hadUndo, true);
+    m_sharedFile->notifyContentsChanged(this, change.position, change.oldLength, change.newLength);
+}
+
+void BinEdit::emitUndoState(bool wasModified, bool hadUndo, bool hadRedo)
+{
+    if (isModified() != wasModified)
+        emit modificationChanged(isModified());
+    if (isUndoAvailable() != hadUndo)
+        emit undoAvailable(isUndoAvailable());
+    if (isRedoAvailable() != hadRedo)
+        emit redoAvailable(isRedoAvailable());
+}
+
+void BinEdit::setUndoLimit(qint64 bytes)
+{
+    const bool wasModified = isModified();
+    const bool hadUndo = isUndoAvailable();
+    const bool hadRedo = isRedoAvailable();
+    m_journal->setLimit(bytes);
+    emitUndoState(wasModified, hadUndo, hadRedo);
+    m_sharedFile->notifyStateChanged(this);
 }
 
 void BinEdit::selectAll()
@@ -1526,71 +2670,248 @@ void BinEdit::selectAll()
 
 void BinEdit::highlightSearchResults(const QByteArray &pattern, QTextDocument::FindFlags findFlags)
 {
-    if (m_searchPattern == pattern)
+    const bool caseSensitive = findFlags & QTextDocument::FindCaseSensitively;
+    if (m_searchPattern == pattern && m_searchCaseSensitive == caseSensitive)
         return;
     m_searchPattern = pattern;
-    m_caseSensitiveSearch = (findFlags & QTextDocument::FindCaseSensitively);
-    if (!m_caseSensitiveSearch)
-        ::lower(m_searchPattern);
-    m_searchPatternHex = calculateHexPattern(pattern);
+    m_searchCaseSensitive = caseSensitive;
+    m_searchMatchers = patternMatchers(pattern, caseSensitive);
     viewport()->update();
 }
 
 
-void BinEdit::changeData(int position, uchar character, bool highNibble)
+void BinEdit::changeData(qint64 position, uchar character)
 {
     if (!requestDataAt(position))
         return;
-    m_redoStack.clear();
-    if (m_unmodifiedState > m_undoStack.size())
-        m_unmodifiedState = -1;
-    BinEditorEditCommand cmd;
-    cmd.position = position;
-    cmd.character = (uchar) dataAt(position);
-    cmd.highNibble = highNibble;
+    editData(position, 1, QByteArray(1, char(character)), true);
+}
 
-    if (!highNibble
-            && !m_undoStack.isEmpty()
-            && m_undoStack.top().position == position
-            && m_undoStack.top().highNibble) {
-        // compress
-        cmd.character = m_undoStack.top().character;
-        m_undoStack.pop();
-    }
+/*!
+    Returns true if bytes can be inserted and removed, which is the case for
+    files but not for memory views.
+*/
+bool BinEdit::canResize() const
+{
+    return m_provider.isOpen() && !isMemoryView();
+}
+
+void BinEdit::setOverwriteMode(bool overwrite)
+{
+    if (m_overwriteMode == overwrite)
+        return;
+    m_overwriteMode = overwrite;
+    if (m_overwriteMode && m_cursorPosition >= m_size)
+        setCursorPosition(m_size - 1);
+    updateLines();
+    emit overwriteModeChanged(m_overwriteMode);
+}
+
+/*!
+    Inserts \a data at \a position.
+*/
+void BinEdit::insertData(qint64 position, const QByteArray &data)
+{
+    if (isReadOnly() || !canResize() || data.isEmpty() || position < 0 || position > m_size)
+        return;
+    editData(position, 0, data, false);
+}
+
+/*!
+    Removes \a length bytes at \a position and puts the cursor there.
+*/
+void BinEdit::removeData(qint64 position, qint64 length)
+{
+    if (isReadOnly() || !canResize() || position < 0 || position >= m_size)
+        return;
+    length = qMin(length, m_size - position);
+    if (length <= 0)
+        return;
+    recordEdit(position, m_pieces->remove(position, length), 0, false);
+    setCursorPosition(position);
+}
 
-    changeDataAt(position, (char) character);
-    bool emitModificationChanged = (m_undoStack.size() == m_unmodifiedState);
-    m_undoStack.push(cmd);
-    if (emitModificationChanged) {
-        emit modificationChanged(m_undoStack.size() != m_unmodifiedState);
+/*!
+    Replaces \a length bytes at \a position with \a data, which can have a
+    different size. This is a single undo step.
+*/
+void BinEdit::replaceData(qint64 position, qint64 length, const QByteArray &data)
+{
+    if (isReadOnly() || !canResize() || position < 0 || position > m_size)
+        return;
+    length = qBound<qint64>(0, length, m_size - position);
+    if (length || !data.isEmpty())
+        editData(position, length, data, false);
+}
+
+/*!
+    Replaces \a length bytes at \a position with \a pieces of this editor's
+    piece table, as one undo step.
+*/
+void BinEdit::replacePieces(qint64 position, qint64 length,
+                            const BinEditPieceTable::PieceList &pieces)
+{
+    if (isReadOnly() || !canResize() || position < 0 || position > m_size)
+        return;
+    length = qBound<qint64>(0, length, m_size - position);
+    qint64 insertedLength = 0;
+    foreach (const BinEditPieceTable::Piece &piece, pieces)
+        insertedLength += piece.length;
+    if (!length && !insertedLength)
+        return;
+
+    const BinEditPieceTable::PieceList removed = m_pieces->remove(position, length);
+    m_pieces->insertPieces(position, pieces);
+    recordEdit(position, removed, insertedLength, false);
+}
+
+/*!
+    Sets \a length bytes at \a position to \a value. This doesn't allocate
+    memory for the bytes however large the range is, and is undone in a
+    single step.
+*/
+void BinEdit::fillData(qint64 position, qint64 length, char value)
+{
+    if (isReadOnly() || !canResize() || position < 0 || position >= m_size)
+        return;
+    length = qMin(length, m_size - position);
+    if (length <= 0)
+        return;
+    const BinEditPieceTable::PieceList removed = m_pieces->remove(position, length);
+    m_pieces->insertFill(position, length, value);
+    recordEdit(position, removed, length, false);
+}
+
+/*!
+    Replaces \a length bytes at \a position with \a data and records the undo
+    step. A \a mergeable step that continues the previous one is merged
+    with it. Returns false if the data couldn't be stored.
+*/
+bool BinEdit::editData(qint64 position, qint64 length, const QByteArray &data, bool mergeable)
+{
+    const BinEditPieceTable::PieceList removed = m_pieces->remove(position, length);
+    if (!m_pieces->insert(position, data)) {
+        m_pieces->insertPieces(position, removed);
+        raiseError(tr("Cannot store the changed data: %1")
+                   .arg(m_pieces->addBuffer()->errorString()));
+        return false;
     }
+    recordEdit(position, removed, data.size(), mergeable);
+    return true;
+}
 
-    if (m_undoStack.size() == 1)
-        emit undoAvailable(true);
+void BinEdit::recordEdit(qint64 position, const BinEditPieceTable::PieceList &removed,
+                         qint64 insertedLength, bool mergeable)
+{
+    const bool wasModified = isModified();
+    const bool hadUndo = isUndoAvailable();
+    const bool hadRedo = isRedoAvailable();
+    m_journal->record(position, removed, insertedLength, mergeable);
+
+    qint64 removedLength = 0;
+    foreach (const BinEditPieceTable::Piece &piece, removed)
+        removedLength += piece.length;
+    contentsChanged(position, removedLength, insertedLength);
+    emitUndoState(wasModified, hadUndo, hadRedo);
+    m_sharedFile->notifyContentsChanged(this, position, removedLength, insertedLength);
 }
 
+/*!
+    Updates the view after \a oldLength bytes at \a position were replaced by
+    \a newLength bytes. Unless both are the same, everything behind them has
+    moved.
+*/
+void BinEdit::contentsChanged(qint64 position, qint64 oldLength, qint64 newLength)
+{
+    if (oldLength == newLength) {
+        if (newLength <= 0)
+            return;
+        const qint64 firstBlock = position / m_blockSize;
+        const qint64 lastBlock = (position + newLength - 1) / m_blockSize;
+        if (lastBlock - firstBlock < EditedBlockCacheSize) {
+            for (qint64 block = firstBlock; block <= lastBlock; ++block) {
+                m_editedBlocks.remove(block);
+                ++m_blockGenerations[block];
+            }
+            updateLines(position, position + newLength - 1);
+        } else {
+            m_editedBlocks.clear();
+            invalidateLines();
+            viewport()->update();
+        }
+        if (newLength <= m_blockSize) {
+            const QByteArray data = contents(position, int(newLength));
+            if (!data.isEmpty())
+                emit dataChanged(m_baseAddr + position, data);
+        }
+        return;
+    }
+
+    m_size = m_pieces->size();
+    m_numLines = m_size / m_bytesPerLine + 1;
+
+    const qint64 block = position / m_blockSize;
+    QHash<qint64, QByteArray>::iterator blockIt = m_editedBlocks.begin();
+    while (blockIt != m_editedBlocks.end()) {
+        if (blockIt.key() >= block)
+            blockIt = m_editedBlocks.erase(blockIt);
+        else
+            ++blockIt;
+    }
+
+    const qint64 line = position / m_bytesPerLine;
+    QHash<qint64, CachedLine>::iterator lineIt = m_lineCache.begin();
+    while (lineIt != m_lineCache.end()) {
+        if (lineIt.key() >= line)
+            lineIt = m_lineCache.erase(lineIt);
+        else
+            ++lineIt;
+    }
+
+    updateScrollBar();
+    viewport()->update();
+}
 
 void BinEdit::contextMenuEvent(QContextMenuEvent *event)
 {
-    const int selStart = selectionStart();
-    const int byteCount = selectionEnd() - selStart;
-    if (byteCount == 0)
+    const qint64 selStart = selectionStart();
+    const qint64 byteCount = selectionEnd() - selStart;
+    const bool editable = !isReadOnly() && canResize();
+    if (byteCount == 0 && !editable)
         return;
 
     QMenu contextMenu;
     QAction copyAsciiAction(tr("Copy Selection as ASCII Characters"), this);
     QAction copyHexAction(tr("Copy Selection as Hex Values"), this);
+    QAction pasteAction(tr("Paste"), this);
+    QAction fillAction(tr("Fill Selection..."), this);
+    QAction deleteAction(tr("Delete Selection"), this);
+    QAction exportAction(tr("Export Selection..."), this);
     QAction jumpToBeAddressHere(this);
     QAction jumpToBeAddressNewWindow(this);
     QAction jumpToLeAddressHere(this);
     QAction jumpToLeAddressNewWindow(this);
     contextMenu.addAction(&copyAsciiAction);
     contextMenu.addAction(&copyHexAction);
+    contextMenu.addAction(&exportAction);
+    copyAsciiAction.setEnabled(byteCount > 0);
+    copyHexAction.setEnabled(byteCount > 0);
+    exportAction.setEnabled(byteCount > 0 && m_provider.isOpen());
+    if (editable) {
+        contextMenu.addAction(&pasteAction);
+        contextMenu.addAction(&fillAction);
+        contextMenu.addAction(&deleteAction);
+        const QMimeData *mimeData = QApplication::clipboard()->mimeData();
+        pasteAction.setEnabled(mimeData && mimeData->hasText());
+        fillAction.setEnabled(byteCount > 0);
+        deleteAction.setEnabled(byteCount > 0);
+    }
+    contextMenu.addSeparator();
 
     quint64 beAddress = 0;
     quint64 leAddress = 0;
-    if (byteCount <= 8) {
-        asIntegers(selStart, byteCount, beAddress, leAddress);
+    if (byteCount > 0 && byteCount <= 8) {
+        asIntegers(selStart, int(byteCount), beAddress, leAddress);
         setupJumpToMenuAction(&contextMenu, &jumpToBeAddressHere,
                               &jumpToBeAddressNewWindow, beAddress);
 
@@ -1613,6 +2934,14 @@ void BinEdit::contextMenuEvent(QContextMenuEvent *event)
         copy(true);
     else if (action == &copyHexAction)
         copy(false);
+    else if (action == &exportAction)
+        exportSelection();
+    else if (action == &pasteAction)
+        paste();
+    else if (action == &fillAction)
+        fillSelection();
+    else if (action == &deleteAction)
+        removeData(selStart, byteCount);
     else if (action == &jumpToBeAddressHere)
         jumpToAddress(beAddress);
     else if (action == &jumpToLeAddressHere)
@@ -1625,47 +2954,206 @@ void BinEdit::contextMenuEvent(QContextMenuEvent *event)
 
 void BinEdit::provideData(quint64 block)
 {
-    if (!m_device)
+    if (!m_provider.isOpen())
         return;
 
-    if (m_device->open(QIODevice::ReadOnly)) {
-        int blockSize = dataBlockSize();
-        m_device->seek(block * blockSize);
-        QByteArray data = m_device->read(blockSize);
-        m_device->close();
-        const int dataSize = data.size();
-        if (dataSize != blockSize)
-            data += QByteArray(blockSize - dataSize, 0);
-        addData(block, data);
-    } else {
-        QString errStr;
-        if (m_fileName.isEmpty()) {
-            errStr = tr("Cannot open device: %2").arg(m_device->errorString());
-        } else {
-            errStr = tr("Cannot open %1: %2").
-                    arg(QDir::toNativeSeparators(m_fileName)).
-                    arg(m_device->errorString());
-        }
-        raiseError(errStr);
-    }
+    addData(block, m_provider.block(block, dataBlockSize()));
 }
 
 void BinEdit::provideNewRange(quint64 offset)
 {
+    // Memory views move between mappings, the gaps between them are not
+    // shown.
+    if (BinEditProcessMemory *memory = processMemory()) {
+        if (offset >= m_baseAddr && offset < m_baseAddr + m_size)
+            return;
+        const int index = memory->findMapping(offset);
+        if (index >= 0) {
+            const BinEditProcessMemory::Mapping &mapping = memory->mappings().at(index);
+            showMapping(mapping.start, mapping.size(), offset);
+        }
+        return;
+    }
     setOffset(/*0, *//*m_fileName, */offset);
 }
 
 void BinEdit::handleStartOfFileRequested()
 {
+    if (processMemory()) {
+        setCursorPosition(0);
+        return;
+    }
     setOffset(/*0, *//*m_fileName, */0);
 }
 
 void BinEdit::handleEndOfFileRequested()
 {
-    setOffset(/*0, *//*m_fileName, */m_device->size() - 1);
+    if (!m_provider.isOpen())
+        return;
+    if (processMemory()) {
+        setCursorPosition(m_size - 1);
+        return;
+    }
+
+    setOffset(/*0, *//*m_fileName, */m_provider.size() - 1);
 //    open(/*0, *//*m_fileName, */QFileInfo(m_fileName).size() - 1);
 }
 
+void BinEdit::handleBlockRead(qint64 block, const QByteArray &data, int generation)
+{
+    if (generation != m_reader->generation() || data.size() != m_blockSize)
+        return;
+
+    addData(block, data);
+}
+
+void BinEdit::scheduleReadAhead()
+{
+    if (!m_provider.isOpen() || m_size == 0)
+        return;
+
+    const qint64 pageSize = qint64(qMax(1, m_numVisibleLines)) * m_bytesPerLine;
+    qint64 ahead = qMax(ReadAheadPages * pageSize, ReadAheadMinimum);
+    qint64 behind = qMax(ReadBehindPages * pageSize, ReadAheadMinimum / 4);
+    // Process memory is read again on every refresh, only what is visible.
+    if (processMemory())
+        ahead = behind = 0;
+
+    const qint64 first = qMin(m_size - 1, m_topLine * m_bytesPerLine);
+    const qint64 last = qMin(m_size - 1, first + pageSize + m_bytesPerLine);
+    const qint64 from = qMax<qint64>(0, first - (m_readAheadDirection > 0 ? behind : ahead));
+    const qint64 to = qMin(m_size - 1, last + (m_readAheadDirection > 0 ? ahead : behind));
+
+    const qint64 firstBlock = first / m_blockSize;
+    const qint64 lastBlock = last / m_blockSize;
+    const qint64 fromBlock = from / m_blockSize;
+    const qint64 toBlock = to / m_blockSize;
+
+    // Visible blocks first, then the scroll direction, then the other side.
+    QList<qint64> blocks;
+    for (qint64 block = firstBlock; block <= lastBlock; ++block)
+        blocks.append(block);
+    if (m_readAheadDirection > 0) {
+        for (qint64 block = lastBlock + 1; block <= toBlock; ++block)
+            blocks.append(block);
+        for (qint64 block = firstBlock - 1; block >= fromBlock; --block)
+            blocks.append(block);
+    } else {
+        for (qint64 block = firstBlock - 1; block >= fromBlock; --block)
+            blocks.append(block);
+        for (qint64 block = lastBlock + 1; block <= toBlock; ++block)
+            blocks.append(block);
+    }
+
+    // Edited blocks need the original blocks their pieces come from.
+    QList<qint64> fileBlocks;
+    QSet<qint64> scheduled;
+    const qint64 baseBlock = m_baseAddr / m_blockSize;
+    foreach (qint64 block, blocks) {
+        if (m_editedBlocks.contains(block))
+            continue;
+        foreach (qint64 sourceBlock, sourceBlocks(block)) {
+            if (!m_data->contains(sourceBlock) && !scheduled.contains(sourceBlock)) {
+                scheduled.insert(sourceBlock);
+                fileBlocks.append(baseBlock + sourceBlock);
+            }
+        }
+    }
+    m_reader->read(fileBlocks, m_blockSize);
+}
+
+void BinEdit::handleFileChanged()
+{
+    if (!m_provider.isOpen())
+        return;
+
+    // The index no longer fits the file, it is built again.
+    if (compressedFile()) {
+        const QString fileName = m_fileName; // open() clears m_fileName.
+        open(fileName);
+        return;
+    }
+
+    // Cached blocks may point into the mapping, drop them before remapping.
+    emit sourceAboutToChange();
+    m_search->cancel();
+    m_strings->cancel();
+    m_checksum->cancel();
+    m_export->cancel();
+    detachClipboardData();
+    m_reader->reset();
+    invalidateLines();
+    m_data->clear();
+    m_editedBlocks.clear();
+    m_requests.clear();
+    if (m_provider.refresh()) {
+        const quint64 cursorAddress = baseAddress() + cursorPosition();
+        const quint64 size = m_provider.size();
+        setSizes(size ? qMin(cursorAddress, size - 1) : 0, size, m_blockSize);
+    }
+    startOverview();
+    viewport()->update();
+}
+
+/*
+    Another editor of the shared file changed its contents.
+*/
+void BinEdit::handleSharedContentsChanged(QObject *source, qint64 position,
+                                          qint64 oldLength, qint64 newLength)
+{
+    if (source == this)
+        return;
+
+    contentsChanged(position, oldLength, newLength);
+    syncSharedFile();
+}
+
+/*
+    Another editor of the shared file reset its edits or changed its undo
+    state.
+*/
+void BinEdit::handleSharedStateChanged(QObject *source)
+{
+    if (source == this)
+        return;
+
+    m_editedBlocks.clear();
+    m_size = m_pieces->size();
+    m_numLines = m_size / m_bytesPerLine + 1;
+    invalidateLines();
+    updateScrollBar();
+    viewport()->update();
+    syncSharedFile();
+}
+
+/*
+    Another editor saved the shared file as \a fileName, which replaced it.
+*/
+void BinEdit::handleSharedFileReopened(QObject *source, const QString &fileName)
+{
+    if (source == this)
+        return;
+
+    QIODevice *oldDevice = m_device;
+    attachDevice(new QFile(fileName, this), fileName);
+    if (oldDevice && oldDevice->parent() == this)
+        delete oldDevice;
+    handleSharedStateChanged(0);
+}
+
+/*
+    Keeps the cursor inside the data and tells the document about the
+    modification and undo state, which the other editor changed.
+*/
+void BinEdit::syncSharedFile()
+{
+    if (m_cursorPosition >= m_size || m_anchorPosition >= m_size)
+        setCursorPosition(m_cursorPosition);
+    emit modificationChanged(isModified());
+    emit undoAvailable(isUndoAvailable());
+    emit redoAvailable(isRedoAvailable());
+}
+
 void BinEdit::setupJumpToMenuAction(QMenu *menu, QAction *actionHere,
                                       QAction *actionNew, quint64 addr)
 {
@@ -1694,19 +3182,55 @@ void BinEdit::setNewWindowRequestAllowed(bool c)
 
 void BinEdit::updateContents()
 {
-    m_oldData = m_data;
-    m_data.clear();
+    takeOldData();
     setSizes(baseAddress() + cursorPosition(), m_size, m_blockSize);
 }
 
-QPoint BinEdit::offsetToPos(int offset) const
+/*
+    Keeps the cached data as the old data the next reads are compared with,
+    changed bytes are then highlighted.
+*/
+void BinEdit::takeOldData()
+{
+    m_reader->reset();
+    // Blocks served from a mapping track the file, take a deep copy.
+    m_oldData.clear();
+    foreach (qint64 block, m_data->keys()) {
+        const QByteArray data = m_data->peek(block);
+        m_oldData.insert(block, QByteArray(data.constData(), data.size()));
+    }
+    m_data->clear();
+    m_editedBlocks.clear();
+    m_requests.clear();
+    invalidateLines();
+}
+
+// Memory views keep their range, the visible blocks are read again
+// when they are painted.
+void BinEdit::refreshContents()
+{
+    takeOldData();
+    viewport()->update();
+}
+
+// Shows the mapping of \a size bytes at \a start of a memory view with the
+// cursor on \a address.
+void BinEdit::showMapping(quint64 start, qint64 size, quint64 address)
+{
+    // setSizes() centers the range on its start address.
+    setSizes(start + quint64(size / 2), size, m_blockSize);
+    m_oldData.clear();
+    setCursorPosition(qint64(address - m_baseAddr));
+}
+
+QPoint BinEdit::offsetToPos(qint64 offset) const
 {
-    const int x = m_labelWidth + (offset % m_bytesPerLine) * m_columnWidth;
-    const int y = (offset / m_bytesPerLine  - verticalScrollBar()->value()) * m_lineHeight;
+    const int x = m_labelWidth + int(offset % m_bytesPerLine) * m_columnWidth;
+    const int y = int(qBound<qint64>(-1, offset / m_bytesPerLine - m_topLine, m_numVisibleLines + 1)) * m_lineHeight;
     return QPoint(x, y);
 }
 
-void BinEdit::asFloat(int offset, float &value, bool old) const
+void BinEdit::asFloat(qint64 offset, float &value, bool old) const
 {
     value = 0;
     const QByteArray data = dataMid(offset, sizeof(float), old);
@@ -1718,7 +3242,7 @@ void BinEdit::asFloat(int offset, float &value, bool old) const
     value = *f;
 }
 
-void BinEdit::asDouble(int offset, double &value, bool old) const
+void BinEdit::asDouble(qint64 offset, double &value, bool old) const
 {
     value = 0;
     const QByteArray data = dataMid(offset, sizeof(double), old);
@@ -1730,7 +3254,7 @@ void BinEdit::asDouble(int offset, double &value, bool old) const
     value = *f;
 }
 
-void BinEdit::asIntegers(int offset, int count, quint64 &bigEndianValue,
+void BinEdit::asIntegers(qint64 offset, int count, quint64 &bigEndianValue,
     quint64 &littleEndianValue, bool old) const
 {
     bigEndianValue = littleEndianValue = 0;
@@ -1744,5 +3268,5 @@ void BinEdit::asIntegers(int offset, int count, quint64 &bigEndianValue,
 
 bool BinEdit::isMemoryView() const
 {
-    return property("MemoryView").toBool();
+    return property("MemoryView").toBool() || processMemory();
 }
@@ -34,15 +34,41 @@
 #define BINEDIT_H
 
 #include <QBasicTimer>
+#include <QHash>
 #include <QMap>
+#include <QPointer>
 #include <QSet>
-#include <QStack>
+#include <QVector>
 #include <QString>
 
 #include <QAbstractScrollArea>
+#include <QPixmap>
 #include <QTextDocument>
 
+#include "bineditblockcache.h"
+#include "bineditblockprovider.h"
+#include "bineditchecksum.h"
+#include "bineditdiff.h"
+#include "bineditglyphatlas.h"
+#include "bineditmatcher.h"
+#include "bineditpiecetable.h"
+#include "bineditsharedfile.h"
+#include "bineditstrings.h"
+#include "bineditundojournal.h"
+
+QT_FORWARD_DECLARE_CLASS(QFileSystemWatcher)
+
+class BinEditBlockReader;
+class BinEditCompressedFile;
+class BinEditCompressedIndex;
+class BinEditExport;
+class BinEditMimeData;
+class BinEditOverview;
+class BinEditOverviewStrip;
+class BinEditProcessMemory;
+class BinEditSearch;
 QT_FORWARD_DECLARE_CLASS(QMenu)
+QT_FORWARD_DECLARE_CLASS(QProgressDialog)
 QT_FORWARD_DECLARE_CLASS(QHelpEvent)
 
 // Rename to QBinEditor ?
@@ -51,7 +77,10 @@ class BinEdit : public QAbstractScrollArea
     Q_OBJECT
     Q_PROPERTY(bool modified READ isModified WRITE setModified DESIGNABLE false)
     Q_PROPERTY(bool readOnly READ isReadOnly WRITE setReadOnly DESIGNABLE false)
+    Q_PROPERTY(bool overwriteMode READ overwriteMode WRITE setOverwriteMode DESIGNABLE false)
     Q_PROPERTY(bool newWindowRequestAllowed READ newWindowRequestAllowed WRITE setNewWindowRequestAllowed DESIGNABLE false)
+    Q_PROPERTY(qint64 cacheSize READ cacheSize WRITE setCacheSize DESIGNABLE false)
+    Q_PROPERTY(qint64 undoLimit READ undoLimit WRITE setUndoLimit DESIGNABLE false)
 
 public:
     BinEdit(QWidget *parent = 0);
@@ -61,13 +90,29 @@ public:
     void setDevice(QIODevice *device, const QString &fileName = QString());
 
     void open(const QString &filePath);
+    bool openProcess(qint64 pid, quint64 address);
+    BinEditProcessMemory *processMemory() const;
+    BinEditCompressedFile *compressedFile() const;
+
+    bool isDecompressionEnabled() const { return m_decompress; }
+    void setDecompressionEnabled(bool enabled);
+
+    int refreshInterval() const { return m_refreshInterval; }
+    void setRefreshInterval(int msec);
 
     quint64 baseAddress() const { return m_baseAddr; }
 
-    Q_INVOKABLE void setSizes(quint64 startAddr, int range, int blockSize = 4096);
+    Q_INVOKABLE void setSizes(quint64 startAddr, qint64 range, int blockSize = 4096);
     int dataBlockSize() const { return m_blockSize; }
     Q_INVOKABLE void addData(quint64 block, const QByteArray &data);
 
+    qint64 cacheSize() const { return m_data->maxCost(); }
+    void setCacheSize(qint64 bytes);
+    BinEditBlockCache::Statistics cacheStatistics() const { return m_data->statistics(); }
+
+    qint64 undoLimit() const { return m_journal->limit(); }
+    void setUndoLimit(qint64 bytes);
+
     bool newWindowRequestAllowed() const { return m_canRequestNewWindow; }
 
     Q_INVOKABLE void updateContents();
@@ -81,37 +126,64 @@ public:
         KeepAnchor
     };
 
-    int cursorPosition() const;
-    Q_INVOKABLE void setCursorPosition(int pos, MoveMode moveMode = MoveAnchor);
+    qint64 cursorPosition() const;
+    Q_INVOKABLE void setCursorPosition(qint64 pos, MoveMode moveMode = MoveAnchor);
     void jumpToAddress(quint64 address);
 
-    void setModified(bool);
     bool isModified() const;
 
     void setReadOnly(bool);
     bool isReadOnly() const;
 
-    int find(const QByteArray &pattern, int from = 0,
+    bool overwriteMode() const { return m_overwriteMode; }
+    void setOverwriteMode(bool overwrite);
+    bool canResize() const;
+
+    void insertData(qint64 position, const QByteArray &data);
+    void removeData(qint64 position, qint64 length);
+    void replaceData(qint64 position, qint64 length, const QByteArray &data);
+    void fillData(qint64 position, qint64 length, char value);
+
+    qint64 find(const QByteArray &pattern, qint64 from = 0,
              QTextDocument::FindFlags findFlags = 0);
+    void findAll(const QByteArray &pattern, QTextDocument::FindFlags findFlags = 0);
+    BinEditSearch *search() const { return m_search; }
+
+    void extractStrings(int minLength, BinEditStrings::Encodings encodings);
+    BinEditStrings *strings() const { return m_strings; }
+
+    void calculateChecksums(BinEditChecksum::Algorithms algorithms, bool selectionOnly);
+    BinEditChecksum *checksum() const { return m_checksum; }
+
+    QByteArray contents(qint64 from, int length) const;
+
+    BinEditDiff::Source diffSource() const;
+    void setDiffRanges(const BinEditDiff::RangeList &ranges, BinEditDiff::Side side);
+
+    qint64 topPosition() const { return m_topLine * m_bytesPerLine; }
+    void setTopPosition(qint64 position);
 
     void clear();
 
     bool hasSelection() const { return m_cursorPosition != m_anchorPosition; }
-    int selectionStart() const { return qMin(m_anchorPosition, m_cursorPosition); }
-    int selectionEnd() const { return qMax(m_anchorPosition, m_cursorPosition); }
+    qint64 selectionStart() const { return qMin(m_anchorPosition, m_cursorPosition); }
+    qint64 selectionEnd() const { return qMax(m_anchorPosition, m_cursorPosition); }
 
     bool event(QEvent*);
 
-    bool isUndoAvailable() const { return m_undoStack.size(); }
-    bool isRedoAvailable() const { return m_redoStack.size(); }
+    bool isUndoAvailable() const { return m_journal->canUndo(); }
+    bool isRedoAvailable() const { return m_journal->canRedo(); }
 
     QString addressString(quint64 address);
 
-    bool isMemoryView() const; // Is a debugger memory view without file?
+    bool isMemoryView() const; // Is a memory view without file?
 
     static const int SearchStride = 1024 * 1024;
+    static const int MaxClipboardSize = 256 * 1024 * 1024;
 
 public slots:
+    void setModified(bool);
+
     void undo();
     void redo();
 
@@ -121,6 +193,9 @@ public slots:
     void highlightSearchResults(const QByteArray &pattern,
                                 QTextDocument::FindFlags findFlags = 0);
     void copy(bool raw = false);
+    void paste();
+    void fillSelection();
+    void exportSelection();
     void setNewWindowRequestAllowed(bool c);
 
 signals:
@@ -128,7 +203,10 @@ signals:
     void undoAvailable(bool);
     void redoAvailable(bool);
     void copyAvailable(bool);
-    void cursorPositionChanged(int position);
+    void cursorPositionChanged(qint64 position);
+    void overwriteModeChanged(bool overwrite);
+    void topPositionChanged(qint64 position);
+    void sourceAboutToChange();
 
     void dataRequested(quint64 block);
     void newWindowRequested(quint64 address);
@@ -157,44 +235,95 @@ private slots:
     void provideNewRange(quint64 offset);
     void handleStartOfFileRequested();
     void handleEndOfFileRequested();
+    void handleFileChanged();
+    void handleBlockRead(qint64 block, const QByteArray &data, int generation);
+    void handleScrollAction(int action);
+    void handleExportProgress(int value, int maximum);
+    void handleExportFinished(bool ok);
+    void handleCompressedIndexProgress(int value, int maximum);
+    void handleCompressedIndexFinished(bool ok);
+    void handleOverviewPositionRequested(qint64 position);
+    void updateOverviewRange();
+    void handleSharedContentsChanged(QObject *source, qint64 position,
+                                     qint64 oldLength, qint64 newLength);
+    void handleSharedStateChanged(QObject *source);
+    void handleSharedFileReopened(QObject *source, const QString &fileName);
 
 private:
-    typedef QMap<int, QByteArray> BlockMap;
-    BlockMap m_data;
+    typedef QMap<qint64, QByteArray> BlockMap;
+    // Owned by m_sharedFile, shared with other editors of the same file.
+    QSharedPointer<BinEditSharedFile> m_sharedFile;
+    BinEditBlockCache *m_data;
     BlockMap m_oldData;
     int m_blockSize;
-    BlockMap m_modifiedData;
-    mutable QSet<int> m_requests;
+    BinEditPieceTable *m_pieces;
+    mutable QHash<qint64, QByteArray> m_editedBlocks;
+    mutable QSet<qint64> m_requests;
     QByteArray m_emptyBlock;
     QByteArray m_lowerBlock;
-    int m_size;
+    qint64 m_size;
 
     bool setOffset(/*QString *errorString,*/ /*const QString &fileName,*/ quint64 offset = 0);
-
-    int dataIndexOf(const QByteArray &pattern, int from, bool caseSensitive = true) const;
-    int dataLastIndexOf(const QByteArray &pattern, int from, bool caseSensitive = true) const;
-
-    bool requestDataAt(int pos) const;
-    bool requestOldDataAt(int pos) const;
-    char dataAt(int pos, bool old = false) const;
-    char oldDataAt(int pos) const;
-    void changeDataAt(int pos, char c);
-    QByteArray dataMid(int from, int length, bool old = false) const;
-    QByteArray blockData(int block, bool old = false) const;
-
-    QPoint offsetToPos(int offset) const;
-    void asIntegers(int offset, int count, quint64 &bigEndianValue, quint64 &littleEndianValue,
+    void attachDevice(QIODevice *device, const QString &fileName);
+    void setSharedFile(const QSharedPointer<BinEditSharedFile> &file);
+    void syncSharedFile();
+    void reopen(const QString &fileName);
+    bool openCompressed(const QString &filePath);
+    void startOverview();
+    void showMapping(quint64 start, qint64 size, quint64 address);
+    void takeOldData();
+    void refreshContents();
+
+    bool saveInPlace(QString *errorString, const QString &fileName);
+    bool saveCopy(QString *errorString, const QString &fileName);
+
+    qint64 dataIndexOf(const QVector<BinEditMatcher> &matchers, qint64 from,
+                       int *matcherIndex = 0) const;
+    qint64 dataLastIndexOf(const QVector<BinEditMatcher> &matchers, qint64 from,
+                           int *matcherIndex = 0) const;
+
+    bool requestDataAt(qint64 pos, bool synchronous = true) const;
+    bool requestSourceBlock(qint64 block, bool synchronous) const;
+    QList<qint64> sourceBlocks(qint64 block) const;
+    void scheduleReadAhead();
+    bool requestOldDataAt(qint64 pos) const;
+    char dataAt(qint64 pos, bool old = false) const;
+    char oldDataAt(qint64 pos) const;
+    QByteArray dataMid(qint64 from, int length, bool old = false) const;
+    QByteArray blockData(qint64 block, bool old = false) const;
+    bool isBlockEdited(qint64 block) const;
+    void contentsChanged(qint64 position, qint64 oldLength, qint64 newLength);
+    void resetEdits();
+    void detachClipboardData();
+
+    QPoint offsetToPos(qint64 offset) const;
+    void asIntegers(qint64 offset, int count, quint64 &bigEndianValue, quint64 &littleEndianValue,
                     bool old = false) const;
-    void asFloat(int offset, float &value, bool old) const;
-    void asDouble(int offset, double &value, bool old) const;
+    void asFloat(qint64 offset, float &value, bool old) const;
+    void asDouble(qint64 offset, double &value, bool old) const;
     QString toolTip(const QHelpEvent *helpEvent) const;
 
+    QString openErrorString(const QString &reason) const;
+    QString writeErrorString(const QString &fileName, const QString &reason) const;
     void raiseError(const QString &errorString);
 
 private:
     QIODevice *m_device;
+    BinEditBlockProvider m_provider;
+    BinEditBlockReader *m_reader;
+    BinEditSearch *m_search;
+    BinEditStrings *m_strings;
+    BinEditChecksum *m_checksum;
+    BinEditExport *m_export;
+    QPointer<QProgressDialog> m_exportProgress;
+    BinEditCompressedIndex *m_compressedIndex;
+    QPointer<QProgressDialog> m_compressedIndexProgress;
+    bool m_decompress;
+    BinEditOverview *m_overview;
+    BinEditOverviewStrip *m_overviewStrip;
+    QPointer<BinEditMimeData> m_clipboardData;
+    QFileSystemWatcher *m_watcher;
     int m_bytesPerLine;
-    int m_unmodifiedState;
     int m_readOnly;
     int m_margin;
     int m_descent;
@@ -204,49 +333,101 @@ private:
     int m_labelWidth;
     int m_textWidth;
     int m_columnWidth;
-    int m_numLines;
+    qint64 m_numLines;
     int m_numVisibleLines;
+    qint64 m_topLine;
+    qint64 m_pendingTopLine;
+    int m_readAheadDirection;
 
     quint64 m_baseAddr;
 
     bool m_cursorVisible;
-    int m_cursorPosition;
-    int m_anchorPosition;
+    qint64 m_cursorPosition;
+    qint64 m_anchorPosition;
     bool m_hexCursor;
     bool m_lowNibble;
+    bool m_overwriteMode;
     bool m_isMonospacedFont;
 
     QByteArray m_searchPattern;
-    QByteArray m_searchPatternHex;
-    bool m_caseSensitiveSearch;
+    bool m_searchCaseSensitive;
+    QVector<BinEditMatcher> m_searchMatchers;
+
+    BinEditDiff::RangeList m_diffRanges;
+    BinEditDiff::Side m_diffSide;
 
     QBasicTimer m_cursorBlinkTimer;
+    QBasicTimer m_refreshTimer;
+    int m_refreshInterval;
 
     void init();
-    int posAt(const QPoint &pos) const;
+    qint64 posAt(const QPoint &pos) const;
     bool inTextArea(const QPoint &pos) const;
     QRect cursorRect() const;
     void updateLines();
-    void updateLines(int fromPosition, int toPosition);
+    void updateLines(qint64 fromPosition, qint64 toPosition);
     void ensureCursorVisible();
     void setBlinkingCursorEnabled(bool enable);
 
-    void changeData(int position, uchar character, bool highNibble = false);
+    qint64 topLine() const { return m_topLine; }
+    qint64 maxTopLine() const;
+    void setTopLine(qint64 line);
+    void moveTopLine(qint64 line);
+    bool isScrollBarScaled() const;
+    qint64 lineForScrollValue(int value) const;
+    int scrollValueForLine(qint64 line) const;
+    void updateScrollBar();
+
+    void changeData(qint64 position, uchar character);
+    bool editData(qint64 position, qint64 length, const QByteArray &data, bool mergeable);
+    void replacePieces(qint64 position, qint64 length, const BinEditPieceTable::PieceList &pieces);
+    void recordEdit(qint64 position, const BinEditPieceTable::PieceList &removed,
+                    qint64 insertedLength, bool mergeable);
+    void emitUndoState(bool wasModified, bool hadUndo, bool hadRedo);
+
+    qint64 findPattern(const QByteArray &data, qint64 from, qint64 offset, int *match);
+
+    enum Highlight {
+        MatchHighlight = 1,
+        DifferenceHighlight = 2
+    };
 
-    int findPattern(const QByteArray &data, const QByteArray &dataHex,
-                    int from, int offset, int *match);
-    void drawItems(QPainter *painter, int x, int y, const QString &itemString);
-    void drawChanges(QPainter *painter, int x, int y, const char *changes);
+    struct LineKey {
+        uint firstGeneration;
+        uint lastGeneration;
+        bool hasData;
+        bool hasOldData;
+        int selectionStart;
+        int selectionEnd;
+        QByteArray highlights;
+
+        bool operator==(const LineKey &other) const
+        {
+            return firstGeneration == other.firstGeneration
+                    && lastGeneration == other.lastGeneration
+                    && hasData == other.hasData
+                    && hasOldData == other.hasOldData
+                    && selectionStart == other.selectionStart
+                    && selectionEnd == other.selectionEnd
+                    && highlights == other.highlights;
+        }
+    };
+    struct CachedLine {
+        LineKey key;
+        QPixmap pixmap;
+    };
+    BinEditGlyphAtlas m_glyphs;
+    QHash<qint64, CachedLine> m_lineCache;
+    QHash<qint64, uint> m_blockGenerations;
+
+    qreal pixelRatio() const;
+    void invalidateLines();
+    void renderLine(QPixmap *pixmap, qint64 line, const LineKey &key);
 
     void setupJumpToMenuAction(QMenu *menu, QAction *actionHere, QAction *actionNew,
                                quint64 addr);
 
-    struct BinEditorEditCommand {
-        int position;
-        uchar character;
-        bool highNibble;
-    };
-    QStack<BinEditorEditCommand> m_undoStack, m_redoStack;
+    BinEditUndoJournal *m_journal;
 
     QBasicTimer m_autoScrollTimer;
     QString m_addressString;
@@ -0,0 +1,122 @@
+#include "bineditaddbuffer.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QTemporaryFile>
+
+#include <string.h>
+
+/*!
+    \class BinEditAddBuffer
+
+    Append-only storage for bytes inserted into a BinEditPieceTable and for
+    old data kept by the undo journal.
+
+    Data is held in memory until it grows past the spill threshold, then it
+    is moved into a temporary file and everything appended later goes there
+    too, so pasting hundreds of megabytes doesn't need as much memory.
+    Bytes never change once appended, which lets background searches read
+    them while the editor appends more. All functions are thread-safe.
+*/
+
+BinEditAddBuffer::BinEditAddBuffer(qint64 spillThreshold) :
+    m_file(0),
+    m_size(0),
+    m_spillThreshold(spillThreshold)
+{
+}
+
+BinEditAddBuffer::~BinEditAddBuffer()
+{
+    delete m_file;
+}
+
+qint64 BinEditAddBuffer::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_size;
+}
+
+/*!
+    Returns the number of bytes held in memory.
+*/
+qint64 BinEditAddBuffer::memoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_memory.size();
+}
+
+bool BinEditAddBuffer::isSpilled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_file != 0;
+}
+
+QString BinEditAddBuffer::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_errorString;
+}
+
+/*!
+    Appends \a data and returns its offset, or -1 if it couldn't be written
+    to the temporary file. Data appended one after the other is contiguous.
+*/
+qint64 BinEditAddBuffer::append(const QByteArray &data)
+{
+    QMutexLocker locker(&m_mutex);
+    const qint64 offset = m_size;
+    if (!m_file && m_size + data.size() > m_spillThreshold)
+        spill(); // Keeps data in memory if there is no temporary file.
+
+    if (m_file) {
+        if (!m_file->seek(offset) || m_file->write(data) != data.size()) {
+            m_errorString = m_file->errorString();
+            return -1;
+        }
+    } else {
+        m_memory.append(data);
+    }
+    m_size += data.size();
+    return offset;
+}
+
+QByteArray BinEditAddBuffer::read(qint64 offset, int length) const
+{
+    QByteArray data(length, '\0');
+    copy(data.data(), offset, length);
+    return data;
+}
+
+/*!
+    Copies \a length bytes at \a offset to \a target.
+*/
+void BinEditAddBuffer::copy(char *target, qint64 offset, int length) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_file) {
+        ::memcpy(target, m_memory.constData() + offset, size_t(length));
+        return;
+    }
+
+    // Bytes that can't be read back show as zeros rather than garbage.
+    qint64 read = -1;
+    if (m_file->seek(offset))
+        read = m_file->read(target, length);
+    if (read < length)
+        ::memset(target + qMax<qint64>(0, read), 0, size_t(length - qMax<qint64>(0, read)));
+}
+
+bool BinEditAddBuffer::spill()
+{
+    QTemporaryFile *file = new QTemporaryFile(QDir::tempPath() + QLatin1String("/binedit.XXXXXX"));
+    if (!file->open() || file->write(m_memory) != m_memory.size()) {
+        m_errorString = file->errorString();
+        delete file;
+        return false;
+    }
+
+    m_file = file;
+    m_memory = QByteArray();
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef BINEDITADDBUFFER_H
+#define BINEDITADDBUFFER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+class QTemporaryFile;
+
+class BinEditAddBuffer
+{
+    Q_DISABLE_COPY(BinEditAddBuffer)
+
+public:
+    static const qint64 DefaultSpillThreshold = 16 * 1024 * 1024;
+
+    explicit BinEditAddBuffer(qint64 spillThreshold = DefaultSpillThreshold);
+    ~BinEditAddBuffer();
+
+    qint64 size() const;
+    qint64 memoryUsage() const;
+    bool isSpilled() const;
+    QString errorString() const;
+
+    qint64 append(const QByteArray &data);
+    QByteArray read(qint64 offset, int length) const;
+    void copy(char *target, qint64 offset, int length) const;
+
+private:
+    bool spill();
+
+    mutable QMutex m_mutex;
+    QByteArray m_memory;
+    QTemporaryFile *m_file;
+    qint64 m_size;
+    qint64 m_spillThreshold;
+    QString m_errorString;
+};
+
+#endif // BINEDITADDBUFFER_H
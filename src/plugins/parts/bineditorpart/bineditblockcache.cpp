@@ -0,0 +1,209 @@
+#include "bineditblockcache.h"
+
+/*!
+    \class BinEditBlockCache
+
+    Least recently used cache of data blocks with a memory budget.
+
+    Blocks are evicted from the least recently used end once the total size
+    of cached blocks exceeds maxCost(). Blocks inside a pinned range (the
+    blocks behind the viewport of one of the editors sharing the cache) are
+    never evicted, even if that means going over the budget.
+
+    Blocks can have an owner, typically the provider whose mapping they
+    point into, so they can be dropped when that mapping goes away while
+    other editors keep using the cache.
+*/
+
+BinEditBlockCache::BinEditBlockCache(qint64 maxCost) :
+    m_first(0),
+    m_last(0),
+    m_maxCost(maxCost),
+    m_totalCost(0)
+{
+}
+
+BinEditBlockCache::~BinEditBlockCache()
+{
+    clear();
+}
+
+void BinEditBlockCache::setMaxCost(qint64 maxCost)
+{
+    m_maxCost = maxCost;
+    trim();
+}
+
+/*!
+    Returns true if \a block is cached and marks it as most recently used.
+    Updates hit and miss counters.
+*/
+bool BinEditBlockCache::lookup(qint64 block)
+{
+    Node *node = m_nodes.value(block);
+    if (!node) {
+        ++m_statistics.misses;
+        return false;
+    }
+
+    ++m_statistics.hits;
+    touch(node);
+    return true;
+}
+
+/*!
+    Returns data of \a block and marks it as most recently used, or
+    \a defaultValue if \a block is not cached.
+*/
+QByteArray BinEditBlockCache::value(qint64 block, const QByteArray &defaultValue)
+{
+    Node *node = m_nodes.value(block);
+    if (!node)
+        return defaultValue;
+
+    touch(node);
+    return node->data;
+}
+
+/*!
+    Returns data of \a block without changing the eviction order.
+*/
+QByteArray BinEditBlockCache::peek(qint64 block) const
+{
+    Node *node = m_nodes.value(block);
+    return node ? node->data : QByteArray();
+}
+
+void BinEditBlockCache::insert(qint64 block, const QByteArray &data, const void *owner)
+{
+    Node *node = m_nodes.value(block);
+    if (node) {
+        m_totalCost += data.size() - node->data.size();
+        node->data = data;
+        node->owner = owner;
+        touch(node);
+    } else {
+        node = new Node;
+        node->block = block;
+        node->data = data;
+        node->owner = owner;
+        link(node);
+        m_nodes.insert(block, node);
+        m_totalCost += data.size();
+    }
+    trim();
+}
+
+void BinEditBlockCache::remove(qint64 block)
+{
+    Node *node = m_nodes.take(block);
+    if (!node)
+        return;
+
+    unlink(node);
+    m_totalCost -= node->data.size();
+    delete node;
+}
+
+/*!
+    Removes the blocks inserted with \a owner.
+*/
+void BinEditBlockCache::removeOwnedBy(const void *owner)
+{
+    if (!owner)
+        return;
+
+    Node *node = m_first;
+    while (node) {
+        Node *next = node->next;
+        if (node->owner == owner) {
+            m_nodes.remove(node->block);
+            unlink(node);
+            m_totalCost -= node->data.size();
+            delete node;
+        }
+        node = next;
+    }
+}
+
+void BinEditBlockCache::clear()
+{
+    qDeleteAll(m_nodes);
+    m_nodes.clear();
+    m_first = m_last = 0;
+    m_totalCost = 0;
+}
+
+/*!
+    Pins blocks from \a firstBlock to \a lastBlock inclusive, replacing the
+    range previously pinned by \a owner.
+*/
+void BinEditBlockCache::setPinnedRange(const void *owner, qint64 firstBlock, qint64 lastBlock)
+{
+    m_pinnedRanges.insert(owner, qMakePair(firstBlock, lastBlock));
+}
+
+void BinEditBlockCache::removePinnedRange(const void *owner)
+{
+    m_pinnedRanges.remove(owner);
+    trim();
+}
+
+bool BinEditBlockCache::isPinned(qint64 block) const
+{
+    typedef QPair<qint64, qint64> Range;
+    foreach (const Range &range, m_pinnedRanges) {
+        if (block >= range.first && block <= range.second)
+            return true;
+    }
+    return false;
+}
+
+void BinEditBlockCache::link(Node *node)
+{
+    node->previous = 0;
+    node->next = m_first;
+    if (m_first)
+        m_first->previous = node;
+    m_first = node;
+    if (!m_last)
+        m_last = node;
+}
+
+void BinEditBlockCache::unlink(Node *node)
+{
+    if (node->previous)
+        node->previous->next = node->next;
+    else
+        m_first = node->next;
+    if (node->next)
+        node->next->previous = node->previous;
+    else
+        m_last = node->previous;
+    node->previous = node->next = 0;
+}
+
+void BinEditBlockCache::touch(Node *node)
+{
+    if (node == m_first)
+        return;
+    unlink(node);
+    link(node);
+}
+
+void BinEditBlockCache::trim()
+{
+    // Never evict the most recently used block, it was just asked for.
+    Node *node = m_last;
+    while (node && node != m_first && m_totalCost > m_maxCost) {
+        Node *previous = node->previous;
+        if (!isPinned(node->block)) {
+            m_nodes.remove(node->block);
+            unlink(node);
+            m_totalCost -= node->data.size();
+            delete node;
+            ++m_statistics.evictions;
+        }
+        node = previous;
+    }
+}
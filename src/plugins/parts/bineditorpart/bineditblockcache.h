@@ -0,0 +1,75 @@
+#ifndef BINEDITBLOCKCACHE_H
+#define BINEDITBLOCKCACHE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QPair>
+
+class BinEditBlockCache
+{
+    Q_DISABLE_COPY(BinEditBlockCache)
+
+public:
+    struct Statistics
+    {
+        Statistics() : hits(0), misses(0), evictions(0) {}
+
+        quint64 hits;
+        quint64 misses;
+        quint64 evictions;
+    };
+
+    explicit BinEditBlockCache(qint64 maxCost = 64 * 1024 * 1024);
+    ~BinEditBlockCache();
+
+    qint64 maxCost() const { return m_maxCost; }
+    void setMaxCost(qint64 maxCost);
+    qint64 totalCost() const { return m_totalCost; }
+
+    int count() const { return m_nodes.count(); }
+    QList<qint64> keys() const { return m_nodes.keys(); }
+
+    bool lookup(qint64 block);
+    bool contains(qint64 block) const { return m_nodes.contains(block); }
+    QByteArray value(qint64 block, const QByteArray &defaultValue = QByteArray());
+    QByteArray peek(qint64 block) const;
+
+    void insert(qint64 block, const QByteArray &data, const void *owner = 0);
+    void remove(qint64 block);
+    void removeOwnedBy(const void *owner);
+    void clear();
+
+    void setPinnedRange(const void *owner, qint64 firstBlock, qint64 lastBlock);
+    void removePinnedRange(const void *owner);
+
+    Statistics statistics() const { return m_statistics; }
+    void resetStatistics() { m_statistics = Statistics(); }
+
+private:
+    struct Node
+    {
+        qint64 block;
+        QByteArray data;
+        const void *owner;
+        Node *previous;
+        Node *next;
+    };
+
+    bool isPinned(qint64 block) const;
+    void link(Node *node);
+    void unlink(Node *node);
+    void touch(Node *node);
+    void trim();
+
+private:
+    QHash<qint64, Node *> m_nodes;
+    QHash<const void *, QPair<qint64, qint64> > m_pinnedRanges;
+    Node *m_first;
+    Node *m_last;
+    qint64 m_maxCost;
+    qint64 m_totalCost;
+    Statistics m_statistics;
+};
+
+#endif // BINEDITBLOCKCACHE_H
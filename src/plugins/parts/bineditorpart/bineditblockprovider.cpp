@@ -0,0 +1,273 @@
+#include "bineditblockprovider.h"
+
+#include "bineditmapguard.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QtAlgorithms>
+
+#include <string.h>
+
+#if defined(Q_OS_UNIX)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static bool lessExtentEnd(const BinEditBlockProvider::Extent &extent, qint64 offset)
+{
+    return extent.offset + extent.length <= offset;
+}
+
+/*!
+    \class BinEditBlockProvider
+
+    Serves fixed-size blocks of a device to BinEdit.
+
+    The device is opened once and kept open for the lifetime of the provider.
+    Regular files are memory mapped and blocks are returned as raw views into
+    the mapping, so no data is copied; devices that can't be mapped (pipes,
+    buffers, files too large for the address space) fall back to seek and
+    read on the persistent handle.
+
+    Holes of sparse files are found with SEEK_DATA and SEEK_HOLE when the
+    file is opened or refreshed. They read as zeros without touching the
+    file or the mapping, so scrolling through and scanning a mostly empty
+    disk image costs no I/O for the empty parts.
+
+    Blocks returned from a mapping stay valid only until close() or a
+    refresh() that changes the size, the caller must drop them before that.
+    The mapping is registered with BinEditMapGuard, so if another process
+    truncates the file, the part of a block past the new end reads as
+    zeroes instead of crashing, until refresh() maps the new size.
+
+    block() may be called from several threads at once, open(), close() and
+    refresh() may not run concurrently with it.
+*/
+
+BinEditBlockProvider::BinEditBlockProvider() :
+    m_device(0),
+    m_file(0),
+    m_map(0),
+    m_size(0),
+    m_openedDevice(false),
+    m_sparse(false)
+{
+}
+
+BinEditBlockProvider::~BinEditBlockProvider()
+{
+    close();
+}
+
+/*!
+    Opens \a device for reading and maps it if possible.
+*/
+bool BinEditBlockProvider::open(QIODevice *device)
+{
+    close();
+
+    if (!device)
+        return false;
+
+    m_openedDevice = !device->isOpen();
+    if (m_openedDevice && !device->open(QIODevice::ReadOnly)) {
+        m_errorString = device->errorString();
+        m_openedDevice = false;
+        return false;
+    }
+
+    m_device = device;
+    m_file = qobject_cast<QFile *>(device);
+    m_size = device->size();
+    m_errorString.clear();
+    map();
+    scanExtents();
+    return true;
+}
+
+/*!
+    Unmaps the device and closes it if it was opened by the provider.
+*/
+void BinEditBlockProvider::close()
+{
+    unmap();
+    if (m_device && m_openedDevice)
+        m_device->close();
+    m_device = 0;
+    m_file = 0;
+    m_size = 0;
+    m_openedDevice = false;
+    m_sparse = false;
+    m_extents.clear();
+}
+
+/*!
+    Returns block number \a block, padded with zeroes to \a blockSize bytes
+    if it crosses the end of the device.
+*/
+QByteArray BinEditBlockProvider::block(qint64 block, int blockSize) const
+{
+    const qint64 offset = block * blockSize;
+    if (!m_device || offset < 0 || offset >= m_size)
+        return QByteArray(blockSize, '\0');
+
+    QByteArray data = read(offset, int(qMin<qint64>(blockSize, m_size - offset)));
+
+    // Reads of the device fall short if the file was truncated since the
+    // last refresh().
+    if (data.size() != blockSize)
+        data.append(QByteArray(blockSize - data.size(), '\0'));
+    return data;
+}
+
+/*!
+    Returns up to \a length bytes starting at \a offset. Unlike block(), the
+    result is not padded, it is shorter if the range crosses the end of the
+    device and empty on errors.
+*/
+QByteArray BinEditBlockProvider::read(qint64 offset, int length) const
+{
+    if (!m_device || offset < 0 || offset >= m_size || length <= 0)
+        return QByteArray();
+
+    const int available = int(qMin<qint64>(length, m_size - offset));
+    if (!m_sparse)
+        return readData(offset, available);
+
+    const qint64 end = offset + available;
+    ExtentList::const_iterator it = qLowerBound(m_extents.constBegin(), m_extents.constEnd(),
+                                                offset, lessExtentEnd);
+    if (it != m_extents.constEnd() && it->offset <= offset && it->offset + it->length >= end)
+        return readData(offset, available);
+
+    // Only the data extents in the range are read, holes stay zero.
+    QByteArray data(available, '\0');
+    for (; it != m_extents.constEnd() && it->offset < end; ++it) {
+        const qint64 from = qMax(offset, it->offset);
+        const qint64 to = qMin(end, it->offset + it->length);
+        const QByteArray part = readData(from, int(to - from));
+        ::memcpy(data.data() + (from - offset), part.constData(), size_t(part.size()));
+    }
+    return data;
+}
+
+/*!
+    Returns true if the \a length bytes at \a offset all lie in holes of a
+    sparse file and read as zeros.
+*/
+bool BinEditBlockProvider::isHole(qint64 offset, qint64 length) const
+{
+    if (!m_sparse || length <= 0)
+        return false;
+
+    const ExtentList::const_iterator it = qLowerBound(m_extents.constBegin(), m_extents.constEnd(),
+                                                      offset, lessExtentEnd);
+    return it == m_extents.constEnd() || it->offset >= offset + length;
+}
+
+/*!
+    Checks whether the size of the underlying file changed and remaps it.
+    Returns true if the size changed, in which case all blocks previously
+    returned by the provider are invalid.
+*/
+bool BinEditBlockProvider::refresh()
+{
+    if (!m_device)
+        return false;
+
+    // Holes may have been filled without changing the size.
+    const qint64 size = m_device->size();
+    if (size == m_size) {
+        scanExtents();
+        return false;
+    }
+
+    unmap();
+    m_size = size;
+    map();
+    scanExtents();
+    return true;
+}
+
+bool BinEditBlockProvider::map()
+{
+    if (!m_file || m_size <= 0)
+        return false;
+
+    m_map = m_file->map(0, m_size);
+    if (m_map && !BinEditMapGuard::add(m_map, m_size)) {
+        m_file->unmap(m_map);
+        m_map = 0;
+    }
+    return m_map != 0;
+}
+
+void BinEditBlockProvider::unmap()
+{
+    if (m_map && m_file) {
+        BinEditMapGuard::remove(m_map);
+        m_file->unmap(m_map);
+    }
+    m_map = 0;
+}
+
+// Reads the range from the mapping or the device, regardless of holes.
+QByteArray BinEditBlockProvider::readData(qint64 offset, int length) const
+{
+    if (m_map)
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(m_map + offset), length);
+
+    QMutexLocker locker(&m_readMutex);
+    if (!m_device->seek(offset))
+        return QByteArray();
+    return m_device->read(length);
+}
+
+/*
+    Collects the data extents of a sparse file. File systems without
+    SEEK_DATA report the whole file as data, the provider then reads
+    holes like any other range.
+*/
+void BinEditBlockProvider::scanExtents()
+{
+    m_sparse = false;
+    m_extents.clear();
+
+#if defined(Q_OS_UNIX) && defined(SEEK_DATA) && defined(SEEK_HOLE)
+    if (!m_file || m_size <= 0)
+        return;
+
+    // Seeking the descriptor of m_file would move it under QFile.
+    const int fd = ::open(QFile::encodeName(m_file->fileName()).constData(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    ExtentList extents;
+    qint64 offset = 0;
+    bool ok = true;
+    while (offset < m_size) {
+        const off_t data = ::lseek(fd, off_t(offset), SEEK_DATA);
+        if (data < 0) {
+            // ENXIO means the rest of the file is a hole.
+            ok = errno == ENXIO;
+            break;
+        }
+        if (data >= m_size)
+            break;
+        const off_t hole = ::lseek(fd, data, SEEK_HOLE);
+        if (hole < 0 || extents.size() == MaxExtentCount) {
+            ok = false;
+            break;
+        }
+        const Extent extent = { qint64(data), qMin<qint64>(hole, m_size) - data };
+        extents.append(extent);
+        offset = extent.offset + extent.length;
+    }
+    ::close(fd);
+
+    if (!ok || (extents.size() == 1 && extents.first().length == m_size))
+        return;
+    m_extents = extents;
+    m_sparse = true;
+#endif
+}
@@ -0,0 +1,62 @@
+#ifndef BINEDITBLOCKPROVIDER_H
+#define BINEDITBLOCKPROVIDER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+class QFile;
+class QIODevice;
+
+class BinEditBlockProvider
+{
+public:
+    // A range of a sparse file that holds data, the rest are holes.
+    struct Extent {
+        qint64 offset;
+        qint64 length;
+    };
+    typedef QVector<Extent> ExtentList;
+
+    // Files with more extents are treated as if they had no holes.
+    static const int MaxExtentCount = 65536;
+
+    BinEditBlockProvider();
+    ~BinEditBlockProvider();
+
+    bool open(QIODevice *device);
+    void close();
+
+    bool isOpen() const { return m_device != 0; }
+    bool isMapped() const { return m_map != 0; }
+
+    qint64 size() const { return m_size; }
+    bool isSparse() const { return m_sparse; }
+    ExtentList dataExtents() const { return m_extents; }
+    bool isHole(qint64 offset, qint64 length) const;
+    QString errorString() const { return m_errorString; }
+
+    QByteArray block(qint64 block, int blockSize) const;
+    QByteArray read(qint64 offset, int length) const;
+    bool refresh();
+
+private:
+    bool map();
+    void unmap();
+    void scanExtents();
+    QByteArray readData(qint64 offset, int length) const;
+
+private:
+    QIODevice *m_device;
+    QFile *m_file;
+    uchar *m_map;
+    qint64 m_size;
+    bool m_openedDevice;
+    bool m_sparse;
+    ExtentList m_extents;
+    QString m_errorString;
+    mutable QMutex m_readMutex;
+};
+
+#endif // BINEDITBLOCKPROVIDER_H
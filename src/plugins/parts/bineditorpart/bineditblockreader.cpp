@@ -0,0 +1,106 @@
+#include "bineditblockreader.h"
+
+#include "bineditblockprovider.h"
+
+/*!
+    \class BinEditBlockReader
+
+    Background thread that reads blocks from a BinEditBlockProvider ahead of
+    the view.
+
+    read() replaces the list of queued blocks, so requests made while
+    scrolling quickly don't pile up behind blocks that are no longer
+    visible. Blocks are delivered through the blockRead() signal together
+    with the generation they were requested in; reset() bumps the
+    generation, so blocks still in flight when the provider is closed or
+    remapped can be recognized and dropped by the receiver.
+*/
+
+BinEditBlockReader::BinEditBlockReader(BinEditBlockProvider *provider, QObject *parent) :
+    QThread(parent),
+    m_provider(provider),
+    m_currentBlock(-1),
+    m_blockSize(4096),
+    m_generation(0),
+    m_stop(false)
+{
+}
+
+BinEditBlockReader::~BinEditBlockReader()
+{
+    m_mutex.lock();
+    m_stop = true;
+    m_queue.clear();
+    m_requestCondition.wakeAll();
+    m_mutex.unlock();
+    wait();
+}
+
+int BinEditBlockReader::generation() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_generation;
+}
+
+/*!
+    Schedules \a blocks for reading in the given order, dropping blocks
+    queued by the previous call that were not read yet.
+*/
+void BinEditBlockReader::read(const QList<qint64> &blocks, int blockSize)
+{
+    QMutexLocker locker(&m_mutex);
+    if (blockSize != m_blockSize) {
+        m_blockSize = blockSize;
+        ++m_generation;
+    }
+
+    m_queue = blocks;
+    m_queue.removeAll(m_currentBlock);
+    if (!m_queue.isEmpty())
+        m_requestCondition.wakeOne();
+}
+
+/*!
+    Drops all queued blocks and waits for the block being read to finish.
+    Blocks emitted before the call carry an outdated generation.
+*/
+void BinEditBlockReader::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    ++m_generation;
+    while (m_currentBlock != -1)
+        m_idleCondition.wait(&m_mutex);
+}
+
+void BinEditBlockReader::run()
+{
+    QMutexLocker locker(&m_mutex);
+    forever {
+        while (!m_stop && m_queue.isEmpty())
+            m_requestCondition.wait(&m_mutex);
+        if (m_stop)
+            return;
+
+        m_currentBlock = m_queue.takeFirst();
+        const qint64 block = m_currentBlock;
+        const int blockSize = m_blockSize;
+        const int generation = m_generation;
+        locker.unlock();
+
+        QByteArray data = m_provider->block(block, blockSize);
+
+        // Blocks of a mapped file are views into the mapping, touch every
+        // page so that the GUI thread doesn't fault them in itself.
+        const char *pages = data.constData();
+        volatile char sink = 0;
+        for (int i = 0; i < data.size(); i += 4096)
+            sink = sink + pages[i];
+
+        locker.relock();
+        m_currentBlock = -1;
+        m_idleCondition.wakeAll();
+        if (generation == m_generation)
+            emit blockRead(block, data, generation);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef BINEDITBLOCKREADER_H
+#define BINEDITBLOCKREADER_H
+
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+class BinEditBlockProvider;
+
+class BinEditBlockReader : public QThread
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditBlockReader)
+
+public:
+    explicit BinEditBlockReader(BinEditBlockProvider *provider, QObject *parent = 0);
+    ~BinEditBlockReader();
+
+    int generation() const;
+
+    void read(const QList<qint64> &blocks, int blockSize);
+    void reset();
+
+signals:
+    void blockRead(qint64 block, const QByteArray &data, int generation);
+
+protected:
+    void run();
+
+private:
+    BinEditBlockProvider *m_provider;
+    mutable QMutex m_mutex;
+    QWaitCondition m_requestCondition;
+    QWaitCondition m_idleCondition;
+    QList<qint64> m_queue;
+    qint64 m_currentBlock;
+    int m_blockSize;
+    int m_generation;
+    bool m_stop;
+};
+
+#endif // BINEDITBLOCKREADER_H
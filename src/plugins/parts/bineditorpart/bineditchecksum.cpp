@@ -0,0 +1,646 @@
+#include "bineditchecksum.h"
+
+#include "bineditblockprovider.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QRunnable>
+
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#  define BINEDIT_HAVE_X86_EXTENSIONS
+#  include <cpuid.h>
+#  include <immintrin.h>
+#endif
+
+/*
+    Table driven CRC, eight bytes per step (slicing-by-8) for the
+    reflected polynomial it was built for.
+*/
+class BinEditCrcTable
+{
+public:
+    explicit BinEditCrcTable(quint32 polynomial)
+    {
+        for (int i = 0; i < 256; ++i) {
+            quint32 crc = quint32(i);
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+            table[0][i] = crc;
+        }
+        for (int i = 0; i < 256; ++i) {
+            for (int slice = 1; slice < 8; ++slice)
+                table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xff];
+        }
+    }
+
+    quint32 update(quint32 crc, const uchar *data, qint64 length) const
+    {
+        while (length && (quintptr(data) & 7)) {
+            crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xff];
+            --length;
+        }
+        for (; length >= 8; data += 8, length -= 8) {
+            const quint32 low = crc ^ (quint32(data[0]) | quint32(data[1]) << 8
+                                       | quint32(data[2]) << 16 | quint32(data[3]) << 24);
+            crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff]
+                    ^ table[5][(low >> 16) & 0xff] ^ table[4][low >> 24]
+                    ^ table[3][data[4]] ^ table[2][data[5]]
+                    ^ table[1][data[6]] ^ table[0][data[7]];
+        }
+        while (length--)
+            crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xff];
+        return crc;
+    }
+
+private:
+    quint32 table[8][256];
+};
+
+static const BinEditCrcTable crc32Table(0xedb88320);
+static const BinEditCrcTable crc32cTable(0x82f63b78);
+
+#if defined(BINEDIT_HAVE_X86_EXTENSIONS)
+
+static bool hasCpuFeature(int leaf, int reg, int bit)
+{
+    unsigned int regs[4] = { 0, 0, 0, 0 };
+    if (!__get_cpuid_count(leaf, 0, &regs[0], &regs[1], &regs[2], &regs[3]))
+        return false;
+    return regs[reg] & (1u << bit);
+}
+
+static bool hasPclmul()
+{
+    // CPUID.1:ECX.PCLMULQDQ and SSE4.1
+    static const bool result = hasCpuFeature(1, 2, 1) && hasCpuFeature(1, 2, 19);
+    return result;
+}
+
+static bool hasSse42()
+{
+    static const bool result = hasCpuFeature(1, 2, 20);
+    return result;
+}
+
+static bool hasShaExtensions()
+{
+    // CPUID.7:EBX.SHA and SSE4.1
+    static const bool result = hasCpuFeature(7, 1, 29) && hasCpuFeature(1, 2, 19);
+    return result;
+}
+
+/*
+    CRC-32 by folding 64 bytes at a time with carry-less multiplication and
+    a final Barrett reduction, see Intel's "Fast CRC Computation for Generic
+    Polynomials Using PCLMULQDQ Instruction". Handles a multiple of 16
+    bytes, at least 64.
+*/
+__attribute__((target("pclmul,sse4.1")))
+static quint32 crc32FoldPclmul(quint32 crc, const uchar *data, qint64 length)
+{
+    const __m128i k1k2 = _mm_set_epi64x(Q_INT64_C(0x01c6e41596), Q_INT64_C(0x0154442bd4));
+    const __m128i k3k4 = _mm_set_epi64x(Q_INT64_C(0x00ccaa009e), Q_INT64_C(0x01751997d0));
+    const __m128i k5 = _mm_set_epi64x(0, Q_INT64_C(0x0163cd6124));
+    const __m128i polynomial = _mm_set_epi64x(Q_INT64_C(0x01f7011641), Q_INT64_C(0x01db710641));
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    const __m128i *p = reinterpret_cast<const __m128i *>(data);
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128(p), _mm_cvtsi32_si128(int(crc)));
+    __m128i x2 = _mm_loadu_si128(p + 1);
+    __m128i x3 = _mm_loadu_si128(p + 2);
+    __m128i x4 = _mm_loadu_si128(p + 3);
+    p += 4;
+    length -= 64;
+
+    for (; length >= 64; p += 4, length -= 64) {
+        const __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        const __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        const __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        const __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k1k2, 0x11), x5), _mm_loadu_si128(p));
+        x2 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x2, k1k2, 0x11), x6), _mm_loadu_si128(p + 1));
+        x3 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x3, k1k2, 0x11), x7), _mm_loadu_si128(p + 2));
+        x4 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x4, k1k2, 0x11), x8), _mm_loadu_si128(p + 3));
+    }
+
+    // Fold the four lanes into one, then the remaining 16 byte blocks.
+    __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+    for (; length >= 16; ++p, length -= 16) {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128(p)), x5);
+    }
+
+    // 128 to 64 bits.
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00), x2);
+
+    // Barrett reduction to 32 bits.
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), polynomial, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), polynomial, 0x00);
+    return quint32(_mm_extract_epi32(_mm_xor_si128(x1, x2), 1));
+}
+
+static quint32 crc32Pclmul(quint32 crc, const uchar *data, qint64 length)
+{
+    if (length >= 64) {
+        const qint64 folded = length & ~qint64(15);
+        crc = crc32FoldPclmul(crc, data, folded);
+        data += folded;
+        length -= folded;
+    }
+    return crc32Table.update(crc, data, length);
+}
+
+__attribute__((target("sse4.2")))
+static quint32 crc32cSse42(quint32 crc, const uchar *data, qint64 length)
+{
+    while (length && (quintptr(data) & 7)) {
+        crc = _mm_crc32_u8(crc, *data++);
+        --length;
+    }
+#if defined(__x86_64__)
+    quint64 crc64 = crc;
+    for (; length >= 8; data += 8, length -= 8)
+        crc64 = _mm_crc32_u64(crc64, *reinterpret_cast<const quint64 *>(data));
+    crc = quint32(crc64);
+#endif
+    for (; length >= 4; data += 4, length -= 4)
+        crc = _mm_crc32_u32(crc, *reinterpret_cast<const quint32 *>(data));
+    while (length--)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+
+#endif // BINEDIT_HAVE_X86_EXTENSIONS
+
+static quint32 crc32Update(quint32 crc, const uchar *data, qint64 length)
+{
+#if defined(BINEDIT_HAVE_X86_EXTENSIONS)
+    if (hasPclmul())
+        return crc32Pclmul(crc, data, length);
+#endif
+    return crc32Table.update(crc, data, length);
+}
+
+static quint32 crc32cUpdate(quint32 crc, const uchar *data, qint64 length)
+{
+#if defined(BINEDIT_HAVE_X86_EXTENSIONS)
+    if (hasSse42())
+        return crc32cSse42(crc, data, length);
+#endif
+    return crc32cTable.update(crc, data, length);
+}
+
+static const quint32 sha256RoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline quint32 rotateRight(quint32 value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static void sha256Blocks(quint32 *state, const uchar *data, qint64 blocks)
+{
+    for (; blocks > 0; --blocks, data += 64) {
+        quint32 w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = quint32(data[4 * i]) << 24 | quint32(data[4 * i + 1]) << 16
+                    | quint32(data[4 * i + 2]) << 8 | quint32(data[4 * i + 3]);
+        }
+        for (int i = 16; i < 64; ++i) {
+            const quint32 s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const quint32 s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        quint32 a = state[0], b = state[1], c = state[2], d = state[3];
+        quint32 e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            const quint32 s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+            const quint32 t1 = h + s1 + ((e & f) ^ (~e & g)) + sha256RoundConstants[i] + w[i];
+            const quint32 s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+            const quint32 t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#if defined(BINEDIT_HAVE_X86_EXTENSIONS)
+
+/*
+    SHA-256 with the SHA extensions, four rounds per sha256rnds2 pair.
+    The state is kept as ABEF and CDGH as the instructions expect.
+*/
+__attribute__((target("sha,sse4.1")))
+static void sha256BlocksSha(quint32 *state, const uchar *data, qint64 blocks)
+{
+    const __m128i byteSwap = _mm_set_epi64x(Q_INT64_C(0x0c0d0e0f08090a0b), Q_INT64_C(0x0405060700010203));
+
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(state));      // DCBA
+    __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)); // HGFE
+    tmp = _mm_shuffle_epi32(tmp, 0xb1);         // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1b);   // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);        // CDGH
+
+    for (; blocks > 0; --blocks, data += 64) {
+        const __m128i abef = state0;
+        const __m128i cdgh = state1;
+        __m128i messages[4];
+        for (int i = 0; i < 4; ++i) {
+            messages[i] = _mm_shuffle_epi8(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data) + i), byteSwap);
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            const __m128i current = messages[i & 3];
+            const __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sha256RoundConstants + 4 * i));
+            __m128i message = _mm_add_epi32(current, k);
+            state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+            if (i >= 3 && i < 15) {
+                // The next four words, the schedule runs three groups ahead.
+                __m128i &next = messages[(i + 1) & 3];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(current, messages[(i - 1) & 3], 4));
+                next = _mm_sha256msg2_epu32(next, current);
+            }
+            message = _mm_shuffle_epi32(message, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, message);
+            if (i >= 1 && i < 13)
+                messages[(i - 1) & 3] = _mm_sha256msg1_epu32(messages[(i - 1) & 3], current);
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);      // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xb1);   // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0); // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);    // HGFE
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), state1);
+}
+
+#endif // BINEDIT_HAVE_X86_EXTENSIONS
+
+/*
+    Incremental SHA-256, Qt 4 has no QCryptographicHash::Sha256 and Qt's
+    implementation does not use the SHA extensions.
+*/
+class BinEditSha256
+{
+public:
+    BinEditSha256() :
+        m_length(0),
+        m_buffered(0)
+    {
+        static const quint32 initialState[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        memcpy(m_state, initialState, sizeof(m_state));
+    }
+
+    void addData(const uchar *data, qint64 length)
+    {
+        m_length += quint64(length);
+        if (m_buffered) {
+            const int count = int(qMin<qint64>(64 - m_buffered, length));
+            memcpy(m_buffer + m_buffered, data, size_t(count));
+            m_buffered += count;
+            data += count;
+            length -= count;
+            if (m_buffered < 64)
+                return;
+            compress(m_buffer, 1);
+            m_buffered = 0;
+        }
+        compress(data, length / 64);
+        data += length & ~qint64(63);
+        m_buffered = int(length & 63);
+        memcpy(m_buffer, data, size_t(m_buffered));
+    }
+
+    QByteArray result()
+    {
+        const quint64 bits = m_length * 8;
+        uchar padding[72];
+        memset(padding, 0, sizeof(padding));
+        padding[0] = 0x80;
+        const int paddingLength = (m_buffered < 56 ? 56 : 120) - m_buffered;
+        for (int i = 0; i < 8; ++i)
+            padding[paddingLength + i] = uchar(bits >> (56 - 8 * i));
+        addData(padding, paddingLength + 8);
+
+        QByteArray digest(32, Qt::Uninitialized);
+        for (int i = 0; i < 32; ++i)
+            digest[i] = char(m_state[i / 4] >> (24 - 8 * (i % 4)));
+        return digest;
+    }
+
+private:
+    void compress(const uchar *data, qint64 blocks)
+    {
+        if (blocks <= 0)
+            return;
+#if defined(BINEDIT_HAVE_X86_EXTENSIONS)
+        if (hasShaExtensions()) {
+            sha256BlocksSha(m_state, data, blocks);
+            return;
+        }
+#endif
+        sha256Blocks(m_state, data, blocks);
+    }
+
+    quint32 m_state[8];
+    uchar m_buffer[64];
+    quint64 m_length;
+    int m_buffered;
+};
+
+static QByteArray bigEndian(quint32 value)
+{
+    QByteArray result(4, Qt::Uninitialized);
+    for (int i = 0; i < 4; ++i)
+        result[i] = char(value >> (24 - 8 * i));
+    return result;
+}
+
+class BinEditChecksumJob
+{
+public:
+    BinEditBlockProvider *provider;
+    BinEditChecksum::Algorithms algorithms;
+    quint64 baseAddress;
+    BinEditPieceTable::PieceList pieces;
+    QSharedPointer<BinEditAddBuffer> addBuffer;
+    qint64 from;
+    qint64 length;
+    int generation;
+    QAtomicInt stopped;
+    QMap<int, QByteArray> digests;
+
+    bool isStopped() const
+    {
+#if QT_VERSION >= 0x050000
+        return stopped.load();
+#else
+        return stopped;
+#endif
+    }
+};
+
+class BinEditChecksumTask : public QRunnable
+{
+public:
+    BinEditChecksumTask(const QSharedPointer<BinEditChecksumJob> &job, QObject *receiver) :
+        m_job(job),
+        m_receiver(receiver)
+    {
+    }
+
+    void run();
+
+private:
+    QSharedPointer<BinEditChecksumJob> m_job;
+    QObject *m_receiver;
+};
+
+void BinEditChecksumTask::run()
+{
+    BinEditChecksumJob &job = *m_job;
+    QElapsedTimer timer;
+    timer.start();
+
+    // Every chunk is read once and fed to all digests while it is hot in
+    // the cache.
+    quint32 crc32 = 0xffffffff;
+    quint32 crc32c = 0xffffffff;
+    QCryptographicHash md5(QCryptographicHash::Md5);
+    QCryptographicHash sha1(QCryptographicHash::Sha1);
+    BinEditSha256 sha256;
+
+    int chunks = 0;
+    for (qint64 offset = 0; offset < job.length && !job.isStopped(); offset += BinEditChecksum::ChunkSize) {
+        const int length = int(qMin<qint64>(BinEditChecksum::ChunkSize, job.length - offset));
+        const QByteArray data = BinEditPieceTable::read(job.pieces, job.addBuffer.data(), job.provider,
+                                                        job.baseAddress, job.from + offset, length);
+        const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+        if (job.algorithms & BinEditChecksum::Crc32)
+            crc32 = crc32Update(crc32, bytes, data.size());
+        if (job.algorithms & BinEditChecksum::Crc32C)
+            crc32c = crc32cUpdate(crc32c, bytes, data.size());
+        if (job.algorithms & BinEditChecksum::Md5)
+            md5.addData(data.constData(), data.size());
+        if (job.algorithms & BinEditChecksum::Sha1)
+            sha1.addData(data.constData(), data.size());
+        if (job.algorithms & BinEditChecksum::Sha256)
+            sha256.addData(bytes, data.size());
+        QMetaObject::invokeMethod(m_receiver, "handleChunkDone", Qt::QueuedConnection,
+                                  Q_ARG(int, job.generation), Q_ARG(int, ++chunks));
+    }
+
+    if (!job.isStopped()) {
+        if (job.algorithms & BinEditChecksum::Crc32)
+            job.digests.insert(BinEditChecksum::Crc32, bigEndian(~crc32));
+        if (job.algorithms & BinEditChecksum::Crc32C)
+            job.digests.insert(BinEditChecksum::Crc32C, bigEndian(~crc32c));
+        if (job.algorithms & BinEditChecksum::Md5)
+            job.digests.insert(BinEditChecksum::Md5, md5.result());
+        if (job.algorithms & BinEditChecksum::Sha1)
+            job.digests.insert(BinEditChecksum::Sha1, sha1.result());
+        if (job.algorithms & BinEditChecksum::Sha256)
+            job.digests.insert(BinEditChecksum::Sha256, sha256.result());
+    }
+
+    QMetaObject::invokeMethod(m_receiver, "handleDone", Qt::QueuedConnection,
+                              Q_ARG(int, job.generation), Q_ARG(qint64, timer.elapsed()));
+}
+
+/*!
+    \class BinEditChecksum
+
+    Computes checksums and digests of a range of the data on a worker
+    thread.
+
+    Like BinEditExport, it works on a snapshot of the piece table and
+    streams original data from the BinEditBlockProvider chunk by chunk.
+    All requested algorithms are computed in a single pass over the data.
+    CRC-32 uses carry-less multiplication, CRC-32C the SSE 4.2 CRC
+    instruction and SHA-256 the SHA extensions when the CPU supports them,
+    table driven and portable code otherwise. MD5 and SHA-1 are computed
+    by QCryptographicHash.
+
+    Digests are returned as raw bytes, CRCs in big endian order as they are
+    usually written. cancel() must be called before the provider is closed
+    or remapped.
+*/
+
+BinEditChecksum::BinEditChecksum(BinEditBlockProvider *provider, QObject *parent) :
+    QObject(parent),
+    m_provider(provider),
+    m_algorithms(0),
+    m_from(0),
+    m_length(0),
+    m_elapsed(0),
+    m_generation(0),
+    m_chunkCount(0),
+    m_running(false)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+BinEditChecksum::~BinEditChecksum()
+{
+    cancel();
+}
+
+/*!
+    Returns all supported algorithms in the order they are usually listed.
+*/
+QList<BinEditChecksum::Algorithm> BinEditChecksum::allAlgorithms()
+{
+    return QList<Algorithm>() << Crc32 << Crc32C << Md5 << Sha1 << Sha256;
+}
+
+/*!
+    Returns the display name of \a algorithm.
+*/
+QString BinEditChecksum::name(Algorithm algorithm)
+{
+    switch (algorithm) {
+    case Crc32:
+        return QLatin1String("CRC-32");
+    case Crc32C:
+        return QLatin1String("CRC-32C");
+    case Md5:
+        return QLatin1String("MD5");
+    case Sha1:
+        return QLatin1String("SHA-1");
+    case Sha256:
+        return QLatin1String("SHA-256");
+    }
+    return QString();
+}
+
+/*!
+    Returns true if \a algorithm uses dedicated instructions of this CPU.
+*/
+bool BinEditChecksum::isHardwareAccelerated(Algorithm algorithm)
+{
+#if defined(BINEDIT_HAVE_X86_EXTENSIONS)
+    switch (algorithm) {
+    case Crc32:
+        return hasPclmul();
+    case Crc32C:
+        return hasSse42();
+    case Sha256:
+        return hasShaExtensions();
+    default:
+        break;
+    }
+#else
+    Q_UNUSED(algorithm);
+#endif
+    return false;
+}
+
+/*!
+    Starts computing \a algorithms over \a length bytes at \a from of the
+    data described by \a pieces and \a addBuffer, with original data at
+    \a baseAddress. A calculation that is already running is canceled.
+*/
+void BinEditChecksum::start(Algorithms algorithms, quint64 baseAddress,
+                            const BinEditPieceTable::PieceList &pieces,
+                            const QSharedPointer<BinEditAddBuffer> &addBuffer,
+                            qint64 from, qint64 length)
+{
+    cancel();
+
+    QSharedPointer<BinEditChecksumJob> job(new BinEditChecksumJob);
+    job->provider = m_provider;
+    job->algorithms = algorithms;
+    job->baseAddress = baseAddress;
+    job->pieces = pieces;
+    job->addBuffer = addBuffer;
+    job->from = from;
+    job->length = qMax<qint64>(0, length);
+    job->generation = m_generation;
+    m_job = job;
+
+    m_algorithms = algorithms;
+    m_digests.clear();
+    m_from = from;
+    m_length = job->length;
+    m_elapsed = 0;
+    m_chunkCount = int((job->length + ChunkSize - 1) / ChunkSize);
+    m_running = true;
+    emit started();
+    emit progressChanged(0, m_chunkCount);
+
+    m_pool.start(new BinEditChecksumTask(job, this));
+}
+
+/*!
+    Stops the running calculation, no digests are available afterwards.
+*/
+void BinEditChecksum::cancel()
+{
+    if (m_job) {
+        m_job->stopped.fetchAndStoreRelaxed(1);
+        m_pool.waitForDone();
+        m_job.clear();
+    }
+
+    ++m_generation;
+    if (m_running) {
+        m_running = false;
+        m_digests.clear();
+        emit finished(false);
+    }
+}
+
+void BinEditChecksum::handleChunkDone(int generation, int chunks)
+{
+    if (generation == m_generation)
+        emit progressChanged(chunks, m_chunkCount);
+}
+
+void BinEditChecksum::handleDone(int generation, qint64 elapsed)
+{
+    if (generation != m_generation || !m_job)
+        return;
+
+    m_digests = m_job->digests;
+    m_elapsed = elapsed;
+    m_job.clear();
+    m_running = false;
+    emit finished(true);
+}
@@ -0,0 +1,80 @@
+#ifndef BINEDITCHECKSUM_H
+#define BINEDITCHECKSUM_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QMap>
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThreadPool>
+
+#include "bineditpiecetable.h"
+
+class BinEditBlockProvider;
+class BinEditChecksumJob;
+
+class BinEditChecksum : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditChecksum)
+
+public:
+    enum Algorithm {
+        Crc32 = 0x1,
+        Crc32C = 0x2,
+        Md5 = 0x4,
+        Sha1 = 0x8,
+        Sha256 = 0x10
+    };
+    Q_DECLARE_FLAGS(Algorithms, Algorithm)
+
+    static const int ChunkSize = 4 * 1024 * 1024;
+
+    explicit BinEditChecksum(BinEditBlockProvider *provider, QObject *parent = 0);
+    ~BinEditChecksum();
+
+    static QList<Algorithm> allAlgorithms();
+    static QString name(Algorithm algorithm);
+    static bool isHardwareAccelerated(Algorithm algorithm);
+
+    bool isRunning() const { return m_running; }
+
+    Algorithms algorithms() const { return m_algorithms; }
+    QByteArray digest(Algorithm algorithm) const { return m_digests.value(algorithm); }
+    qint64 from() const { return m_from; }
+    qint64 length() const { return m_length; }
+    qint64 elapsed() const { return m_elapsed; }
+
+    void start(Algorithms algorithms, quint64 baseAddress,
+               const BinEditPieceTable::PieceList &pieces,
+               const QSharedPointer<BinEditAddBuffer> &addBuffer,
+               qint64 from, qint64 length);
+
+public slots:
+    void cancel();
+
+signals:
+    void started();
+    void progressChanged(int value, int maximum);
+    void finished(bool ok);
+
+private slots:
+    void handleChunkDone(int generation, int chunks);
+    void handleDone(int generation, qint64 elapsed);
+
+private:
+    BinEditBlockProvider *m_provider;
+    QThreadPool m_pool;
+    QSharedPointer<BinEditChecksumJob> m_job;
+    Algorithms m_algorithms;
+    QMap<int, QByteArray> m_digests;
+    qint64 m_from;
+    qint64 m_length;
+    qint64 m_elapsed;
+    int m_generation;
+    int m_chunkCount;
+    bool m_running;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(BinEditChecksum::Algorithms)
+
+#endif // BINEDITCHECKSUM_H
@@ -0,0 +1,164 @@
+#include "bineditchecksumpanel.h"
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QCheckBox>
+#include <QtWidgets/QGridLayout>
+#include <QtWidgets/QHBoxLayout>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QLineEdit>
+#include <QtWidgets/QProgressBar>
+#include <QtWidgets/QPushButton>
+#include <QtWidgets/QVBoxLayout>
+#else
+#include <QtGui/QCheckBox>
+#include <QtGui/QGridLayout>
+#include <QtGui/QHBoxLayout>
+#include <QtGui/QLabel>
+#include <QtGui/QLineEdit>
+#include <QtGui/QProgressBar>
+#include <QtGui/QPushButton>
+#include <QtGui/QVBoxLayout>
+#endif
+
+#include "binedit.h"
+#include "bineditchecksum.h"
+
+/*!
+    \class BinEditChecksumPanel
+
+    Panel below the BinEdit that computes CRCs and digests of the whole
+    data or of the selection in the background and shows them with the
+    throughput that was reached.
+*/
+
+BinEditChecksumPanel::BinEditChecksumPanel(BinEdit *editor, QWidget *parent) :
+    QWidget(parent),
+    m_editor(editor)
+{
+    setupUi();
+    retranslateUi();
+
+    BinEditChecksum *checksum = m_editor->checksum();
+    connect(checksum, SIGNAL(started()), SLOT(onStarted()));
+    connect(checksum, SIGNAL(progressChanged(int,int)), SLOT(onProgressChanged(int,int)));
+    connect(checksum, SIGNAL(finished(bool)), SLOT(onFinished(bool)));
+}
+
+/*!
+    Shows the panel and computes the checked digests of the selection, if
+    there is one, or of the whole data.
+*/
+void BinEditChecksumPanel::activate()
+{
+    show();
+    m_selectionBox->setChecked(m_editor->hasSelection());
+    if (!m_editor->checksum()->isRunning())
+        startOrCancel();
+    m_calculateButton->setFocus();
+}
+
+void BinEditChecksumPanel::startOrCancel()
+{
+    BinEditChecksum *checksum = m_editor->checksum();
+    if (checksum->isRunning()) {
+        checksum->cancel();
+        return;
+    }
+
+    BinEditChecksum::Algorithms algorithms = 0;
+    foreach (BinEditChecksum::Algorithm algorithm, BinEditChecksum::allAlgorithms()) {
+        if (m_algorithmBoxes.value(algorithm)->isChecked())
+            algorithms |= algorithm;
+    }
+    m_editor->calculateChecksums(algorithms, m_selectionBox->isChecked());
+}
+
+void BinEditChecksumPanel::onStarted()
+{
+    foreach (QLineEdit *edit, m_digestEdits)
+        edit->clear();
+    m_calculateButton->setText(tr("Cancel"));
+    m_progressBar->setValue(0);
+    m_progressBar->show();
+    m_statusLabel->clear();
+}
+
+void BinEditChecksumPanel::onProgressChanged(int value, int maximum)
+{
+    m_progressBar->setMaximum(maximum);
+    m_progressBar->setValue(value);
+}
+
+void BinEditChecksumPanel::onFinished(bool ok)
+{
+    m_calculateButton->setText(tr("Calculate"));
+    m_progressBar->hide();
+    if (!ok) {
+        m_statusLabel->setText(tr("Canceled"));
+        return;
+    }
+
+    const BinEditChecksum *checksum = m_editor->checksum();
+    foreach (BinEditChecksum::Algorithm algorithm, BinEditChecksum::allAlgorithms())
+        m_digestEdits.value(algorithm)->setText(QString::fromLatin1(checksum->digest(algorithm).toHex()));
+
+    // Elapsed times below a millisecond are reported as one.
+    const double seconds = qMax<qint64>(1, checksum->elapsed()) / 1000.0;
+    m_statusLabel->setText(tr("%n byte(s) at 0x%1 in %2 s, %3 MB/s", 0, checksum->length())
+                           .arg(QString::number(m_editor->baseAddress() + checksum->from(), 16))
+                           .arg(seconds, 0, 'f', 3)
+                           .arg(checksum->length() / seconds / (1024 * 1024), 0, 'f', 1));
+}
+
+void BinEditChecksumPanel::setupUi()
+{
+    QGridLayout *digestLayout = new QGridLayout;
+    int row = 0;
+    foreach (BinEditChecksum::Algorithm algorithm, BinEditChecksum::allAlgorithms()) {
+        QCheckBox *box = new QCheckBox(BinEditChecksum::name(algorithm), this);
+        box->setChecked(algorithm != BinEditChecksum::Crc32C);
+        m_algorithmBoxes.insert(algorithm, box);
+
+        QLineEdit *edit = new QLineEdit(this);
+        edit->setReadOnly(true);
+        m_digestEdits.insert(algorithm, edit);
+
+        digestLayout->addWidget(box, row, 0);
+        digestLayout->addWidget(edit, row, 1);
+        ++row;
+    }
+
+    m_selectionBox = new QCheckBox(this);
+
+    m_calculateButton = new QPushButton(this);
+    connect(m_calculateButton, SIGNAL(clicked()), SLOT(startOrCancel()));
+
+    m_progressBar = new QProgressBar(this);
+    m_progressBar->setTextVisible(false);
+    m_progressBar->hide();
+
+    m_statusLabel = new QLabel(this);
+
+    QHBoxLayout *optionsLayout = new QHBoxLayout;
+    optionsLayout->addWidget(m_selectionBox);
+    optionsLayout->addWidget(m_calculateButton);
+    optionsLayout->addWidget(m_progressBar);
+    optionsLayout->addWidget(m_statusLabel, 1);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(optionsLayout);
+    layout->addLayout(digestLayout);
+    layout->addStretch();
+}
+
+void BinEditChecksumPanel::retranslateUi()
+{
+    foreach (BinEditChecksum::Algorithm algorithm, BinEditChecksum::allAlgorithms()) {
+        m_algorithmBoxes.value(algorithm)->setToolTip(BinEditChecksum::isHardwareAccelerated(algorithm)
+                                                      ? tr("Computed with CPU instructions for it")
+                                                      : QString());
+    }
+    m_selectionBox->setText(tr("Selection only"));
+    m_calculateButton->setText(m_editor->checksum()->isRunning() ? tr("Cancel") : tr("Calculate"));
+}
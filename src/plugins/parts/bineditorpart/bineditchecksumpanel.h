@@ -0,0 +1,52 @@
+#ifndef BINEDITCHECKSUMPANEL_H
+#define BINEDITCHECKSUMPANEL_H
+
+#include <QtCore/QMap>
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QWidget>
+#else
+#include <QtGui/QWidget>
+#endif
+
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QProgressBar;
+class QPushButton;
+
+class BinEdit;
+
+class BinEditChecksumPanel : public QWidget
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditChecksumPanel)
+
+public:
+    explicit BinEditChecksumPanel(BinEdit *editor, QWidget *parent = 0);
+
+public slots:
+    void activate();
+
+private slots:
+    void startOrCancel();
+    void onStarted();
+    void onProgressChanged(int value, int maximum);
+    void onFinished(bool ok);
+
+private:
+    void setupUi();
+    void retranslateUi();
+
+private:
+    BinEdit *m_editor;
+
+    QMap<int, QCheckBox *> m_algorithmBoxes;
+    QMap<int, QLineEdit *> m_digestEdits;
+    QCheckBox *m_selectionBox;
+    QPushButton *m_calculateButton;
+    QProgressBar *m_progressBar;
+    QLabel *m_statusLabel;
+};
+
+#endif // BINEDITCHECKSUMPANEL_H
@@ -0,0 +1,560 @@
+#include "bineditcompressedfile.h"
+
+#include "bineditcompressedindex.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QtAlgorithms>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lzma.h>
+#include <zlib.h>
+
+static const int inputSize = 64 * 1024;
+
+static bool lessUncompressedOffset(const BinEditCompressedIndex::Point &point, qint64 offset)
+{
+    return point.uncompressedOffset < offset;
+}
+
+/*
+    Decodes a compressed file from positions where decoding can start,
+    keeping the decoder alive so that consecutive reads continue where the
+    last one stopped.
+*/
+class BinEditDecompressor
+{
+public:
+    BinEditDecompressor() :
+        m_position(0),
+        m_active(false),
+        m_scratch(inputSize, Qt::Uninitialized)
+    {
+    }
+
+    virtual ~BinEditDecompressor() {}
+
+    virtual bool open(const QString &fileName, qint64 *size, QString *errorString) = 0;
+
+    // Reads up to length bytes at position, fewer only at the end of the
+    // data. Returns -1 on errors.
+    qint64 read(qint64 position, char *data, qint64 length)
+    {
+        // Continue if restarting would not get any closer.
+        if (!m_active || position < m_position || restartPoint(position) > m_position) {
+            m_active = restart(position);
+            if (!m_active)
+                return -1;
+        }
+
+        while (m_position < position) {
+            const qint64 count = decode(m_scratch.data(), qMin<qint64>(m_scratch.size(), position - m_position));
+            if (count <= 0)
+                return fail(count);
+            m_position += count;
+        }
+
+        qint64 done = 0;
+        while (done < length) {
+            const qint64 count = decode(data + done, length - done);
+            if (count < 0)
+                return fail(count);
+            if (count == 0)
+                break;
+            done += count;
+            m_position += count;
+        }
+        return done;
+    }
+
+protected:
+    // Where decoding restarts for position.
+    virtual qint64 restartPoint(qint64 position) const = 0;
+    // Restarts decoding at restartPoint(position) and sets m_position to it.
+    virtual bool restart(qint64 position) = 0;
+    // Decodes the next up to length bytes, returns 0 at the end.
+    virtual qint64 decode(char *data, qint64 length) = 0;
+
+    qint64 m_position;
+
+private:
+    qint64 fail(qint64 count)
+    {
+        m_active = false;
+        return count < 0 ? -1 : 0;
+    }
+
+    bool m_active;
+    QByteArray m_scratch;
+};
+
+/*
+    Resumes decompression of gzip files at the points of their
+    BinEditCompressedIndex, the way zran.c of zlib does.
+*/
+class BinEditGzipDecompressor : public BinEditDecompressor
+{
+public:
+    BinEditGzipDecompressor() :
+        m_initialized(false),
+        m_buffer(inputSize, Qt::Uninitialized),
+        m_raw(true),
+        m_trailer(0),
+        m_memberEnded(false),
+        m_end(false)
+    {
+        memset(&m_stream, 0, sizeof(m_stream));
+    }
+
+    ~BinEditGzipDecompressor()
+    {
+        if (m_initialized)
+            inflateEnd(&m_stream);
+    }
+
+    bool open(const QString &fileName, qint64 *size, QString *errorString)
+    {
+        if (!BinEditCompressedIndex::load(fileName, &m_points, size)) {
+            *errorString = BinEditCompressedFile::tr("The file has not been indexed yet.");
+            return false;
+        }
+
+        m_input.setFileName(fileName);
+        m_windows.setFileName(BinEditCompressedIndex::windowsFileName(fileName));
+        if (!m_input.open(QIODevice::ReadOnly)) {
+            *errorString = m_input.errorString();
+            return false;
+        }
+        if (!m_windows.open(QIODevice::ReadOnly)) {
+            *errorString = m_windows.errorString();
+            return false;
+        }
+        return true;
+    }
+
+protected:
+    qint64 restartPoint(qint64 position) const
+    {
+        return m_points.at(pointIndex(position)).uncompressedOffset;
+    }
+
+    bool restart(qint64 position)
+    {
+        const BinEditCompressedIndex::Point &point = m_points.at(pointIndex(position));
+        if (m_initialized)
+            inflateEnd(&m_stream);
+        memset(&m_stream, 0, sizeof(m_stream));
+        m_initialized = inflateInit2(&m_stream, -15) == Z_OK;
+        if (!m_initialized)
+            return false;
+
+        // The block may start within a byte.
+        if (!m_input.seek(point.compressedOffset - (point.bits ? 1 : 0)))
+            return false;
+        if (point.bits) {
+            char byte = 0;
+            if (!m_input.getChar(&byte))
+                return false;
+            inflatePrime(&m_stream, point.bits, uchar(byte) >> (8 - point.bits));
+        }
+
+        if (!m_windows.seek(point.windowOffset))
+            return false;
+        const QByteArray compressed = m_windows.read(point.windowLength);
+        uchar window[BinEditCompressedIndex::WindowSize];
+        uLongf windowLength = sizeof(window);
+        if (compressed.size() != point.windowLength
+                || uncompress(window, &windowLength, reinterpret_cast<const Bytef *>(compressed.constData()),
+                              uLong(compressed.size())) != Z_OK) {
+            return false;
+        }
+        if (windowLength && inflateSetDictionary(&m_stream, window, uInt(windowLength)) != Z_OK)
+            return false;
+
+        m_raw = true;
+        m_trailer = 0;
+        m_memberEnded = false;
+        m_end = false;
+        m_position = point.uncompressedOffset;
+        return true;
+    }
+
+    qint64 decode(char *data, qint64 length)
+    {
+        // avail_out is 32 bits, read() asks again for the rest.
+        const uInt request = uInt(qMin<qint64>(length, 1 << 30));
+        m_stream.next_out = reinterpret_cast<Bytef *>(data);
+        m_stream.avail_out = request;
+        while (m_stream.avail_out > 0 && !m_end) {
+            if (m_stream.avail_in == 0 && !fill())
+                break;
+            if (m_memberEnded) {
+                if (!startMember())
+                    continue;
+            }
+
+            const int ret = inflate(&m_stream, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                // Raw deflate leaves the CRC and size of the member unread.
+                m_trailer = m_raw ? 8 : 0;
+                m_memberEnded = true;
+            } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                return -1;
+            }
+        }
+        return qint64(request - m_stream.avail_out);
+    }
+
+private:
+    int pointIndex(qint64 position) const
+    {
+        const BinEditCompressedIndex::PointList::const_iterator it =
+                qLowerBound(m_points.constBegin(), m_points.constEnd(), position + 1, lessUncompressedOffset);
+        return qMax(0, int(it - m_points.constBegin()) - 1);
+    }
+
+    bool fill()
+    {
+        const qint64 count = m_input.read(m_buffer.data(), m_buffer.size());
+        if (count <= 0) {
+            m_end = true;
+            return false;
+        }
+        m_stream.next_in = reinterpret_cast<Bytef *>(m_buffer.data());
+        m_stream.avail_in = uInt(count);
+        return true;
+    }
+
+    // Skips the trailer of the member that ended and starts decoding the
+    // next one. Returns false if more input is needed first.
+    bool startMember()
+    {
+        const uInt skipped = qMin<uInt>(m_trailer, m_stream.avail_in);
+        m_stream.next_in += skipped;
+        m_stream.avail_in -= skipped;
+        m_trailer -= int(skipped);
+        if (m_trailer > 0 || m_stream.avail_in == 0)
+            return false;
+
+        // Anything but another member is ignored like gzip does.
+        if (*m_stream.next_in != 0x1f) {
+            m_end = true;
+            return false;
+        }
+        inflateReset2(&m_stream, 31);
+        m_raw = false;
+        m_memberEnded = false;
+        return true;
+    }
+
+    QFile m_input;
+    QFile m_windows;
+    BinEditCompressedIndex::PointList m_points;
+    z_stream m_stream;
+    bool m_initialized;
+    QByteArray m_buffer;
+    bool m_raw;
+    int m_trailer;
+    bool m_memberEnded;
+    bool m_end;
+};
+
+/*
+    Decodes xz files block by block, using the index at the end of every
+    stream to find the block that contains a position. Files written by
+    single threaded xz consist of one block and are decoded from the start.
+*/
+class BinEditXzDecompressor : public BinEditDecompressor
+{
+public:
+    BinEditXzDecompressor() :
+        m_index(0),
+        m_buffer(inputSize, Qt::Uninitialized),
+        m_blockEnd(0),
+        m_size(0)
+    {
+        const lzma_stream init = LZMA_STREAM_INIT;
+        m_stream = init;
+    }
+
+    ~BinEditXzDecompressor()
+    {
+        lzma_end(&m_stream);
+        if (m_index)
+            lzma_index_end(m_index, 0);
+    }
+
+    bool open(const QString &fileName, qint64 *size, QString *errorString)
+    {
+        m_input.setFileName(fileName);
+        if (!m_input.open(QIODevice::ReadOnly)) {
+            *errorString = m_input.errorString();
+            return false;
+        }
+        m_index = readIndex();
+        if (!m_index) {
+            *errorString = BinEditCompressedFile::tr("The xz index is corrupt.");
+            return false;
+        }
+        m_size = qint64(lzma_index_uncompressed_size(m_index));
+        *size = m_size;
+        return true;
+    }
+
+protected:
+    qint64 restartPoint(qint64 position) const
+    {
+        lzma_index_iter iter;
+        lzma_index_iter_init(&iter, m_index);
+        if (lzma_index_iter_locate(&iter, lzma_vli(position)))
+            return m_size;
+        return qint64(iter.block.uncompressed_file_offset);
+    }
+
+    bool restart(qint64 position)
+    {
+        lzma_index_iter iter;
+        lzma_index_iter_init(&iter, m_index);
+        if (lzma_index_iter_locate(&iter, lzma_vli(position))) {
+            // Past the end, there is nothing to decode.
+            m_position = m_blockEnd = m_size;
+            return true;
+        }
+
+        uint8_t header[LZMA_BLOCK_HEADER_SIZE_MAX];
+        if (!m_input.seek(qint64(iter.block.compressed_file_offset))
+                || m_input.read(reinterpret_cast<char *>(header), 1) != 1 || header[0] == 0) {
+            return false;
+        }
+
+        lzma_filter filters[LZMA_FILTERS_MAX + 1];
+        lzma_block block;
+        memset(&block, 0, sizeof(block));
+        block.version = 0;
+        block.check = iter.stream.flags->check;
+        block.filters = filters;
+        block.header_size = lzma_block_header_size_decode(header[0]);
+        const qint64 rest = qint64(block.header_size) - 1;
+        if (m_input.read(reinterpret_cast<char *>(header) + 1, rest) != rest
+                || lzma_block_header_decode(&block, 0, header) != LZMA_OK) {
+            return false;
+        }
+
+        bool ok = lzma_block_compressed_size(&block, iter.block.unpadded_size) == LZMA_OK
+                && lzma_block_decoder(&m_stream, &block) == LZMA_OK;
+        // The decoder keeps copies of the filter options.
+        for (int i = 0; filters[i].id != LZMA_VLI_UNKNOWN; ++i)
+            free(filters[i].options);
+        if (!ok)
+            return false;
+
+        m_stream.avail_in = 0;
+        m_position = qint64(iter.block.uncompressed_file_offset);
+        m_blockEnd = m_position + qint64(iter.block.uncompressed_size);
+        return true;
+    }
+
+    qint64 decode(char *data, qint64 length)
+    {
+        if (m_position >= m_blockEnd) {
+            if (m_position >= m_size)
+                return 0;
+            if (!restart(m_position))
+                return -1;
+        }
+
+        m_stream.next_out = reinterpret_cast<uint8_t *>(data);
+        m_stream.avail_out = size_t(length);
+        while (m_stream.avail_out > 0) {
+            if (m_stream.avail_in == 0) {
+                const qint64 count = m_input.read(m_buffer.data(), m_buffer.size());
+                if (count <= 0)
+                    return -1;
+                m_stream.next_in = reinterpret_cast<const uint8_t *>(m_buffer.constData());
+                m_stream.avail_in = size_t(count);
+            }
+
+            const lzma_ret ret = lzma_code(&m_stream, LZMA_RUN);
+            if (ret == LZMA_STREAM_END) {
+                // The next block is located when it is needed.
+                m_blockEnd = m_position + qint64(length - m_stream.avail_out);
+                break;
+            }
+            if (ret != LZMA_OK)
+                return -1;
+        }
+        return qint64(length - m_stream.avail_out);
+    }
+
+private:
+    bool readAt(qint64 position, void *data, qint64 length)
+    {
+        return m_input.seek(position) && m_input.read(static_cast<char *>(data), length) == length;
+    }
+
+    // Reads the indexes of all streams from the end of the file, as
+    // xz --list does.
+    lzma_index *readIndex()
+    {
+        lzma_index *combined = 0;
+        qint64 position = m_input.size();
+        lzma_vli padding = 0;
+        while (position > 0) {
+            uint8_t footer[LZMA_STREAM_HEADER_SIZE];
+            if (position < 2 * LZMA_STREAM_HEADER_SIZE
+                    || !readAt(position - LZMA_STREAM_HEADER_SIZE, footer, LZMA_STREAM_HEADER_SIZE)) {
+                break;
+            }
+
+            // Stream padding is a multiple of four zero bytes.
+            if (!footer[8] && !footer[9] && !footer[10] && !footer[11]) {
+                padding += 4;
+                position -= 4;
+                continue;
+            }
+
+            lzma_stream_flags footerFlags;
+            if (lzma_stream_footer_decode(&footerFlags, footer) != LZMA_OK
+                    || position < 2 * LZMA_STREAM_HEADER_SIZE + qint64(footerFlags.backward_size)) {
+                break;
+            }
+            position -= LZMA_STREAM_HEADER_SIZE + qint64(footerFlags.backward_size);
+
+            QByteArray data(int(footerFlags.backward_size), Qt::Uninitialized);
+            if (!readAt(position, data.data(), data.size()))
+                break;
+            lzma_index *index = 0;
+            uint64_t memoryLimit = UINT64_MAX;
+            size_t inPosition = 0;
+            if (lzma_index_buffer_decode(&index, &memoryLimit, 0,
+                                         reinterpret_cast<const uint8_t *>(data.constData()),
+                                         &inPosition, size_t(data.size())) != LZMA_OK) {
+                break;
+            }
+
+            // Check the stream header against the footer.
+            uint8_t header[LZMA_STREAM_HEADER_SIZE];
+            lzma_stream_flags headerFlags;
+            position -= qint64(lzma_index_total_size(index)) + LZMA_STREAM_HEADER_SIZE;
+            if (position < 0 || !readAt(position, header, LZMA_STREAM_HEADER_SIZE)
+                    || lzma_stream_header_decode(&headerFlags, header) != LZMA_OK
+                    || lzma_stream_flags_compare(&headerFlags, &footerFlags) != LZMA_OK
+                    || lzma_index_stream_flags(index, &footerFlags) != LZMA_OK
+                    || lzma_index_stream_padding(index, padding) != LZMA_OK
+                    || (combined && lzma_index_cat(index, combined, 0) != LZMA_OK)) {
+                lzma_index_end(index, 0);
+                break;
+            }
+            combined = index;
+            padding = 0;
+        }
+
+        if (position != 0 && combined) {
+            lzma_index_end(combined, 0);
+            combined = 0;
+        }
+        return combined;
+    }
+
+    QFile m_input;
+    lzma_index *m_index;
+    lzma_stream m_stream;
+    QByteArray m_buffer;
+    qint64 m_blockEnd;
+    qint64 m_size;
+};
+
+/*!
+    \class BinEditCompressedFile
+
+    Read-only device that presents the decompressed data of a gzip or xz
+    file with random access, so BinEdit can show compressed images and
+    archives without decompressing them to disk.
+
+    gzip files need a BinEditCompressedIndex built before they can be
+    opened, xz files are located through the index at their end. Reads
+    continue the running decoder when they follow the previous one, other
+    positions restart it at the closest point before them.
+*/
+
+BinEditCompressedFile::BinEditCompressedFile(const QString &fileName, QObject *parent) :
+    QIODevice(parent),
+    m_fileName(fileName),
+    m_format(detectFormat(fileName)),
+    m_size(0),
+    m_decompressor(0)
+{
+}
+
+BinEditCompressedFile::~BinEditCompressedFile()
+{
+    close();
+}
+
+/*!
+    Returns the format of \a fileName, judged by its magic bytes.
+*/
+BinEditCompressedFile::Format BinEditCompressedFile::detectFormat(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return Uncompressed;
+
+    const QByteArray magic = file.read(6);
+    if (magic.startsWith("\x1f\x8b"))
+        return Gzip;
+    if (magic == QByteArray("\xfd" "7zXZ\0", 6))
+        return Xz;
+    return Uncompressed;
+}
+
+bool BinEditCompressedFile::open(OpenMode mode)
+{
+    if (mode & WriteOnly) {
+        setErrorString(tr("Compressed files can only be opened for reading."));
+        return false;
+    }
+
+    close();
+    if (m_format == Gzip)
+        m_decompressor = new BinEditGzipDecompressor;
+    else if (m_format == Xz)
+        m_decompressor = new BinEditXzDecompressor;
+    else {
+        setErrorString(tr("The file is not compressed."));
+        return false;
+    }
+
+    QString errorString;
+    if (!m_decompressor->open(m_fileName, &m_size, &errorString)) {
+        setErrorString(errorString);
+        delete m_decompressor;
+        m_decompressor = 0;
+        m_size = 0;
+        return false;
+    }
+    // Reads are served from the decoder, buffering would only decode
+    // past the requested range.
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void BinEditCompressedFile::close()
+{
+    delete m_decompressor;
+    m_decompressor = 0;
+    m_size = 0;
+    QIODevice::close();
+}
+
+qint64 BinEditCompressedFile::readData(char *data, qint64 maxSize)
+{
+    if (!m_decompressor)
+        return -1;
+    return m_decompressor->read(pos(), data, qBound<qint64>(0, m_size - pos(), maxSize));
+}
+
+qint64 BinEditCompressedFile::writeData(const char *, qint64)
+{
+    return -1;
+}
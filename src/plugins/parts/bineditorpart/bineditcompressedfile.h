@@ -0,0 +1,44 @@
+#ifndef BINEDITCOMPRESSEDFILE_H
+#define BINEDITCOMPRESSEDFILE_H
+
+#include <QtCore/QIODevice>
+
+class BinEditDecompressor;
+
+class BinEditCompressedFile : public QIODevice
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditCompressedFile)
+
+public:
+    enum Format {
+        Uncompressed,
+        Gzip,
+        Xz
+    };
+
+    explicit BinEditCompressedFile(const QString &fileName, QObject *parent = 0);
+    ~BinEditCompressedFile();
+
+    static Format detectFormat(const QString &fileName);
+
+    QString fileName() const { return m_fileName; }
+    Format format() const { return m_format; }
+
+    bool open(OpenMode mode);
+    void close();
+    bool isSequential() const { return false; }
+    qint64 size() const { return m_size; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    QString m_fileName;
+    Format m_format;
+    qint64 m_size;
+    BinEditDecompressor *m_decompressor;
+};
+
+#endif // BINEDITCOMPRESSEDFILE_H
@@ -0,0 +1,399 @@
+#include "bineditcompressedindex.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QRunnable>
+
+#if QT_VERSION >= 0x050000
+#include <QtCore/QStandardPaths>
+#else
+#include <QtGui/QDesktopServices>
+#endif
+
+#include <string.h>
+#include <zlib.h>
+
+static const quint32 indexMagic = 0x42455a49; // "BEZI"
+static const quint32 indexVersion = 1;
+static const int inputSize = 64 * 1024;
+static const int progressMaximum = 1000;
+
+class BinEditCompressedIndexJob
+{
+public:
+    QString fileName;
+    int generation;
+    QAtomicInt stopped;
+
+    bool isStopped() const
+    {
+#if QT_VERSION >= 0x050000
+        return stopped.load();
+#else
+        return stopped;
+#endif
+    }
+};
+
+/*
+    Writes the last WindowSize bytes of output before the current position
+    of the ring buffer \a window, compressed, to \a windows.
+*/
+static bool writeWindow(QIODevice *windows, const uchar *window, uInt left, qint64 totalOut,
+                        BinEditCompressedIndex::Point *point)
+{
+    const int windowSize = BinEditCompressedIndex::WindowSize;
+    uchar linear[BinEditCompressedIndex::WindowSize];
+    if (left)
+        memcpy(linear, window + windowSize - left, left);
+    if (left < uInt(windowSize))
+        memcpy(linear + left, window, windowSize - left);
+
+    // Only output of the stream so far is a valid dictionary.
+    const int dictionarySize = int(qMin<qint64>(totalOut, windowSize));
+    uLongf length = compressBound(uLong(dictionarySize));
+    QByteArray compressed(int(length), Qt::Uninitialized);
+    if (compress2(reinterpret_cast<Bytef *>(compressed.data()), &length,
+                  linear + windowSize - dictionarySize, uLong(dictionarySize), 1) != Z_OK) {
+        return false;
+    }
+
+    point->windowOffset = windows->pos();
+    point->windowLength = int(length);
+    return windows->write(compressed.constData(), qint64(length)) == qint64(length);
+}
+
+/*
+    Decompresses the gzip file \a input once and records a Point at the
+    first deflate block boundary after every Span bytes of output, as
+    zran.c of zlib does. Concatenated members are indexed as one stream,
+    data that follows the last member is ignored like gzip does.
+*/
+static bool buildGzipIndex(QIODevice *input, QIODevice *windows, const BinEditCompressedIndexJob &job,
+                           QObject *receiver, BinEditCompressedIndex::PointList *points,
+                           qint64 *uncompressedSize, QString *errorString)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 47) != Z_OK) {
+        *errorString = BinEditCompressedIndex::tr("Not enough memory to decompress.");
+        return false;
+    }
+
+    QByteArray buffer(inputSize, Qt::Uninitialized);
+    uchar window[BinEditCompressedIndex::WindowSize];
+    memset(window, 0, sizeof(window));
+    const qint64 fileSize = qMax<qint64>(1, input->size());
+    qint64 totalIn = 0;
+    qint64 totalOut = 0;
+    qint64 last = 0;
+    int progress = 0;
+    int ret = Z_OK;
+    bool ok = true;
+
+    for (;;) {
+        if (job.isStopped()) {
+            ok = false;
+            break;
+        }
+
+        if (stream.avail_in == 0) {
+            const qint64 count = input->read(buffer.data(), inputSize);
+            if (count < 0) {
+                *errorString = input->errorString();
+                ok = false;
+                break;
+            }
+            if (count == 0) {
+                if (ret != Z_STREAM_END) {
+                    *errorString = BinEditCompressedIndex::tr("The compressed data is truncated.");
+                    ok = false;
+                }
+                break;
+            }
+            stream.next_in = reinterpret_cast<Bytef *>(buffer.data());
+            stream.avail_in = uInt(count);
+        }
+
+        if (ret == Z_STREAM_END) {
+            if (*stream.next_in != 0x1f)
+                break;
+            inflateReset(&stream);
+        }
+
+        if (stream.avail_out == 0) {
+            stream.next_out = window;
+            stream.avail_out = BinEditCompressedIndex::WindowSize;
+        }
+
+        totalIn += stream.avail_in;
+        totalOut += stream.avail_out;
+        ret = inflate(&stream, Z_BLOCK);
+        totalIn -= stream.avail_in;
+        totalOut -= stream.avail_out;
+        if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+            *errorString = stream.msg ? QString::fromLatin1(stream.msg)
+                                      : BinEditCompressedIndex::tr("The compressed data is corrupt.");
+            ok = false;
+            break;
+        }
+
+        // At a block boundary, but not after the last block of a member.
+        if (ret != Z_STREAM_END && (stream.data_type & 128) && !(stream.data_type & 64)
+                && (totalOut == 0 || totalOut - last > BinEditCompressedIndex::Span)) {
+            BinEditCompressedIndex::Point point;
+            point.compressedOffset = totalIn;
+            point.uncompressedOffset = totalOut;
+            point.bits = stream.data_type & 7;
+            if (!writeWindow(windows, window, stream.avail_out, totalOut, &point)) {
+                *errorString = windows->errorString();
+                ok = false;
+                break;
+            }
+            points->append(point);
+            last = totalOut;
+        }
+
+        const int value = int(totalIn * progressMaximum / fileSize);
+        if (value != progress) {
+            progress = value;
+            QMetaObject::invokeMethod(receiver, "handleProgress", Qt::QueuedConnection,
+                                      Q_ARG(int, job.generation), Q_ARG(int, value));
+        }
+    }
+
+    inflateEnd(&stream);
+    *uncompressedSize = totalOut;
+    return ok;
+}
+
+class BinEditCompressedIndexTask : public QRunnable
+{
+public:
+    BinEditCompressedIndexTask(const QSharedPointer<BinEditCompressedIndexJob> &job, QObject *receiver) :
+        m_job(job),
+        m_receiver(receiver)
+    {
+    }
+
+    void run();
+
+private:
+    bool save(const BinEditCompressedIndex::PointList &points, qint64 uncompressedSize) const;
+
+    QSharedPointer<BinEditCompressedIndexJob> m_job;
+    QObject *m_receiver;
+};
+
+void BinEditCompressedIndexTask::run()
+{
+    const BinEditCompressedIndexJob &job = *m_job;
+    const QString indexFileName = BinEditCompressedIndex::indexFileName(job.fileName);
+    const QString windowsFileName = BinEditCompressedIndex::windowsFileName(job.fileName);
+    QDir().mkpath(QFileInfo(indexFileName).absolutePath());
+
+    // The index is written last, it must not describe other windows.
+    QFile::remove(indexFileName);
+
+    QString errorString;
+    QFile input(job.fileName);
+    QFile windows(windowsFileName);
+    BinEditCompressedIndex::PointList points;
+    qint64 uncompressedSize = 0;
+    bool ok = false;
+    if (!input.open(QIODevice::ReadOnly)) {
+        errorString = input.errorString();
+    } else if (!windows.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorString = windows.errorString();
+    } else {
+        ok = buildGzipIndex(&input, &windows, job, m_receiver, &points, &uncompressedSize, &errorString)
+                && windows.flush();
+        windows.close();
+        if (ok && !save(points, uncompressedSize))
+            errorString = BinEditCompressedIndex::tr("Cannot write %1.")
+                    .arg(QDir::toNativeSeparators(indexFileName));
+    }
+    if (!ok || !errorString.isEmpty()) {
+        QFile::remove(indexFileName);
+        QFile::remove(windowsFileName);
+    }
+
+    QMetaObject::invokeMethod(m_receiver, "handleDone", Qt::QueuedConnection,
+                              Q_ARG(int, job.generation), Q_ARG(QString, errorString));
+}
+
+bool BinEditCompressedIndexTask::save(const BinEditCompressedIndex::PointList &points,
+                                      qint64 uncompressedSize) const
+{
+    const QFileInfo info(m_job->fileName);
+    QFile file(BinEditCompressedIndex::indexFileName(m_job->fileName));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QDataStream stream(&file);
+    stream << indexMagic << indexVersion << info.absoluteFilePath() << info.size()
+           << info.lastModified() << uncompressedSize << qint32(points.size());
+    foreach (const BinEditCompressedIndex::Point &point, points) {
+        stream << point.compressedOffset << point.uncompressedOffset << qint32(point.bits)
+               << point.windowOffset << qint32(point.windowLength);
+    }
+    return stream.status() == QDataStream::Ok && file.flush();
+}
+
+/*!
+    \class BinEditCompressedIndex
+
+    Builds the index that gives random access to the decompressed data of a
+    gzip file, on a worker thread.
+
+    Deflate streams can only be decoded from their start, so the file is
+    decompressed once and a Point is recorded about every Span bytes of
+    output, with the 32 KB of output before it that later data may refer
+    to. BinEditCompressedFile resumes decompression at the point before a
+    position and discards at most Span bytes to reach it.
+
+    The points are kept in the cache directory next to the overview cache,
+    the windows in a separate file that is only read when decompression
+    resumes. The index is rebuilt when the size or modification time of
+    the file changed. xz files carry a block index of their own and need
+    none.
+*/
+
+BinEditCompressedIndex::BinEditCompressedIndex(QObject *parent) :
+    QObject(parent),
+    m_generation(0),
+    m_running(false)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+BinEditCompressedIndex::~BinEditCompressedIndex()
+{
+    cancel();
+}
+
+/*!
+    Reads the index of \a fileName into \a points and \a uncompressedSize.
+    Returns false if there is none or it is out of date.
+*/
+bool BinEditCompressedIndex::load(const QString &fileName, PointList *points, qint64 *uncompressedSize)
+{
+    QFile file(indexFileName(fileName));
+    if (!file.open(QIODevice::ReadOnly) || !QFile::exists(windowsFileName(fileName)))
+        return false;
+
+    const QFileInfo info(fileName);
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString indexedFileName;
+    qint64 size = 0;
+    QDateTime lastModified;
+    qint32 count = 0;
+    stream >> magic >> version;
+    if (magic != indexMagic || version != indexVersion)
+        return false;
+    stream >> indexedFileName >> size >> lastModified >> *uncompressedSize >> count;
+    if (stream.status() != QDataStream::Ok || indexedFileName != info.absoluteFilePath()
+            || size != info.size() || lastModified != info.lastModified() || count <= 0) {
+        return false;
+    }
+
+    points->resize(count);
+    for (int i = 0; i < count; ++i) {
+        Point &point = (*points)[i];
+        qint32 bits = 0;
+        qint32 windowLength = 0;
+        stream >> point.compressedOffset >> point.uncompressedOffset >> bits
+               >> point.windowOffset >> windowLength;
+        point.bits = bits;
+        point.windowLength = windowLength;
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+/*!
+    Returns where the points of the index of \a fileName are stored.
+*/
+QString BinEditCompressedIndex::indexFileName(const QString &fileName)
+{
+#if QT_VERSION >= 0x050000
+    const QString location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    const QString location = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+    const QString path = QFileInfo(fileName).absoluteFilePath();
+    const QByteArray key = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1);
+    return location + QLatin1String("/binedit-gzindex/") + QString::fromLatin1(key.toHex());
+}
+
+/*!
+    Returns where the windows of the index of \a fileName are stored.
+*/
+QString BinEditCompressedIndex::windowsFileName(const QString &fileName)
+{
+    return indexFileName(fileName) + QLatin1String(".windows");
+}
+
+/*!
+    Starts indexing the gzip file \a fileName. Indexing that is already
+    running is canceled.
+*/
+void BinEditCompressedIndex::start(const QString &fileName)
+{
+    cancel();
+
+    QSharedPointer<BinEditCompressedIndexJob> job(new BinEditCompressedIndexJob);
+    job->fileName = fileName;
+    job->generation = m_generation;
+    m_job = job;
+
+    m_fileName = fileName;
+    m_errorString.clear();
+    m_running = true;
+    emit started();
+    emit progressChanged(0, progressMaximum);
+
+    m_pool.start(new BinEditCompressedIndexTask(job, this));
+}
+
+/*!
+    Stops indexing and waits for the worker to remove what it has written.
+*/
+void BinEditCompressedIndex::cancel()
+{
+    if (m_job) {
+        m_job->stopped.fetchAndStoreRelaxed(1);
+        m_pool.waitForDone();
+        m_job.clear();
+    }
+
+    ++m_generation;
+    if (m_running) {
+        m_running = false;
+        emit finished(false);
+    }
+}
+
+void BinEditCompressedIndex::handleProgress(int generation, int value)
+{
+    if (generation == m_generation)
+        emit progressChanged(value, progressMaximum);
+}
+
+void BinEditCompressedIndex::handleDone(int generation, const QString &errorString)
+{
+    if (generation != m_generation || !m_job)
+        return;
+
+    const bool stopped = m_job->isStopped();
+    m_job.clear();
+    m_running = false;
+    m_errorString = errorString;
+    emit finished(!stopped && errorString.isEmpty());
+}
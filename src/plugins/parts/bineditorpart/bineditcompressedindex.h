@@ -0,0 +1,64 @@
+#ifndef BINEDITCOMPRESSEDINDEX_H
+#define BINEDITCOMPRESSEDINDEX_H
+
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+class BinEditCompressedIndexJob;
+
+class BinEditCompressedIndex : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditCompressedIndex)
+
+public:
+    // A position in a gzip file where decompression can be resumed.
+    struct Point {
+        qint64 compressedOffset;   // First byte of the deflate block.
+        qint64 uncompressedOffset;
+        int bits;                  // Bits of the previous byte that belong to the block.
+        qint64 windowOffset;       // Compressed window in windowsFileName().
+        int windowLength;
+    };
+    typedef QVector<Point> PointList;
+
+    static const int Span = 4 * 1024 * 1024;
+    static const int WindowSize = 32 * 1024;
+
+    explicit BinEditCompressedIndex(QObject *parent = 0);
+    ~BinEditCompressedIndex();
+
+    static bool load(const QString &fileName, PointList *points, qint64 *uncompressedSize);
+    static QString indexFileName(const QString &fileName);
+    static QString windowsFileName(const QString &fileName);
+
+    bool isRunning() const { return m_running; }
+    QString fileName() const { return m_fileName; }
+    QString errorString() const { return m_errorString; }
+
+    void start(const QString &fileName);
+
+public slots:
+    void cancel();
+
+signals:
+    void started();
+    void progressChanged(int value, int maximum);
+    void finished(bool ok);
+
+private slots:
+    void handleProgress(int generation, int value);
+    void handleDone(int generation, const QString &errorString);
+
+private:
+    QThreadPool m_pool;
+    QSharedPointer<BinEditCompressedIndexJob> m_job;
+    QString m_fileName;
+    QString m_errorString;
+    int m_generation;
+    bool m_running;
+};
+
+#endif // BINEDITCOMPRESSEDINDEX_H
@@ -0,0 +1,638 @@
+#include "bineditdiff.h"
+
+#include "bineditblockprovider.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QRunnable>
+#include <QtCore/QtAlgorithms>
+
+#include <string.h>
+
+static const int FilterBits = 24;
+static const int MaxCandidates = 8;
+static const int CompareSize = 64 * 1024;
+// Differences that are closer than this are reported as one range.
+static const int MinEqualLength = 8;
+
+/*
+    Adler-32 like checksum of a window that can be moved by one byte in
+    constant time, as used by rsync.
+*/
+class BinEditRollingHash
+{
+public:
+    void reset(const uchar *data, int length)
+    {
+        m_a = 0;
+        m_b = 0;
+        for (int i = 0; i < length; ++i) {
+            m_a += data[i];
+            m_b += m_a;
+        }
+    }
+
+    void roll(uchar out, uchar in, int length)
+    {
+        m_a = m_a - out + in;
+        m_b = m_b - quint32(length) * out + m_a;
+    }
+
+    quint32 value() const { return (m_a & 0xffff) | (m_b << 16); }
+
+private:
+    quint32 m_a;
+    quint32 m_b;
+};
+
+static quint64 strongHash(const uchar *data, int length)
+{
+    quint64 hash = 0xcbf29ce484222325ULL ^ quint64(length);
+    int i = 0;
+    for (; i + 8 <= length; i += 8) {
+        quint64 word;
+        ::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 32;
+    }
+    for (; i < length; ++i)
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    return hash ^ (hash >> 32);
+}
+
+static quint32 filterIndex(quint32 weakHash)
+{
+    return (weakHash * 0x9e3779b1u) >> (32 - FilterBits);
+}
+
+struct BinEditDiffRun
+{
+    qint64 leftPosition;
+    qint64 rightPosition;
+    qint64 length;
+};
+
+class BinEditDiffJob
+{
+public:
+    BinEditDiff::Source sources[2];
+    int blockSize;
+    int blockCount;
+    int leftChunkCount;
+    int generation;
+    QAtomicInt stopped;
+
+    // Blocks of the left side, the index holds weak hash and block number
+    // sorted, the filter has a bit set for every weak hash in it.
+    QVector<quint32> weakHashes;
+    QVector<quint64> strongHashes;
+    QVector<quint64> index;
+    QVector<quint32> filter;
+
+    // Matching blocks found in each chunk of the right side.
+    QVector<QVector<BinEditDiffRun> > runs;
+    BinEditDiff::RangeList ranges;
+
+    bool isStopped() const
+    {
+#if QT_VERSION >= 0x050000
+        return stopped.load();
+#else
+        return stopped;
+#endif
+    }
+
+    QByteArray read(BinEditDiff::Side side, qint64 from, int length) const
+    {
+        const BinEditDiff::Source &source = sources[side];
+        return BinEditPieceTable::read(source.pieces, source.addBuffer.data(), source.provider,
+                                       source.baseAddress, from, length);
+    }
+
+    int findBlock(quint32 weakHash, const uchar *data, qint64 expected, qint64 from) const;
+};
+
+/*
+    Returns the left block with the contents of the window at \a data,
+    preferring the one at \a expected and otherwise the nearest one not
+    before \a from, or -1.
+*/
+int BinEditDiffJob::findBlock(quint32 weakHash, const uchar *data, qint64 expected,
+                              qint64 from) const
+{
+    const quint32 bit = filterIndex(weakHash);
+    if (!(filter.at(int(bit >> 5)) & (1u << (bit & 31))))
+        return -1;
+
+    quint64 hash = 0;
+    bool hashed = false;
+    if (expected % blockSize == 0 && expected / blockSize < blockCount) {
+        const int block = int(expected / blockSize);
+        if (weakHashes.at(block) == weakHash) {
+            hash = strongHash(data, blockSize);
+            hashed = true;
+            if (strongHashes.at(block) == hash)
+                return block;
+        }
+    }
+
+    // Taking the nearest candidate keeps repeated blocks, like zero
+    // padding, in file order.
+    const quint64 key = (quint64(weakHash) << 32) | quint64((from + blockSize - 1) / blockSize);
+    QVector<quint64>::const_iterator it = qLowerBound(index.constBegin(), index.constEnd(), key);
+    for (int i = 0; i < MaxCandidates && it != index.constEnd() && quint32(*it >> 32) == weakHash;
+         ++i, ++it) {
+        if (!hashed) {
+            hash = strongHash(data, blockSize);
+            hashed = true;
+        }
+        const int block = int(*it & 0xffffffff);
+        if (strongHashes.at(block) == hash)
+            return block;
+    }
+    return -1;
+}
+
+class BinEditDiffHashTask : public QRunnable
+{
+public:
+    BinEditDiffHashTask(const QSharedPointer<BinEditDiffJob> &job, QObject *receiver, int chunk) :
+        m_job(job),
+        m_receiver(receiver),
+        m_chunk(chunk)
+    {
+    }
+
+    void run();
+
+private:
+    QSharedPointer<BinEditDiffJob> m_job;
+    QObject *m_receiver;
+    int m_chunk;
+};
+
+void BinEditDiffHashTask::run()
+{
+    BinEditDiffJob &job = *m_job;
+    const qint64 start = qint64(m_chunk) * BinEditDiff::ChunkSize;
+    const qint64 end = qMin<qint64>(start + BinEditDiff::ChunkSize,
+                                    qint64(job.blockCount) * job.blockSize);
+
+    if (!job.isStopped() && end > start) {
+        const QByteArray data = job.read(BinEditDiff::Left, start, int(end - start));
+        const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+        quint32 *weakHashes = job.weakHashes.data();
+        quint64 *strongHashes = job.strongHashes.data();
+        int block = int(start / job.blockSize);
+        BinEditRollingHash hash;
+        for (int offset = 0; offset < data.size(); offset += job.blockSize, ++block) {
+            hash.reset(bytes + offset, job.blockSize);
+            weakHashes[block] = hash.value();
+            strongHashes[block] = strongHash(bytes + offset, job.blockSize);
+        }
+    }
+
+    QMetaObject::invokeMethod(m_receiver, "handleChunkDone", Qt::QueuedConnection,
+                              Q_ARG(int, job.generation));
+}
+
+class BinEditDiffScanTask : public QRunnable
+{
+public:
+    BinEditDiffScanTask(const QSharedPointer<BinEditDiffJob> &job, QObject *receiver, int chunk) :
+        m_job(job),
+        m_receiver(receiver),
+        m_chunk(chunk)
+    {
+    }
+
+    void run();
+
+private:
+    void scan(qint64 start, qint64 end);
+
+    QSharedPointer<BinEditDiffJob> m_job;
+    QObject *m_receiver;
+    int m_chunk;
+};
+
+void BinEditDiffScanTask::run()
+{
+    const qint64 start = qint64(m_chunk) * BinEditDiff::ChunkSize;
+    const qint64 end = qMin<qint64>(start + BinEditDiff::ChunkSize,
+                                    m_job->sources[BinEditDiff::Right].size);
+    if (!m_job->isStopped() && m_job->blockCount > 0)
+        scan(start, end);
+
+    QMetaObject::invokeMethod(m_receiver, "handleChunkDone", Qt::QueuedConnection,
+                              Q_ARG(int, m_job->generation));
+}
+
+/*
+    Moves a window of a block over the chunk a byte at a time and jumps
+    over every window that is found in the left side.
+*/
+void BinEditDiffScanTask::scan(qint64 start, qint64 end)
+{
+    BinEditDiffJob &job = *m_job;
+    const int blockSize = job.blockSize;
+    const qint64 readEnd = qMin<qint64>(end + blockSize - 1, job.sources[BinEditDiff::Right].size);
+    if (readEnd - start < blockSize)
+        return;
+
+    const QByteArray data = job.read(BinEditDiff::Right, start, int(readEnd - start));
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+    const int windows = int(end - start);
+    const int lastWindow = data.size() - blockSize;
+
+    // The chunk is assumed to be aligned with the left side until something
+    // matches.
+    QVector<BinEditDiffRun> runs;
+    qint64 leftEnd = start;
+    qint64 rightEnd = start;
+    qint64 from = 0;
+    BinEditRollingHash hash;
+    bool hashed = false;
+    int steps = 0;
+    int pos = 0;
+    while (pos < windows && pos <= lastWindow) {
+        if (++steps % 65536 == 0 && job.isStopped())
+            return;
+        if (!hashed) {
+            hash.reset(bytes + pos, blockSize);
+            hashed = true;
+        }
+
+        const qint64 rightPosition = start + pos;
+        const int block = job.findBlock(hash.value(), bytes + pos,
+                                        leftEnd + rightPosition - rightEnd, from);
+        if (block >= 0) {
+            const qint64 leftPosition = qint64(block) * blockSize;
+            if (!runs.isEmpty() && runs.last().leftPosition + runs.last().length == leftPosition
+                    && runs.last().rightPosition + runs.last().length == rightPosition) {
+                runs.last().length += blockSize;
+            } else {
+                const BinEditDiffRun run = { leftPosition, rightPosition, blockSize };
+                runs.append(run);
+            }
+            leftEnd = from = leftPosition + blockSize;
+            rightEnd = rightPosition + blockSize;
+            pos += blockSize;
+            hashed = false;
+            continue;
+        }
+
+        if (pos == lastWindow)
+            break;
+        hash.roll(bytes[pos], bytes[pos + blockSize], blockSize);
+        ++pos;
+    }
+    job.runs[m_chunk] = runs;
+}
+
+class BinEditDiffTask : public QRunnable
+{
+public:
+    BinEditDiffTask(const QSharedPointer<BinEditDiffJob> &job, QThreadPool *pool,
+                    QObject *receiver) :
+        m_job(job),
+        m_pool(pool),
+        m_receiver(receiver)
+    {
+    }
+
+    void run();
+
+private:
+    void buildIndex();
+    void merge();
+    void addGap(qint64 leftFrom, qint64 leftTo, qint64 rightFrom, qint64 rightTo);
+    void addChanges(qint64 left, qint64 right, qint64 length);
+    void addRange(qint64 left, qint64 leftLength, qint64 right, qint64 rightLength);
+    qint64 equalPrefix(qint64 left, qint64 right, qint64 length) const;
+    qint64 equalSuffix(qint64 leftEnd, qint64 rightEnd, qint64 length) const;
+
+    QSharedPointer<BinEditDiffJob> m_job;
+    QThreadPool *m_pool;
+    QObject *m_receiver;
+};
+
+void BinEditDiffTask::run()
+{
+    BinEditDiffJob &job = *m_job;
+
+    for (int chunk = 0; chunk < job.leftChunkCount; ++chunk)
+        m_pool->start(new BinEditDiffHashTask(m_job, m_receiver, chunk));
+    m_pool->waitForDone();
+
+    if (!job.isStopped()) {
+        buildIndex();
+        for (int chunk = 0; chunk < job.runs.size(); ++chunk)
+            m_pool->start(new BinEditDiffScanTask(m_job, m_receiver, chunk));
+        m_pool->waitForDone();
+    }
+
+    if (!job.isStopped())
+        merge();
+
+    QMetaObject::invokeMethod(m_receiver, "handleDone", Qt::QueuedConnection,
+                              Q_ARG(int, job.generation));
+}
+
+void BinEditDiffTask::buildIndex()
+{
+    BinEditDiffJob &job = *m_job;
+    job.index.resize(job.blockCount);
+    job.filter.fill(0, 1 << (FilterBits - 5));
+    for (int block = 0; block < job.blockCount; ++block) {
+        const quint32 weakHash = job.weakHashes.at(block);
+        job.index[block] = (quint64(weakHash) << 32) | quint64(block);
+        const quint32 bit = filterIndex(weakHash);
+        job.filter[int(bit >> 5)] |= 1u << (bit & 31);
+    }
+    qSort(job.index);
+}
+
+/*
+    Joins the runs of all chunks into one alignment and reports what is
+    between them as differences.
+*/
+void BinEditDiffTask::merge()
+{
+    const BinEditDiffJob &job = *m_job;
+    qint64 left = 0;
+    qint64 right = 0;
+    foreach (const QVector<BinEditDiffRun> &runs, job.runs) {
+        foreach (const BinEditDiffRun &run, runs) {
+            if (job.isStopped())
+                return;
+
+            // Runs that cross the alignment, like moved blocks or overlaps
+            // of neighboring chunks, are cut or become differences.
+            const qint64 cut = qMax(qMax<qint64>(0, left - run.leftPosition),
+                                    right - run.rightPosition);
+            if (cut >= run.length)
+                continue;
+            addGap(left, run.leftPosition + cut, right, run.rightPosition + cut);
+            left = run.leftPosition + run.length;
+            right = run.rightPosition + run.length;
+        }
+    }
+    addGap(left, job.sources[BinEditDiff::Left].size, right, job.sources[BinEditDiff::Right].size);
+}
+
+/*
+    Adds the differences between the unmatched data of both sides. Gaps are
+    only block accurate, equal bytes at their ends are trimmed, and gaps of
+    the same length are compared byte by byte.
+*/
+void BinEditDiffTask::addGap(qint64 leftFrom, qint64 leftTo, qint64 rightFrom, qint64 rightTo)
+{
+    const qint64 prefix = equalPrefix(leftFrom, rightFrom,
+                                      qMin(leftTo - leftFrom, rightTo - rightFrom));
+    leftFrom += prefix;
+    rightFrom += prefix;
+    if (leftTo - leftFrom == rightTo - rightFrom) {
+        addChanges(leftFrom, rightFrom, leftTo - leftFrom);
+        return;
+    }
+
+    const qint64 suffix = equalSuffix(leftTo, rightTo,
+                                      qMin(leftTo - leftFrom, rightTo - rightFrom));
+    addRange(leftFrom, leftTo - suffix - leftFrom, rightFrom, rightTo - suffix - rightFrom);
+}
+
+void BinEditDiffTask::addChanges(qint64 left, qint64 right, qint64 length)
+{
+    const BinEditDiffJob &job = *m_job;
+    qint64 changeStart = -1;
+    qint64 changeEnd = -1;
+    for (qint64 offset = 0; offset < length && !job.isStopped(); offset += CompareSize) {
+        const int count = int(qMin<qint64>(CompareSize, length - offset));
+        const QByteArray leftData = job.read(BinEditDiff::Left, left + offset, count);
+        const QByteArray rightData = job.read(BinEditDiff::Right, right + offset, count);
+        if (leftData == rightData)
+            continue;
+
+        const char *leftBytes = leftData.constData();
+        const char *rightBytes = rightData.constData();
+        for (int i = 0; i < count; ++i) {
+            if (leftBytes[i] == rightBytes[i])
+                continue;
+            const qint64 at = offset + i;
+            if (changeStart >= 0 && at - changeEnd < MinEqualLength) {
+                changeEnd = at + 1;
+                continue;
+            }
+            if (changeStart >= 0)
+                addRange(left + changeStart, changeEnd - changeStart, right + changeStart, changeEnd - changeStart);
+            changeStart = at;
+            changeEnd = at + 1;
+        }
+    }
+    if (changeStart >= 0)
+        addRange(left + changeStart, changeEnd - changeStart, right + changeStart, changeEnd - changeStart);
+}
+
+void BinEditDiffTask::addRange(qint64 left, qint64 leftLength, qint64 right, qint64 rightLength)
+{
+    if (leftLength <= 0 && rightLength <= 0)
+        return;
+
+    BinEditDiff::RangeList &ranges = m_job->ranges;
+    if (ranges.size() >= BinEditDiff::MaxRanges) {
+        // Keep the list bounded, the last range covers everything beyond.
+        BinEditDiff::Range &last = ranges.last();
+        last.leftLength = left + leftLength - last.leftPosition;
+        last.rightLength = right + rightLength - last.rightPosition;
+        return;
+    }
+
+    const BinEditDiff::Range range = { left, leftLength, right, rightLength };
+    ranges.append(range);
+}
+
+qint64 BinEditDiffTask::equalPrefix(qint64 left, qint64 right, qint64 length) const
+{
+    const BinEditDiffJob &job = *m_job;
+    for (qint64 offset = 0; offset < length && !job.isStopped(); offset += CompareSize) {
+        const int count = int(qMin<qint64>(CompareSize, length - offset));
+        const QByteArray leftData = job.read(BinEditDiff::Left, left + offset, count);
+        const QByteArray rightData = job.read(BinEditDiff::Right, right + offset, count);
+        const char *leftBytes = leftData.constData();
+        const char *rightBytes = rightData.constData();
+        for (int i = 0; i < count; ++i) {
+            if (leftBytes[i] != rightBytes[i])
+                return offset + i;
+        }
+    }
+    return length;
+}
+
+qint64 BinEditDiffTask::equalSuffix(qint64 leftEnd, qint64 rightEnd, qint64 length) const
+{
+    const BinEditDiffJob &job = *m_job;
+    for (qint64 offset = 0; offset < length && !job.isStopped(); offset += CompareSize) {
+        const int count = int(qMin<qint64>(CompareSize, length - offset));
+        const QByteArray leftData = job.read(BinEditDiff::Left, leftEnd - offset - count, count);
+        const QByteArray rightData = job.read(BinEditDiff::Right, rightEnd - offset - count, count);
+        const char *leftBytes = leftData.constData();
+        const char *rightBytes = rightData.constData();
+        for (int i = count - 1; i >= 0; --i) {
+            if (leftBytes[i] != rightBytes[i])
+                return offset + count - 1 - i;
+        }
+    }
+    return length;
+}
+
+/*!
+    \class BinEditDiff
+
+    Compares two files on a thread pool and lists the ranges in which they
+    differ.
+
+    Like rsync, the left side is split into blocks that are hashed in
+    parallel, with a weak rolling hash and a strong one. Chunks of the right
+    side are then scanned in parallel with a window of one block that is
+    moved a byte at a time until it matches a block of the left side, so
+    the sides are aligned again after data was inserted or removed. Matched
+    blocks are skipped as a whole, comparing mostly equal files costs about
+    as much as reading both of them once. What is between matches is
+    compared byte by byte at the end.
+
+    Both sides are snapshots of a BinEdit, see BinEdit::diffSource(). cancel()
+    must be called before a provider of them is closed or remapped.
+*/
+
+BinEditDiff::BinEditDiff(QObject *parent) :
+    QObject(parent),
+    m_generation(0),
+    m_chunkCount(0),
+    m_finishedChunks(0),
+    m_running(false)
+{
+    m_coordinator.setMaxThreadCount(1);
+}
+
+BinEditDiff::~BinEditDiff()
+{
+    cancel();
+}
+
+/*!
+    Starts comparing \a left with \a right. A comparison that is already
+    running is canceled.
+*/
+void BinEditDiff::start(const Source &left, const Source &right)
+{
+    cancel();
+
+    QSharedPointer<BinEditDiffJob> job(new BinEditDiffJob);
+    job->sources[Left] = left;
+    job->sources[Right] = right;
+
+    // Huge files use larger blocks to keep the index in bounds.
+    int blockSize = MinBlockSize;
+    while (blockSize < ChunkSize && left.size / blockSize > MaxBlockCount)
+        blockSize *= 2;
+    job->blockSize = blockSize;
+    job->blockCount = int(left.size / blockSize);
+    job->leftChunkCount = int((qint64(job->blockCount) * blockSize + ChunkSize - 1) / ChunkSize);
+    job->weakHashes.resize(job->blockCount);
+    job->strongHashes.resize(job->blockCount);
+    job->runs.resize(int((right.size + ChunkSize - 1) / ChunkSize));
+    job->generation = m_generation;
+    m_job = job;
+
+    m_ranges.clear();
+    m_chunkCount = job->leftChunkCount + job->runs.size();
+    m_finishedChunks = 0;
+    m_running = true;
+    emit started();
+    emit progressChanged(0, m_chunkCount);
+
+    m_coordinator.start(new BinEditDiffTask(job, &m_pool, this));
+}
+
+/*!
+    Stops the running comparison and waits for its tasks to finish.
+*/
+void BinEditDiff::cancel()
+{
+    if (m_job) {
+        m_job->stopped.fetchAndStoreRelaxed(1);
+        m_coordinator.waitForDone();
+        m_job.clear();
+    }
+
+    ++m_generation;
+    if (m_running) {
+        m_running = false;
+        emit finished();
+    }
+}
+
+/*!
+    Returns the index of the first of \a ranges that ends after \a position
+    on \a side, or the number of ranges.
+*/
+int BinEditDiff::findRange(const RangeList &ranges, Side side, qint64 position)
+{
+    int low = 0;
+    int high = ranges.size();
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        const Range &range = ranges.at(middle);
+        if (range.position(side) + range.length(side) <= position)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/*!
+    Maps \a position on \a side to the corresponding position on the other
+    side, as aligned by \a ranges. Positions within a range map into the
+    range of the other side.
+*/
+qint64 BinEditDiff::mapPosition(const RangeList &ranges, Side side, qint64 position)
+{
+    int low = 0;
+    int high = ranges.size();
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (ranges.at(middle).position(side) <= position)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == 0)
+        return position;
+
+    const Range &range = ranges.at(low - 1);
+    const Side other = side == Left ? Right : Left;
+    const qint64 offset = position - range.position(side);
+    if (offset < range.length(side))
+        return range.position(other) + qMin(offset, qMax<qint64>(0, range.length(other) - 1));
+    return range.position(other) + range.length(other) + offset - range.length(side);
+}
+
+void BinEditDiff::handleChunkDone(int generation)
+{
+    if (generation == m_generation)
+        emit progressChanged(++m_finishedChunks, m_chunkCount);
+}
+
+void BinEditDiff::handleDone(int generation)
+{
+    if (generation != m_generation || !m_job)
+        return;
+
+    m_ranges = m_job->ranges;
+    m_job.clear();
+    m_running = false;
+    emit finished();
+}
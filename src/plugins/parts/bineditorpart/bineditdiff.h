@@ -0,0 +1,83 @@
+#ifndef BINEDITDIFF_H
+#define BINEDITDIFF_H
+
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+#include "bineditpiecetable.h"
+
+class BinEditBlockProvider;
+class BinEditDiffJob;
+
+class BinEditDiff : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditDiff)
+
+public:
+    enum Side {
+        Left,
+        Right
+    };
+
+    struct Source {
+        const BinEditBlockProvider *provider;
+        quint64 baseAddress;
+        BinEditPieceTable::PieceList pieces;
+        QSharedPointer<BinEditAddBuffer> addBuffer;
+        qint64 size;
+    };
+
+    struct Range {
+        qint64 leftPosition;
+        qint64 leftLength;
+        qint64 rightPosition;
+        qint64 rightLength;
+
+        qint64 position(Side side) const { return side == Left ? leftPosition : rightPosition; }
+        qint64 length(Side side) const { return side == Left ? leftLength : rightLength; }
+    };
+    typedef QVector<Range> RangeList;
+
+    static const int ChunkSize = 4 * 1024 * 1024;
+    static const int MinBlockSize = 4096;
+    static const int MaxBlockCount = 1024 * 1024;
+    static const int MaxRanges = 100000;
+
+    explicit BinEditDiff(QObject *parent = 0);
+    ~BinEditDiff();
+
+    bool isRunning() const { return m_running; }
+    RangeList ranges() const { return m_ranges; }
+
+    void start(const Source &left, const Source &right);
+
+    static int findRange(const RangeList &ranges, Side side, qint64 position);
+    static qint64 mapPosition(const RangeList &ranges, Side side, qint64 position);
+
+public slots:
+    void cancel();
+
+signals:
+    void started();
+    void progressChanged(int value, int maximum);
+    void finished();
+
+private slots:
+    void handleChunkDone(int generation);
+    void handleDone(int generation);
+
+private:
+    QThreadPool m_pool;
+    QThreadPool m_coordinator;
+    QSharedPointer<BinEditDiffJob> m_job;
+    int m_generation;
+    int m_chunkCount;
+    int m_finishedChunks;
+    bool m_running;
+    RangeList m_ranges;
+};
+
+#endif // BINEDITDIFF_H
@@ -0,0 +1,89 @@
+#include "bineditdiffmodel.h"
+
+#include "binedit.h"
+
+/*!
+    \class BinEditDiffModel
+
+    Lists the differing ranges of a BinEditDiff with their offsets in both
+    compared editors.
+*/
+
+BinEditDiffModel::BinEditDiffModel(BinEdit *left, BinEdit *right, QObject *parent) :
+    QAbstractTableModel(parent),
+    m_left(left),
+    m_right(right)
+{
+}
+
+int BinEditDiffModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_ranges.size();
+}
+
+int BinEditDiffModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant BinEditDiffModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_ranges.size())
+        return QVariant();
+
+    if (role == Qt::TextAlignmentRole)
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole)
+        return QVariant();
+
+    const BinEditDiff::Range &range = m_ranges.at(index.row());
+    switch (index.column()) {
+    case LeftOffsetColumn:
+        return m_left->addressString(m_left->baseAddress() + range.leftPosition);
+    case LeftLengthColumn:
+        return range.leftLength;
+    case RightOffsetColumn:
+        return m_right->addressString(m_right->baseAddress() + range.rightPosition);
+    case RightLengthColumn:
+        return range.rightLength;
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+QVariant BinEditDiffModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+    case LeftOffsetColumn: return tr("Offset");
+    case LeftLengthColumn: return tr("Length");
+    case RightOffsetColumn: return tr("Other Offset");
+    case RightLengthColumn: return tr("Other Length");
+    default: break;
+    }
+    return QVariant();
+}
+
+void BinEditDiffModel::setRanges(const BinEditDiff::RangeList &ranges)
+{
+#if QT_VERSION >= 0x050000
+    beginResetModel();
+    m_ranges = ranges;
+    endResetModel();
+#else
+    m_ranges = ranges;
+    reset();
+#endif
+}
+
+BinEditDiff::Range BinEditDiffModel::range(const QModelIndex &index) const
+{
+    if (index.isValid() && index.row() < m_ranges.size())
+        return m_ranges.at(index.row());
+
+    const BinEditDiff::Range range = { -1, 0, -1, 0 };
+    return range;
+}
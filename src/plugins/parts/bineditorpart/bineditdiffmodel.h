@@ -0,0 +1,43 @@
+#ifndef BINEDITDIFFMODEL_H
+#define BINEDITDIFFMODEL_H
+
+#include <QtCore/QAbstractTableModel>
+
+#include "bineditdiff.h"
+
+class BinEdit;
+
+class BinEditDiffModel : public QAbstractTableModel
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditDiffModel)
+
+public:
+    enum Column {
+        LeftOffsetColumn,
+        LeftLengthColumn,
+        RightOffsetColumn,
+        RightLengthColumn,
+
+        ColumnCount
+    };
+
+    BinEditDiffModel(BinEdit *left, BinEdit *right, QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    BinEditDiff::RangeList ranges() const { return m_ranges; }
+    void setRanges(const BinEditDiff::RangeList &ranges);
+
+    BinEditDiff::Range range(const QModelIndex &index) const;
+
+private:
+    BinEdit *m_left;
+    BinEdit *m_right;
+    BinEditDiff::RangeList m_ranges;
+};
+
+#endif // BINEDITDIFFMODEL_H
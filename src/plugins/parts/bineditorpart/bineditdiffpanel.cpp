@@ -0,0 +1,218 @@
+#include "bineditdiffpanel.h"
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QHBoxLayout>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QProgressBar>
+#include <QtWidgets/QPushButton>
+#include <QtWidgets/QTreeView>
+#include <QtWidgets/QVBoxLayout>
+#else
+#include <QtGui/QHBoxLayout>
+#include <QtGui/QHeaderView>
+#include <QtGui/QLabel>
+#include <QtGui/QProgressBar>
+#include <QtGui/QPushButton>
+#include <QtGui/QTreeView>
+#include <QtGui/QVBoxLayout>
+#endif
+
+#include "binedit.h"
+#include "bineditdiff.h"
+#include "bineditdiffmodel.h"
+
+/*!
+    \class BinEditDiffPanel
+
+    Panel below two BinEdits shown side by side that compares them in the
+    background and lists the differing ranges, which are highlighted in
+    both editors. Activating a range selects it on both sides.
+
+    The editors scroll together, positions are mapped through the
+    differences, so data that was inserted on one side doesn't shift the
+    other one out of alignment.
+*/
+
+BinEditDiffPanel::BinEditDiffPanel(BinEdit *left, BinEdit *right, QWidget *parent) :
+    QWidget(parent),
+    m_left(left),
+    m_right(right),
+    m_diff(new BinEditDiff(this)),
+    m_model(new BinEditDiffModel(left, right, this)),
+    m_syncing(false)
+{
+    setupUi();
+    retranslateUi();
+
+    connect(m_diff, SIGNAL(started()), SLOT(onStarted()));
+    connect(m_diff, SIGNAL(progressChanged(int,int)), SLOT(onProgressChanged(int,int)));
+    connect(m_diff, SIGNAL(finished()), SLOT(onFinished()));
+
+    // The comparison reads from both editors, stop it before either of
+    // them closes or remaps its file.
+    connect(m_left, SIGNAL(sourceAboutToChange()), SLOT(onSourceAboutToChange()));
+    connect(m_right, SIGNAL(sourceAboutToChange()), SLOT(onSourceAboutToChange()));
+    connect(m_left, SIGNAL(topPositionChanged(qint64)), SLOT(syncRight(qint64)));
+    connect(m_right, SIGNAL(topPositionChanged(qint64)), SLOT(syncLeft(qint64)));
+}
+
+/*!
+    Compares the data of both editors, including unsaved changes.
+*/
+void BinEditDiffPanel::compare()
+{
+    clear();
+    if (m_left && m_right)
+        m_diff->start(m_left->diffSource(), m_right->diffSource());
+}
+
+/*!
+    Stops the comparison and removes all differences.
+*/
+void BinEditDiffPanel::clear()
+{
+    m_diff->cancel();
+    m_model->setRanges(BinEditDiff::RangeList());
+    if (m_left)
+        m_left->setDiffRanges(BinEditDiff::RangeList(), BinEditDiff::Left);
+    if (m_right)
+        m_right->setDiffRanges(BinEditDiff::RangeList(), BinEditDiff::Right);
+    updateStatus();
+}
+
+void BinEditDiffPanel::compareOrCancel()
+{
+    if (m_diff->isRunning())
+        m_diff->cancel();
+    else
+        compare();
+}
+
+void BinEditDiffPanel::onStarted()
+{
+    m_compareButton->setText(tr("Cancel"));
+    m_progressBar->setValue(0);
+    m_progressBar->show();
+    updateStatus();
+}
+
+void BinEditDiffPanel::onProgressChanged(int value, int maximum)
+{
+    m_progressBar->setMaximum(maximum);
+    m_progressBar->setValue(value);
+}
+
+void BinEditDiffPanel::onFinished()
+{
+    const BinEditDiff::RangeList ranges = m_diff->ranges();
+    m_model->setRanges(ranges);
+    if (m_left)
+        m_left->setDiffRanges(ranges, BinEditDiff::Left);
+    if (m_right)
+        m_right->setDiffRanges(ranges, BinEditDiff::Right);
+
+    m_compareButton->setText(tr("Compare"));
+    m_progressBar->hide();
+    updateStatus();
+}
+
+void BinEditDiffPanel::onActivated(const QModelIndex &index)
+{
+    const BinEditDiff::Range range = m_model->range(index);
+    if (range.leftPosition < 0 || !m_left || !m_right)
+        return;
+
+    // Both editors scroll to their range on their own.
+    m_syncing = true;
+    m_right->setCursorPosition(range.rightPosition);
+    m_right->setCursorPosition(range.rightPosition + range.rightLength, BinEdit::KeepAnchor);
+    m_left->setCursorPosition(range.leftPosition);
+    m_left->setCursorPosition(range.leftPosition + range.leftLength, BinEdit::KeepAnchor);
+    m_syncing = false;
+    m_left->setFocus();
+}
+
+void BinEditDiffPanel::onSourceAboutToChange()
+{
+    clear();
+}
+
+void BinEditDiffPanel::syncLeft(qint64 position)
+{
+    if (m_syncing || !m_left)
+        return;
+
+    m_syncing = true;
+    m_left->setTopPosition(BinEditDiff::mapPosition(m_model->ranges(), BinEditDiff::Right, position));
+    m_syncing = false;
+}
+
+void BinEditDiffPanel::syncRight(qint64 position)
+{
+    if (m_syncing || !m_right)
+        return;
+
+    m_syncing = true;
+    m_right->setTopPosition(BinEditDiff::mapPosition(m_model->ranges(), BinEditDiff::Left, position));
+    m_syncing = false;
+}
+
+void BinEditDiffPanel::setupUi()
+{
+    m_compareButton = new QPushButton(this);
+    connect(m_compareButton, SIGNAL(clicked()), SLOT(compareOrCancel()));
+
+    m_closeButton = new QPushButton(this);
+    connect(m_closeButton, SIGNAL(clicked()), SIGNAL(closeRequested()));
+
+    m_progressBar = new QProgressBar(this);
+    m_progressBar->setTextVisible(false);
+    m_progressBar->hide();
+
+    m_statusLabel = new QLabel(this);
+
+    m_view = new QTreeView(this);
+    m_view->setModel(m_model);
+    m_view->setRootIsDecorated(false);
+    m_view->setUniformRowHeights(true);
+    m_view->setAllColumnsShowFocus(true);
+#if QT_VERSION >= 0x050000
+    m_view->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+#else
+    m_view->header()->setResizeMode(QHeaderView::ResizeToContents);
+#endif
+    connect(m_view, SIGNAL(activated(QModelIndex)), SLOT(onActivated(QModelIndex)));
+    connect(m_view, SIGNAL(clicked(QModelIndex)), SLOT(onActivated(QModelIndex)));
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout;
+    buttonLayout->addWidget(m_statusLabel, 1);
+    buttonLayout->addWidget(m_progressBar);
+    buttonLayout->addWidget(m_compareButton);
+    buttonLayout->addWidget(m_closeButton);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(buttonLayout);
+    layout->addWidget(m_view);
+}
+
+void BinEditDiffPanel::retranslateUi()
+{
+    m_compareButton->setText(m_diff->isRunning() ? tr("Cancel") : tr("Compare"));
+    m_closeButton->setText(tr("Close"));
+}
+
+void BinEditDiffPanel::updateStatus()
+{
+    if (m_diff->isRunning()) {
+        m_statusLabel->setText(tr("Comparing..."));
+        return;
+    }
+
+    const int count = m_model->rowCount();
+    QString status = tr("%n difference(s)", 0, count);
+    if (count >= BinEditDiff::MaxRanges)
+        status = tr("%1 (the last one covers the rest)").arg(status);
+    m_statusLabel->setText(status);
+}
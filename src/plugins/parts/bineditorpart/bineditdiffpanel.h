@@ -0,0 +1,67 @@
+#ifndef BINEDITDIFFPANEL_H
+#define BINEDITDIFFPANEL_H
+
+#include <QtCore/QModelIndex>
+#include <QtCore/QPointer>
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QWidget>
+#else
+#include <QtGui/QWidget>
+#endif
+
+class QLabel;
+class QProgressBar;
+class QPushButton;
+class QTreeView;
+
+class BinEdit;
+class BinEditDiff;
+class BinEditDiffModel;
+
+class BinEditDiffPanel : public QWidget
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditDiffPanel)
+
+public:
+    BinEditDiffPanel(BinEdit *left, BinEdit *right, QWidget *parent = 0);
+
+public slots:
+    void compare();
+    void clear();
+
+signals:
+    void closeRequested();
+
+private slots:
+    void compareOrCancel();
+    void onStarted();
+    void onProgressChanged(int value, int maximum);
+    void onFinished();
+    void onActivated(const QModelIndex &index);
+    void onSourceAboutToChange();
+    void syncLeft(qint64 position);
+    void syncRight(qint64 position);
+
+private:
+    void setupUi();
+    void retranslateUi();
+    void updateStatus();
+
+private:
+    // Either editor may be destroyed first.
+    QPointer<BinEdit> m_left;
+    QPointer<BinEdit> m_right;
+    BinEditDiff *m_diff;
+    BinEditDiffModel *m_model;
+    bool m_syncing;
+
+    QPushButton *m_compareButton;
+    QPushButton *m_closeButton;
+    QProgressBar *m_progressBar;
+    QLabel *m_statusLabel;
+    QTreeView *m_view;
+};
+
+#endif // BINEDITDIFFPANEL_H
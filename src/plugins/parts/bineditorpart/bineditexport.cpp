@@ -0,0 +1,281 @@
+#include "bineditexport.h"
+
+#include "bineditblockprovider.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QFile>
+#include <QtCore/QRunnable>
+
+static const char hexDigits[] = "0123456789abcdef";
+
+class BinEditExportJob
+{
+public:
+    BinEditBlockProvider *provider;
+    QString fileName;
+    BinEditExport::Format format;
+    quint64 baseAddress;
+    BinEditPieceTable::PieceList pieces;
+    QSharedPointer<BinEditAddBuffer> addBuffer;
+    qint64 from;
+    qint64 length;
+    int generation;
+    QAtomicInt stopped;
+
+    bool isStopped() const
+    {
+#if QT_VERSION >= 0x050000
+        return stopped.load();
+#else
+        return stopped;
+#endif
+    }
+};
+
+class BinEditExportTask : public QRunnable
+{
+public:
+    BinEditExportTask(const QSharedPointer<BinEditExportJob> &job, QObject *receiver) :
+        m_job(job),
+        m_receiver(receiver)
+    {
+    }
+
+    void run();
+
+private:
+    bool write(QFile *file, const QByteArray &data) const;
+
+    QSharedPointer<BinEditExportJob> m_job;
+    QObject *m_receiver;
+};
+
+void BinEditExportTask::run()
+{
+    const BinEditExportJob &job = *m_job;
+    QFile file(job.fileName);
+    QString errorString;
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        bool ok = write(&file, BinEditExport::header(job.format));
+        int chunks = 0;
+        for (qint64 offset = 0; ok && offset < job.length && !job.isStopped();
+             offset += BinEditExport::ChunkSize) {
+            const qint64 position = job.from + offset;
+            const int length = int(qMin<qint64>(BinEditExport::ChunkSize, job.length - offset));
+            const QByteArray data = BinEditPieceTable::read(job.pieces, job.addBuffer.data(),
+                                                            job.provider, job.baseAddress,
+                                                            position, length);
+            ok = write(&file, BinEditExport::encode(job.format, data, job.baseAddress + position));
+            QMetaObject::invokeMethod(m_receiver, "handleChunkWritten", Qt::QueuedConnection,
+                                      Q_ARG(int, job.generation), Q_ARG(int, ++chunks));
+        }
+        ok = ok && write(&file, BinEditExport::footer(job.format, job.length)) && file.flush();
+        if (!ok)
+            errorString = file.errorString();
+        file.close();
+
+        // Don't leave a truncated file behind.
+        if (!ok || job.isStopped())
+            file.remove();
+    } else {
+        errorString = file.errorString();
+    }
+
+    QMetaObject::invokeMethod(m_receiver, "handleDone", Qt::QueuedConnection,
+                              Q_ARG(int, job.generation), Q_ARG(QString, errorString));
+}
+
+bool BinEditExportTask::write(QFile *file, const QByteArray &data) const
+{
+    return file->write(data) == data.size();
+}
+
+static QByteArray hexDump(const QByteArray &data, quint64 address)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+    QByteArray result;
+    result.reserve((data.size() / 16 + 1) * 80);
+    for (int line = 0; line < data.size(); line += 16) {
+        const int count = qMin(16, data.size() - line);
+        const quint64 lineAddress = address + quint64(line);
+        result += QByteArray::number(lineAddress, 16).rightJustified(lineAddress >> 32 ? 16 : 8, '0');
+        result += ' ';
+        for (int i = 0; i < 16; ++i) {
+            if (i % 8 == 0)
+                result += ' ';
+            if (i < count) {
+                const uchar value = bytes[line + i];
+                result += hexDigits[value >> 4];
+                result += hexDigits[value & 0xf];
+                result += ' ';
+            } else {
+                result += "   ";
+            }
+        }
+        result += " |";
+        for (int i = 0; i < count; ++i) {
+            const uchar value = bytes[line + i];
+            result += (value >= 0x20 && value < 0x7f) ? char(value) : '.';
+        }
+        result += "|\n";
+    }
+    return result;
+}
+
+static QByteArray cArray(const QByteArray &data)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+    QByteArray result;
+    result.reserve((data.size() / 12 + 1) * 76);
+    for (int i = 0; i < data.size(); ++i) {
+        if (i % 12 == 0)
+            result += "   ";
+        result += " 0x";
+        result += hexDigits[bytes[i] >> 4];
+        result += hexDigits[bytes[i] & 0xf];
+        result += (i % 12 == 11 || i == data.size() - 1) ? ",\n" : ",";
+    }
+    return result;
+}
+
+/*!
+    \class BinEditExport
+
+    Writes a range of the data to a file on a worker thread.
+
+    Like BinEditSearch, it works on a snapshot of the piece table and reads
+    original data straight from the BinEditBlockProvider, so selections of
+    any size are streamed chunk by chunk without blocking the event loop.
+    The data is written as raw bytes or encoded as a hex dump, a C array or
+    Base64. A file that couldn't be completed is removed.
+
+    cancel() must be called before the provider is closed or remapped.
+*/
+
+BinEditExport::BinEditExport(BinEditBlockProvider *provider, QObject *parent) :
+    QObject(parent),
+    m_provider(provider),
+    m_generation(0),
+    m_chunkCount(0),
+    m_running(false)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+BinEditExport::~BinEditExport()
+{
+    cancel();
+}
+
+/*!
+    Starts writing \a length bytes at \a from of the data described by
+    \a pieces and \a addBuffer, with original data at \a baseAddress, to
+    \a fileName. An export that is already running is canceled.
+*/
+void BinEditExport::start(const QString &fileName, Format format, quint64 baseAddress,
+                          const BinEditPieceTable::PieceList &pieces,
+                          const QSharedPointer<BinEditAddBuffer> &addBuffer,
+                          qint64 from, qint64 length)
+{
+    cancel();
+
+    QSharedPointer<BinEditExportJob> job(new BinEditExportJob);
+    job->provider = m_provider;
+    job->fileName = fileName;
+    job->format = format;
+    job->baseAddress = baseAddress;
+    job->pieces = pieces;
+    job->addBuffer = addBuffer;
+    job->from = from;
+    job->length = qMax<qint64>(0, length);
+    job->generation = m_generation;
+    m_job = job;
+
+    m_chunkCount = int((job->length + ChunkSize - 1) / ChunkSize);
+    m_running = true;
+    m_errorString.clear();
+    emit started();
+    emit progressChanged(0, m_chunkCount);
+
+    m_pool.start(new BinEditExportTask(job, this));
+}
+
+/*!
+    Stops the running export and waits for the worker to remove the
+    incomplete file.
+*/
+void BinEditExport::cancel()
+{
+    if (m_job) {
+        m_job->stopped.fetchAndStoreRelaxed(1);
+        m_pool.waitForDone();
+        m_job.clear();
+    }
+
+    ++m_generation;
+    if (m_running) {
+        m_running = false;
+        emit finished(false);
+    }
+}
+
+/*!
+    Returns what precedes the encoded data in a file of \a format.
+*/
+QByteArray BinEditExport::header(Format format)
+{
+    if (format == CArray)
+        return "unsigned char data[] = {\n";
+    return QByteArray();
+}
+
+/*!
+    Encodes \a data that is at \a address. Data is encoded in whole lines,
+    so consecutive chunks can be encoded separately as long as they are a
+    multiple of ChunkSize long.
+*/
+QByteArray BinEditExport::encode(Format format, const QByteArray &data, quint64 address)
+{
+    switch (format) {
+    case Raw:
+        return data;
+    case HexDump:
+        return hexDump(data, address);
+    case CArray:
+        return cArray(data);
+    case Base64: {
+        QByteArray result;
+        for (int i = 0; i < data.size(); i += 57)
+            result += data.mid(i, 57).toBase64() + '\n';
+        return result;
+    }
+    }
+    return QByteArray();
+}
+
+/*!
+    Returns what follows the encoded \a length bytes in a file of \a format.
+*/
+QByteArray BinEditExport::footer(Format format, qint64 length)
+{
+    if (format == CArray)
+        return "};\nunsigned int data_len = " + QByteArray::number(length) + ";\n";
+    return QByteArray();
+}
+
+void BinEditExport::handleChunkWritten(int generation, int chunks)
+{
+    if (generation == m_generation)
+        emit progressChanged(chunks, m_chunkCount);
+}
+
+void BinEditExport::handleDone(int generation, const QString &errorString)
+{
+    if (generation != m_generation || !m_job)
+        return;
+
+    m_job.clear();
+    m_running = false;
+    m_errorString = errorString;
+    emit finished(errorString.isEmpty());
+}
@@ -0,0 +1,67 @@
+#ifndef BINEDITEXPORT_H
+#define BINEDITEXPORT_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThreadPool>
+
+#include "bineditpiecetable.h"
+
+class BinEditBlockProvider;
+class BinEditExportJob;
+
+class BinEditExport : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditExport)
+
+public:
+    enum Format {
+        Raw,
+        HexDump,
+        CArray,
+        Base64
+    };
+
+    // A multiple of the bytes per line of every format.
+    static const int ChunkSize = 912 * 1024;
+
+    explicit BinEditExport(BinEditBlockProvider *provider, QObject *parent = 0);
+    ~BinEditExport();
+
+    bool isRunning() const { return m_running; }
+    QString errorString() const { return m_errorString; }
+
+    void start(const QString &fileName, Format format, quint64 baseAddress,
+               const BinEditPieceTable::PieceList &pieces,
+               const QSharedPointer<BinEditAddBuffer> &addBuffer,
+               qint64 from, qint64 length);
+
+    static QByteArray header(Format format);
+    static QByteArray encode(Format format, const QByteArray &data, quint64 address);
+    static QByteArray footer(Format format, qint64 length);
+
+public slots:
+    void cancel();
+
+signals:
+    void started();
+    void progressChanged(int value, int maximum);
+    void finished(bool ok);
+
+private slots:
+    void handleChunkWritten(int generation, int chunks);
+    void handleDone(int generation, const QString &errorString);
+
+private:
+    BinEditBlockProvider *m_provider;
+    QThreadPool m_pool;
+    QSharedPointer<BinEditExportJob> m_job;
+    int m_generation;
+    int m_chunkCount;
+    bool m_running;
+    QString m_errorString;
+};
+
+#endif // BINEDITEXPORT_H
@@ -0,0 +1,132 @@
+#include "bineditglyphatlas.h"
+
+#include <QtGui/QFontMetrics>
+#include <QtGui/QPainter>
+
+static const int GridSize = 16;
+
+/*!
+    \class BinEditGlyphAtlas
+
+    Pre-rendered glyphs for BinEdit.
+
+    The 256 hex pairs and the 256 printable characters BinEdit can show are
+    drawn once per text color into a single pixmap; painting a byte is then
+    a pixmap blit instead of laying out text. Atlases are created lazily for
+    each color and dropped when the font or the palette changes.
+*/
+
+BinEditGlyphAtlas::BinEditGlyphAtlas() :
+    m_columnWidth(0),
+    m_hexWidth(0),
+    m_lineHeight(0),
+    m_ascent(0),
+    m_maxCharWidth(0),
+    m_devicePixelRatio(1.0)
+{
+    for (int i = 0; i < 256; ++i)
+        m_charWidths[i] = 0;
+}
+
+/*!
+    Sets the \a font glyphs are rendered with and the width of a hex column.
+    Returns true if anything changed, in which case all atlases are dropped.
+*/
+bool BinEditGlyphAtlas::setFont(const QFont &font, int columnWidth, qreal devicePixelRatio)
+{
+    if (m_font == font && m_columnWidth == columnWidth && m_devicePixelRatio == devicePixelRatio
+            && m_lineHeight)
+        return false;
+
+    m_font = font;
+    m_columnWidth = columnWidth;
+    m_devicePixelRatio = devicePixelRatio;
+
+    const QFontMetrics fm(font);
+    m_hexWidth = fm.width(QLatin1String("00"));
+    m_lineHeight = fm.lineSpacing();
+    m_ascent = fm.ascent();
+    m_maxCharWidth = 0;
+    for (int i = 0; i < 256; ++i) {
+        m_charWidths[i] = fm.width(printableChar(uchar(i)));
+        m_maxCharWidth = qMax(m_maxCharWidth, m_charWidths[i]);
+    }
+
+    clear();
+    return true;
+}
+
+void BinEditGlyphAtlas::clear()
+{
+    m_atlases.clear();
+}
+
+/*!
+    Returns the character shown for \a value in the text column.
+*/
+QChar BinEditGlyphAtlas::printableChar(uchar value)
+{
+    QChar qc(QLatin1Char(char(value)));
+    if (qc.unicode() >= 127 || !qc.isPrint())
+        qc = 0xB7;
+    return qc;
+}
+
+/*!
+    Draws the hex pair of \a value with its top left corner at \a x, \a y.
+*/
+void BinEditGlyphAtlas::drawHex(QPainter *painter, int x, int y, uchar value, const QColor &color)
+{
+    const qreal ratio = m_devicePixelRatio;
+    const QRectF source((value % GridSize) * m_columnWidth * ratio, (value / GridSize) * m_lineHeight * ratio,
+                        m_columnWidth * ratio, m_lineHeight * ratio);
+    painter->drawPixmap(QRectF(x, y, m_columnWidth, m_lineHeight), atlas(color), source);
+}
+
+/*!
+    Draws the printable character of \a value with its top left corner at
+    \a x, \a y.
+*/
+void BinEditGlyphAtlas::drawChar(QPainter *painter, int x, int y, uchar value, const QColor &color)
+{
+    const qreal ratio = m_devicePixelRatio;
+    const int left = GridSize * m_columnWidth + (value % GridSize) * m_maxCharWidth;
+    const int width = m_charWidths[value];
+    const QRectF source(left * ratio, (value / GridSize) * m_lineHeight * ratio,
+                        width * ratio, m_lineHeight * ratio);
+    painter->drawPixmap(QRectF(x, y, width, m_lineHeight), atlas(color), source);
+}
+
+const QPixmap &BinEditGlyphAtlas::atlas(const QColor &color)
+{
+    QHash<QRgb, QPixmap>::iterator it = m_atlases.find(color.rgba());
+    if (it != m_atlases.end())
+        return it.value();
+
+    const int width = GridSize * (m_columnWidth + m_maxCharWidth);
+    const int height = GridSize * m_lineHeight;
+    QPixmap pixmap(qRound(width * m_devicePixelRatio), qRound(height * m_devicePixelRatio));
+#if QT_VERSION >= 0x050100
+    pixmap.setDevicePixelRatio(m_devicePixelRatio);
+#endif
+    pixmap.fill(Qt::transparent);
+
+    QPainter painter(&pixmap);
+#if QT_VERSION < 0x050100
+    painter.scale(m_devicePixelRatio, m_devicePixelRatio);
+#endif
+    painter.setFont(m_font);
+    painter.setPen(color);
+
+    const char *hex = "0123456789abcdef";
+    for (int i = 0; i < 256; ++i) {
+        const int y = (i / GridSize) * m_lineHeight + m_ascent;
+        const char pair[3] = { hex[i >> 4], hex[i & 0xf], 0 };
+        painter.drawText((i % GridSize) * m_columnWidth, y, QLatin1String(pair));
+        painter.drawText(GridSize * m_columnWidth + (i % GridSize) * m_maxCharWidth, y,
+                         QString(printableChar(uchar(i))));
+    }
+    painter.end();
+
+    return m_atlases.insert(color.rgba(), pixmap).value();
+}
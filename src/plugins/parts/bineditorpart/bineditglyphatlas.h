@@ -0,0 +1,43 @@
+#ifndef BINEDITGLYPHATLAS_H
+#define BINEDITGLYPHATLAS_H
+
+#include <QtCore/QHash>
+#include <QtGui/QColor>
+#include <QtGui/QFont>
+#include <QtGui/QPixmap>
+
+class QPainter;
+
+class BinEditGlyphAtlas
+{
+public:
+    BinEditGlyphAtlas();
+
+    bool setFont(const QFont &font, int columnWidth, qreal devicePixelRatio = 1.0);
+    void clear();
+
+    int charWidth(uchar value) const { return m_charWidths[value]; }
+    int maxCharWidth() const { return m_maxCharWidth; }
+    int hexWidth() const { return m_hexWidth; }
+    int lineHeight() const { return m_lineHeight; }
+
+    static QChar printableChar(uchar value);
+
+    void drawHex(QPainter *painter, int x, int y, uchar value, const QColor &color);
+    void drawChar(QPainter *painter, int x, int y, uchar value, const QColor &color);
+
+private:
+    const QPixmap &atlas(const QColor &color);
+
+    QFont m_font;
+    int m_columnWidth;
+    int m_hexWidth;
+    int m_lineHeight;
+    int m_ascent;
+    int m_maxCharWidth;
+    int m_charWidths[256];
+    qreal m_devicePixelRatio;
+    QHash<QRgb, QPixmap> m_atlases;
+};
+
+#endif // BINEDITGLYPHATLAS_H
@@ -0,0 +1,129 @@
+#include "bineditmapguard.h"
+
+#include <QtCore/QMutex>
+
+#include <string.h>
+
+#if defined(Q_OS_UNIX)
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*!
+    \class BinEditMapGuard
+
+    Keeps reads of truncated file mappings from crashing.
+
+    Pages of a mapping past the end of a file that was truncated by another
+    process raise SIGBUS when they are read. The guard installs a handler
+    that replaces such a page of a registered mapping with a page of zeroes
+    and lets the read go on, so the reader thread, searches and painting
+    see zeroes until the owner notices the new size and maps the file again.
+    Faults outside of registered mappings are passed to the previous handler.
+
+    Other systems don't let files be truncated while they are mapped.
+*/
+
+#if defined(Q_OS_UNIX)
+
+namespace {
+
+struct Mapping {
+    volatile quintptr start;
+    volatile quintptr size;
+};
+
+Mapping mappings[BinEditMapGuard::MaxMappings];
+QMutex mappingsMutex;
+quintptr pageSize = 0;
+struct sigaction previousAction;
+
+// Runs in the signal handler, it may only use async-signal-safe calls.
+void handleBusError(int number, siginfo_t *info, void *context)
+{
+    const quintptr address = quintptr(info->si_addr);
+    for (int i = 0; i < BinEditMapGuard::MaxMappings; ++i) {
+        const quintptr start = mappings[i].start;
+        if (start == 0 || address < start || address - start >= mappings[i].size)
+            continue;
+
+        void *page = reinterpret_cast<void *>(address & ~(pageSize - 1));
+        if (::mmap(page, size_t(pageSize), PROT_READ,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            return;
+        }
+        break;
+    }
+
+    if (previousAction.sa_flags & SA_SIGINFO) {
+        previousAction.sa_sigaction(number, info, context);
+    } else if (previousAction.sa_handler != SIG_DFL && previousAction.sa_handler != SIG_IGN) {
+        previousAction.sa_handler(number);
+    } else {
+        // The read faults again and takes the default action.
+        ::sigaction(SIGBUS, &previousAction, 0);
+    }
+}
+
+void installHandler()
+{
+    pageSize = quintptr(::sysconf(_SC_PAGESIZE));
+
+    struct sigaction action;
+    ::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handleBusError;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    ::sigemptyset(&action.sa_mask);
+    ::sigaction(SIGBUS, &action, &previousAction);
+}
+
+} // namespace
+
+#endif
+
+/*!
+    Guards the \a size bytes mapped at \a data. Returns false if they can't
+    be guarded, the caller should then read the file instead of mapping it.
+*/
+bool BinEditMapGuard::add(const uchar *data, qint64 size)
+{
+#if defined(Q_OS_UNIX)
+    QMutexLocker locker(&mappingsMutex);
+    if (!pageSize)
+        installHandler();
+
+    for (int i = 0; i < MaxMappings; ++i) {
+        if (mappings[i].start == 0) {
+            // The handler checks the start, so it is set last.
+            mappings[i].size = quintptr(size);
+            mappings[i].start = quintptr(data);
+            return true;
+        }
+    }
+    return false;
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(size);
+    return true;
+#endif
+}
+
+/*!
+    Stops guarding the mapping at \a data, before it is unmapped.
+*/
+void BinEditMapGuard::remove(const uchar *data)
+{
+#if defined(Q_OS_UNIX)
+    QMutexLocker locker(&mappingsMutex);
+    for (int i = 0; i < MaxMappings; ++i) {
+        if (mappings[i].start == quintptr(data)) {
+            mappings[i].start = 0;
+            mappings[i].size = 0;
+            return;
+        }
+    }
+#else
+    Q_UNUSED(data);
+#endif
+}
@@ -0,0 +1,16 @@
+#ifndef BINEDITMAPGUARD_H
+#define BINEDITMAPGUARD_H
+
+#include <QtCore/qglobal.h>
+
+class BinEditMapGuard
+{
+public:
+    // At most this many mappings are guarded at once.
+    static const int MaxMappings = 64;
+
+    static bool add(const uchar *data, qint64 size);
+    static void remove(const uchar *data);
+};
+
+#endif // BINEDITMAPGUARD_H
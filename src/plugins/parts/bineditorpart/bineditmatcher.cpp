@@ -0,0 +1,578 @@
+#include "bineditmatcher.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define BINEDIT_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+#if defined(BINEDIT_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__)) \
+    && (defined(__x86_64__) || defined(__i386__))
+#  define BINEDIT_HAVE_AVX2
+#  include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+/*!
+    \class BinEditMatcher
+
+    Finds a byte pattern in raw data, optionally ignoring the case of ASCII
+    letters or bits that are cleared in a mask.
+
+    Candidates are located by comparing two anchor bytes of the pattern
+    against 16 (SSE2) or 32 (AVX2) positions at once, only positions where
+    both match are compared in full. For plain patterns the anchors are the
+    first and the last byte, masked patterns use the two bytes with the most
+    bits to match, so wildcards never have to be prefiltered. Case folding
+    and masking are done in registers, so the searched data is never
+    copied. AVX2 is used when the CPU supports it, builds without SSE2 use a
+    plain loop.
+*/
+
+// What the search functions need to know about a pattern.
+struct BinEditNeedle
+{
+    const char *pattern;
+    const char *mask;   // 0 if all bits must match.
+    int size;
+    int firstAnchor;
+    int lastAnchor;
+    bool caseSensitive;
+};
+
+static inline char fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c + 0x20) : c;
+}
+
+static inline char maskedAt(const char *data, const BinEditNeedle &needle, int i)
+{
+    if (needle.mask)
+        return char(data[i] & needle.mask[i]);
+    return needle.caseSensitive ? data[i] : fold(data[i]);
+}
+
+static inline bool equalsAt(const char *data, const BinEditNeedle &needle)
+{
+    if (needle.caseSensitive && !needle.mask)
+        return ::memcmp(data, needle.pattern, needle.size) == 0;
+    for (int i = 0; i < needle.size; ++i) {
+        if (maskedAt(data, needle, i) != needle.pattern[i])
+            return false;
+    }
+    return true;
+}
+
+static int scalarIndexIn(const char *data, int last, int from, const BinEditNeedle &needle)
+{
+    const int anchor = needle.firstAnchor;
+    if (needle.caseSensitive && !needle.mask) {
+        const char *it = data + from + anchor;
+        const char *end = data + last + anchor + 1;
+        while (it < end) {
+            it = static_cast<const char *>(::memchr(it, needle.pattern[anchor], end - it));
+            if (!it)
+                return -1;
+            if (equalsAt(it - anchor, needle))
+                return int(it - anchor - data);
+            ++it;
+        }
+        return -1;
+    }
+
+    for (int i = from; i <= last; ++i) {
+        if (maskedAt(data + i, needle, anchor) == needle.pattern[anchor] && equalsAt(data + i, needle))
+            return i;
+    }
+    return -1;
+}
+
+static int scalarLastIndexIn(const char *data, int from, const BinEditNeedle &needle)
+{
+    const int anchor = needle.firstAnchor;
+    for (int i = from; i >= 0; --i) {
+        if (maskedAt(data + i, needle, anchor) == needle.pattern[anchor] && equalsAt(data + i, needle))
+            return i;
+    }
+    return -1;
+}
+
+#if defined(BINEDIT_HAVE_SSE2)
+
+static inline int lowestBit(uint mask)
+{
+#if defined(_MSC_VER)
+    unsigned long result;
+    _BitScanForward(&result, mask);
+    return int(result);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+static inline int highestBit(uint mask)
+{
+#if defined(_MSC_VER)
+    unsigned long result;
+    _BitScanReverse(&result, mask);
+    return int(result);
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
+
+static inline __m128i foldSse2(__m128i x)
+{
+    // Bytes above 0x7f compare as negative and are left alone.
+    const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('A' - 1)),
+                                        _mm_cmplt_epi8(x, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+// Broadcast anchor bytes and masks of a needle.
+struct BinEditAnchorsSse2
+{
+    explicit BinEditAnchorsSse2(const BinEditNeedle &needle) :
+        first(_mm_set1_epi8(needle.pattern[needle.firstAnchor])),
+        last(_mm_set1_epi8(needle.pattern[needle.lastAnchor])),
+        firstMask(_mm_set1_epi8(needle.mask ? needle.mask[needle.firstAnchor] : char(0xff))),
+        lastMask(_mm_set1_epi8(needle.mask ? needle.mask[needle.lastAnchor] : char(0xff)))
+    {
+    }
+
+    __m128i first;
+    __m128i last;
+    __m128i firstMask;
+    __m128i lastMask;
+};
+
+static inline uint candidatesSse2(const char *data, const BinEditNeedle &needle, const BinEditAnchorsSse2 &anchors)
+{
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + needle.firstAnchor));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + needle.lastAnchor));
+    if (needle.mask) {
+        a = _mm_and_si128(a, anchors.firstMask);
+        b = _mm_and_si128(b, anchors.lastMask);
+    } else if (!needle.caseSensitive) {
+        a = foldSse2(a);
+        b = foldSse2(b);
+    }
+    return uint(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, anchors.first),
+                                                _mm_cmpeq_epi8(b, anchors.last))));
+}
+
+static int sse2IndexIn(const char *data, int last, int from, const BinEditNeedle &needle)
+{
+    const BinEditAnchorsSse2 anchors(needle);
+
+    int i = from;
+    for (; i + 15 <= last; i += 16) {
+        uint mask = candidatesSse2(data + i, needle, anchors);
+        while (mask) {
+            const int bit = lowestBit(mask);
+            if (equalsAt(data + i + bit, needle))
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return scalarIndexIn(data, last, i, needle);
+}
+
+static int sse2LastIndexIn(const char *data, int from, const BinEditNeedle &needle)
+{
+    const BinEditAnchorsSse2 anchors(needle);
+
+    int i = from;
+    for (; i >= 15; i -= 16) {
+        const int start = i - 15;
+        uint mask = candidatesSse2(data + start, needle, anchors);
+        while (mask) {
+            const int bit = highestBit(mask);
+            if (equalsAt(data + start + bit, needle))
+                return start + bit;
+            mask &= ~(1u << bit);
+        }
+    }
+    return scalarLastIndexIn(data, i, needle);
+}
+
+#endif // BINEDIT_HAVE_SSE2
+
+#if defined(BINEDIT_HAVE_AVX2)
+
+__attribute__((target("avx2")))
+static inline __m256i foldAvx2(__m256i x)
+{
+    const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('A' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), x));
+    return _mm256_or_si256(x, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+struct BinEditAnchorsAvx2
+{
+    __attribute__((target("avx2")))
+    explicit BinEditAnchorsAvx2(const BinEditNeedle &needle) :
+        first(_mm256_set1_epi8(needle.pattern[needle.firstAnchor])),
+        last(_mm256_set1_epi8(needle.pattern[needle.lastAnchor])),
+        firstMask(_mm256_set1_epi8(needle.mask ? needle.mask[needle.firstAnchor] : char(0xff))),
+        lastMask(_mm256_set1_epi8(needle.mask ? needle.mask[needle.lastAnchor] : char(0xff)))
+    {
+    }
+
+    __m256i first;
+    __m256i last;
+    __m256i firstMask;
+    __m256i lastMask;
+};
+
+__attribute__((target("avx2")))
+static inline uint candidatesAvx2(const char *data, const BinEditNeedle &needle, const BinEditAnchorsAvx2 &anchors)
+{
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + needle.firstAnchor));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + needle.lastAnchor));
+    if (needle.mask) {
+        a = _mm256_and_si256(a, anchors.firstMask);
+        b = _mm256_and_si256(b, anchors.lastMask);
+    } else if (!needle.caseSensitive) {
+        a = foldAvx2(a);
+        b = foldAvx2(b);
+    }
+    return uint(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, anchors.first),
+                                                      _mm256_cmpeq_epi8(b, anchors.last))));
+}
+
+__attribute__((target("avx2")))
+static int avx2IndexIn(const char *data, int last, int from, const BinEditNeedle &needle)
+{
+    const BinEditAnchorsAvx2 anchors(needle);
+
+    int i = from;
+    for (; i + 31 <= last; i += 32) {
+        uint mask = candidatesAvx2(data + i, needle, anchors);
+        while (mask) {
+            const int bit = lowestBit(mask);
+            if (equalsAt(data + i + bit, needle))
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return sse2IndexIn(data, last, i, needle);
+}
+
+__attribute__((target("avx2")))
+static int avx2LastIndexIn(const char *data, int from, const BinEditNeedle &needle)
+{
+    const BinEditAnchorsAvx2 anchors(needle);
+
+    int i = from;
+    for (; i >= 31; i -= 32) {
+        const int start = i - 31;
+        uint mask = candidatesAvx2(data + start, needle, anchors);
+        while (mask) {
+            const int bit = highestBit(mask);
+            if (equalsAt(data + start + bit, needle))
+                return start + bit;
+            mask &= ~(1u << bit);
+        }
+    }
+    return sse2LastIndexIn(data, i, needle);
+}
+
+static bool hasAvx2()
+{
+    static const bool result = __builtin_cpu_supports("avx2");
+    return result;
+}
+
+#endif // BINEDIT_HAVE_AVX2
+
+BinEditMatcher::BinEditMatcher() :
+    m_caseSensitive(true),
+    m_firstAnchor(0),
+    m_lastAnchor(0)
+{
+}
+
+/*!
+    Creates a matcher for \a pattern. If \a caseSensitive is false, ASCII
+    letters match regardless of their case.
+*/
+BinEditMatcher::BinEditMatcher(const QByteArray &pattern, bool caseSensitive) :
+    m_pattern(pattern),
+    m_caseSensitive(caseSensitive),
+    m_firstAnchor(0),
+    m_lastAnchor(qMax(0, pattern.size() - 1))
+{
+    if (!m_caseSensitive) {
+        char *data = m_pattern.data();
+        for (int i = 0; i < m_pattern.size(); ++i)
+            data[i] = fold(data[i]);
+    }
+}
+
+/*!
+    Creates a matcher for \a pattern that only compares the bits set in the
+    byte of \a mask at the same position, a zero byte in \a mask matches
+    any byte.
+*/
+BinEditMatcher::BinEditMatcher(const QByteArray &pattern, const QByteArray &mask) :
+    m_pattern(pattern),
+    m_mask(mask),
+    m_caseSensitive(true),
+    m_firstAnchor(0),
+    m_lastAnchor(qMax(0, pattern.size() - 1))
+{
+    Q_ASSERT(m_mask.size() == m_pattern.size());
+
+    bool exact = true;
+    char *data = m_pattern.data();
+    for (int i = 0; i < m_pattern.size(); ++i) {
+        data[i] = char(data[i] & m_mask.at(i));
+        exact = exact && uchar(m_mask.at(i)) == 0xff;
+    }
+    // Plain patterns take the memchr() path.
+    if (exact)
+        m_mask.clear();
+    else
+        chooseAnchors();
+}
+
+static int bitCount(uchar byte)
+{
+    int count = 0;
+    for (; byte; byte &= byte - 1)
+        ++count;
+    return count;
+}
+
+/*
+    Picks the bytes with the most bits to match as anchors, the first one
+    as early and the second one as late as possible. Zero and 0xff bytes,
+    which are everywhere in binaries, only win if nothing else does.
+*/
+void BinEditMatcher::chooseAnchors()
+{
+    int firstScore = -1;
+    int lastScore = -1;
+    for (int i = 0; i < m_pattern.size(); ++i) {
+        const uchar value = uchar(m_pattern.at(i));
+        int score = 2 * bitCount(uchar(m_mask.at(i)));
+        if (score && value != 0 && value != 0xff)
+            ++score;
+        if (score > firstScore) {
+            firstScore = score;
+            m_firstAnchor = i;
+        }
+    }
+    m_lastAnchor = m_firstAnchor;
+    for (int i = m_pattern.size() - 1; i >= 0; --i) {
+        if (i == m_firstAnchor)
+            continue;
+        const uchar value = uchar(m_pattern.at(i));
+        int score = 2 * bitCount(uchar(m_mask.at(i)));
+        if (score && value != 0 && value != 0xff)
+            ++score;
+        if (score > lastScore) {
+            lastScore = score;
+            m_lastAnchor = i;
+        }
+    }
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+class BinEditHexPatternParser
+{
+public:
+    // A sequence of masked bytes, one of the alternatives of a pattern.
+    struct Alternative
+    {
+        QByteArray pattern;
+        QByteArray mask;
+    };
+    typedef QVector<Alternative> Alternatives;
+
+    explicit BinEditHexPatternParser(const QByteArray &text) : m_text(text), m_pos(0) {}
+
+    bool parse(Alternatives *result);
+
+private:
+    bool parseSequence(Alternatives *result);
+    void skipSpaces();
+
+    QByteArray m_text;
+    int m_pos;
+};
+
+bool BinEditHexPatternParser::parse(Alternatives *result)
+{
+    return parseSequence(result) && m_pos == m_text.size();
+}
+
+void BinEditHexPatternParser::skipSpaces()
+{
+    while (m_pos < m_text.size() && (m_text.at(m_pos) == ' ' || m_text.at(m_pos) == '\t'))
+        ++m_pos;
+}
+
+/*
+    Parses bytes and groups up to the end of the text, a '|' or a ')'.
+    Bytes are two nibbles, each a hex digit or '?' for any value. Groups
+    are alternatives in parentheses separated by '|', every combination of
+    alternatives is one sequence of \a result.
+*/
+bool BinEditHexPatternParser::parseSequence(Alternatives *result)
+{
+    Alternatives sequences(1);
+    int nibbles = 0;
+    uchar value = 0;
+    uchar mask = 0;
+    for (skipSpaces(); m_pos < m_text.size(); skipSpaces()) {
+        const char c = m_text.at(m_pos);
+        if (c == '|' || c == ')')
+            break;
+
+        if (c == '(') {
+            if (nibbles % 2)
+                return false;
+            Alternatives group;
+            do {
+                ++m_pos;
+                Alternatives alternatives;
+                if (!parseSequence(&alternatives))
+                    return false;
+                group += alternatives;
+            } while (m_pos < m_text.size() && m_text.at(m_pos) == '|');
+            if (m_pos == m_text.size() || m_text.at(m_pos) != ')')
+                return false;
+            ++m_pos;
+
+            if (sequences.size() * group.size() > BinEditMatcher::MaxAlternatives)
+                return false;
+            Alternatives combined;
+            foreach (const Alternative &sequence, sequences) {
+                foreach (const Alternative &alternative, group) {
+                    Alternative joined = { sequence.pattern + alternative.pattern,
+                                           sequence.mask + alternative.mask };
+                    combined.append(joined);
+                }
+            }
+            sequences = combined;
+            continue;
+        }
+
+        const int digit = hexValue(c);
+        if (digit < 0 && c != '?')
+            return false;
+        ++m_pos;
+        value = uchar(value << 4 | qMax(digit, 0));
+        mask = uchar(mask << 4 | (digit < 0 ? 0 : 0xf));
+        if (++nibbles % 2)
+            continue;
+        for (int i = 0; i < sequences.size(); ++i) {
+            sequences[i].pattern.append(char(value));
+            sequences[i].mask.append(char(mask));
+        }
+        value = 0;
+        mask = 0;
+    }
+
+    if (nibbles % 2)
+        return false;
+    *result = sequences;
+    return true;
+}
+
+/*!
+    Compiles \a text, bytes written as pairs of hex digits, into matchers.
+
+    A '?' matches any value of a nibble, so "4D 5A ?? ?? 50 45" matches
+    any two bytes in between and "A? 0F" any byte from 0xa0 to 0xaf
+    followed by 0x0f. Alternatives are put in parentheses and separated by
+    '|', like "(4D 5A | 7F 45 4C 46) 00", each combination of them gets its
+    own matcher, up to MaxAlternatives. Spaces are ignored.
+
+    Returns no matchers if \a text is not such a pattern or one of its
+    alternatives is empty or only wildcards.
+*/
+QVector<BinEditMatcher> BinEditMatcher::fromHexPattern(const QByteArray &text)
+{
+    BinEditHexPatternParser::Alternatives alternatives;
+    BinEditHexPatternParser parser(text);
+    if (!parser.parse(&alternatives))
+        return QVector<BinEditMatcher>();
+
+    QVector<BinEditMatcher> matchers;
+    foreach (const BinEditHexPatternParser::Alternative &alternative, alternatives) {
+        if (alternative.mask.count(char(0)) == alternative.mask.size())
+            return QVector<BinEditMatcher>();
+        matchers.append(BinEditMatcher(alternative.pattern, alternative.mask));
+    }
+    return matchers;
+}
+
+/*!
+    Returns the position of the first match in \a length bytes of \a data
+    at or after \a from, or -1 if there is none or the pattern is empty.
+*/
+int BinEditMatcher::indexIn(const char *data, int length, int from) const
+{
+    const int size = m_pattern.size();
+    const int last = length - size;
+    if (from < 0)
+        from = 0;
+    if (size == 0 || from > last)
+        return -1;
+
+    const BinEditNeedle needle = { m_pattern.constData(), m_mask.isEmpty() ? 0 : m_mask.constData(),
+                            size, m_firstAnchor, m_lastAnchor, m_caseSensitive };
+#if defined(BINEDIT_HAVE_AVX2)
+    if (hasAvx2())
+        return avx2IndexIn(data, last, from, needle);
+#endif
+#if defined(BINEDIT_HAVE_SSE2)
+    return sse2IndexIn(data, last, from, needle);
+#else
+    return scalarIndexIn(data, last, from, needle);
+#endif
+}
+
+/*!
+    Returns the position of the last match in \a length bytes of \a data
+    starting at or before \a from, or -1 if there is none or the pattern is
+    empty. A negative \a from searches from the end.
+*/
+int BinEditMatcher::lastIndexIn(const char *data, int length, int from) const
+{
+    const int size = m_pattern.size();
+    const int last = length - size;
+    if (size == 0 || last < 0)
+        return -1;
+    if (from < 0 || from > last)
+        from = last;
+
+    const BinEditNeedle needle = { m_pattern.constData(), m_mask.isEmpty() ? 0 : m_mask.constData(),
+                            size, m_firstAnchor, m_lastAnchor, m_caseSensitive };
+#if defined(BINEDIT_HAVE_AVX2)
+    if (hasAvx2())
+        return avx2LastIndexIn(data, from, needle);
+#endif
+#if defined(BINEDIT_HAVE_SSE2)
+    return sse2LastIndexIn(data, from, needle);
+#else
+    return scalarLastIndexIn(data, from, needle);
+#endif
+}
@@ -0,0 +1,42 @@
+#ifndef BINEDITMATCHER_H
+#define BINEDITMATCHER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QVector>
+
+class BinEditMatcher
+{
+public:
+    static const int MaxAlternatives = 64;
+
+    BinEditMatcher();
+    explicit BinEditMatcher(const QByteArray &pattern, bool caseSensitive = true);
+    BinEditMatcher(const QByteArray &pattern, const QByteArray &mask);
+
+    static QVector<BinEditMatcher> fromHexPattern(const QByteArray &text);
+
+    QByteArray pattern() const { return m_pattern; }
+    QByteArray mask() const { return m_mask; }
+    int size() const { return m_pattern.size(); }
+    bool isEmpty() const { return m_pattern.isEmpty(); }
+    bool isCaseSensitive() const { return m_caseSensitive; }
+
+    int indexIn(const char *data, int length, int from = 0) const;
+    int indexIn(const QByteArray &data, int from = 0) const
+    { return indexIn(data.constData(), data.size(), from); }
+
+    int lastIndexIn(const char *data, int length, int from = -1) const;
+    int lastIndexIn(const QByteArray &data, int from = -1) const
+    { return lastIndexIn(data.constData(), data.size(), from); }
+
+private:
+    void chooseAnchors();
+
+    QByteArray m_pattern;
+    QByteArray m_mask; // Empty if all bits of all bytes must match.
+    bool m_caseSensitive;
+    int m_firstAnchor;
+    int m_lastAnchor;
+};
+
+#endif // BINEDITMATCHER_H
@@ -0,0 +1,98 @@
+#include "bineditmimedata.h"
+
+#include "bineditblockprovider.h"
+
+static const char octetStreamType[] = "application/octet-stream";
+static const char textType[] = "text/plain";
+
+/*!
+    \class BinEditMimeData
+
+    Clipboard data for a selection of a BinEdit that is only materialized
+    when it is pasted.
+
+    It keeps a snapshot of the pieces of the selection instead of the bytes,
+    so copying costs the same however large the selection is. The data is
+    offered as raw bytes and as text, which is either the bytes themselves
+    or hex values, depending on how it was copied. BinEdit pastes its own
+    data as pieces, without materializing it at all.
+
+    The original data the pieces refer to must not change while the data is
+    on the clipboard, detach() copies it before it does.
+*/
+
+BinEditMimeData::BinEditMimeData(bool raw, const BinEditBlockProvider *provider,
+                                 quint64 baseAddress, const BinEditPieceTable::PieceList &pieces,
+                                 const QSharedPointer<BinEditAddBuffer> &addBuffer) :
+    m_raw(raw),
+    m_provider(provider),
+    m_baseAddress(baseAddress),
+    m_pieces(pieces),
+    m_addBuffer(addBuffer),
+    m_from(pieces.isEmpty() ? 0 : pieces.first().position),
+    m_length(0)
+{
+    foreach (const BinEditPieceTable::Piece &piece, pieces)
+        m_length += piece.length;
+}
+
+/*!
+    Copies the original data the selection refers to into the add buffer,
+    the provider isn't used afterwards. Returns false if it couldn't be
+    stored, the data is empty then.
+*/
+bool BinEditMimeData::detach()
+{
+    if (!m_provider)
+        return true;
+
+    const bool ok = BinEditPieceTable::detach(&m_pieces, m_provider, m_baseAddress,
+                                              m_addBuffer.data());
+    if (!ok) {
+        m_pieces.clear();
+        m_length = 0;
+    }
+    m_provider = 0;
+    return ok;
+}
+
+QStringList BinEditMimeData::formats() const
+{
+    return QStringList() << QLatin1String(octetStreamType) << QLatin1String(textType);
+}
+
+bool BinEditMimeData::hasFormat(const QString &mimeType) const
+{
+    return mimeType == QLatin1String(octetStreamType) || mimeType == QLatin1String(textType);
+}
+
+QVariant BinEditMimeData::retrieveData(const QString &mimeType, QVariant::Type type) const
+{
+    Q_UNUSED(type)
+
+    if (mimeType == QLatin1String(octetStreamType))
+        return bytes();
+    if (mimeType != QLatin1String(textType))
+        return QVariant();
+
+    const QByteArray data = bytes();
+    if (m_raw)
+        return QString::fromLatin1(data.constData(), data.size());
+
+    QString hexString;
+    const char * const hex = "0123456789abcdef";
+    hexString.reserve(3 * data.size());
+    for (int i = 0; i < data.size(); ++i) {
+        const uchar val = static_cast<uchar>(data[i]);
+        hexString.append(QLatin1Char(hex[val >> 4])).append(QLatin1Char(hex[val & 0xf]))
+                .append(QLatin1Char(' '));
+    }
+    hexString.chop(1);
+    return hexString;
+}
+
+QByteArray BinEditMimeData::bytes() const
+{
+    return BinEditPieceTable::read(m_pieces, m_addBuffer.data(), m_provider, m_baseAddress,
+                                   m_from, int(m_length));
+}
@@ -0,0 +1,46 @@
+#ifndef BINEDITMIMEDATA_H
+#define BINEDITMIMEDATA_H
+
+#include <QtCore/QMimeData>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QStringList>
+
+#include "bineditpiecetable.h"
+
+class BinEditBlockProvider;
+
+class BinEditMimeData : public QMimeData
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditMimeData)
+
+public:
+    BinEditMimeData(bool raw, const BinEditBlockProvider *provider, quint64 baseAddress,
+                    const BinEditPieceTable::PieceList &pieces,
+                    const QSharedPointer<BinEditAddBuffer> &addBuffer);
+
+    qint64 length() const { return m_length; }
+    BinEditPieceTable::PieceList pieces() const { return m_pieces; }
+    QSharedPointer<BinEditAddBuffer> addBuffer() const { return m_addBuffer; }
+
+    bool detach();
+
+    QStringList formats() const;
+    bool hasFormat(const QString &mimeType) const;
+
+protected:
+    QVariant retrieveData(const QString &mimeType, QVariant::Type type) const;
+
+private:
+    QByteArray bytes() const;
+
+    bool m_raw;
+    const BinEditBlockProvider *m_provider;
+    quint64 m_baseAddress;
+    BinEditPieceTable::PieceList m_pieces;
+    QSharedPointer<BinEditAddBuffer> m_addBuffer;
+    qint64 m_from;
+    qint64 m_length;
+};
+
+#endif // BINEDITMIMEDATA_H
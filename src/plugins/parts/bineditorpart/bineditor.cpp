@@ -1,32 +1,51 @@
 #include "bineditor.h"
 
-#include <QtGui/QResizeEvent>
+#include <QtCore/QSettings>
 
 #if QT_VERSION >= 0x050000
 #include <QtWidgets/QAction>
+#include <QtWidgets/QFileDialog>
 #include <QtWidgets/QFileIconProvider>
+#include <QtWidgets/QSplitter>
+#include <QtWidgets/QVBoxLayout>
 #else
 #include <QtGui/QAction>
+#include <QtGui/QFileDialog>
 #include <QtGui/QFileIconProvider>
+#include <QtGui/QSplitter>
+#include <QtGui/QVBoxLayout>
 #endif
 
 #include <Parts/constants.h>
 
 #include "binedit.h"
+#include "bineditchecksumpanel.h"
+#include "bineditdiffpanel.h"
 #include "bineditordocument.h"
+#include "bineditprocessdialog.h"
+#include "bineditsearchpanel.h"
+#include "bineditstringspanel.h"
 
 using namespace Parts;
 using namespace BINEditor;
 
 BinEditor::BinEditor(QWidget *parent) :
     AbstractEditor(*new BinEditorDocument, parent),
-    m_editor(new BinEdit(this))
+    m_editor(new BinEdit(this)),
+    m_otherEditor(0),
+    m_diffPanel(0)
 {
     document()->setParent(this);
+    setupUi();
     createActions();
     retranslateUi();
+    loadSettings();
 
     connect(document(), SIGNAL(urlChanged(QUrl)), this, SLOT(open(QUrl)));
+    connect(m_editor, SIGNAL(modificationChanged(bool)), document(), SLOT(setModified(bool)));
+    connect(document(), SIGNAL(modificationChanged(bool)), m_editor, SLOT(setModified(bool)));
+
+    static_cast<BinEditorDocument *>(document())->setEditor(this);
 }
 
 void BinEditor::setDocument(AbstractDocument *document)
@@ -38,7 +57,10 @@ void BinEditor::setDocument(AbstractDocument *document)
     if (!binDocument)
         return;
 
+    binDocument->setEditor(this);
     connect(document, SIGNAL(urlChanged(QUrl)), this, SLOT(open(QUrl)));
+    connect(m_editor, SIGNAL(modificationChanged(bool)), document, SLOT(setModified(bool)));
+    connect(document, SIGNAL(modificationChanged(bool)), m_editor, SLOT(setModified(bool)));
 
     AbstractEditor::setDocument(document);
 }
@@ -48,9 +70,100 @@ void BinEditor::open(const QUrl &url)
     m_editor->open(url.toLocalFile());
 }
 
-void BinEditor::resizeEvent(QResizeEvent *e)
+/*!
+    Asks for another file and shows it next to the edited one with the
+    differences between them highlighted.
+*/
+void BinEditor::compareWith()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, tr("Compare With"));
+    if (fileName.isEmpty())
+        return;
+
+    if (!m_otherEditor) {
+        m_otherEditor = new BinEdit(this);
+        m_otherEditor->setReadOnly(true);
+        m_otherEditor->setCacheSize(m_editor->cacheSize());
+        m_editorSplitter->addWidget(m_otherEditor);
+
+        m_diffPanel = new BinEditDiffPanel(m_editor, m_otherEditor, this);
+        connect(m_diffPanel, SIGNAL(closeRequested()), SLOT(closeComparison()));
+        m_splitter->addWidget(m_diffPanel);
+        m_splitter->setStretchFactor(m_splitter->indexOf(m_diffPanel), 1);
+    }
+
+    m_otherEditor->open(fileName);
+    m_otherEditor->show();
+    m_diffPanel->show();
+    m_diffPanel->compare();
+}
+
+void BinEditor::closeComparison()
+{
+    m_diffPanel->clear();
+    m_diffPanel->hide();
+    m_otherEditor->open(QString());
+    m_otherEditor->hide();
+    m_editor->setFocus();
+}
+
+/*!
+    Asks for a local process and shows the memory of one of its mappings
+    read-only instead of the file.
+*/
+void BinEditor::attachToProcess()
+{
+    BinEditProcessDialog dialog(this);
+    dialog.setRefreshInterval(m_editor->refreshInterval());
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+
+    m_editor->setRefreshInterval(dialog.refreshInterval());
+    m_editor->openProcess(dialog.pid(), dialog.address());
+    m_editor->setFocus();
+}
+
+/*!
+    Shows gzip and xz files decompressed or as they are stored, and
+    remembers the choice for other editors.
+*/
+void BinEditor::setDecompressionEnabled(bool enabled)
+{
+    m_editor->setDecompressionEnabled(enabled);
+
+    QSettings settings;
+    settings.beginGroup(QLatin1String("binEditor"));
+    settings.setValue(QLatin1String("decompress"), enabled);
+}
+
+void BinEditor::setupUi()
 {
-    m_editor->resize(e->size());
+    m_searchPanel = new BinEditSearchPanel(m_editor, this);
+    m_searchPanel->hide();
+
+    m_stringsPanel = new BinEditStringsPanel(m_editor, this);
+    m_stringsPanel->hide();
+
+    m_checksumPanel = new BinEditChecksumPanel(m_editor, this);
+    m_checksumPanel->hide();
+
+    m_editorSplitter = new QSplitter(Qt::Horizontal, this);
+    m_editorSplitter->addWidget(m_editor);
+
+    m_splitter = new QSplitter(Qt::Vertical, this);
+    m_splitter->addWidget(m_editorSplitter);
+    m_splitter->addWidget(m_searchPanel);
+    m_splitter->addWidget(m_stringsPanel);
+    m_splitter->addWidget(m_checksumPanel);
+    m_splitter->setStretchFactor(0, 3);
+    m_splitter->setStretchFactor(1, 1);
+    m_splitter->setStretchFactor(2, 1);
+    m_splitter->setStretchFactor(3, 1);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setSpacing(0);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(m_splitter);
 }
 
 void BinEditor::createActions()
@@ -76,10 +189,69 @@ void BinEditor::createActions()
     connect(m_editor, SIGNAL(copyAvailable(bool)), actions[BinEditor::Copy], SLOT(setEnabled(bool)));
     connect(actions[BinEditor::Copy], SIGNAL(triggered()), m_editor, SLOT(copy()));
 
+    actions[BinEditor::Paste] = new QAction(this);
+    actions[BinEditor::Paste]->setObjectName(Constants::Actions::Paste);
+    addAction(actions[BinEditor::Paste]);
+    connect(actions[BinEditor::Paste], SIGNAL(triggered()), m_editor, SLOT(paste()));
+
     actions[BinEditor::SelectAll] = new QAction(this);
     actions[BinEditor::SelectAll]->setObjectName(Constants::Actions::SelectAll);
     addAction(actions[BinEditor::SelectAll]);
     connect(actions[BinEditor::SelectAll], SIGNAL(triggered()), m_editor, SLOT(selectAll()));
+
+    actions[BinEditor::FindAll] = new QAction(this);
+    actions[BinEditor::FindAll]->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_F));
+    actions[BinEditor::FindAll]->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    addAction(actions[BinEditor::FindAll]);
+    connect(actions[BinEditor::FindAll], SIGNAL(triggered()), m_searchPanel, SLOT(activate()));
+
+    actions[BinEditor::Strings] = new QAction(this);
+    actions[BinEditor::Strings]->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_T));
+    actions[BinEditor::Strings]->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    addAction(actions[BinEditor::Strings]);
+    connect(actions[BinEditor::Strings], SIGNAL(triggered()), m_stringsPanel, SLOT(activate()));
+
+    actions[BinEditor::Checksums] = new QAction(this);
+    actions[BinEditor::Checksums]->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_H));
+    actions[BinEditor::Checksums]->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    addAction(actions[BinEditor::Checksums]);
+    connect(actions[BinEditor::Checksums], SIGNAL(triggered()), m_checksumPanel, SLOT(activate()));
+
+    actions[BinEditor::Compare] = new QAction(this);
+    actions[BinEditor::Compare]->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_D));
+    actions[BinEditor::Compare]->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    addAction(actions[BinEditor::Compare]);
+    connect(actions[BinEditor::Compare], SIGNAL(triggered()), this, SLOT(compareWith()));
+
+    actions[BinEditor::AttachToProcess] = new QAction(this);
+    actions[BinEditor::AttachToProcess]->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    addAction(actions[BinEditor::AttachToProcess]);
+    connect(actions[BinEditor::AttachToProcess], SIGNAL(triggered()), this, SLOT(attachToProcess()));
+
+    actions[BinEditor::Decompress] = new QAction(this);
+    actions[BinEditor::Decompress]->setCheckable(true);
+    actions[BinEditor::Decompress]->setChecked(m_editor->isDecompressionEnabled());
+    actions[BinEditor::Decompress]->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    addAction(actions[BinEditor::Decompress]);
+    connect(actions[BinEditor::Decompress], SIGNAL(toggled(bool)), this, SLOT(setDecompressionEnabled(bool)));
+#if !defined(BINEDITOR_HAVE_DECOMPRESSION)
+    // Built without zlib and liblzma, compressed files are shown as stored.
+    actions[BinEditor::Decompress]->setVisible(false);
+#endif
+}
+
+void BinEditor::loadSettings()
+{
+    QSettings settings;
+    settings.beginGroup(QLatin1String("binEditor"));
+
+    const qint64 cacheSize = settings.value(QLatin1String("cacheSize"),
+                                            m_editor->cacheSize() / (1024 * 1024)).toLongLong();
+    m_editor->setCacheSize(cacheSize * 1024 * 1024);
+
+    const bool decompress = settings.value(QLatin1String("decompress"),
+                                           m_editor->isDecompressionEnabled()).toBool();
+    actions[BinEditor::Decompress]->setChecked(decompress);
 }
 
 void BinEditor::retranslateUi()
@@ -87,7 +259,14 @@ void BinEditor::retranslateUi()
     actions[BinEditor::Redo]->setText(tr("Redo"));
     actions[BinEditor::Undo]->setText(tr("Undo"));
     actions[BinEditor::Copy]->setText(tr("Copy"));
+    actions[BinEditor::Paste]->setText(tr("Paste"));
     actions[BinEditor::SelectAll]->setText(tr("Select all"));
+    actions[BinEditor::FindAll]->setText(tr("Find in file"));
+    actions[BinEditor::Strings]->setText(tr("Strings"));
+    actions[BinEditor::Checksums]->setText(tr("Checksums"));
+    actions[BinEditor::Compare]->setText(tr("Compare with..."));
+    actions[BinEditor::AttachToProcess]->setText(tr("Attach to process..."));
+    actions[BinEditor::Decompress]->setText(tr("Show decompressed"));
 }
 
 /*!
@@ -6,7 +6,13 @@
 #include <Parts/AbstractEditor>
 #include <Parts/AbstractEditorFactory>
 
+class QSplitter;
+
 class BinEdit;
+class BinEditChecksumPanel;
+class BinEditDiffPanel;
+class BinEditSearchPanel;
+class BinEditStringsPanel;
 
 namespace BINEditor {
 
@@ -22,8 +28,16 @@ public:
         Undo,
 
         Copy,
+        Paste,
         SelectAll,
 
+        FindAll,
+        Strings,
+        Checksums,
+        Compare,
+        AttachToProcess,
+        Decompress,
+
         ActionCount
     };
 
@@ -31,20 +45,32 @@ public:
 
     void setDocument(Parts::AbstractDocument *document);
 
-protected:
-    void resizeEvent(QResizeEvent *);
-
 private:
+    void setupUi();
     void createActions();
+    void loadSettings();
     void retranslateUi();
 
 private slots:
     void open(const QUrl &url);
+    void compareWith();
+    void closeComparison();
+    void attachToProcess();
+    void setDecompressionEnabled(bool enabled);
 
 private:
     BinEdit *m_editor;
+    BinEdit *m_otherEditor;
+    BinEditSearchPanel *m_searchPanel;
+    BinEditStringsPanel *m_stringsPanel;
+    BinEditChecksumPanel *m_checksumPanel;
+    BinEditDiffPanel *m_diffPanel;
+    QSplitter *m_editorSplitter;
+    QSplitter *m_splitter;
 
     QAction *actions[ActionCount];
+
+    friend class BinEditorDocument;
 };
 
 class BinEditorFactory : public Parts::AbstractEditorFactory
@@ -4,17 +4,23 @@
 
 #if QT_VERSION >= 0x050000
 #include <QtWidgets/QFileIconProvider>
+#include <QtWidgets/QMessageBox>
 #else
 #include <QtGui/QFileIconProvider>
+#include <QtGui/QMessageBox>
 #endif
 
+#include "binedit.h"
+#include "bineditor.h"
+
 using namespace Parts;
 using namespace BINEditor;
 
 BinEditorDocument::BinEditorDocument(QObject *parent) :
-    AbstractDocument(parent)
+    AbstractDocument(parent),
+    m_editor(0)
 {
-    setWritable(false);
+    setWritable(true);
 }
 
 bool BinEditorDocument::openUrl(const QUrl &url)
@@ -28,6 +34,28 @@ bool BinEditorDocument::openUrl(const QUrl &url)
     return true;
 }
 
+/*!
+    \reimp
+
+    Only blocks changed since the last save are written back when saving to
+    the same file, other files are streamed through a temporary file.
+*/
+bool BinEditorDocument::saveUrl(const QUrl &url)
+{
+    if (!m_editor)
+        return false;
+
+    const QString oldFileName = this->url().toLocalFile();
+    const QString newFileName = url.isEmpty() ? oldFileName : url.toLocalFile();
+
+    QString errorString;
+    if (!m_editor->m_editor->save(&errorString, oldFileName, newFileName)) {
+        QMessageBox::warning(m_editor, tr("Save failed"), errorString);
+        return false;
+    }
+    return true;
+}
+
 /*!
     \class BinEditorDocumentFactory
 */
@@ -8,14 +8,22 @@
 
 namespace BINEditor {
 
+class BinEditor;
+
 class BINEDITOR_EXPORT BinEditorDocument : public Parts::AbstractDocument
 {
     Q_OBJECT
 public:
     explicit BinEditorDocument(QObject *parent = 0);
 
+    void setEditor(BinEditor *editor) { m_editor = editor; }
+
 protected:
     bool openUrl(const QUrl &url);
+    bool saveUrl(const QUrl &url);
+
+private:
+    BinEditor *m_editor;
 };
 
 class BinEditorDocumentFactory : public Parts::AbstractDocumentFactory
@@ -0,0 +1,429 @@
+#include "bineditoverview.h"
+
+#include "bineditblockprovider.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QRunnable>
+#include <QtCore/QtAlgorithms>
+
+#if QT_VERSION >= 0x050000
+#include <QtCore/QStandardPaths>
+#else
+#include <QtGui/QDesktopServices>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define BINEDIT_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+static const quint32 cacheMagic = 0x42454f56; // "BEOV"
+static const quint32 cacheVersion = 1;
+
+static bool lessExtentEnd(const BinEditBlockProvider::Extent &extent, qint64 offset)
+{
+    return extent.offset + extent.length <= offset;
+}
+
+static uint packRegion(const BinEditOverview::Region &region)
+{
+    return uint(region.entropy) | uint(region.zeros) << 8 | uint(region.text) << 16
+            | uint(region.high) << 24;
+}
+
+static BinEditOverview::Region unpackRegion(uint value)
+{
+    const BinEditOverview::Region region = {
+        quint8(value), quint8(value >> 8), quint8(value >> 16), quint8(value >> 24)
+    };
+    return region;
+}
+
+#if defined(BINEDIT_HAVE_SSE2)
+static inline bool isZero64(const uchar *data)
+{
+    const __m128i *p = reinterpret_cast<const __m128i *>(data);
+    const __m128i any = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+                                     _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) == 0xffff;
+}
+#endif
+
+static inline void countBytes(const uchar *data, int length, quint32 counts[4][256])
+{
+    int i = 0;
+    for (; i + 8 <= length; i += 8) {
+        quint64 word;
+        ::memcpy(&word, data + i, sizeof(word));
+        ++counts[0][word & 0xff];
+        ++counts[1][(word >> 8) & 0xff];
+        ++counts[2][(word >> 16) & 0xff];
+        ++counts[3][(word >> 24) & 0xff];
+        ++counts[0][(word >> 32) & 0xff];
+        ++counts[1][(word >> 40) & 0xff];
+        ++counts[2][(word >> 48) & 0xff];
+        ++counts[3][word >> 56];
+    }
+    for (; i < length; ++i)
+        ++counts[0][data[i]];
+}
+
+/*
+    Adds the bytes of \a data to \a histogram.
+
+    Bytes are counted into four tables in turn, so runs of equal bytes
+    don't wait for each other's increments of the same counter. Blocks of
+    zeros, which make up much of disk images, are skipped 64 bytes at a
+    time with SSE2.
+*/
+static void addHistogram(const uchar *data, int length, quint64 *histogram)
+{
+    quint32 counts[4][256];
+    ::memset(counts, 0, sizeof(counts));
+    quint64 zeros = 0;
+
+    int i = 0;
+#if defined(BINEDIT_HAVE_SSE2)
+    while (i + 64 <= length) {
+        if (isZero64(data + i)) {
+            zeros += 64;
+            i += 64;
+            continue;
+        }
+        countBytes(data + i, 64, counts);
+        i += 64;
+    }
+#endif
+    countBytes(data + i, length - i, counts);
+
+    for (int value = 0; value < 256; ++value)
+        histogram[value] += quint64(counts[0][value]) + counts[1][value] + counts[2][value] + counts[3][value];
+    histogram[0] += zeros;
+}
+
+class BinEditOverviewJob
+{
+public:
+    BinEditBlockProvider *provider;
+    qint64 size;
+    qint64 regionSize;
+    int generation;
+    QAtomicInt stopped;
+
+    bool isStopped() const
+    {
+#if QT_VERSION >= 0x050000
+        return stopped.load();
+#else
+        return stopped;
+#endif
+    }
+};
+
+class BinEditOverviewTask : public QRunnable
+{
+public:
+    BinEditOverviewTask(const QSharedPointer<BinEditOverviewJob> &job, QObject *receiver, int index) :
+        m_job(job),
+        m_receiver(receiver),
+        m_index(index)
+    {
+    }
+
+    void run();
+
+private:
+    QSharedPointer<BinEditOverviewJob> m_job;
+    QObject *m_receiver;
+    int m_index;
+};
+
+void BinEditOverviewTask::run()
+{
+    const BinEditOverviewJob &job = *m_job;
+    if (job.isStopped())
+        return;
+
+    quint64 histogram[256];
+    ::memset(histogram, 0, sizeof(histogram));
+    const qint64 start = qint64(m_index) * job.regionSize;
+    const qint64 end = qMin(start + job.regionSize, job.size);
+    for (qint64 offset = start; offset < end; offset += BinEditOverview::ReadSize) {
+        if (job.isStopped())
+            return;
+        const int length = int(qMin<qint64>(BinEditOverview::ReadSize, end - offset));
+        if (job.provider->isHole(offset, length)) {
+            histogram[0] += quint64(length);
+            continue;
+        }
+        const QByteArray data = job.provider->read(offset, length);
+        addHistogram(reinterpret_cast<const uchar *>(data.constData()), data.size(), histogram);
+    }
+
+    QMetaObject::invokeMethod(m_receiver, "handleRegionDone", Qt::QueuedConnection,
+                              Q_ARG(int, job.generation), Q_ARG(int, m_index),
+                              Q_ARG(uint, packRegion(BinEditOverview::analyze(histogram))));
+}
+
+/*!
+    \class BinEditOverview
+
+    Computes the byte entropy and the share of zero, text and high bytes of
+    the regions of a file on a thread pool, for an overview of where its
+    compressed, encrypted, empty and text parts are.
+
+    A file is split into at most MaxRegionCount regions. They are computed
+    coarse to fine, first every region at a large stride, then the ones in
+    between, so the overview covers the whole file early and refines while
+    the rest is read. Results are cached on disk by path, size and
+    modification time, reopening an unchanged file doesn't read it again.
+    For sparse files the data extents of the provider are kept as well,
+    holes count as zeros without being read.
+
+    The overview describes the file on disk, unsaved edits are not part of
+    it. cancel() must be called before the provider is closed or remapped.
+*/
+
+BinEditOverview::BinEditOverview(BinEditBlockProvider *provider, QObject *parent) :
+    QObject(parent),
+    m_provider(provider),
+    m_generation(0),
+    m_pendingRegions(0),
+    m_running(false),
+    m_size(0),
+    m_regionSize(MinRegionSize),
+    m_sparse(false)
+{
+}
+
+BinEditOverview::~BinEditOverview()
+{
+    cancel();
+}
+
+/*!
+    Starts computing the overview of the \a size bytes of the provider,
+    which has \a fileName open. A cached overview is used if the file didn't
+    change since.
+*/
+void BinEditOverview::start(const QString &fileName, qint64 size)
+{
+    clear();
+
+    const QFileInfo info(fileName);
+    m_fileName = info.absoluteFilePath();
+    m_lastModified = info.lastModified();
+    m_size = size;
+    const qint64 perRegion = (size + MaxRegionCount - 1) / MaxRegionCount;
+    m_regionSize = qMax<qint64>(MinRegionSize, (perRegion + 4095) / 4096 * 4096);
+    const int count = int((size + m_regionSize - 1) / m_regionSize);
+    m_regions.resize(count);
+    m_computed.resize(count);
+    m_sparse = m_provider->isSparse();
+    m_extents = m_provider->dataExtents();
+
+    if (!count || load()) {
+        emit regionsChanged();
+        return;
+    }
+
+    QSharedPointer<BinEditOverviewJob> job(new BinEditOverviewJob);
+    job->provider = m_provider;
+    job->size = size;
+    job->regionSize = m_regionSize;
+    job->generation = m_generation;
+    m_job = job;
+
+    m_pendingRegions = count;
+    m_running = true;
+    emit started();
+
+    // Coarse to fine: all regions at the largest stride first, then the
+    // ones halfway between them, and so on.
+    int stride = 1;
+    while (stride < count)
+        stride *= 2;
+    QBitArray queued(count);
+    for (; stride >= 1; stride /= 2) {
+        for (int index = 0; index < count; index += stride) {
+            if (queued.testBit(index))
+                continue;
+            queued.setBit(index);
+            m_pool.start(new BinEditOverviewTask(job, this, index));
+        }
+    }
+}
+
+/*!
+    Cancels the computation and forgets the overview.
+*/
+void BinEditOverview::clear()
+{
+    cancel();
+    m_fileName.clear();
+    m_size = 0;
+    m_regions.clear();
+    m_computed.clear();
+    m_sparse = false;
+    m_extents.clear();
+    emit regionsChanged();
+}
+
+/*!
+    Stops the running computation, computed regions are kept.
+*/
+void BinEditOverview::cancel()
+{
+    if (m_job) {
+        m_job->stopped.fetchAndStoreRelaxed(1);
+        m_pool.waitForDone();
+        m_job.clear();
+    }
+
+    ++m_generation;
+    if (m_running) {
+        m_running = false;
+        emit finished();
+    }
+}
+
+/*!
+    Returns the share of the file offsets from \a from to \a to that hold
+    data rather than holes, scaled to 0..255.
+*/
+int BinEditOverview::dataShare(qint64 from, qint64 to) const
+{
+    if (to <= from)
+        return 0;
+    if (!m_sparse)
+        return 255;
+
+    qint64 data = 0;
+    BinEditBlockProvider::ExtentList::const_iterator it =
+            qLowerBound(m_extents.constBegin(), m_extents.constEnd(), from, lessExtentEnd);
+    for (; it != m_extents.constEnd() && it->offset < to; ++it)
+        data += qMin(to, it->offset + it->length) - qMax(from, it->offset);
+    return int(data * 255 / (to - from));
+}
+
+/*!
+    Returns the statistics of a region from its \a histogram of byte values.
+*/
+BinEditOverview::Region BinEditOverview::analyze(const quint64 *histogram)
+{
+    quint64 total = 0;
+    quint64 text = 0;
+    quint64 high = 0;
+    double sum = 0;
+    for (int value = 0; value < 256; ++value) {
+        const quint64 count = histogram[value];
+        if (!count)
+            continue;
+        total += count;
+        sum += double(count) * ::log(double(count));
+        if ((value >= 0x20 && value < 0x7f) || value == '\t' || value == '\n' || value == '\r')
+            text += count;
+        else if (value >= 0x80)
+            high += count;
+    }
+
+    Region region = { 0, 0, 0, 0 };
+    if (!total)
+        return region;
+
+    // H = log2(n) - sum(c * log2(c)) / n
+    const double entropy = (::log(double(total)) - sum / double(total)) / ::log(2.0);
+    region.entropy = quint8(qBound(0, int(entropy * 255 / 8 + 0.5), 255));
+    region.zeros = quint8(histogram[0] * 255 / total);
+    region.text = quint8(text * 255 / total);
+    region.high = quint8(high * 255 / total);
+    return region;
+}
+
+void BinEditOverview::handleRegionDone(int generation, int index, uint region)
+{
+    if (generation != m_generation)
+        return;
+
+    m_regions[index] = unpackRegion(region);
+    m_computed.setBit(index);
+    emit regionsChanged();
+
+    if (--m_pendingRegions > 0)
+        return;
+
+    m_job.clear();
+    m_running = false;
+    save();
+    emit finished();
+}
+
+QString BinEditOverview::cacheFileName() const
+{
+#if QT_VERSION >= 0x050000
+    const QString location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    const QString location = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+    const QByteArray key = QCryptographicHash::hash(m_fileName.toUtf8(), QCryptographicHash::Sha1);
+    return location + QLatin1String("/binedit-overview/") + QString::fromLatin1(key.toHex());
+}
+
+bool BinEditOverview::load()
+{
+    if (m_fileName.isEmpty() || m_regions.isEmpty())
+        return false;
+
+    QFile file(cacheFileName());
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString fileName;
+    qint64 size = 0;
+    QDateTime lastModified;
+    qint64 regionSize = 0;
+    QByteArray regions;
+    stream >> magic >> version;
+    if (magic != cacheMagic || version != cacheVersion)
+        return false;
+    stream >> fileName >> size >> lastModified >> regionSize >> regions;
+    if (stream.status() != QDataStream::Ok || fileName != m_fileName || size != m_size
+            || lastModified != m_lastModified || regionSize != m_regionSize
+            || regions.size() != m_regions.size() * int(sizeof(Region))) {
+        return false;
+    }
+
+    ::memcpy(m_regions.data(), regions.constData(), size_t(regions.size()));
+    m_computed.fill(true);
+    return true;
+}
+
+// Failing to write the cache only means computing the overview again.
+void BinEditOverview::save() const
+{
+    if (m_fileName.isEmpty() || m_regions.isEmpty())
+        return;
+
+    const QString fileName = cacheFileName();
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    QDataStream stream(&file);
+    stream << cacheMagic << cacheVersion << m_fileName << m_size << m_lastModified
+           << m_regionSize
+           << QByteArray(reinterpret_cast<const char *>(m_regions.constData()),
+                         m_regions.size() * int(sizeof(Region)));
+}
@@ -0,0 +1,86 @@
+#ifndef BINEDITOVERVIEW_H
+#define BINEDITOVERVIEW_H
+
+#include <QtCore/QBitArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+#include "bineditblockprovider.h"
+
+class BinEditOverviewJob;
+
+class BinEditOverview : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditOverview)
+
+public:
+    // Statistics of a region, all scaled to 0..255.
+    struct Region {
+        quint8 entropy; // Shannon entropy, 255 is 8 bits per byte.
+        quint8 zeros;   // Share of zero bytes.
+        quint8 text;    // Share of printable ASCII and whitespace.
+        quint8 high;    // Share of bytes >= 0x80.
+    };
+
+    static const int ReadSize = 4 * 1024 * 1024;
+    static const int MinRegionSize = 64 * 1024;
+    static const int MaxRegionCount = 4096;
+
+    explicit BinEditOverview(BinEditBlockProvider *provider, QObject *parent = 0);
+    ~BinEditOverview();
+
+    bool isRunning() const { return m_running; }
+
+    qint64 size() const { return m_size; }
+    qint64 regionSize() const { return m_regionSize; }
+    int regionCount() const { return m_regions.size(); }
+    bool hasRegion(int index) const { return m_computed.testBit(index); }
+    Region region(int index) const { return m_regions.at(index); }
+
+    bool isSparse() const { return m_sparse; }
+    int dataShare(qint64 from, qint64 to) const;
+
+    void start(const QString &fileName, qint64 size);
+    void clear();
+
+    static Region analyze(const quint64 *histogram);
+
+public slots:
+    void cancel();
+
+signals:
+    void started();
+    void regionsChanged();
+    void finished();
+
+private slots:
+    void handleRegionDone(int generation, int index, uint region);
+
+private:
+    bool load();
+    void save() const;
+    QString cacheFileName() const;
+
+    BinEditBlockProvider *m_provider;
+    QThreadPool m_pool;
+    QSharedPointer<BinEditOverviewJob> m_job;
+    int m_generation;
+    int m_pendingRegions;
+    bool m_running;
+
+    QString m_fileName;
+    QDateTime m_lastModified;
+    qint64 m_size;
+    qint64 m_regionSize;
+    QVector<Region> m_regions;
+    QBitArray m_computed;
+    bool m_sparse;
+    BinEditBlockProvider::ExtentList m_extents;
+};
+
+#endif // BINEDITOVERVIEW_H
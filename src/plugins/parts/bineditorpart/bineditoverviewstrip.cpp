@@ -0,0 +1,218 @@
+#include "bineditoverviewstrip.h"
+
+#include <QtGui/QHelpEvent>
+#include <QtGui/QMouseEvent>
+#include <QtGui/QPainter>
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QToolTip>
+#else
+#include <QtGui/QToolTip>
+#endif
+
+/*!
+    \class BinEditOverviewStrip
+
+    Narrow strip next to a BinEdit that shows a BinEditOverview of the whole
+    file. The left half is colored by entropy, from blue for uniform data to
+    red for compressed or encrypted data, the right half by the mix of zero
+    (gray), text (green) and high (orange) bytes. Sparse files get a map of
+    their extents at the right edge, dark where there is data and empty at
+    holes. The visible part of the file is framed, clicking or dragging
+    requests a position.
+*/
+
+BinEditOverviewStrip::BinEditOverviewStrip(BinEditOverview *overview, QWidget *parent) :
+    QWidget(parent),
+    m_overview(overview),
+    m_visibleFrom(0),
+    m_visibleTo(0)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setCursor(Qt::PointingHandCursor);
+    connect(m_overview, SIGNAL(regionsChanged()), SLOT(update()));
+}
+
+QSize BinEditOverviewStrip::sizeHint() const
+{
+    return QSize(StripWidth, 0);
+}
+
+/*!
+    Frames the file offsets from \a from to \a to as the visible part.
+*/
+void BinEditOverviewStrip::setVisibleRange(qint64 from, qint64 to)
+{
+    if (m_visibleFrom == from && m_visibleTo == to)
+        return;
+
+    m_visibleFrom = from;
+    m_visibleTo = to;
+    update();
+}
+
+bool BinEditOverviewStrip::event(QEvent *e)
+{
+    if (e->type() == QEvent::ToolTip) {
+        QHelpEvent *helpEvent = static_cast<QHelpEvent *>(e);
+        BinEditOverview::Region region;
+        qint64 position;
+        if (!regionAt(helpEvent->pos().y(), &region, &position)) {
+            QToolTip::hideText();
+            e->ignore();
+            return true;
+        }
+        QString text = tr("Offset: 0x%1\nEntropy: %2 bits per byte\n"
+                          "Zeros: %3%\nText: %4%\nHigh bytes: %5%")
+                .arg(QString::number(position, 16))
+                .arg(region.entropy * 8.0 / 255, 0, 'f', 2)
+                .arg(region.zeros * 100 / 255)
+                .arg(region.text * 100 / 255)
+                .arg(region.high * 100 / 255);
+        if (m_overview->isSparse()) {
+            const int y = helpEvent->pos().y();
+            text += tr("\nAllocated: %1%").arg(m_overview->dataShare(positionAt(y), positionAt(y + 1)) * 100 / 255);
+        }
+        QToolTip::showText(helpEvent->globalPos(), text, this);
+        return true;
+    }
+    return QWidget::event(e);
+}
+
+void BinEditOverviewStrip::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().window());
+
+    const int count = m_overview->regionCount();
+    const int h = height();
+    if (!count || h <= 0)
+        return;
+
+    const int half = width() / 2;
+    const int mapWidth = m_overview->isSparse() ? ExtentMapWidth : 0;
+    const qint64 size = m_overview->size();
+    for (int y = 0; y < h; ++y) {
+        // Average the regions that fall on this row, a row shows at least
+        // one region.
+        const int first = int(qint64(y) * count / h);
+        const int last = qMax(first, int(qint64(y + 1) * count / h) - 1);
+        int entropy = 0;
+        int zeros = 0;
+        int text = 0;
+        int high = 0;
+        int computed = 0;
+        for (int index = first; index <= last; ++index) {
+            if (!m_overview->hasRegion(index))
+                continue;
+            const BinEditOverview::Region region = m_overview->region(index);
+            entropy += region.entropy;
+            zeros += region.zeros;
+            text += region.text;
+            high += region.high;
+            ++computed;
+        }
+        if (!computed) {
+            // Not read yet, rows are filled from a nearby region while the
+            // overview is refined.
+            BinEditOverview::Region region;
+            qint64 position;
+            if (!regionAt(y, &region, &position))
+                continue;
+            entropy = region.entropy;
+            zeros = region.zeros;
+            text = region.text;
+            high = region.high;
+            computed = 1;
+        }
+        entropy /= computed;
+        zeros /= computed;
+        text /= computed;
+        high /= computed;
+
+        painter.setPen(QColor::fromHsv(240 - entropy * 240 / 255, 200, 230));
+        painter.drawLine(0, y, half - 1, y);
+
+        // Byte classes as shares of the right half, other control bytes
+        // are left blank.
+        const int classWidth = width() - half - mapWidth;
+        int x = half;
+        const int zeroWidth = zeros * classWidth / 255;
+        const int textWidth = text * classWidth / 255;
+        const int highWidth = high * classWidth / 255;
+        if (zeroWidth > 0)
+            painter.fillRect(x, y, zeroWidth, 1, Qt::gray);
+        x += zeroWidth;
+        if (textWidth > 0)
+            painter.fillRect(x, y, textWidth, 1, QColor(80, 180, 80));
+        x += textWidth;
+        if (highWidth > 0)
+            painter.fillRect(x, y, highWidth, 1, QColor(240, 150, 40));
+
+        if (mapWidth) {
+            const int share = m_overview->dataShare(qint64(y) * size / h, qint64(y + 1) * size / h);
+            if (share > 0) {
+                QColor color = palette().color(QPalette::WindowText);
+                color.setAlpha(55 + share * 200 / 255);
+                painter.fillRect(width() - mapWidth, y, mapWidth, 1, color);
+            }
+        }
+    }
+
+    if (size <= 0 || m_visibleTo <= m_visibleFrom)
+        return;
+    const int top = int(m_visibleFrom * h / size);
+    const int bottom = qMax(top + 2, int(m_visibleTo * h / size));
+    painter.setPen(palette().color(QPalette::Highlight));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(0, top, width() - 1, qMin(bottom, h) - top - 1);
+}
+
+void BinEditOverviewStrip::mousePressEvent(QMouseEvent *e)
+{
+    if (e->button() != Qt::LeftButton || m_overview->size() <= 0)
+        return;
+    emit positionRequested(positionAt(e->pos().y()));
+}
+
+void BinEditOverviewStrip::mouseMoveEvent(QMouseEvent *e)
+{
+    if (!(e->buttons() & Qt::LeftButton) || m_overview->size() <= 0)
+        return;
+    emit positionRequested(positionAt(e->pos().y()));
+}
+
+/*
+    Returns the computed region closest to row \a y in \a region and the
+    file offset of the row in \a position, preferring regions before it.
+*/
+bool BinEditOverviewStrip::regionAt(int y, BinEditOverview::Region *region, qint64 *position) const
+{
+    const int count = m_overview->regionCount();
+    if (!count || height() <= 0)
+        return false;
+
+    *position = positionAt(y);
+    const int index = int(qMin<qint64>(*position / m_overview->regionSize(), count - 1));
+    for (int i = index; i >= 0; --i) {
+        if (m_overview->hasRegion(i)) {
+            *region = m_overview->region(i);
+            return true;
+        }
+    }
+    for (int i = index + 1; i < count; ++i) {
+        if (m_overview->hasRegion(i)) {
+            *region = m_overview->region(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+qint64 BinEditOverviewStrip::positionAt(int y) const
+{
+    const qint64 size = m_overview->size();
+    const int h = qMax(1, height());
+    y = qBound(0, y, h - 1);
+    return qMin(size - 1, qint64(y) * size / h);
+}
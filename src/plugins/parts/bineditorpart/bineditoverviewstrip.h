@@ -0,0 +1,45 @@
+#ifndef BINEDITOVERVIEWSTRIP_H
+#define BINEDITOVERVIEWSTRIP_H
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QWidget>
+#else
+#include <QtGui/QWidget>
+#endif
+
+#include "bineditoverview.h"
+
+class BinEditOverviewStrip : public QWidget
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditOverviewStrip)
+
+public:
+    explicit BinEditOverviewStrip(BinEditOverview *overview, QWidget *parent = 0);
+
+    static const int StripWidth = 16;
+    static const int ExtentMapWidth = 3;
+
+    QSize sizeHint() const;
+
+    void setVisibleRange(qint64 from, qint64 to);
+
+signals:
+    void positionRequested(qint64 position);
+
+protected:
+    bool event(QEvent *e);
+    void paintEvent(QPaintEvent *e);
+    void mousePressEvent(QMouseEvent *e);
+    void mouseMoveEvent(QMouseEvent *e);
+
+private:
+    bool regionAt(int y, BinEditOverview::Region *region, qint64 *position) const;
+    qint64 positionAt(int y) const;
+
+    BinEditOverview *m_overview;
+    qint64 m_visibleFrom;
+    qint64 m_visibleTo;
+};
+
+#endif // BINEDITOVERVIEWSTRIP_H
@@ -0,0 +1,445 @@
+#include "bineditpiecetable.h"
+
+#include "bineditblockprovider.h"
+
+#include <string.h>
+
+static const int DetachChunkSize = 1024 * 1024;
+
+/*!
+    \class BinEditPieceTable
+
+    Describes edited data as a sequence of pieces of the original data, of
+    an append-only buffer holding inserted bytes, and of runs of a single
+    byte value.
+
+    Pieces are kept in a treap ordered by their position in the edited data,
+    every node knows the length of its subtree. Inserting, removing and
+    looking up ranges thus costs O(log n) in the number of pieces, however
+    large the ranges are. Fills don't allocate anything and adjacent pieces
+    that continue each other are joined, so typing doesn't fragment the
+    table.
+*/
+
+struct BinEditPieceTable::Node
+{
+    Piece piece;
+    quint32 priority;
+    qint64 total;
+    Node *left;
+    Node *right;
+};
+
+static inline qint64 totalLength(const BinEditPieceTable::Node *node)
+{
+    return node ? node->total : 0;
+}
+
+static inline void update(BinEditPieceTable::Node *node)
+{
+    node->total = totalLength(node->left) + node->piece.length + totalLength(node->right);
+}
+
+static void deleteTree(BinEditPieceTable::Node *node)
+{
+    if (!node)
+        return;
+    deleteTree(node->left);
+    deleteTree(node->right);
+    delete node;
+}
+
+static BinEditPieceTable::Node *merge(BinEditPieceTable::Node *left, BinEditPieceTable::Node *right)
+{
+    if (!left)
+        return right;
+    if (!right)
+        return left;
+    if (left->priority > right->priority) {
+        left->right = merge(left->right, right);
+        update(left);
+        return left;
+    }
+    right->left = merge(left, right->left);
+    update(right);
+    return right;
+}
+
+// Moves the first position bytes of node to left and the rest to right,
+// cutting a piece in two if needed.
+static void split(BinEditPieceTable::Node *node, qint64 position,
+                  BinEditPieceTable::Node **left, BinEditPieceTable::Node **right)
+{
+    if (!node) {
+        *left = *right = 0;
+        return;
+    }
+
+    const qint64 leftLength = totalLength(node->left);
+    if (position <= leftLength) {
+        split(node->left, position, left, &node->left);
+        update(node);
+        *right = node;
+    } else if (position >= leftLength + node->piece.length) {
+        split(node->right, position - leftLength - node->piece.length, &node->right, right);
+        update(node);
+        *left = node;
+    } else {
+        const qint64 offset = position - leftLength;
+        BinEditPieceTable::Node *tail = new BinEditPieceTable::Node;
+        tail->piece = node->piece;
+        tail->piece.length -= offset;
+        if (tail->piece.source != BinEditPieceTable::Fill)
+            tail->piece.start += offset;
+        // The old priority keeps both halves valid treaps.
+        tail->priority = node->priority;
+        tail->left = 0;
+        tail->right = node->right;
+        node->piece.length = offset;
+        node->right = 0;
+        update(tail);
+        update(node);
+        *left = node;
+        *right = tail;
+    }
+}
+
+static BinEditPieceTable::Node *firstNode(BinEditPieceTable::Node *node)
+{
+    while (node->left)
+        node = node->left;
+    return node;
+}
+
+static BinEditPieceTable::Node *lastNode(BinEditPieceTable::Node *node)
+{
+    while (node->right)
+        node = node->right;
+    return node;
+}
+
+static void growLast(BinEditPieceTable::Node *node, qint64 length)
+{
+    if (node->right)
+        growLast(node->right, length);
+    else
+        node->piece.length += length;
+    node->total += length;
+}
+
+static bool continues(const BinEditPieceTable::Piece &first, const BinEditPieceTable::Piece &second)
+{
+    if (first.source != second.source)
+        return false;
+    if (first.source == BinEditPieceTable::Fill)
+        return first.start == second.start;
+    return first.start + first.length == second.start;
+}
+
+static void collect(const BinEditPieceTable::Node *node, qint64 offset, qint64 from, qint64 to,
+                    BinEditPieceTable::PieceList *pieces)
+{
+    if (!node || offset >= to || offset + node->total <= from)
+        return;
+
+    collect(node->left, offset, from, to, pieces);
+
+    const qint64 start = offset + totalLength(node->left);
+    const qint64 end = start + node->piece.length;
+    if (start < to && end > from) {
+        BinEditPieceTable::Piece piece = node->piece;
+        const qint64 skip = qMax(from, start) - start;
+        piece.position = start + skip;
+        piece.length = qMin(end, to) - piece.position;
+        if (piece.source != BinEditPieceTable::Fill)
+            piece.start += skip;
+        pieces->append(piece);
+    }
+
+    collect(node->right, end, from, to, pieces);
+}
+
+BinEditPieceTable::BinEditPieceTable() :
+    m_root(0),
+    m_originalSize(0),
+    m_added(new BinEditAddBuffer),
+    m_seed(0x9e3779b9u)
+{
+}
+
+BinEditPieceTable::~BinEditPieceTable()
+{
+    deleteTree(m_root);
+}
+
+/*!
+    Discards all edits, the data is \a size bytes of the original again.
+*/
+void BinEditPieceTable::reset(qint64 size)
+{
+    m_added = QSharedPointer<BinEditAddBuffer>(new BinEditAddBuffer);
+    rebase(size);
+}
+
+/*!
+    Makes the data \a size bytes of the original again but keeps the add
+    buffer, so pieces referring to it stay valid. Used once edits have been
+    written to the original.
+*/
+void BinEditPieceTable::rebase(qint64 size)
+{
+    deleteTree(m_root);
+    m_root = 0;
+    m_originalSize = qMax<qint64>(0, size);
+    if (m_originalSize) {
+        Piece piece = { Original, 0, 0, m_originalSize };
+        m_root = createNode(piece);
+    }
+}
+
+qint64 BinEditPieceTable::size() const
+{
+    return totalLength(m_root);
+}
+
+/*!
+    Returns true if the data is the unchanged original.
+*/
+bool BinEditPieceTable::isIdentity() const
+{
+    if (!m_root)
+        return m_originalSize == 0;
+    return !m_root->left && !m_root->right
+            && m_root->piece.source == Original
+            && m_root->piece.start == 0
+            && m_root->piece.length == m_originalSize;
+}
+
+/*!
+    Returns true if any original byte is no longer at its original position,
+    which means the data can't be written back by patching the original.
+*/
+bool BinEditPieceTable::hasMovedData() const
+{
+    foreach (const Piece &piece, pieces()) {
+        if (piece.source == Original && piece.start != piece.position)
+            return true;
+    }
+    return false;
+}
+
+/*!
+    Inserts \a data at \a position. Returns false if the add buffer couldn't
+    store it.
+*/
+bool BinEditPieceTable::insert(qint64 position, const QByteArray &data)
+{
+    if (data.isEmpty())
+        return true;
+    const qint64 start = m_added->append(data);
+    if (start < 0)
+        return false;
+    Piece piece = { Added, position, start, data.size() };
+    insertPieces(position, PieceList() << piece);
+    return true;
+}
+
+void BinEditPieceTable::insertFill(qint64 position, qint64 length, char value)
+{
+    if (length <= 0)
+        return;
+    Piece piece = { Fill, position, uchar(value), length };
+    insertPieces(position, PieceList() << piece);
+}
+
+/*!
+    Inserts \a pieces, as returned by remove(), at \a position.
+*/
+void BinEditPieceTable::insertPieces(qint64 position, const PieceList &pieces)
+{
+    Node *middle = 0;
+    foreach (const Piece &piece, pieces) {
+        if (piece.length > 0)
+            middle = join(middle, createNode(piece));
+    }
+    if (!middle)
+        return;
+
+    Node *left;
+    Node *right;
+    split(m_root, qBound<qint64>(0, position, size()), &left, &right);
+    m_root = join(join(left, middle), right);
+}
+
+/*!
+    Removes \a length bytes at \a position and returns the pieces they were
+    made of.
+*/
+BinEditPieceTable::PieceList BinEditPieceTable::remove(qint64 position, qint64 length)
+{
+    PieceList result;
+    if (position < 0 || length <= 0 || position >= size())
+        return result;
+
+    Node *left;
+    Node *middle;
+    Node *right;
+    split(m_root, position, &left, &middle);
+    split(middle, length, &middle, &right);
+    collect(middle, position, position, position + length, &result);
+    deleteTree(middle);
+    m_root = join(left, right);
+    return result;
+}
+
+/*!
+    Returns the pieces covering \a length bytes at \a from, cut to that
+    range.
+*/
+BinEditPieceTable::PieceList BinEditPieceTable::pieces(qint64 from, qint64 length) const
+{
+    PieceList result;
+    if (length > 0)
+        collect(m_root, 0, from, from + length, &result);
+    return result;
+}
+
+/*!
+    Returns \a length bytes at \a from composed of \a pieces, original data
+    is read from \a provider at \a baseAddress. This only uses its arguments,
+    so it can be called on a snapshot from any thread.
+*/
+QByteArray BinEditPieceTable::read(const PieceList &pieces, const BinEditAddBuffer *added,
+                                   const BinEditBlockProvider *provider, quint64 baseAddress,
+                                   qint64 from, int length)
+{
+    QByteArray data(length, '\0');
+    char *out = data.data();
+    const qint64 to = from + length;
+
+    // Pieces are sorted, find the first one ending after from.
+    int low = 0;
+    int high = pieces.size();
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        const Piece &piece = pieces.at(middle);
+        if (piece.position + piece.length <= from)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    for (int i = low; i < pieces.size() && pieces.at(i).position < to; ++i) {
+        const Piece &piece = pieces.at(i);
+        const qint64 begin = qMax(from, piece.position);
+        const qint64 end = qMin(to, piece.position + piece.length);
+        const qint64 offset = begin - piece.position;
+        const int count = int(end - begin);
+        char *target = out + (begin - from);
+        switch (piece.source) {
+        case Original: {
+            const QByteArray chunk = provider->read(baseAddress + piece.start + offset, count);
+            ::memcpy(target, chunk.constData(), size_t(chunk.size()));
+            break;
+        }
+        case Added:
+            added->copy(target, piece.start + offset, count);
+            break;
+        case Fill:
+            ::memset(target, int(piece.start), size_t(count));
+            break;
+        }
+    }
+    return data;
+}
+
+/*!
+    Returns true if the \a length bytes at \a from composed of \a pieces
+    are known to be zeros without reading them: they come from holes of a
+    sparse file or from fills with zero.
+*/
+bool BinEditPieceTable::isHole(const PieceList &pieces, const BinEditBlockProvider *provider,
+                               quint64 baseAddress, qint64 from, qint64 length)
+{
+    const qint64 to = from + length;
+    foreach (const Piece &piece, pieces) {
+        if (piece.position >= to)
+            break;
+        if (piece.position + piece.length <= from)
+            continue;
+        const qint64 begin = qMax(from, piece.position);
+        const qint64 end = qMin(to, piece.position + piece.length);
+        switch (piece.source) {
+        case Original:
+            if (!provider->isHole(baseAddress + piece.start + begin - piece.position, end - begin))
+                return false;
+            break;
+        case Added:
+            return false;
+        case Fill:
+            if (piece.start != 0)
+                return false;
+            break;
+        }
+    }
+    return length > 0;
+}
+
+/*!
+    Copies original data of \a pieces from \a provider at \a baseAddress to
+    \a added and makes them refer to the copy, so they stay valid when the
+    original changes. Returns false if the data couldn't be stored.
+*/
+bool BinEditPieceTable::detach(PieceList *pieces, const BinEditBlockProvider *provider,
+                               quint64 baseAddress, BinEditAddBuffer *added)
+{
+    for (int i = 0; i < pieces->size(); ++i) {
+        Piece &piece = (*pieces)[i];
+        if (piece.source != Original)
+            continue;
+
+        // Appends are contiguous, the copy is a single piece.
+        qint64 start = -1;
+        for (qint64 offset = 0; offset < piece.length; offset += DetachChunkSize) {
+            const int length = int(qMin<qint64>(DetachChunkSize, piece.length - offset));
+            const qint64 at = added->append(provider->read(baseAddress + piece.start + offset, length));
+            if (at < 0)
+                return false;
+            if (start < 0)
+                start = at;
+        }
+        piece.source = Added;
+        piece.start = start;
+    }
+    return true;
+}
+
+BinEditPieceTable::Node *BinEditPieceTable::createNode(const Piece &piece)
+{
+    // xorshift, priorities only need to be well spread.
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+
+    Node *node = new Node;
+    node->piece = piece;
+    node->priority = m_seed;
+    node->total = piece.length;
+    node->left = 0;
+    node->right = 0;
+    return node;
+}
+
+// Merges two trees, extending the last piece of left if the first piece of
+// right continues it.
+BinEditPieceTable::Node *BinEditPieceTable::join(Node *left, Node *right)
+{
+    if (left && right && continues(lastNode(left)->piece, firstNode(right)->piece)) {
+        const qint64 length = firstNode(right)->piece.length;
+        Node *head;
+        split(right, length, &head, &right);
+        deleteTree(head);
+        growLast(left, length);
+    }
+    return merge(left, right);
+}
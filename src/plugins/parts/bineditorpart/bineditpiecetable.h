@@ -0,0 +1,71 @@
+#ifndef BINEDITPIECETABLE_H
+#define BINEDITPIECETABLE_H
+
+#include "bineditaddbuffer.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVector>
+
+class BinEditBlockProvider;
+
+class BinEditPieceTable
+{
+    Q_DISABLE_COPY(BinEditPieceTable)
+
+public:
+    enum Source {
+        Original,
+        Added,
+        Fill
+    };
+
+    struct Piece {
+        Source source;
+        qint64 position; // In the edited data, set by pieces() and remove().
+        qint64 start;    // In the source, the byte value for Fill pieces.
+        qint64 length;
+    };
+    typedef QVector<Piece> PieceList;
+
+    BinEditPieceTable();
+    ~BinEditPieceTable();
+
+    void reset(qint64 size);
+    void rebase(qint64 size);
+
+    qint64 size() const;
+    qint64 originalSize() const { return m_originalSize; }
+    bool isIdentity() const;
+    bool hasMovedData() const;
+
+    bool insert(qint64 position, const QByteArray &data);
+    void insertFill(qint64 position, qint64 length, char value);
+    void insertPieces(qint64 position, const PieceList &pieces);
+    PieceList remove(qint64 position, qint64 length);
+
+    PieceList pieces(qint64 from, qint64 length) const;
+    PieceList pieces() const { return pieces(0, size()); }
+    QSharedPointer<BinEditAddBuffer> addBuffer() const { return m_added; }
+
+    static QByteArray read(const PieceList &pieces, const BinEditAddBuffer *added,
+                           const BinEditBlockProvider *provider, quint64 baseAddress,
+                           qint64 from, int length);
+    static bool isHole(const PieceList &pieces, const BinEditBlockProvider *provider,
+                       quint64 baseAddress, qint64 from, qint64 length);
+    static bool detach(PieceList *pieces, const BinEditBlockProvider *provider,
+                       quint64 baseAddress, BinEditAddBuffer *added);
+
+    struct Node;
+
+private:
+    Node *createNode(const Piece &piece);
+    Node *join(Node *left, Node *right);
+
+    Node *m_root;
+    qint64 m_originalSize;
+    QSharedPointer<BinEditAddBuffer> m_added;
+    quint32 m_seed;
+};
+
+#endif // BINEDITPIECETABLE_H
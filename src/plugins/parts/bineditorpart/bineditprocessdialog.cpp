@@ -0,0 +1,167 @@
+#include "bineditprocessdialog.h"
+
+#include <QtCore/QCoreApplication>
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QDialogButtonBox>
+#include <QtWidgets/QFormLayout>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QPushButton>
+#include <QtWidgets/QSpinBox>
+#include <QtWidgets/QTreeWidget>
+#include <QtWidgets/QVBoxLayout>
+#else
+#include <QtGui/QDialogButtonBox>
+#include <QtGui/QFormLayout>
+#include <QtGui/QHeaderView>
+#include <QtGui/QLabel>
+#include <QtGui/QPushButton>
+#include <QtGui/QSpinBox>
+#include <QtGui/QTreeWidget>
+#include <QtGui/QVBoxLayout>
+#endif
+
+#include "bineditprocessmemory.h"
+
+static const int addressRole = Qt::UserRole;
+
+/*!
+    \class BinEditProcessDialog
+
+    Asks for a local process and one of its mappings to show in a BinEdit
+    memory view, and how often the view is refreshed.
+*/
+
+BinEditProcessDialog::BinEditProcessDialog(QWidget *parent) :
+    QDialog(parent)
+{
+    setupUi();
+    retranslateUi();
+    loadMappings();
+}
+
+qint64 BinEditProcessDialog::pid() const
+{
+    return m_pidBox->value();
+}
+
+/*!
+    Returns the start of the selected mapping.
+*/
+quint64 BinEditProcessDialog::address() const
+{
+    const QTreeWidgetItem *item = m_mappingView->currentItem();
+    return item ? item->data(0, addressRole).toULongLong() : 0;
+}
+
+/*!
+    Returns the refresh interval in milliseconds, 0 if the view is not
+    refreshed.
+*/
+int BinEditProcessDialog::refreshInterval() const
+{
+    return m_refreshBox->value();
+}
+
+void BinEditProcessDialog::setRefreshInterval(int msec)
+{
+    m_refreshBox->setValue(msec);
+}
+
+void BinEditProcessDialog::loadMappings()
+{
+    m_mappingView->clear();
+
+    QString errorString;
+    const BinEditProcessMemory::MappingList mappings =
+            BinEditProcessMemory::mappings(m_pidBox->value(), &errorString);
+    m_errorLabel->setText(errorString);
+    m_errorLabel->setVisible(!errorString.isEmpty());
+
+    foreach (const BinEditProcessMemory::Mapping &mapping, mappings) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(m_mappingView);
+        item->setText(0, QString::fromLatin1("%1-%2")
+                      .arg(mapping.start, 12, 16, QLatin1Char('0'))
+                      .arg(mapping.end, 12, 16, QLatin1Char('0')));
+        item->setText(1, QString::number(mapping.size()));
+        item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        item->setText(2, mapping.permissions);
+        item->setText(3, mapping.path);
+        item->setData(0, addressRole, mapping.start);
+        if (!mapping.isReadable())
+            item->setFlags(item->flags() & ~Qt::ItemIsEnabled);
+    }
+    updateButtons();
+}
+
+void BinEditProcessDialog::updateButtons()
+{
+    const QTreeWidgetItem *item = m_mappingView->currentItem();
+    m_buttonBox->button(QDialogButtonBox::Ok)->setEnabled(item && (item->flags() & Qt::ItemIsEnabled));
+}
+
+void BinEditProcessDialog::setupUi()
+{
+    m_pidBox = new QSpinBox(this);
+    m_pidBox->setRange(1, 0x3fffffff);
+    m_pidBox->setKeyboardTracking(false);
+    m_pidBox->setValue(int(QCoreApplication::applicationPid()));
+    connect(m_pidBox, SIGNAL(valueChanged(int)), SLOT(loadMappings()));
+
+    m_refreshBox = new QSpinBox(this);
+    m_refreshBox->setRange(0, 60 * 1000);
+    m_refreshBox->setSingleStep(100);
+
+    m_errorLabel = new QLabel(this);
+    m_errorLabel->setWordWrap(true);
+    m_errorLabel->hide();
+
+    m_mappingView = new QTreeWidget(this);
+    m_mappingView->setColumnCount(4);
+    m_mappingView->setRootIsDecorated(false);
+    m_mappingView->setUniformRowHeights(true);
+    m_mappingView->setAllColumnsShowFocus(true);
+#if QT_VERSION >= 0x050000
+    m_mappingView->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+#else
+    m_mappingView->header()->setResizeMode(QHeaderView::ResizeToContents);
+#endif
+    m_mappingView->header()->setStretchLastSection(true);
+    connect(m_mappingView, SIGNAL(currentItemChanged(QTreeWidgetItem*,QTreeWidgetItem*)),
+            SLOT(updateButtons()));
+    connect(m_mappingView, SIGNAL(itemActivated(QTreeWidgetItem*,int)), SLOT(accept()));
+
+    m_buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, Qt::Horizontal, this);
+    connect(m_buttonBox, SIGNAL(accepted()), SLOT(accept()));
+    connect(m_buttonBox, SIGNAL(rejected()), SLOT(reject()));
+
+    m_pidLabel = new QLabel(this);
+    m_pidLabel->setBuddy(m_pidBox);
+    m_refreshLabel = new QLabel(this);
+    m_refreshLabel->setBuddy(m_refreshBox);
+
+    QFormLayout *formLayout = new QFormLayout;
+    formLayout->addRow(m_pidLabel, m_pidBox);
+    formLayout->addRow(m_refreshLabel, m_refreshBox);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(formLayout);
+    layout->addWidget(m_errorLabel);
+    layout->addWidget(m_mappingView);
+    layout->addWidget(m_buttonBox);
+
+    resize(640, 480);
+}
+
+void BinEditProcessDialog::retranslateUi()
+{
+    setWindowTitle(tr("Attach to Process"));
+    m_pidLabel->setText(tr("&Process ID:"));
+    m_refreshLabel->setText(tr("&Refresh:"));
+
+    m_refreshBox->setSuffix(tr(" ms"));
+    m_refreshBox->setSpecialValueText(tr("Off"));
+    m_mappingView->setHeaderLabels(QStringList() << tr("Address") << tr("Size")
+                                   << tr("Permissions") << tr("Path"));
+}
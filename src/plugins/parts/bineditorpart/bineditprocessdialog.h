@@ -0,0 +1,47 @@
+#ifndef BINEDITPROCESSDIALOG_H
+#define BINEDITPROCESSDIALOG_H
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QDialog>
+#else
+#include <QtGui/QDialog>
+#endif
+
+class QDialogButtonBox;
+class QLabel;
+class QSpinBox;
+class QTreeWidget;
+
+class BinEditProcessDialog : public QDialog
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditProcessDialog)
+
+public:
+    explicit BinEditProcessDialog(QWidget *parent = 0);
+
+    qint64 pid() const;
+    quint64 address() const;
+
+    int refreshInterval() const;
+    void setRefreshInterval(int msec);
+
+private slots:
+    void loadMappings();
+    void updateButtons();
+
+private:
+    void setupUi();
+    void retranslateUi();
+
+private:
+    QLabel *m_pidLabel;
+    QSpinBox *m_pidBox;
+    QLabel *m_refreshLabel;
+    QSpinBox *m_refreshBox;
+    QLabel *m_errorLabel;
+    QTreeWidget *m_mappingView;
+    QDialogButtonBox *m_buttonBox;
+};
+
+#endif // BINEDITPROCESSDIALOG_H
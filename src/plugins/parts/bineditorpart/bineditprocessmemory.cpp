@@ -0,0 +1,183 @@
+#include "bineditprocessmemory.h"
+
+#include <QtCore/QFile>
+
+#include <string.h>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+static const qint64 pageSize = 4096;
+
+/*!
+    \class BinEditProcessMemory
+
+    Read-only device over the address space of a local process, for showing
+    it in BinEdit as a memory view. Positions are virtual addresses, the
+    size is the end of the highest mapping.
+
+    Pages are read on demand with process_vm_readv(), or from
+    /proc/<pid>/mem where that system call is not available. Addresses that
+    are not mapped or not readable read as zeroes, so every read returns as
+    many bytes as were asked for.
+
+    The mappings are read from /proc/<pid>/maps when the device is opened.
+    Only supported on Linux, open() fails elsewhere.
+*/
+
+BinEditProcessMemory::BinEditProcessMemory(qint64 pid, QObject *parent) :
+    QIODevice(parent),
+    m_pid(pid),
+    m_memFd(-1),
+    m_size(0)
+{
+}
+
+BinEditProcessMemory::~BinEditProcessMemory()
+{
+    close();
+}
+
+/*!
+    Returns the mappings of process \a pid in ascending order. Returns an
+    empty list and sets \a errorString if they cannot be read.
+*/
+BinEditProcessMemory::MappingList BinEditProcessMemory::mappings(qint64 pid, QString *errorString)
+{
+    MappingList result;
+    QFile file(QString::fromLatin1("/proc/%1/maps").arg(pid));
+    // Files in /proc report a size of 0, they have to be read line by line.
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return result;
+    }
+
+    while (!file.atEnd()) {
+        // start-end perms offset dev inode [path]
+        const QByteArray line = file.readLine().trimmed();
+        const int dash = line.indexOf('-');
+        const int space = line.indexOf(' ');
+        if (dash <= 0 || space <= dash)
+            continue;
+
+        bool startOk = false;
+        bool endOk = false;
+        Mapping mapping;
+        mapping.start = line.left(dash).toULongLong(&startOk, 16);
+        mapping.end = line.mid(dash + 1, space - dash - 1).toULongLong(&endOk, 16);
+        // The vsyscall page lies above the range of qint64 positions.
+        if (!startOk || !endOk || mapping.end <= mapping.start
+                || mapping.end > quint64(Q_INT64_C(0x7fffffffffffffff)))
+            continue;
+
+        const QList<QByteArray> fields = line.mid(space + 1).simplified().split(' ');
+        mapping.permissions = QString::fromLatin1(fields.value(0));
+        if (fields.size() > 4) {
+            const int pathStart = line.indexOf(fields.at(4), space + 1);
+            mapping.path = QString::fromLocal8Bit(line.mid(pathStart));
+        }
+        result.append(mapping);
+    }
+    return result;
+}
+
+/*!
+    Returns the index of the mapping containing \a address, or -1.
+*/
+int BinEditProcessMemory::findMapping(quint64 address) const
+{
+    for (int i = 0; i < m_mappings.size(); ++i) {
+        if (address >= m_mappings.at(i).start && address < m_mappings.at(i).end)
+            return i;
+    }
+    return -1;
+}
+
+bool BinEditProcessMemory::open(OpenMode mode)
+{
+    if (mode & WriteOnly) {
+        setErrorString(tr("Process memory can only be opened for reading."));
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    QString errorString;
+    m_mappings = mappings(m_pid, &errorString);
+    if (m_mappings.isEmpty()) {
+        setErrorString(errorString.isEmpty() ? tr("The process has no mappings.") : errorString);
+        return false;
+    }
+    m_size = qint64(m_mappings.last().end);
+
+    // Only needed where process_vm_readv() is missing or not permitted.
+    const QByteArray memPath = QString::fromLatin1("/proc/%1/mem").arg(m_pid).toLocal8Bit();
+    m_memFd = ::open(memPath.constData(), O_RDONLY);
+
+    // Reads are cheap system calls, buffering would only read past the
+    // requested range.
+    return QIODevice::open(mode | Unbuffered);
+#else
+    setErrorString(tr("Reading process memory is not supported on this platform."));
+    return false;
+#endif
+}
+
+void BinEditProcessMemory::close()
+{
+#ifdef Q_OS_LINUX
+    if (m_memFd >= 0)
+        ::close(m_memFd);
+#endif
+    m_memFd = -1;
+    m_size = 0;
+    m_mappings.clear();
+    QIODevice::close();
+}
+
+qint64 BinEditProcessMemory::readData(char *data, qint64 maxSize)
+{
+    const qint64 from = pos();
+    const qint64 length = qBound<qint64>(0, m_size - from, maxSize);
+
+#ifdef Q_OS_LINUX
+    qint64 done = 0;
+    while (done < length) {
+        const quint64 address = quint64(from + done);
+        const qint64 remaining = length - done;
+
+        struct iovec local;
+        local.iov_base = data + done;
+        local.iov_len = size_t(remaining);
+        struct iovec remote;
+        remote.iov_base = reinterpret_cast<void *>(address);
+        remote.iov_len = size_t(remaining);
+
+        ssize_t result = ::process_vm_readv(pid_t(m_pid), &local, 1, &remote, 1, 0);
+        if (result < 0 && (errno == ENOSYS || errno == EPERM) && m_memFd >= 0)
+            result = ::pread(m_memFd, data + done, size_t(remaining), off_t(address));
+
+        if (result > 0) {
+            done += result;
+            continue;
+        }
+
+        // Unmapped or unreadable, skip to the next page.
+        const qint64 skip = qMin(remaining, pageSize - qint64(address % pageSize));
+        memset(data + done, 0, size_t(skip));
+        done += skip;
+    }
+#else
+    memset(data, 0, size_t(length));
+#endif
+    return length;
+}
+
+qint64 BinEditProcessMemory::writeData(const char *, qint64)
+{
+    return -1;
+}
@@ -0,0 +1,50 @@
+#ifndef BINEDITPROCESSMEMORY_H
+#define BINEDITPROCESSMEMORY_H
+
+#include <QtCore/QIODevice>
+#include <QtCore/QList>
+
+class BinEditProcessMemory : public QIODevice
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditProcessMemory)
+
+public:
+    struct Mapping
+    {
+        quint64 start;
+        quint64 end;
+        QString permissions;
+        QString path;
+
+        qint64 size() const { return qint64(end - start); }
+        bool isReadable() const { return permissions.startsWith(QLatin1Char('r')); }
+    };
+    typedef QList<Mapping> MappingList;
+
+    explicit BinEditProcessMemory(qint64 pid, QObject *parent = 0);
+    ~BinEditProcessMemory();
+
+    static MappingList mappings(qint64 pid, QString *errorString = 0);
+
+    qint64 pid() const { return m_pid; }
+    MappingList mappings() const { return m_mappings; }
+    int findMapping(quint64 address) const;
+
+    bool open(OpenMode mode);
+    void close();
+    bool isSequential() const { return false; }
+    qint64 size() const { return m_size; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    qint64 m_pid;
+    int m_memFd;
+    qint64 m_size;
+    MappingList m_mappings;
+};
+
+#endif // BINEDITPROCESSMEMORY_H
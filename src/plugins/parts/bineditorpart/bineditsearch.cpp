@@ -0,0 +1,243 @@
+#include "bineditsearch.h"
+
+#include "bineditblockprovider.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QRunnable>
+
+class BinEditSearchJob
+{
+public:
+    BinEditBlockProvider *provider;
+    QVector<BinEditMatcher> matchers;
+    quint64 baseAddress;
+    qint64 size;
+    BinEditPieceTable::PieceList pieces;
+    QSharedPointer<BinEditAddBuffer> addBuffer;
+    bool skipHoles;
+    int generation;
+    QAtomicInt stopped;
+    QAtomicInt matchCount;
+    // Matches of each matcher per chunk, each written by the task of its
+    // chunk only.
+    QVector<QVector<QList<qint64> > > results;
+
+    bool isStopped() const
+    {
+#if QT_VERSION >= 0x050000
+        return stopped.load();
+#else
+        return stopped;
+#endif
+    }
+};
+
+class BinEditSearchTask : public QRunnable
+{
+public:
+    BinEditSearchTask(const QSharedPointer<BinEditSearchJob> &job, QObject *receiver, int chunk) :
+        m_job(job),
+        m_receiver(receiver),
+        m_chunk(chunk),
+        m_start(qint64(chunk) * BinEditSearch::ChunkSize)
+    {
+    }
+
+    void run();
+
+private:
+    qint64 readEnd(qint64 end) const;
+    QByteArray chunkData(qint64 end) const;
+    void findAll(const QByteArray &data, const BinEditMatcher &matcher, qint64 end,
+                 QList<qint64> *matches) const;
+
+    QSharedPointer<BinEditSearchJob> m_job;
+    QObject *m_receiver;
+    int m_chunk;
+    qint64 m_start;
+};
+
+void BinEditSearchTask::run()
+{
+    QVector<QList<qint64> > matches(m_job->matchers.size());
+
+    if (!m_job->isStopped()) {
+        const qint64 end = qMin<qint64>(m_start + BinEditSearch::ChunkSize, m_job->size);
+        // Every match starting in a chunk of zeros would consist of zeros.
+        const bool hole = m_job->skipHoles
+                && BinEditPieceTable::isHole(m_job->pieces, m_job->provider, m_job->baseAddress,
+                                             m_start, readEnd(end) - m_start);
+        if (!hole) {
+            const QByteArray data = chunkData(end);
+            for (int i = 0; i < m_job->matchers.size(); ++i)
+                findAll(data, m_job->matchers.at(i), end, &matches[i]);
+        }
+    }
+    m_job->results[m_chunk] = matches;
+
+    // Always report back, the receiver counts finished chunks for progress.
+    QMetaObject::invokeMethod(m_receiver, "handleChunkDone", Qt::QueuedConnection,
+                              Q_ARG(int, m_job->generation), Q_ARG(int, m_chunk));
+}
+
+/*!
+    Returns data of the chunk plus enough trailing bytes to find matches
+    starting before \a end, composed from the pieces of the edited data.
+*/
+QByteArray BinEditSearchTask::chunkData(qint64 end) const
+{
+    return BinEditPieceTable::read(m_job->pieces, m_job->addBuffer.data(), m_job->provider,
+                                   m_job->baseAddress, m_start, int(readEnd(end) - m_start));
+}
+
+// Matches starting before end may extend past it by the longest pattern.
+qint64 BinEditSearchTask::readEnd(qint64 end) const
+{
+    int overlap = 0;
+    foreach (const BinEditMatcher &matcher, m_job->matchers)
+        overlap = qMax(overlap, matcher.size() - 1);
+    return qMin<qint64>(end + overlap, m_job->size);
+}
+
+void BinEditSearchTask::findAll(const QByteArray &data, const BinEditMatcher &matcher, qint64 end,
+                                QList<qint64> *matches) const
+{
+    const int limit = int(end - m_start);
+    int pos = matcher.indexIn(data, 0);
+    while (pos >= 0 && pos < limit && !m_job->isStopped()) {
+        if (m_job->matchCount.fetchAndAddRelaxed(1) >= BinEditSearch::MaxMatches) {
+            m_job->stopped.fetchAndStoreRelaxed(1);
+            return;
+        }
+        matches->append(m_start + pos);
+        pos = matcher.indexIn(data, pos + 1);
+    }
+}
+
+/*!
+    \class BinEditSearch
+
+    Searches the whole file for patterns on a thread pool.
+
+    The data is split into chunks of ChunkSize bytes that are searched in
+    parallel straight from the BinEditBlockProvider, so a search is bound by
+    disk bandwidth rather than by the event loop. Unsaved edits are applied
+    from a snapshot of the piece table. Matches are streamed back
+    chunk by chunk and matcher by matcher through matchesFound(), positions
+    are relative to the base address passed to start(). The search stops
+    after MaxMatches hits. Chunks that lie in holes of a sparse file are
+    skipped without reading when none of the patterns matches zeros.
+
+    cancel() must be called before the provider is closed or remapped.
+*/
+
+BinEditSearch::BinEditSearch(BinEditBlockProvider *provider, QObject *parent) :
+    QObject(parent),
+    m_provider(provider),
+    m_generation(0),
+    m_chunkCount(0),
+    m_finishedChunks(0),
+    m_matchCount(0),
+    m_running(false)
+{
+}
+
+BinEditSearch::~BinEditSearch()
+{
+    cancel();
+}
+
+bool BinEditSearch::isLimitReached() const
+{
+    return m_matchCount >= MaxMatches;
+}
+
+/*!
+    Starts searching the data described by \a pieces and \a addBuffer, with
+    original data at \a baseAddress, for all of \a matchers. A search that
+    is already running is canceled.
+*/
+void BinEditSearch::start(const QVector<BinEditMatcher> &matchers, quint64 baseAddress,
+                          const BinEditPieceTable::PieceList &pieces,
+                          const QSharedPointer<BinEditAddBuffer> &addBuffer)
+{
+    cancel();
+
+    const qint64 size = pieces.isEmpty() ? 0 : pieces.last().position + pieces.last().length;
+
+    QVector<BinEditMatcher> nonEmpty;
+    bool matchesZeros = false;
+    foreach (const BinEditMatcher &matcher, matchers) {
+        if (matcher.isEmpty())
+            continue;
+        nonEmpty.append(matcher);
+        matchesZeros = matchesZeros || matcher.indexIn(QByteArray(matcher.size(), '\0')) == 0;
+    }
+    if (nonEmpty.isEmpty() || size <= 0 || !m_provider->isOpen())
+        return;
+
+    QSharedPointer<BinEditSearchJob> job(new BinEditSearchJob);
+    job->provider = m_provider;
+    job->matchers = nonEmpty;
+    job->baseAddress = baseAddress;
+    job->size = size;
+    job->pieces = pieces;
+    job->addBuffer = addBuffer;
+    job->skipHoles = !matchesZeros && m_provider->isSparse();
+    job->generation = m_generation;
+    m_chunkCount = int((size + ChunkSize - 1) / ChunkSize);
+    job->results.resize(m_chunkCount);
+    m_job = job;
+
+    m_finishedChunks = 0;
+    m_matchCount = 0;
+    m_running = true;
+    emit started();
+    emit progressChanged(0, m_chunkCount);
+
+    for (int chunk = 0; chunk < m_chunkCount; ++chunk)
+        m_pool.start(new BinEditSearchTask(job, this, chunk));
+}
+
+/*!
+    Stops the running search and waits for chunks being searched to finish.
+    Results still queued for delivery are dropped.
+*/
+void BinEditSearch::cancel()
+{
+    if (m_job) {
+        m_job->stopped.fetchAndStoreRelaxed(1);
+        m_pool.waitForDone();
+        m_job.clear();
+    }
+
+    ++m_generation;
+    if (m_running) {
+        m_running = false;
+        emit finished();
+    }
+}
+
+void BinEditSearch::handleChunkDone(int generation, int chunk)
+{
+    if (generation != m_generation || !m_job)
+        return;
+
+    QVector<QList<qint64> > matches;
+    matches.swap(m_job->results[chunk]);
+    for (int i = 0; i < matches.size(); ++i) {
+        if (matches.at(i).isEmpty())
+            continue;
+        m_matchCount += matches.at(i).size();
+        emit matchesFound(matches.at(i), m_job->matchers.at(i).size());
+    }
+
+    ++m_finishedChunks;
+    emit progressChanged(m_finishedChunks, m_chunkCount);
+
+    if (m_finishedChunks == m_chunkCount) {
+        m_job.clear();
+        m_running = false;
+        emit finished();
+    }
+}
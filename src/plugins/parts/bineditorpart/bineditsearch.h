@@ -0,0 +1,60 @@
+#ifndef BINEDITSEARCH_H
+#define BINEDITSEARCH_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+#include "bineditmatcher.h"
+#include "bineditpiecetable.h"
+
+class BinEditBlockProvider;
+class BinEditSearchJob;
+
+class BinEditSearch : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditSearch)
+
+public:
+    explicit BinEditSearch(BinEditBlockProvider *provider, QObject *parent = 0);
+    ~BinEditSearch();
+
+    static const int ChunkSize = 4 * 1024 * 1024;
+    static const int MaxMatches = 100000;
+
+    bool isRunning() const { return m_running; }
+    bool isLimitReached() const;
+    int matchCount() const { return m_matchCount; }
+
+    void start(const QVector<BinEditMatcher> &matchers, quint64 baseAddress,
+               const BinEditPieceTable::PieceList &pieces,
+               const QSharedPointer<BinEditAddBuffer> &addBuffer);
+
+public slots:
+    void cancel();
+
+signals:
+    void started();
+    void matchesFound(const QList<qint64> &positions, int length);
+    void progressChanged(int value, int maximum);
+    void finished();
+
+private slots:
+    void handleChunkDone(int generation, int chunk);
+
+private:
+    BinEditBlockProvider *m_provider;
+    QThreadPool m_pool;
+    QSharedPointer<BinEditSearchJob> m_job;
+    int m_generation;
+    int m_chunkCount;
+    int m_finishedChunks;
+    int m_matchCount;
+    bool m_running;
+};
+
+#endif // BINEDITSEARCH_H
@@ -0,0 +1,158 @@
+#include "bineditsearchmodel.h"
+
+#include "binedit.h"
+
+#include <QtCore/QtAlgorithms>
+
+/*!
+    \class BinEditSearchModel
+
+    Lists matches of a BinEditSearch sorted by position.
+
+    Only positions are stored, the bytes around a match are read from the
+    editor when a row is displayed, so a search with many thousand matches
+    stays cheap.
+*/
+
+BinEditSearchModel::BinEditSearchModel(BinEdit *editor, QObject *parent) :
+    QAbstractTableModel(parent),
+    m_editor(editor)
+{
+}
+
+int BinEditSearchModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_matches.size();
+}
+
+int BinEditSearchModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant BinEditSearchModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_matches.size())
+        return QVariant();
+
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole)
+        return QVariant();
+
+    const Match &match = m_matches.at(index.row());
+    if (index.column() == OffsetColumn)
+        return m_editor->addressString(m_editor->baseAddress() + match.position);
+
+    const qint64 from = qMax<qint64>(0, match.position - ContextSize);
+    const QByteArray data = m_editor->contents(from, int(match.position - from) + match.length + ContextSize);
+
+    QString result;
+    if (index.column() == HexColumn) {
+        const char *hex = "0123456789abcdef";
+        for (int i = 0; i < data.size(); ++i) {
+            if (i)
+                result += QLatin1Char(' ');
+            const uchar c = uchar(data.at(i));
+            result += QLatin1Char(hex[c >> 4]);
+            result += QLatin1Char(hex[c & 0xf]);
+        }
+    } else {
+        for (int i = 0; i < data.size(); ++i) {
+            const uchar c = uchar(data.at(i));
+            result += (c >= 0x20 && c < 0x7f) ? QLatin1Char(c) : QLatin1Char('.');
+        }
+    }
+    return result;
+}
+
+QVariant BinEditSearchModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+    case OffsetColumn: return tr("Offset");
+    case HexColumn: return tr("Hex");
+    case TextColumn: return tr("Text");
+    default: break;
+    }
+    return QVariant();
+}
+
+qint64 BinEditSearchModel::position(const QModelIndex &index) const
+{
+    return index.isValid() ? m_matches.at(index.row()).position : -1;
+}
+
+int BinEditSearchModel::length(const QModelIndex &index) const
+{
+    return index.isValid() ? m_matches.at(index.row()).length : 0;
+}
+
+void BinEditSearchModel::clear()
+{
+    if (m_matches.isEmpty())
+        return;
+
+#if QT_VERSION >= 0x050000
+    beginResetModel();
+    m_matches.clear();
+    endResetModel();
+#else
+    m_matches.clear();
+    reset();
+#endif
+}
+
+/*!
+    Adds sorted \a positions of matches that are \a length bytes long.
+*/
+void BinEditSearchModel::addMatches(const QList<qint64> &positions, int length)
+{
+    if (positions.isEmpty())
+        return;
+
+    // Chunks mostly finish in file order, so batches usually go to the end.
+    if (m_matches.isEmpty() || m_matches.last().position < positions.first()) {
+        const int first = m_matches.size();
+        beginInsertRows(QModelIndex(), first, first + positions.size() - 1);
+        foreach (qint64 position, positions) {
+            Match match = { position, length };
+            m_matches.append(match);
+        }
+        endInsertRows();
+        return;
+    }
+
+    // Batches of later matchers and of chunks that finished early go in
+    // between. They are merged in one pass from the back, only the rows
+    // after the first new one move.
+    Match firstMatch = { positions.first(), length };
+    const int first = int(qLowerBound(m_matches.begin(), m_matches.end(), firstMatch) - m_matches.begin());
+
+    emit layoutAboutToBeChanged();
+    const QModelIndexList oldIndexes = persistentIndexList();
+    QModelIndexList newIndexes;
+    foreach (const QModelIndex &index, oldIndexes) {
+        int row = index.row();
+        if (row >= first) {
+            row += int(qLowerBound(positions.begin(), positions.end(), m_matches.at(row).position)
+                       - positions.begin());
+        }
+        newIndexes.append(createIndex(row, index.column()));
+    }
+
+    int oldRow = m_matches.size() - 1;
+    int i = positions.size() - 1;
+    m_matches.resize(m_matches.size() + positions.size());
+    for (int row = m_matches.size() - 1; i >= 0; --row) {
+        if (oldRow >= first && m_matches.at(oldRow).position > positions.at(i)) {
+            m_matches[row] = m_matches.at(oldRow--);
+        } else {
+            Match match = { positions.at(i--), length };
+            m_matches[row] = match;
+        }
+    }
+
+    changePersistentIndexList(oldIndexes, newIndexes);
+    emit layoutChanged();
+}
@@ -0,0 +1,52 @@
+#ifndef BINEDITSEARCHMODEL_H
+#define BINEDITSEARCHMODEL_H
+
+#include <QtCore/QAbstractTableModel>
+#include <QtCore/QVector>
+
+class BinEdit;
+
+class BinEditSearchModel : public QAbstractTableModel
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditSearchModel)
+
+public:
+    enum Column {
+        OffsetColumn,
+        HexColumn,
+        TextColumn,
+
+        ColumnCount
+    };
+
+    explicit BinEditSearchModel(BinEdit *editor, QObject *parent = 0);
+
+    static const int ContextSize = 8;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    qint64 position(const QModelIndex &index) const;
+    int length(const QModelIndex &index) const;
+
+public slots:
+    void clear();
+    void addMatches(const QList<qint64> &positions, int length);
+
+private:
+    struct Match
+    {
+        qint64 position;
+        int length;
+
+        bool operator<(const Match &other) const { return position < other.position; }
+    };
+
+    BinEdit *m_editor;
+    QVector<Match> m_matches;
+};
+
+#endif // BINEDITSEARCHMODEL_H
@@ -0,0 +1,173 @@
+#include "bineditsearchpanel.h"
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QCheckBox>
+#include <QtWidgets/QHBoxLayout>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QLineEdit>
+#include <QtWidgets/QProgressBar>
+#include <QtWidgets/QPushButton>
+#include <QtWidgets/QTreeView>
+#include <QtWidgets/QVBoxLayout>
+#else
+#include <QtGui/QCheckBox>
+#include <QtGui/QHBoxLayout>
+#include <QtGui/QHeaderView>
+#include <QtGui/QLabel>
+#include <QtGui/QLineEdit>
+#include <QtGui/QProgressBar>
+#include <QtGui/QPushButton>
+#include <QtGui/QTreeView>
+#include <QtGui/QVBoxLayout>
+#endif
+
+#include "binedit.h"
+#include "bineditsearch.h"
+#include "bineditsearchmodel.h"
+
+/*!
+    \class BinEditSearchPanel
+
+    Panel below the BinEdit that searches the whole file in the background
+    and lists all matches. Activating a match selects it in the editor.
+*/
+
+BinEditSearchPanel::BinEditSearchPanel(BinEdit *editor, QWidget *parent) :
+    QWidget(parent),
+    m_editor(editor),
+    m_model(new BinEditSearchModel(editor, this))
+{
+    setupUi();
+    retranslateUi();
+
+    BinEditSearch *search = m_editor->search();
+    connect(search, SIGNAL(started()), SLOT(onStarted()));
+    connect(search, SIGNAL(progressChanged(int,int)), SLOT(onProgressChanged(int,int)));
+    connect(search, SIGNAL(finished()), SLOT(onFinished()));
+    connect(search, SIGNAL(matchesFound(QList<qint64>,int)),
+            m_model, SLOT(addMatches(QList<qint64>,int)));
+}
+
+/*!
+    Shows the panel and focuses the pattern editor.
+*/
+void BinEditSearchPanel::activate()
+{
+    show();
+    m_patternEdit->setFocus();
+    m_patternEdit->selectAll();
+}
+
+void BinEditSearchPanel::startOrCancel()
+{
+    BinEditSearch *search = m_editor->search();
+    if (search->isRunning()) {
+        search->cancel();
+        return;
+    }
+
+    const QByteArray pattern = m_patternEdit->text().toLatin1();
+    QTextDocument::FindFlags flags = 0;
+    if (m_caseSensitiveBox->isChecked())
+        flags |= QTextDocument::FindCaseSensitively;
+
+    m_model->clear();
+    m_editor->highlightSearchResults(pattern, flags);
+    m_editor->findAll(pattern, flags);
+}
+
+void BinEditSearchPanel::onStarted()
+{
+    m_findButton->setText(tr("Cancel"));
+    m_progressBar->setValue(0);
+    m_progressBar->show();
+    updateStatus();
+}
+
+void BinEditSearchPanel::onProgressChanged(int value, int maximum)
+{
+    m_progressBar->setMaximum(maximum);
+    m_progressBar->setValue(value);
+    updateStatus();
+}
+
+void BinEditSearchPanel::onFinished()
+{
+    m_findButton->setText(tr("Find All"));
+    m_progressBar->hide();
+    updateStatus();
+}
+
+void BinEditSearchPanel::onActivated(const QModelIndex &index)
+{
+    const qint64 position = m_model->position(index);
+    if (position < 0)
+        return;
+
+    m_editor->setCursorPosition(position);
+    m_editor->setCursorPosition(position + m_model->length(index), BinEdit::KeepAnchor);
+    m_editor->setFocus();
+}
+
+void BinEditSearchPanel::setupUi()
+{
+    m_patternEdit = new QLineEdit(this);
+    connect(m_patternEdit, SIGNAL(returnPressed()), SLOT(startOrCancel()));
+
+    m_caseSensitiveBox = new QCheckBox(this);
+
+    m_findButton = new QPushButton(this);
+    connect(m_findButton, SIGNAL(clicked()), SLOT(startOrCancel()));
+
+    m_progressBar = new QProgressBar(this);
+    m_progressBar->setTextVisible(false);
+    m_progressBar->hide();
+
+    m_statusLabel = new QLabel(this);
+
+    m_view = new QTreeView(this);
+    m_view->setModel(m_model);
+    m_view->setRootIsDecorated(false);
+    m_view->setUniformRowHeights(true);
+    m_view->setAllColumnsShowFocus(true);
+#if QT_VERSION >= 0x050000
+    m_view->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+#else
+    m_view->header()->setResizeMode(QHeaderView::ResizeToContents);
+#endif
+    connect(m_view, SIGNAL(activated(QModelIndex)), SLOT(onActivated(QModelIndex)));
+    connect(m_view, SIGNAL(clicked(QModelIndex)), SLOT(onActivated(QModelIndex)));
+
+    QHBoxLayout *searchLayout = new QHBoxLayout;
+    searchLayout->addWidget(m_patternEdit, 1);
+    searchLayout->addWidget(m_caseSensitiveBox);
+    searchLayout->addWidget(m_findButton);
+    searchLayout->addWidget(m_progressBar);
+    searchLayout->addWidget(m_statusLabel);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(searchLayout);
+    layout->addWidget(m_view);
+}
+
+void BinEditSearchPanel::retranslateUi()
+{
+#if QT_VERSION >= 0x040700
+    m_patternEdit->setPlaceholderText(tr("Text or hex bytes"));
+#endif
+    m_patternEdit->setToolTip(tr("Hex bytes may use ? for any nibble and alternatives in "
+                                 "parentheses, like 4D 5A ?? ?? (50 45 | 4E 45)."));
+    m_caseSensitiveBox->setText(tr("Case sensitive"));
+    m_findButton->setText(m_editor->search()->isRunning() ? tr("Cancel") : tr("Find All"));
+}
+
+void BinEditSearchPanel::updateStatus()
+{
+    const BinEditSearch *search = m_editor->search();
+    QString status = tr("%n match(es)", 0, search->matchCount());
+    if (search->isLimitReached())
+        status = tr("%1 (search stopped)").arg(status);
+    m_statusLabel->setText(status);
+}
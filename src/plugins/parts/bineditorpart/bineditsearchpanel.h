@@ -0,0 +1,57 @@
+#ifndef BINEDITSEARCHPANEL_H
+#define BINEDITSEARCHPANEL_H
+
+#include <QtCore/QModelIndex>
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QWidget>
+#else
+#include <QtGui/QWidget>
+#endif
+
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QProgressBar;
+class QPushButton;
+class QTreeView;
+
+class BinEdit;
+class BinEditSearchModel;
+
+class BinEditSearchPanel : public QWidget
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditSearchPanel)
+
+public:
+    explicit BinEditSearchPanel(BinEdit *editor, QWidget *parent = 0);
+
+public slots:
+    void activate();
+
+private slots:
+    void startOrCancel();
+    void onStarted();
+    void onProgressChanged(int value, int maximum);
+    void onFinished();
+    void onActivated(const QModelIndex &index);
+
+private:
+    void setupUi();
+    void retranslateUi();
+    void updateStatus();
+
+private:
+    BinEdit *m_editor;
+    BinEditSearchModel *m_model;
+
+    QLineEdit *m_patternEdit;
+    QCheckBox *m_caseSensitiveBox;
+    QPushButton *m_findButton;
+    QProgressBar *m_progressBar;
+    QLabel *m_statusLabel;
+    QTreeView *m_view;
+};
+
+#endif // BINEDITSEARCHPANEL_H
@@ -0,0 +1,128 @@
+#include "bineditsharedfile.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QWeakPointer>
+
+#if defined(Q_OS_UNIX)
+#include <sys/stat.h>
+#endif
+
+typedef QHash<QString, QWeakPointer<BinEditSharedFile> > SharedFileHash;
+Q_GLOBAL_STATIC(SharedFileHash, sharedFiles)
+
+/*!
+    \class BinEditSharedFile
+
+    Data of a file shared by all editors showing it: the block cache, the
+    piece table with the edits and the undo journal.
+
+    Editors showing the same file get the same instance from instance(), so
+    the file is cached once and an edit made in one editor shows up in all
+    others. The editor making a change announces it with one of the notify
+    functions; the others update their views from the signals.
+
+    Files are identified by device and inode where available, so different
+    paths to the same file share data as well.
+*/
+
+BinEditSharedFile::BinEditSharedFile() :
+    m_viewCount(0)
+{
+}
+
+BinEditSharedFile::~BinEditSharedFile()
+{
+    setKey(QString());
+}
+
+/*!
+    Returns a new instance that is not shared with other editors.
+*/
+QSharedPointer<BinEditSharedFile> BinEditSharedFile::create()
+{
+    QSharedPointer<BinEditSharedFile> result(new BinEditSharedFile);
+    result->m_self = result.toWeakRef();
+    return result;
+}
+
+/*!
+    Returns the instance of the open \a file, creating it if no editor shows
+    that file yet.
+*/
+QSharedPointer<BinEditSharedFile> BinEditSharedFile::instance(const QFile *file)
+{
+    const QString key = fileKey(file);
+    if (key.isEmpty())
+        return create();
+
+    QSharedPointer<BinEditSharedFile> result = sharedFiles()->value(key).toStrongRef();
+    if (!result) {
+        result = create();
+        result->setKey(key);
+        sharedFiles()->insert(key, result->m_self);
+    }
+    return result;
+}
+
+/*!
+    Makes the instance the one of \a file, which replaced the previous file
+    on disk, for example after saving a copy.
+*/
+void BinEditSharedFile::setFile(const QFile *file)
+{
+    const QString key = fileKey(file);
+    if (key == m_key)
+        return;
+
+    setKey(QString());
+    // Another editor already shows the new file with its own data.
+    if (key.isEmpty() || sharedFiles()->value(key).toStrongRef())
+        return;
+
+    setKey(key);
+    sharedFiles()->insert(key, m_self);
+}
+
+void BinEditSharedFile::notifyContentsChanged(QObject *source, qint64 position,
+                                              qint64 oldLength, qint64 newLength)
+{
+    emit contentsChanged(source, position, oldLength, newLength);
+}
+
+void BinEditSharedFile::notifyStateChanged(QObject *source)
+{
+    emit stateChanged(source);
+}
+
+void BinEditSharedFile::notifyReopened(QObject *source, const QString &fileName)
+{
+    emit reopened(source, fileName);
+}
+
+QString BinEditSharedFile::fileKey(const QFile *file)
+{
+    if (!file || !file->isOpen() || file->fileName().isEmpty())
+        return QString();
+
+#if defined(Q_OS_UNIX)
+    struct stat st;
+    if (file->handle() != -1 && ::fstat(file->handle(), &st) == 0 && st.st_ino != 0)
+        return QString::fromLatin1("%1:%2").arg(quint64(st.st_dev)).arg(quint64(st.st_ino));
+#endif
+
+    return QFileInfo(file->fileName()).canonicalFilePath();
+}
+
+void BinEditSharedFile::setKey(const QString &key)
+{
+    if (!m_key.isEmpty()) {
+        SharedFileHash::iterator it = sharedFiles()->find(m_key);
+        // The entry is null once the last reference went away; an entry of
+        // another instance that took over the key is left alone.
+        if (it != sharedFiles()->end() && (it.value().isNull() || it.value().data() == this))
+            sharedFiles()->erase(it);
+    }
+    m_key = key;
+}
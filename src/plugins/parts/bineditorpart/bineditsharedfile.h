@@ -0,0 +1,62 @@
+#ifndef BINEDITSHAREDFILE_H
+#define BINEDITSHAREDFILE_H
+
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QWeakPointer>
+
+#include "bineditblockcache.h"
+#include "bineditpiecetable.h"
+#include "bineditundojournal.h"
+
+QT_FORWARD_DECLARE_CLASS(QFile)
+
+class BinEditSharedFile : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditSharedFile)
+
+public:
+    ~BinEditSharedFile();
+
+    static QSharedPointer<BinEditSharedFile> create();
+    static QSharedPointer<BinEditSharedFile> instance(const QFile *file);
+
+    QString key() const { return m_key; }
+    void setFile(const QFile *file);
+
+    BinEditBlockCache *cache() { return &m_cache; }
+    BinEditPieceTable *pieces() { return &m_pieces; }
+    BinEditUndoJournal *journal() { return &m_journal; }
+
+    int viewCount() const { return m_viewCount; }
+    bool isShared() const { return m_viewCount > 1; }
+    void addView() { ++m_viewCount; }
+    void removeView() { --m_viewCount; }
+
+    void notifyContentsChanged(QObject *source, qint64 position,
+                               qint64 oldLength, qint64 newLength);
+    void notifyStateChanged(QObject *source);
+    void notifyReopened(QObject *source, const QString &fileName);
+
+signals:
+    void contentsChanged(QObject *source, qint64 position, qint64 oldLength, qint64 newLength);
+    void stateChanged(QObject *source);
+    void reopened(QObject *source, const QString &fileName);
+
+private:
+    BinEditSharedFile();
+
+    static QString fileKey(const QFile *file);
+    void setKey(const QString &key);
+
+    QWeakPointer<BinEditSharedFile> m_self;
+    QString m_key;
+    int m_viewCount;
+    BinEditBlockCache m_cache;
+    BinEditPieceTable m_pieces;
+    BinEditUndoJournal m_journal;
+};
+
+#endif // BINEDITSHAREDFILE_H
@@ -0,0 +1,451 @@
+#include "bineditstrings.h"
+
+#include "bineditblockprovider.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QRunnable>
+
+#include <limits.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define BINEDIT_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+// Runs that reach the end of a chunk are followed in pieces of this size.
+static const int ExtendSize = 64 * 1024;
+
+static inline bool isPrintable(uchar c)
+{
+    return (c >= 0x20 && c < 0x7f) || c == '\t';
+}
+
+static inline int lowestBit(quint32 mask)
+{
+#if defined(_MSC_VER)
+    unsigned long result;
+    _BitScanForward(&result, mask);
+    return int(result);
+#elif defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int result = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++result;
+    }
+    return result;
+#endif
+}
+
+/*
+    Sets bit i of \a printable if byte i of \a data is printable and bit i of
+    \a zeros if it is zero, 32 bytes at a time with SSE2.
+*/
+static void classifyBytes(const uchar *data, int length, QVector<quint32> *printable,
+                          QVector<quint32> *zeros)
+{
+    const int words = (length + 31) / 32;
+    printable->fill(0, words);
+    zeros->fill(0, words);
+    quint32 *p = printable->data();
+    quint32 *z = zeros->data();
+
+    int i = 0;
+#if defined(BINEDIT_HAVE_SSE2)
+    const __m128i low = _mm_set1_epi8(0x1f);
+    const __m128i high = _mm_set1_epi8(0x7f);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 32 <= length; i += 32) {
+        quint32 printableMask = 0;
+        quint32 zeroMask = 0;
+        for (int half = 0; half < 2; ++half) {
+            // Signed compares, bytes >= 0x80 are negative and not printable.
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 16 * half));
+            const __m128i inRange = _mm_and_si128(_mm_cmpgt_epi8(x, low), _mm_cmplt_epi8(x, high));
+            const __m128i isPrintable = _mm_or_si128(inRange, _mm_cmpeq_epi8(x, tab));
+            printableMask |= quint32(_mm_movemask_epi8(isPrintable)) << (16 * half);
+            zeroMask |= quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero))) << (16 * half);
+        }
+        p[i / 32] = printableMask;
+        z[i / 32] = zeroMask;
+    }
+#endif
+    for (; i < length; ++i) {
+        if (isPrintable(data[i]))
+            p[i / 32] |= quint32(1) << (i % 32);
+        else if (!data[i])
+            z[i / 32] |= quint32(1) << (i % 32);
+    }
+}
+
+// Returns the 16 even bits of \a x packed into the low half.
+static inline quint32 evenBits(quint32 x)
+{
+    x &= 0x55555555;
+    x = (x | (x >> 1)) & 0x33333333;
+    x = (x | (x >> 2)) & 0x0f0f0f0f;
+    x = (x | (x >> 4)) & 0x00ff00ff;
+    x = (x | (x >> 8)) & 0x0000ffff;
+    return x;
+}
+
+static inline quint32 wordAt(const QVector<quint32> &bits, int index)
+{
+    return index < bits.size() ? bits.at(index) : 0;
+}
+
+/*
+    Returns a bitmap with bit k set if the UTF-16LE unit at byte 2k + \a
+    alignment is a printable character followed by a zero byte.
+*/
+static QVector<quint32> unitBits(const QVector<quint32> &printable, const QVector<quint32> &zeros,
+                                 int alignment)
+{
+    const int words = printable.size();
+    QVector<quint32> units(words);
+    for (int j = 0; j < words; ++j) {
+        const quint32 nextZeros = (zeros.at(j) >> 1) | (wordAt(zeros, j + 1) << 31);
+        units[j] = printable.at(j) & nextZeros;
+    }
+    if (alignment) {
+        for (int j = 0; j < words; ++j)
+            units[j] = (units.at(j) >> 1) | (wordAt(units, j + 1) << 31);
+    }
+
+    QVector<quint32> result((words + 1) / 2);
+    for (int j = 0; j < result.size(); ++j)
+        result[j] = evenBits(units.at(2 * j)) | evenBits(wordAt(units, 2 * j + 1)) << 16;
+    return result;
+}
+
+// Returns the first set (or, with \a set false, clear) bit at or after \a from.
+static int nextBit(const QVector<quint32> &bits, int from, int count, bool set)
+{
+    if (from >= count)
+        return count;
+
+    int index = from / 32;
+    quint32 word = (set ? bits.at(index) : ~bits.at(index)) & (~quint32(0) << (from % 32));
+    while (!word) {
+        if (++index >= bits.size())
+            return count;
+        word = set ? bits.at(index) : ~bits.at(index);
+    }
+    return qMin(count, index * 32 + lowestBit(word));
+}
+
+class BinEditStringsJob
+{
+public:
+    BinEditBlockProvider *provider;
+    quint64 baseAddress;
+    qint64 size;
+    BinEditPieceTable::PieceList pieces;
+    QSharedPointer<BinEditAddBuffer> addBuffer;
+    int minLength;
+    BinEditStrings::Encodings encodings;
+    int generation;
+    QAtomicInt stopped;
+    QAtomicInt stringCount;
+    // One slot per chunk, each written by the task of its chunk only.
+    QVector<BinEditStrings::StringList> results;
+
+    bool isStopped() const
+    {
+#if QT_VERSION >= 0x050000
+        return stopped.load();
+#else
+        return stopped;
+#endif
+    }
+
+    QByteArray read(qint64 from, int length) const
+    {
+        return BinEditPieceTable::read(pieces, addBuffer.data(), provider, baseAddress, from, length);
+    }
+};
+
+class BinEditStringsTask : public QRunnable
+{
+public:
+    BinEditStringsTask(const QSharedPointer<BinEditStringsJob> &job, QObject *receiver, int chunk) :
+        m_job(job),
+        m_receiver(receiver),
+        m_chunk(chunk)
+    {
+    }
+
+    void run();
+
+private:
+    void findStrings(BinEditStrings::StringList *strings) const;
+    bool addString(BinEditStrings::StringList *strings, qint64 position, int characters,
+                   BinEditStrings::Encoding encoding, const QByteArray &text) const;
+    int extend(BinEditStrings::Encoding encoding, qint64 from, QByteArray *text) const;
+
+    QSharedPointer<BinEditStringsJob> m_job;
+    QObject *m_receiver;
+    int m_chunk;
+};
+
+void BinEditStringsTask::run()
+{
+    BinEditStrings::StringList strings;
+    if (!m_job->isStopped())
+        findStrings(&strings);
+    m_job->results[m_chunk] = strings;
+
+    // Always report back, the receiver counts finished chunks for progress.
+    QMetaObject::invokeMethod(m_receiver, "handleChunkDone", Qt::QueuedConnection,
+                              Q_ARG(int, m_job->generation), Q_ARG(int, m_chunk));
+}
+
+/*
+    Finds the strings that start in the chunk. The data read starts two
+    bytes early, so runs continuing from the previous chunk are recognized
+    and left to it, and ends a byte late for the last UTF-16 unit. Runs that
+    reach the end of the data are followed into the next chunk.
+*/
+void BinEditStringsTask::findStrings(BinEditStrings::StringList *strings) const
+{
+    const BinEditStringsJob &job = *m_job;
+    const qint64 start = qint64(m_chunk) * BinEditStrings::ChunkSize;
+    const qint64 end = qMin<qint64>(start + BinEditStrings::ChunkSize, job.size);
+    // Strings start with a printable byte, holes of sparse files have none.
+    if (BinEditPieceTable::isHole(job.pieces, job.provider, job.baseAddress, start, end - start))
+        return;
+    const qint64 dataStart = qMax<qint64>(0, start - 2);
+    const qint64 dataEnd = qMin<qint64>(end + 1, job.size);
+    const QByteArray data = job.read(dataStart, int(dataEnd - dataStart));
+    const int length = data.size();
+
+    QVector<quint32> printable;
+    QVector<quint32> zeros;
+    classifyBytes(reinterpret_cast<const uchar *>(data.constData()), length, &printable, &zeros);
+
+    if (job.encodings & BinEditStrings::Ascii) {
+        int from = nextBit(printable, 0, length, true);
+        while (from < length && !job.isStopped()) {
+            const int to = nextBit(printable, from, length, false);
+            const qint64 position = dataStart + from;
+            if (position >= start && position < end) {
+                QByteArray text = data.mid(from, qMin(to - from, int(BinEditStrings::MaxTextLength)));
+                int characters = to - from;
+                if (to == length)
+                    characters += extend(BinEditStrings::Ascii, dataStart + to, &text);
+                if (characters >= job.minLength
+                        && !addString(strings, position, characters, BinEditStrings::Ascii, text)) {
+                    return;
+                }
+            }
+            from = nextBit(printable, to, length, true);
+        }
+    }
+
+    if (!(job.encodings & BinEditStrings::Utf16LittleEndian))
+        return;
+
+    // dataStart is even, so alignments are the same in the file and the data.
+    for (int alignment = 0; alignment < 2; ++alignment) {
+        const QVector<quint32> units = unitBits(printable, zeros, alignment);
+        const int count = (length - alignment) / 2;
+        int from = nextBit(units, 0, count, true);
+        while (from < count && !job.isStopped()) {
+            const int to = nextBit(units, from, count, false);
+            const qint64 position = dataStart + alignment + 2 * qint64(from);
+            if (position >= start && position < end) {
+                QByteArray text;
+                const int textLength = qMin(to - from, int(BinEditStrings::MaxTextLength));
+                text.reserve(textLength);
+                for (int k = from; k < from + textLength; ++k)
+                    text.append(data.at(alignment + 2 * k));
+                int characters = to - from;
+                if (to == count)
+                    characters += extend(BinEditStrings::Utf16LittleEndian,
+                                         dataStart + alignment + 2 * qint64(to), &text) / 2;
+                if (characters >= job.minLength
+                        && !addString(strings, position, characters,
+                                      BinEditStrings::Utf16LittleEndian, text)) {
+                    return;
+                }
+            }
+            from = nextBit(units, to, count, true);
+        }
+    }
+}
+
+// Returns false once the job has found MaxStrings strings and stopped.
+bool BinEditStringsTask::addString(BinEditStrings::StringList *strings, qint64 position,
+                                   int characters, BinEditStrings::Encoding encoding,
+                                   const QByteArray &text) const
+{
+    if (m_job->stringCount.fetchAndAddRelaxed(1) >= BinEditStrings::MaxStrings) {
+        m_job->stopped.fetchAndStoreRelaxed(1);
+        return false;
+    }
+
+    BinEditStrings::String string;
+    string.position = position;
+    string.length = encoding == BinEditStrings::Ascii ? characters : 2 * characters;
+    string.encoding = encoding;
+    string.text = text;
+    strings->append(string);
+    return true;
+}
+
+/*
+    Returns the number of bytes a run of \a encoding continues at \a from,
+    appending its characters to \a text up to MaxTextLength.
+*/
+int BinEditStringsTask::extend(BinEditStrings::Encoding encoding, qint64 from, QByteArray *text) const
+{
+    const BinEditStringsJob &job = *m_job;
+    const int step = encoding == BinEditStrings::Ascii ? 1 : 2;
+    qint64 position = from;
+    while (position < job.size && !job.isStopped()) {
+        const QByteArray data = job.read(position, int(qMin<qint64>(ExtendSize, job.size - position)));
+        int i = 0;
+        for (; i + step <= data.size(); i += step) {
+            if (!isPrintable(uchar(data.at(i))) || (step == 2 && data.at(i + 1)))
+                break;
+            if (text->size() < BinEditStrings::MaxTextLength)
+                text->append(data.at(i));
+        }
+        position += i;
+        if (i + step <= data.size() || i == 0)
+            break;
+    }
+    return int(qMin<qint64>(position - from, INT_MAX - 1) / step * step);
+}
+
+/*!
+    \class BinEditStrings
+
+    Extracts runs of printable ASCII and UTF-16LE characters from the whole
+    file on a thread pool, like the strings tool.
+
+    The data is split into chunks of ChunkSize bytes that are scanned in
+    parallel. Printable and zero bytes of a chunk are classified into
+    bitmaps 32 bytes at a time with SSE2, run boundaries are then found a
+    word of the bitmap at a time. Unsaved edits are applied from a snapshot
+    of the piece table. Strings are reported through stringsFound() in file
+    order, positions are relative to the base address passed to start().
+    Extraction stops after MaxStrings strings.
+
+    cancel() must be called before the provider is closed or remapped.
+*/
+
+BinEditStrings::BinEditStrings(BinEditBlockProvider *provider, QObject *parent) :
+    QObject(parent),
+    m_provider(provider),
+    m_generation(0),
+    m_chunkCount(0),
+    m_finishedChunks(0),
+    m_reportedChunks(0),
+    m_stringCount(0),
+    m_running(false)
+{
+}
+
+BinEditStrings::~BinEditStrings()
+{
+    cancel();
+}
+
+bool BinEditStrings::isLimitReached() const
+{
+    return m_stringCount >= MaxStrings;
+}
+
+/*!
+    Starts extracting strings of at least \a minLength characters in \a
+    encodings from the data described by \a pieces and \a addBuffer, with
+    original data at \a baseAddress. An extraction that is already running
+    is canceled.
+*/
+void BinEditStrings::start(int minLength, Encodings encodings, quint64 baseAddress,
+                           const BinEditPieceTable::PieceList &pieces,
+                           const QSharedPointer<BinEditAddBuffer> &addBuffer)
+{
+    cancel();
+
+    const qint64 size = pieces.isEmpty() ? 0 : pieces.last().position + pieces.last().length;
+
+    if (!encodings || size <= 0 || !m_provider->isOpen())
+        return;
+
+    m_chunkCount = int((size + ChunkSize - 1) / ChunkSize);
+
+    QSharedPointer<BinEditStringsJob> job(new BinEditStringsJob);
+    job->provider = m_provider;
+    job->baseAddress = baseAddress;
+    job->size = size;
+    job->pieces = pieces;
+    job->addBuffer = addBuffer;
+    job->minLength = qMax(1, minLength);
+    job->encodings = encodings;
+    job->generation = m_generation;
+    job->results.resize(m_chunkCount);
+    m_job = job;
+
+    m_doneChunks.fill(false, m_chunkCount);
+    m_finishedChunks = 0;
+    m_reportedChunks = 0;
+    m_stringCount = 0;
+    m_running = true;
+    emit started();
+    emit progressChanged(0, m_chunkCount);
+
+    for (int chunk = 0; chunk < m_chunkCount; ++chunk)
+        m_pool.start(new BinEditStringsTask(job, this, chunk));
+}
+
+/*!
+    Stops the running extraction and waits for chunks being scanned to
+    finish. Strings not reported yet are dropped.
+*/
+void BinEditStrings::cancel()
+{
+    if (m_job) {
+        m_job->stopped.fetchAndStoreRelaxed(1);
+        m_pool.waitForDone();
+        m_job.clear();
+    }
+
+    ++m_generation;
+    if (m_running) {
+        m_running = false;
+        emit finished();
+    }
+}
+
+void BinEditStrings::handleChunkDone(int generation, int chunk)
+{
+    if (generation != m_generation || !m_job)
+        return;
+
+    // Chunks finish in any order, strings are passed on in file order.
+    m_doneChunks[chunk] = true;
+    ++m_finishedChunks;
+    while (m_reportedChunks < m_chunkCount && m_doneChunks.at(m_reportedChunks)) {
+        StringList strings;
+        strings.swap(m_job->results[m_reportedChunks++]);
+        if (!strings.isEmpty()) {
+            m_stringCount += strings.size();
+            emit stringsFound(strings);
+        }
+    }
+    emit progressChanged(m_finishedChunks, m_chunkCount);
+
+    if (m_finishedChunks == m_chunkCount) {
+        m_job.clear();
+        m_running = false;
+        emit finished();
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef BINEDITSTRINGS_H
+#define BINEDITSTRINGS_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+#include "bineditpiecetable.h"
+
+class BinEditBlockProvider;
+class BinEditStringsJob;
+
+class BinEditStrings : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditStrings)
+
+public:
+    enum Encoding {
+        Ascii = 0x1,
+        Utf16LittleEndian = 0x2
+    };
+    Q_DECLARE_FLAGS(Encodings, Encoding)
+
+    struct String {
+        qint64 position;
+        int length;          // In bytes.
+        Encoding encoding;
+        QByteArray text;     // At most MaxTextLength characters.
+    };
+    typedef QVector<String> StringList;
+
+    explicit BinEditStrings(BinEditBlockProvider *provider, QObject *parent = 0);
+    ~BinEditStrings();
+
+    static const int ChunkSize = 4 * 1024 * 1024;
+    static const int MaxStrings = 1000000;
+    static const int MaxTextLength = 256;
+    static const int DefaultMinLength = 4;
+
+    bool isRunning() const { return m_running; }
+    bool isLimitReached() const;
+    int stringCount() const { return m_stringCount; }
+
+    void start(int minLength, Encodings encodings, quint64 baseAddress,
+               const BinEditPieceTable::PieceList &pieces,
+               const QSharedPointer<BinEditAddBuffer> &addBuffer);
+
+public slots:
+    void cancel();
+
+signals:
+    void started();
+    void stringsFound(const BinEditStrings::StringList &strings);
+    void progressChanged(int value, int maximum);
+    void finished();
+
+private slots:
+    void handleChunkDone(int generation, int chunk);
+
+private:
+    BinEditBlockProvider *m_provider;
+    QThreadPool m_pool;
+    QSharedPointer<BinEditStringsJob> m_job;
+    QVector<bool> m_doneChunks;
+    int m_generation;
+    int m_chunkCount;
+    int m_finishedChunks;
+    int m_reportedChunks;
+    int m_stringCount;
+    bool m_running;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(BinEditStrings::Encodings)
+
+#endif // BINEDITSTRINGS_H
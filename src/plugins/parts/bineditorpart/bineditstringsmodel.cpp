@@ -0,0 +1,146 @@
+#include "bineditstringsmodel.h"
+
+#include "binedit.h"
+
+/*!
+    \class BinEditStringsModel
+
+    Lists the strings found by a BinEditStrings in file order.
+
+    Strings are filtered by a case insensitive substring of their text, only
+    the indexes of matching strings are kept for the rows, so filtering a
+    million strings doesn't copy them. The filter is matched against the
+    first BinEditStrings::MaxTextLength characters of a string.
+*/
+
+BinEditStringsModel::BinEditStringsModel(BinEdit *editor, QObject *parent) :
+    QAbstractTableModel(parent),
+    m_editor(editor)
+{
+}
+
+int BinEditStringsModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+int BinEditStringsModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant BinEditStringsModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size())
+        return QVariant();
+
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole)
+        return QVariant();
+
+    const BinEditStrings::String &string = m_strings.at(m_rows.at(index.row()));
+    switch (index.column()) {
+    case OffsetColumn:
+        return m_editor->addressString(m_editor->baseAddress() + string.position);
+    case EncodingColumn:
+        return string.encoding == BinEditStrings::Ascii ? tr("ASCII") : tr("UTF-16LE");
+    case LengthColumn:
+        return string.encoding == BinEditStrings::Ascii ? string.length : string.length / 2;
+    case TextColumn:
+        return QString::fromLatin1(string.text.constData(), string.text.size());
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+QVariant BinEditStringsModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+    case OffsetColumn: return tr("Offset");
+    case EncodingColumn: return tr("Encoding");
+    case LengthColumn: return tr("Length");
+    case TextColumn: return tr("Text");
+    default: break;
+    }
+    return QVariant();
+}
+
+qint64 BinEditStringsModel::position(const QModelIndex &index) const
+{
+    return index.isValid() ? m_strings.at(m_rows.at(index.row())).position : -1;
+}
+
+int BinEditStringsModel::length(const QModelIndex &index) const
+{
+    return index.isValid() ? m_strings.at(m_rows.at(index.row())).length : 0;
+}
+
+void BinEditStringsModel::clear()
+{
+    if (m_strings.isEmpty())
+        return;
+
+#if QT_VERSION >= 0x050000
+    beginResetModel();
+    m_strings.clear();
+    m_rows.clear();
+    endResetModel();
+#else
+    m_strings.clear();
+    m_rows.clear();
+    reset();
+#endif
+}
+
+/*!
+    Shows only strings that contain \a filter, ignoring case.
+*/
+void BinEditStringsModel::setFilter(const QString &filter)
+{
+    const QByteArray pattern = filter.toLatin1();
+    if (pattern == m_filter.pattern())
+        return;
+
+#if QT_VERSION >= 0x050000
+    beginResetModel();
+#endif
+    m_filter = BinEditMatcher(pattern, false);
+    m_rows.clear();
+    for (int i = 0; i < m_strings.size(); ++i) {
+        if (matches(m_strings.at(i)))
+            m_rows.append(i);
+    }
+#if QT_VERSION >= 0x050000
+    endResetModel();
+#else
+    reset();
+#endif
+}
+
+/*!
+    Appends \a strings, which follow all strings added before.
+*/
+void BinEditStringsModel::addStrings(const BinEditStrings::StringList &strings)
+{
+    QVector<int> rows;
+    for (int i = 0; i < strings.size(); ++i) {
+        if (matches(strings.at(i)))
+            rows.append(m_strings.size() + i);
+    }
+    m_strings += strings;
+    if (rows.isEmpty())
+        return;
+
+    const int first = m_rows.size();
+    beginInsertRows(QModelIndex(), first, first + rows.size() - 1);
+    m_rows += rows;
+    endInsertRows();
+}
+
+bool BinEditStringsModel::matches(const BinEditStrings::String &string) const
+{
+    return m_filter.isEmpty() || m_filter.indexIn(string.text) >= 0;
+}
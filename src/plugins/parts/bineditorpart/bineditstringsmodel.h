@@ -0,0 +1,52 @@
+#ifndef BINEDITSTRINGSMODEL_H
+#define BINEDITSTRINGSMODEL_H
+
+#include <QtCore/QAbstractTableModel>
+#include <QtCore/QVector>
+
+#include "bineditmatcher.h"
+#include "bineditstrings.h"
+
+class BinEdit;
+
+class BinEditStringsModel : public QAbstractTableModel
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditStringsModel)
+
+public:
+    enum Column {
+        OffsetColumn,
+        EncodingColumn,
+        LengthColumn,
+        TextColumn,
+
+        ColumnCount
+    };
+
+    explicit BinEditStringsModel(BinEdit *editor, QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    int stringCount() const { return m_strings.size(); }
+    qint64 position(const QModelIndex &index) const;
+    int length(const QModelIndex &index) const;
+
+public slots:
+    void clear();
+    void setFilter(const QString &filter);
+    void addStrings(const BinEditStrings::StringList &strings);
+
+private:
+    bool matches(const BinEditStrings::String &string) const;
+
+    BinEdit *m_editor;
+    BinEditStrings::StringList m_strings;
+    QVector<int> m_rows; // Indexes of the strings that match the filter.
+    BinEditMatcher m_filter;
+};
+
+#endif // BINEDITSTRINGSMODEL_H
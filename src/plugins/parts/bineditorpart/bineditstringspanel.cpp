@@ -0,0 +1,190 @@
+#include "bineditstringspanel.h"
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QCheckBox>
+#include <QtWidgets/QHBoxLayout>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QLineEdit>
+#include <QtWidgets/QProgressBar>
+#include <QtWidgets/QPushButton>
+#include <QtWidgets/QSpinBox>
+#include <QtWidgets/QTreeView>
+#include <QtWidgets/QVBoxLayout>
+#else
+#include <QtGui/QCheckBox>
+#include <QtGui/QHBoxLayout>
+#include <QtGui/QHeaderView>
+#include <QtGui/QLabel>
+#include <QtGui/QLineEdit>
+#include <QtGui/QProgressBar>
+#include <QtGui/QPushButton>
+#include <QtGui/QSpinBox>
+#include <QtGui/QTreeView>
+#include <QtGui/QVBoxLayout>
+#endif
+
+#include "binedit.h"
+#include "bineditstrings.h"
+#include "bineditstringsmodel.h"
+
+/*!
+    \class BinEditStringsPanel
+
+    Panel below the BinEdit that extracts the printable strings of the
+    whole file in the background, like the strings tool, and lists them.
+    The list can be filtered while strings are still coming in. Activating
+    a string selects it in the editor.
+*/
+
+BinEditStringsPanel::BinEditStringsPanel(BinEdit *editor, QWidget *parent) :
+    QWidget(parent),
+    m_editor(editor),
+    m_model(new BinEditStringsModel(editor, this))
+{
+    setupUi();
+    retranslateUi();
+
+    BinEditStrings *strings = m_editor->strings();
+    connect(strings, SIGNAL(started()), SLOT(onStarted()));
+    connect(strings, SIGNAL(progressChanged(int,int)), SLOT(onProgressChanged(int,int)));
+    connect(strings, SIGNAL(finished()), SLOT(onFinished()));
+    connect(strings, SIGNAL(stringsFound(BinEditStrings::StringList)),
+            m_model, SLOT(addStrings(BinEditStrings::StringList)));
+}
+
+/*!
+    Shows the panel and extracts strings unless there are some already.
+*/
+void BinEditStringsPanel::activate()
+{
+    show();
+    m_filterEdit->setFocus();
+    if (!m_editor->strings()->isRunning() && !m_model->stringCount())
+        startOrCancel();
+}
+
+void BinEditStringsPanel::startOrCancel()
+{
+    BinEditStrings *strings = m_editor->strings();
+    if (strings->isRunning()) {
+        strings->cancel();
+        return;
+    }
+
+    BinEditStrings::Encodings encodings = 0;
+    if (m_asciiBox->isChecked())
+        encodings |= BinEditStrings::Ascii;
+    if (m_utf16Box->isChecked())
+        encodings |= BinEditStrings::Utf16LittleEndian;
+
+    m_model->clear();
+    m_editor->extractStrings(m_minLengthBox->value(), encodings);
+    updateStatus();
+}
+
+void BinEditStringsPanel::onStarted()
+{
+    m_extractButton->setText(tr("Cancel"));
+    m_progressBar->setValue(0);
+    m_progressBar->show();
+    updateStatus();
+}
+
+void BinEditStringsPanel::onProgressChanged(int value, int maximum)
+{
+    m_progressBar->setMaximum(maximum);
+    m_progressBar->setValue(value);
+    updateStatus();
+}
+
+void BinEditStringsPanel::onFinished()
+{
+    m_extractButton->setText(tr("Extract"));
+    m_progressBar->hide();
+    updateStatus();
+}
+
+void BinEditStringsPanel::onActivated(const QModelIndex &index)
+{
+    const qint64 position = m_model->position(index);
+    if (position < 0)
+        return;
+
+    m_editor->setCursorPosition(position);
+    m_editor->setCursorPosition(position + m_model->length(index), BinEdit::KeepAnchor);
+    m_editor->setFocus();
+}
+
+void BinEditStringsPanel::setupUi()
+{
+    m_minLengthBox = new QSpinBox(this);
+    m_minLengthBox->setRange(1, BinEditStrings::MaxTextLength);
+    m_minLengthBox->setValue(BinEditStrings::DefaultMinLength);
+
+    m_asciiBox = new QCheckBox(this);
+    m_asciiBox->setChecked(true);
+
+    m_utf16Box = new QCheckBox(this);
+    m_utf16Box->setChecked(true);
+
+    m_extractButton = new QPushButton(this);
+    connect(m_extractButton, SIGNAL(clicked()), SLOT(startOrCancel()));
+
+    m_filterEdit = new QLineEdit(this);
+    connect(m_filterEdit, SIGNAL(textChanged(QString)), m_model, SLOT(setFilter(QString)));
+
+    m_progressBar = new QProgressBar(this);
+    m_progressBar->setTextVisible(false);
+    m_progressBar->hide();
+
+    m_statusLabel = new QLabel(this);
+
+    m_view = new QTreeView(this);
+    m_view->setModel(m_model);
+    m_view->setRootIsDecorated(false);
+    m_view->setUniformRowHeights(true);
+    m_view->setAllColumnsShowFocus(true);
+#if QT_VERSION >= 0x050000
+    m_view->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+#else
+    m_view->header()->setResizeMode(QHeaderView::ResizeToContents);
+#endif
+    m_view->header()->setStretchLastSection(true);
+    connect(m_view, SIGNAL(activated(QModelIndex)), SLOT(onActivated(QModelIndex)));
+    connect(m_view, SIGNAL(clicked(QModelIndex)), SLOT(onActivated(QModelIndex)));
+
+    QHBoxLayout *optionsLayout = new QHBoxLayout;
+    optionsLayout->addWidget(m_filterEdit, 1);
+    optionsLayout->addWidget(m_minLengthBox);
+    optionsLayout->addWidget(m_asciiBox);
+    optionsLayout->addWidget(m_utf16Box);
+    optionsLayout->addWidget(m_extractButton);
+    optionsLayout->addWidget(m_progressBar);
+    optionsLayout->addWidget(m_statusLabel);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(optionsLayout);
+    layout->addWidget(m_view);
+}
+
+void BinEditStringsPanel::retranslateUi()
+{
+#if QT_VERSION >= 0x040700
+    m_filterEdit->setPlaceholderText(tr("Filter"));
+#endif
+    m_minLengthBox->setPrefix(tr("Min. length: "));
+    m_asciiBox->setText(tr("ASCII"));
+    m_utf16Box->setText(tr("UTF-16LE"));
+    m_extractButton->setText(m_editor->strings()->isRunning() ? tr("Cancel") : tr("Extract"));
+}
+
+void BinEditStringsPanel::updateStatus()
+{
+    const BinEditStrings *strings = m_editor->strings();
+    QString status = tr("%n string(s)", 0, strings->stringCount());
+    if (strings->isLimitReached())
+        status = tr("%1 (extraction stopped)").arg(status);
+    m_statusLabel->setText(status);
+}
@@ -0,0 +1,60 @@
+#ifndef BINEDITSTRINGSPANEL_H
+#define BINEDITSTRINGSPANEL_H
+
+#include <QtCore/QModelIndex>
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QWidget>
+#else
+#include <QtGui/QWidget>
+#endif
+
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QProgressBar;
+class QPushButton;
+class QSpinBox;
+class QTreeView;
+
+class BinEdit;
+class BinEditStringsModel;
+
+class BinEditStringsPanel : public QWidget
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BinEditStringsPanel)
+
+public:
+    explicit BinEditStringsPanel(BinEdit *editor, QWidget *parent = 0);
+
+public slots:
+    void activate();
+
+private slots:
+    void startOrCancel();
+    void onStarted();
+    void onProgressChanged(int value, int maximum);
+    void onFinished();
+    void onActivated(const QModelIndex &index);
+
+private:
+    void setupUi();
+    void retranslateUi();
+    void updateStatus();
+
+private:
+    BinEdit *m_editor;
+    BinEditStringsModel *m_model;
+
+    QSpinBox *m_minLengthBox;
+    QCheckBox *m_asciiBox;
+    QCheckBox *m_utf16Box;
+    QPushButton *m_extractButton;
+    QLineEdit *m_filterEdit;
+    QProgressBar *m_progressBar;
+    QLabel *m_statusLabel;
+    QTreeView *m_view;
+};
+
+#endif // BINEDITSTRINGSPANEL_H
@@ -0,0 +1,210 @@
+#include "bineditundojournal.h"
+
+#include "bineditaddbuffer.h"
+
+/*!
+    \class BinEditUndoJournal
+
+    Undo history of a BinEditPieceTable.
+
+    Every step replaces a range of the data with another one of any length,
+    so overwriting, inserting, removing and filling are all recorded the same
+    way. A step keeps the pieces it took out of the table rather than the
+    bytes themselves, undoing a fill of any size is a single O(log n) swap of
+    pieces. Consecutive typing is merged into one step.
+
+    Old data is only copied when the original it refers to is about to be
+    overwritten by a save, see detach(). It goes to the add buffer, which
+    spills to a temporary file past a threshold. The size of the old data
+    and of the journal itself is capped by limit(), the oldest steps are
+    dropped beyond it.
+*/
+
+BinEditUndoJournal::BinEditUndoJournal() :
+    m_cleanIndex(0),
+    m_limit(DefaultLimit),
+    m_usage(0)
+{
+}
+
+void BinEditUndoJournal::setLimit(qint64 limit)
+{
+    m_limit = qMax<qint64>(0, limit);
+    trim();
+}
+
+/*!
+    Marks the current state as the unmodified one if \a clean is true, or
+    makes the unmodified state unreachable otherwise.
+*/
+void BinEditUndoJournal::setClean(bool clean)
+{
+    m_cleanIndex = clean ? m_undo.size() : -1;
+}
+
+void BinEditUndoJournal::clear()
+{
+    m_undo.clear();
+    m_redo.clear();
+    m_cleanIndex = 0;
+    m_usage = 0;
+}
+
+/*!
+    Records that the \a removed pieces at \a position were replaced by
+    \a insertedLength bytes, which are in the table already.
+
+    A \a mergeable step that continues the previous mergeable one, or
+    changes data that step inserted, extends it instead.
+*/
+void BinEditUndoJournal::record(qint64 position, const BinEditPieceTable::PieceList &removed,
+                                qint64 insertedLength, bool mergeable)
+{
+    m_redo.clear();
+    if (m_cleanIndex > m_undo.size())
+        m_cleanIndex = -1;
+
+    qint64 removedLength = 0;
+    foreach (const BinEditPieceTable::Piece &piece, removed)
+        removedLength += piece.length;
+
+    // The unmodified state must stay reachable, don't change the step
+    // leading to it.
+    if (mergeable && !m_undo.isEmpty() && m_undo.last().mergeable
+            && m_cleanIndex != m_undo.size()) {
+        Entry &top = m_undo.last();
+        const qint64 topEnd = top.position + top.insertedLength;
+        if (position >= top.position && position + removedLength <= topEnd) {
+            // Only data top inserted is replaced, undoing top removes it anyway.
+            top.insertedLength += insertedLength - removedLength;
+            return;
+        }
+        if (position == topEnd) {
+            top.removedLength += removedLength;
+            top.insertedLength += insertedLength;
+            setPieces(&top, top.pieces + removed);
+            trim();
+            return;
+        }
+    }
+
+    Entry entry;
+    entry.position = position;
+    entry.removedLength = removedLength;
+    entry.insertedLength = insertedLength;
+    entry.mergeable = mergeable;
+    entry.usage = 0;
+    setPieces(&entry, removed);
+    m_undo.append(entry);
+    trim();
+}
+
+/*!
+    Reverts the last step in \a table.
+*/
+BinEditUndoJournal::Change BinEditUndoJournal::undo(BinEditPieceTable *table)
+{
+    Entry entry = m_undo.takeLast();
+    const BinEditPieceTable::PieceList inserted = table->remove(entry.position, entry.insertedLength);
+    table->insertPieces(entry.position, entry.pieces);
+    setPieces(&entry, inserted);
+    m_redo.append(entry);
+
+    const Change change = { entry.position, entry.insertedLength, entry.removedLength };
+    return change;
+}
+
+/*!
+    Applies the last undone step to \a table again.
+*/
+BinEditUndoJournal::Change BinEditUndoJournal::redo(BinEditPieceTable *table)
+{
+    Entry entry = m_redo.takeLast();
+    const BinEditPieceTable::PieceList removed = table->remove(entry.position, entry.removedLength);
+    table->insertPieces(entry.position, entry.pieces);
+    setPieces(&entry, removed);
+    m_undo.append(entry);
+
+    const Change change = { entry.position, entry.removedLength, entry.insertedLength };
+    return change;
+}
+
+/*!
+    Copies all original data the journal refers to from \a provider at
+    \a baseAddress into \a buffer. This must be done before the original is
+    overwritten, steps that can't be copied are dropped and false is
+    returned.
+*/
+bool BinEditUndoJournal::detach(const BinEditBlockProvider *provider, quint64 baseAddress,
+                                BinEditAddBuffer *buffer)
+{
+    bool ok = true;
+    for (int i = m_undo.size() - 1; i >= 0; --i) {
+        if (!detach(&m_undo[i], provider, baseAddress, buffer)) {
+            // Older steps would apply on top of a missing one.
+            m_cleanIndex = m_cleanIndex > i ? m_cleanIndex - i - 1 : -1;
+            for (int j = 0; j <= i; ++j)
+                m_usage -= m_undo.at(j).usage;
+            m_undo.erase(m_undo.begin(), m_undo.begin() + i + 1);
+            ok = false;
+            break;
+        }
+    }
+    for (int i = m_redo.size() - 1; i >= 0; --i) {
+        if (!detach(&m_redo[i], provider, baseAddress, buffer)) {
+            // Farther steps are redone on top of this one.
+            for (int j = 0; j <= i; ++j)
+                m_usage -= m_redo.at(j).usage;
+            m_redo.erase(m_redo.begin(), m_redo.begin() + i + 1);
+            if (m_cleanIndex > m_undo.size() + m_redo.size())
+                m_cleanIndex = -1;
+            ok = false;
+            break;
+        }
+    }
+    trim();
+    return ok;
+}
+
+qint64 BinEditUndoJournal::usage(const BinEditPieceTable::PieceList &pieces)
+{
+    qint64 result = sizeof(Entry) + pieces.size() * sizeof(BinEditPieceTable::Piece);
+    foreach (const BinEditPieceTable::Piece &piece, pieces) {
+        if (piece.source == BinEditPieceTable::Added)
+            result += piece.length;
+    }
+    return result;
+}
+
+void BinEditUndoJournal::setPieces(Entry *entry, const BinEditPieceTable::PieceList &pieces)
+{
+    entry->pieces = pieces;
+    m_usage -= entry->usage;
+    entry->usage = usage(pieces);
+    m_usage += entry->usage;
+}
+
+bool BinEditUndoJournal::detach(Entry *entry, const BinEditBlockProvider *provider,
+                                quint64 baseAddress, BinEditAddBuffer *buffer)
+{
+    BinEditPieceTable::PieceList pieces = entry->pieces;
+    if (!BinEditPieceTable::detach(&pieces, provider, baseAddress, buffer))
+        return false;
+    setPieces(entry, pieces);
+    return true;
+}
+
+// Drops the oldest undo steps, then the farthest redo steps, until the
+// journal fits its limit.
+void BinEditUndoJournal::trim()
+{
+    while (m_usage > m_limit && !m_undo.isEmpty()) {
+        m_usage -= m_undo.takeFirst().usage;
+        m_cleanIndex = m_cleanIndex > 0 ? m_cleanIndex - 1 : -1;
+    }
+    while (m_usage > m_limit && !m_redo.isEmpty()) {
+        m_usage -= m_redo.takeFirst().usage;
+        if (m_cleanIndex > m_undo.size() + m_redo.size())
+            m_cleanIndex = -1;
+    }
+}
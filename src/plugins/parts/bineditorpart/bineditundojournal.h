@@ -0,0 +1,71 @@
+#ifndef BINEDITUNDOJOURNAL_H
+#define BINEDITUNDOJOURNAL_H
+
+#include "bineditpiecetable.h"
+
+#include <QtCore/QList>
+
+class BinEditAddBuffer;
+class BinEditBlockProvider;
+
+class BinEditUndoJournal
+{
+    Q_DISABLE_COPY(BinEditUndoJournal)
+
+public:
+    static const qint64 DefaultLimit = 64 * 1024 * 1024;
+
+    // oldLength bytes at position were replaced by newLength bytes.
+    struct Change {
+        qint64 position;
+        qint64 oldLength;
+        qint64 newLength;
+    };
+
+    BinEditUndoJournal();
+
+    qint64 limit() const { return m_limit; }
+    void setLimit(qint64 limit);
+    qint64 usage() const { return m_usage; }
+
+    bool canUndo() const { return !m_undo.isEmpty(); }
+    bool canRedo() const { return !m_redo.isEmpty(); }
+
+    bool isClean() const { return m_cleanIndex == m_undo.size(); }
+    void setClean(bool clean);
+    void clear();
+
+    void record(qint64 position, const BinEditPieceTable::PieceList &removed,
+                qint64 insertedLength, bool mergeable);
+    Change undo(BinEditPieceTable *table);
+    Change redo(BinEditPieceTable *table);
+
+    bool detach(const BinEditBlockProvider *provider, quint64 baseAddress,
+                BinEditAddBuffer *buffer);
+
+private:
+    struct Entry {
+        qint64 position;
+        qint64 removedLength;
+        qint64 insertedLength;
+        // The data not in the table: what was removed for undo entries,
+        // what was inserted for redo entries.
+        BinEditPieceTable::PieceList pieces;
+        bool mergeable;
+        qint64 usage;
+    };
+
+    static qint64 usage(const BinEditPieceTable::PieceList &pieces);
+    void setPieces(Entry *entry, const BinEditPieceTable::PieceList &pieces);
+    bool detach(Entry *entry, const BinEditBlockProvider *provider, quint64 baseAddress,
+                BinEditAddBuffer *buffer);
+    void trim();
+
+    QList<Entry> m_undo;
+    QList<Entry> m_redo;
+    int m_cleanIndex; // Undo entries at the unmodified state, -1 if it is gone.
+    qint64 m_limit;
+    qint64 m_usage;
+};
+
+#endif // BINEDITUNDOJOURNAL_H
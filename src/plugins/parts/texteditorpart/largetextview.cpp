@@ -0,0 +1,468 @@
+#include "largetextview.h"
+
+#include "textlineindex.h"
+
+#include <QtCore/QtAlgorithms>
+
+#include <QtGui/QKeyEvent>
+#include <QtGui/QPainter>
+#include <QtGui/QTextLayout>
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QAction>
+#include <QtWidgets/QApplication>
+#include <QtWidgets/QClipboard>
+#include <QtWidgets/QInputDialog>
+#include <QtWidgets/QScrollBar>
+#else
+#include <QtGui/QAction>
+#include <QtGui/QApplication>
+#include <QtGui/QClipboard>
+#include <QtGui/QInputDialog>
+#include <QtGui/QScrollBar>
+#endif
+
+#include <limits.h>
+
+using namespace TextEditor;
+
+static const int Margin = 4;
+static const int TabStopColumns = 8;
+
+/*!
+    \class LargeTextView
+
+    Read-only view of a file that is too large for QTextDocument.
+
+    The text is read from the mapping of a TextLineIndex and only the
+    visible lines are decoded and laid out, so the view costs the same for
+    any file size. Positions and selections are byte offsets in the file.
+    Lines longer than TextLineIndex::MaxLineLength are shown cut.
+*/
+
+/*!
+    Creates LargeTextView with the given \a parent.
+*/
+LargeTextView::LargeTextView(QWidget *parent) :
+    QAbstractScrollArea(parent),
+    m_index(0),
+    m_anchor(0),
+    m_position(0),
+    m_scrollScale(1),
+    m_textWidth(0),
+    m_findLength(0)
+{
+    setFocusPolicy(Qt::WheelFocus);
+    viewport()->setCursor(Qt::IBeamCursor);
+
+    m_copyAction = new QAction(tr("Copy"), this);
+    m_copyAction->setShortcut(QKeySequence::Copy);
+    m_copyAction->setIcon(QIcon::fromTheme("edit-copy"));
+    m_copyAction->setEnabled(false);
+    connect(m_copyAction, SIGNAL(triggered()), SLOT(copy()));
+    connect(this, SIGNAL(copyAvailable(bool)), m_copyAction, SLOT(setEnabled(bool)));
+    addAction(m_copyAction);
+
+    m_selectAllAction = new QAction(tr("Select All"), this);
+    m_selectAllAction->setShortcut(QKeySequence::SelectAll);
+    connect(m_selectAllAction, SIGNAL(triggered()), SLOT(selectAll()));
+    addAction(m_selectAllAction);
+
+    m_gotoLineAction = new QAction(tr("Go to Line..."), this);
+    m_gotoLineAction->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_L));
+    connect(m_gotoLineAction, SIGNAL(triggered()), SLOT(requestGotoLine()));
+    addAction(m_gotoLineAction);
+
+    setContextMenuPolicy(Qt::ActionsContextMenu);
+}
+
+/*!
+    Shows the file of \a index, which must stay valid while it is shown.
+*/
+void LargeTextView::setLineIndex(TextLineIndex *index)
+{
+    if (m_index == index)
+        return;
+
+    if (m_index) {
+        m_index->cancelFind();
+        disconnect(m_index, 0, this, 0);
+    }
+    m_index = index;
+    if (m_index) {
+        connect(m_index, SIGNAL(linesChanged()), SLOT(updateScrollBars()));
+        connect(m_index, SIGNAL(linesChanged()), viewport(), SLOT(update()));
+        connect(m_index, SIGNAL(findFinished(qint64)), SLOT(handleFindFinished(qint64)));
+    }
+
+    m_textWidth = 0;
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+    setSelection(0, 0);
+    updateScrollBars();
+    viewport()->update();
+}
+
+/*!
+    Selects the bytes between \a anchor and \a position.
+*/
+void LargeTextView::setSelection(qint64 anchor, qint64 position)
+{
+    const qint64 size = m_index ? m_index->size() : 0;
+    anchor = qBound<qint64>(0, anchor, size);
+    position = qBound<qint64>(0, position, size);
+    if (anchor == m_anchor && position == m_position)
+        return;
+
+    const bool hadSelection = hasSelection();
+    m_anchor = anchor;
+    m_position = position;
+    if (hasSelection() != hadSelection)
+        emit copyAvailable(hasSelection());
+    viewport()->update();
+}
+
+QString LargeTextView::selectedText() const
+{
+    if (!m_index || !hasSelection() || selectionEnd() - selectionStart() > MaxCopySize)
+        return QString();
+    return m_index->text(selectionStart(), selectionEnd());
+}
+
+/*!
+    Starts looking for the next occurrence of \a text after the selection,
+    or the one before it with QTextDocument::FindBackward, wrapping around
+    at the end of the file. An \a incremental search starts at the
+    selection, so that it grows while the text is typed.
+
+    The file is searched on a worker thread, the occurrence is selected
+    when it is found. Starting another search cancels this one.
+*/
+void LargeTextView::find(const QString &text, QTextDocument::FindFlags flags, bool incremental)
+{
+    if (!m_index || text.isEmpty())
+        return;
+
+    const QByteArray needle = m_index->encode(text);
+    const bool backward = flags & QTextDocument::FindBackward;
+    const bool caseSensitive = flags & QTextDocument::FindCaseSensitively;
+    const bool wholeWords = flags & QTextDocument::FindWholeWords;
+    qint64 from = selectionEnd();
+    if (incremental)
+        from = selectionStart();
+    else if (backward)
+        from = selectionStart() - 1;
+
+    m_findLength = needle.size();
+    m_index->startFind(needle, from, backward, caseSensitive, wholeWords);
+}
+
+void LargeTextView::handleFindFinished(qint64 offset)
+{
+    if (offset < 0)
+        return;
+
+    setSelection(offset, offset + m_findLength);
+    ensureVisible(offset + m_findLength);
+    ensureVisible(offset);
+}
+
+/*!
+    Moves to the start of \a line, counted from 0.
+*/
+void LargeTextView::gotoLine(qint64 line)
+{
+    if (!m_index)
+        return;
+
+    line = qBound<qint64>(0, line, m_index->lineCount() - 1);
+    const qint64 start = m_index->lineStart(line);
+    setSelection(start, start);
+    setTopLine(line - visibleLineCount() / 2);
+    horizontalScrollBar()->setValue(0);
+}
+
+void LargeTextView::copy()
+{
+    if (!hasSelection())
+        return;
+
+    if (selectionEnd() - selectionStart() > MaxCopySize) {
+        QApplication::beep();
+        return;
+    }
+    QApplication::clipboard()->setText(selectedText());
+}
+
+void LargeTextView::selectAll()
+{
+    if (m_index)
+        setSelection(0, m_index->size());
+}
+
+/*!
+    Asks for a line number and moves there.
+*/
+void LargeTextView::requestGotoLine()
+{
+    if (!m_index)
+        return;
+
+    const qint64 lineCount = m_index->lineCount();
+    bool ok = false;
+    const QString text = QInputDialog::getText(this, tr("Go to Line"),
+                                               tr("Line (1 - %1):").arg(lineCount),
+                                               QLineEdit::Normal, QString(), &ok);
+    if (!ok)
+        return;
+
+    const qint64 line = text.trimmed().toLongLong(&ok);
+    if (ok)
+        gotoLine(line - 1);
+}
+
+void LargeTextView::changeEvent(QEvent *e)
+{
+    QAbstractScrollArea::changeEvent(e);
+    if (e->type() == QEvent::FontChange) {
+        m_textWidth = 0;
+        updateScrollBars();
+    }
+}
+
+void LargeTextView::paintEvent(QPaintEvent *)
+{
+    QPainter painter(viewport());
+    const int gutter = gutterWidth();
+    const int height = lineHeight();
+    painter.fillRect(0, 0, gutter, viewport()->height(), palette().window());
+    if (!m_index)
+        return;
+
+    const qint64 top = topLine();
+    const qint64 lineCount = m_index->lineCount();
+    const int xOffset = horizontalScrollBar()->value();
+    const qint64 selectionFrom = selectionStart();
+    const qint64 selectionTo = selectionEnd();
+    int textWidth = m_textWidth;
+
+    for (int row = 0; row <= visibleLineCount() && top + row < lineCount; ++row) {
+        const qint64 line = top + row;
+        const int y = row * height;
+        QVector<qint64> offsets;
+        const QString text = m_index->lineText(line, &offsets);
+        const qint64 start = offsets.first();
+        const qint64 end = offsets.last();
+
+        painter.setPen(palette().color(QPalette::Disabled, QPalette::Text));
+        painter.drawText(QRect(0, y, gutter - Margin, height), Qt::AlignRight | Qt::AlignVCenter,
+                         QString::number(line + 1));
+
+        QTextLayout layout(text, font());
+        layoutLine(&layout);
+        textWidth = qMax(textWidth, int(layout.lineAt(0).naturalTextWidth()));
+
+        QVector<QTextLayout::FormatRange> selections;
+        if (selectionFrom < selectionTo && selectionFrom <= end && selectionTo > start) {
+            QTextLayout::FormatRange range;
+            range.start = columnAt(offsets, selectionFrom);
+            range.length = columnAt(offsets, selectionTo) - range.start;
+            // The line break is selected as a space.
+            if (selectionTo > end) {
+                layout.setText(text + QLatin1Char(' '));
+                layoutLine(&layout);
+                ++range.length;
+            }
+            range.format.setBackground(palette().highlight());
+            range.format.setForeground(palette().highlightedText());
+            selections.append(range);
+        }
+
+        painter.save();
+        painter.setClipRect(gutter, y, viewport()->width() - gutter, height);
+        painter.setPen(palette().color(QPalette::Text));
+        layout.draw(&painter, QPointF(gutter + Margin - xOffset, y), selections);
+        painter.restore();
+    }
+
+    if (textWidth > m_textWidth) {
+        m_textWidth = textWidth;
+        updateScrollBars();
+    }
+}
+
+void LargeTextView::resizeEvent(QResizeEvent *e)
+{
+    QAbstractScrollArea::resizeEvent(e);
+    updateScrollBars();
+}
+
+void LargeTextView::keyPressEvent(QKeyEvent *e)
+{
+    const int pageLines = qMax(1, visibleLineCount() - 1);
+    switch (e->key()) {
+    case Qt::Key_Up:
+        setTopLine(topLine() - 1);
+        break;
+    case Qt::Key_Down:
+        setTopLine(topLine() + 1);
+        break;
+    case Qt::Key_PageUp:
+        setTopLine(topLine() - pageLines);
+        break;
+    case Qt::Key_PageDown:
+        setTopLine(topLine() + pageLines);
+        break;
+    case Qt::Key_Left:
+        horizontalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepSub);
+        break;
+    case Qt::Key_Right:
+        horizontalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+        break;
+    case Qt::Key_Home:
+        if (e->modifiers() & Qt::ControlModifier)
+            setTopLine(0);
+        horizontalScrollBar()->setValue(0);
+        break;
+    case Qt::Key_End:
+        if (e->modifiers() & Qt::ControlModifier && m_index)
+            setTopLine(m_index->lineCount());
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(e);
+        return;
+    }
+    e->accept();
+}
+
+void LargeTextView::mousePressEvent(QMouseEvent *e)
+{
+    if (e->button() != Qt::LeftButton || !m_index)
+        return;
+
+    const qint64 position = offsetAt(e->pos());
+    setSelection(e->modifiers() & Qt::ShiftModifier ? m_anchor : position, position);
+}
+
+void LargeTextView::mouseMoveEvent(QMouseEvent *e)
+{
+    if (!(e->buttons() & Qt::LeftButton) || !m_index)
+        return;
+
+    // Dragging past the top or bottom scrolls by a line per move.
+    if (e->pos().y() < 0)
+        setTopLine(topLine() - 1);
+    else if (e->pos().y() >= viewport()->height())
+        setTopLine(topLine() + 1);
+    setSelection(m_anchor, offsetAt(e->pos()));
+}
+
+void LargeTextView::updateScrollBars()
+{
+    const qint64 lineCount = m_index ? m_index->lineCount() : 0;
+    const qint64 maxTop = qMax<qint64>(0, lineCount - visibleLineCount() + 1);
+    // Scroll bars count in int, files may have more lines.
+    m_scrollScale = maxTop / INT_MAX + 1;
+    verticalScrollBar()->setRange(0, int(maxTop / m_scrollScale));
+    verticalScrollBar()->setPageStep(qMax(1, int(visibleLineCount() / m_scrollScale)));
+
+    const int width = viewport()->width() - gutterWidth() - 2 * Margin;
+    horizontalScrollBar()->setRange(0, qMax(0, m_textWidth - width));
+    horizontalScrollBar()->setPageStep(qMax(1, width));
+    horizontalScrollBar()->setSingleStep(fontMetrics().width(QLatin1Char('x')));
+}
+
+qint64 LargeTextView::topLine() const
+{
+    return qint64(verticalScrollBar()->value()) * m_scrollScale;
+}
+
+void LargeTextView::setTopLine(qint64 line)
+{
+    verticalScrollBar()->setValue(int(qMax<qint64>(0, line) / m_scrollScale));
+}
+
+int LargeTextView::lineHeight() const
+{
+    return qMax(1, fontMetrics().lineSpacing());
+}
+
+int LargeTextView::visibleLineCount() const
+{
+    return viewport()->height() / lineHeight();
+}
+
+int LargeTextView::gutterWidth() const
+{
+    const qint64 lineCount = m_index ? m_index->lineCount() : 1;
+    const int digits = QString::number(lineCount).size();
+    return fontMetrics().width(QLatin1Char('9')) * qMax(3, digits) + 2 * Margin;
+}
+
+/*
+    Returns the column of the first character at or after \a offset in a
+    line whose characters start at \a offsets.
+*/
+int LargeTextView::columnAt(const QVector<qint64> &offsets, qint64 offset)
+{
+    const QVector<qint64>::const_iterator it =
+            qLowerBound(offsets.constBegin(), offsets.constEnd() - 1, offset);
+    return int(it - offsets.constBegin());
+}
+
+void LargeTextView::layoutLine(QTextLayout *layout) const
+{
+    QTextOption option;
+    option.setWrapMode(QTextOption::NoWrap);
+    option.setTabStop(fontMetrics().width(QLatin1Char(' ')) * TabStopColumns);
+    layout->setTextOption(option);
+    layout->beginLayout();
+    QTextLine line = layout->createLine();
+    line.setLineWidth(INT_MAX / 2);
+    layout->endLayout();
+}
+
+/*
+    Returns the offset of the character boundary nearest to \a pos.
+*/
+qint64 LargeTextView::offsetAt(const QPoint &pos) const
+{
+    const qint64 row = pos.y() < 0 ? -1 : pos.y() / lineHeight();
+    const qint64 line = qBound<qint64>(0, topLine() + row, m_index->lineCount() - 1);
+    QVector<qint64> offsets;
+    const QString text = m_index->lineText(line, &offsets);
+
+    QTextLayout layout(text, font());
+    layoutLine(&layout);
+    const qreal x = pos.x() - gutterWidth() - Margin + horizontalScrollBar()->value();
+    const int column = layout.lineAt(0).xToCursor(qMax<qreal>(0, x));
+    return offsets.at(qBound(0, column, text.size()));
+}
+
+/*
+    Scrolls so that \a offset is shown.
+*/
+void LargeTextView::ensureVisible(qint64 offset)
+{
+    const qint64 line = m_index->lineAt(offset);
+    const qint64 top = topLine();
+    if (line < top || line >= top + visibleLineCount())
+        setTopLine(line - visibleLineCount() / 2);
+
+    if (m_index->lineStart(line) < 0)
+        return;
+
+    // Only the part of long lines that is shown counts.
+    QVector<qint64> offsets;
+    QTextLayout layout(m_index->lineText(line, &offsets), font());
+    layoutLine(&layout);
+    const int x = int(layout.lineAt(0).cursorToX(columnAt(offsets, offset)));
+    const int width = viewport()->width() - gutterWidth() - 2 * Margin;
+    QScrollBar *bar = horizontalScrollBar();
+    if (x > m_textWidth) {
+        m_textWidth = x;
+        updateScrollBars();
+    }
+    if (x < bar->value() || x > bar->value() + width)
+        bar->setValue(qMax(0, x - width / 2));
+}
@@ -0,0 +1,89 @@
+#ifndef LARGETEXTVIEW_H
+#define LARGETEXTVIEW_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/QVector>
+
+#if QT_VERSION >= 0x050000
+#include <QtWidgets/QAbstractScrollArea>
+#else
+#include <QtGui/QAbstractScrollArea>
+#endif
+
+#include <QtGui/QTextDocument>
+
+class QAction;
+class QTextLayout;
+
+namespace TextEditor {
+
+class TextLineIndex;
+
+class LargeTextView : public QAbstractScrollArea
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(LargeTextView)
+
+public:
+    // Larger selections are not copied as a whole.
+    static const int MaxCopySize = 256 * 1024 * 1024;
+
+    explicit LargeTextView(QWidget *parent = 0);
+
+    TextLineIndex *lineIndex() const { return m_index; }
+    void setLineIndex(TextLineIndex *index);
+
+    bool hasSelection() const { return m_anchor != m_position; }
+    qint64 selectionStart() const { return qMin(m_anchor, m_position); }
+    qint64 selectionEnd() const { return qMax(m_anchor, m_position); }
+    void setSelection(qint64 anchor, qint64 position);
+    QString selectedText() const;
+
+    void find(const QString &text, QTextDocument::FindFlags flags, bool incremental);
+    void gotoLine(qint64 line);
+
+public slots:
+    void copy();
+    void selectAll();
+    void requestGotoLine();
+
+signals:
+    void copyAvailable(bool available);
+
+protected:
+    void changeEvent(QEvent *e);
+    void paintEvent(QPaintEvent *e);
+    void resizeEvent(QResizeEvent *e);
+    void keyPressEvent(QKeyEvent *e);
+    void mousePressEvent(QMouseEvent *e);
+    void mouseMoveEvent(QMouseEvent *e);
+
+private slots:
+    void updateScrollBars();
+    void handleFindFinished(qint64 offset);
+
+private:
+    qint64 topLine() const;
+    void setTopLine(qint64 line);
+    int lineHeight() const;
+    int visibleLineCount() const;
+    int gutterWidth() const;
+    static int columnAt(const QVector<qint64> &offsets, qint64 offset);
+    void layoutLine(QTextLayout *layout) const;
+    qint64 offsetAt(const QPoint &pos) const;
+    void ensureVisible(qint64 offset);
+
+    TextLineIndex *m_index;
+    qint64 m_anchor;
+    qint64 m_position;
+    qint64 m_scrollScale;
+    int m_textWidth;
+    int m_findLength;
+    QAction *m_copyAction;
+    QAction *m_selectAllAction;
+    QAction *m_gotoLineAction;
+};
+
+} // namespace TextEditor
+
+#endif // LARGETEXTVIEW_H
@@ -1,5 +1,15 @@
 #include "plaintextdocument.h"
 
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QTextCodec>
+#include <QtCore/QUrl>
+#include <QtGui/QTextBlock>
+#include <QtGui/QTextCursor>
 #include <QtGui/QTextDocument>
 
 #if QT_VERSION >= 0x050000
@@ -8,9 +18,89 @@
 #include <QtGui/QPlainTextDocumentLayout>
 #endif
 
+#if defined(Q_OS_UNIX)
+#include <stdio.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#include <windows.h>
+#endif
+
+#include "textencoding.h"
+#include "textlineindex.h"
+#include "textloader.h"
+
 using namespace Parts;
 using namespace TextEditor;
 
+// Characters collected before they are encoded and written while saving.
+static const int SaveBufferSize = 256 * 1024;
+
+static bool syncFile(QFile *file)
+{
+#if defined(Q_OS_UNIX)
+    return ::fsync(file->handle()) == 0;
+#elif defined(Q_OS_WIN)
+    return ::_commit(file->handle()) == 0;
+#else
+    Q_UNUSED(file);
+    return true;
+#endif
+}
+
+static bool replaceFile(const QString &source, const QString &target)
+{
+#if defined(Q_OS_UNIX)
+    return ::rename(QFile::encodeName(source).constData(),
+                    QFile::encodeName(target).constData()) == 0;
+#elif defined(Q_OS_WIN)
+    return ::MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(source).utf16()),
+                         reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(target).utf16()),
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    if (QFile::exists(target) && !QFile::remove(target))
+        return false;
+    return QFile::rename(source, target);
+#endif
+}
+
+static bool writeData(QIODevice *device, const QByteArray &data)
+{
+    return device->write(data) == data.size();
+}
+
+/*
+    Writes the text of \a document encoded with \a codec to \a device block
+    by block, so that only about SaveBufferSize characters are held at a
+    time instead of a copy of the whole text. Sets \a lossy if characters
+    can't be encoded.
+*/
+static bool writeBlocks(const QTextDocument *document, QIODevice *device,
+                        QTextCodec *codec, bool bom, bool *lossy = 0)
+{
+    // The byte order mark is written only if the file had one.
+    QScopedPointer<QTextEncoder> encoder(codec->makeEncoder(QTextCodec::IgnoreHeader));
+    if (bom && !writeData(device, TextEncoding::bom(codec)))
+        return false;
+
+    QString buffer;
+    buffer.reserve(SaveBufferSize);
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+        if (block != document->begin())
+            buffer += QLatin1Char('\n');
+        buffer += block.text();
+        if (buffer.size() >= SaveBufferSize) {
+            if (!writeData(device, encoder->fromUnicode(buffer)))
+                return false;
+            buffer.resize(0);
+        }
+    }
+    const bool ok = writeData(device, encoder->fromUnicode(buffer));
+    if (lossy)
+        *lossy = encoder->hasFailure();
+    return ok;
+}
+
 /*!
     \class PlainTextDocument
 */
@@ -20,13 +110,25 @@ using namespace TextEditor;
 */
 PlainTextDocument::PlainTextDocument(QObject *parent) :
     FileDocument(parent),
-    m_textDocument(new QTextDocument(this))
+    m_textDocument(new QTextDocument(this)),
+    m_loader(new TextLoader(this)),
+    m_lineIndex(new TextLineIndex(this)),
+    m_codec(QTextCodec::codecForName("UTF-8")),
+    m_forcedCodec(0),
+    m_bom(false)
 {
     setIcon(QIcon(":/texteditor/icons/texteditor.png"));
     m_textDocument->setDocumentLayout(new QPlainTextDocumentLayout(m_textDocument));
 
     connect(m_textDocument, SIGNAL(modificationChanged(bool)), this, SLOT(setModified(bool)));
     connect(this, SIGNAL(modificationChanged(bool)), m_textDocument, SLOT(setModified(bool)));
+
+    connect(m_loader, SIGNAL(textLoaded(QString)), SLOT(appendText(QString)));
+    connect(m_loader, SIGNAL(progressChanged(int)), SLOT(setProgress(int)));
+    connect(m_loader, SIGNAL(finished(bool)), SLOT(handleLoadFinished()));
+
+    connect(m_lineIndex, SIGNAL(progressChanged(int)), SLOT(setProgress(int)));
+    connect(m_lineIndex, SIGNAL(finished()), SLOT(handleIndexFinished()));
 }
 
 QTextDocument * PlainTextDocument::textDocument() const
@@ -34,22 +136,290 @@ QTextDocument * PlainTextDocument::textDocument() const
     return m_textDocument;
 }
 
+/*!
+    Returns the index of the file shown instead of textDocument() if it is
+    a large file, 0 otherwise.
+*/
+TextLineIndex * PlainTextDocument::lineIndex() const
+{
+    return isLargeFile() ? m_lineIndex : 0;
+}
+
+/*!
+    Returns true if the file is larger than LargeFileSize and shown
+    read-only from its mapping.
+*/
+bool PlainTextDocument::isLargeFile() const
+{
+    return m_lineIndex->isOpen();
+}
+
+/*!
+    Returns true while a file is read in the background.
+*/
+bool PlainTextDocument::isLoading() const
+{
+    return m_loader->isRunning();
+}
+
+/*!
+    Returns the name of the encoding the file is read and saved with.
+*/
+QByteArray PlainTextDocument::encoding() const
+{
+    return m_codec->name();
+}
+
+/*!
+    Sets the encoding the file is read and saved with to \a encoding instead
+    of the detected one. An unmodified file is read again with it, the text
+    of a modified one is converted when it is saved.
+*/
+void PlainTextDocument::setEncoding(const QByteArray &encoding)
+{
+    QTextCodec *codec = QTextCodec::codecForName(encoding);
+    if (!codec)
+        return;
+
+    m_forcedCodec = codec;
+    if (codec == m_codec)
+        return;
+
+    const QString fileName = url().toLocalFile();
+    QFile file(fileName);
+    if (!m_textDocument->isModified() && !fileName.isEmpty() && file.open(QIODevice::ReadOnly)) {
+        read(&file, fileName);
+        return;
+    }
+    // Without a byte order mark UTF-16 is hard to tell when read again.
+    setCodec(codec, !TextEncoding::isAsciiCompatible(codec));
+}
+
 /*!
     \reimp
+
+    Files larger than the first chunk are read on a worker thread and
+    appended as they are decoded; the document is not undoable and the
+    editor read-only until the whole file is there. Files larger than
+    LargeFileSize are not loaded at all, see lineIndex().
+
+    The encoding is detected from the start of the file unless one was set
+    with setEncoding().
 */
 bool PlainTextDocument::read(QIODevice *device, const QString &/*fileName*/)
 {
-    m_textDocument->setPlainText(QString::fromUtf8(device->readAll()));
+    m_loader->cancel();
+
+    QFile *file = qobject_cast<QFile *>(device);
+    if (!file || file->fileName().isEmpty() || file->isSequential()) {
+        closeLargeFile();
+        const QByteArray data = device->readAll();
+        const int bomLength = detectCodec(data, true);
+        m_textDocument->setPlainText(m_codec->toUnicode(data.constData() + bomLength,
+                                                        data.size() - bomLength));
+        setModified(false);
+        return true;
+    }
+
+    const qint64 size = file->size() - file->pos();
+    const QByteArray sample = file->peek(TextEncoding::SampleSize);
+    const int bomLength = detectCodec(sample, sample.size() >= size);
+
+    // Line breaks are found byte-wise in the mapping, UTF-16 files are
+    // loaded however large they are.
+    if (file->size() >= LargeFileSize && TextEncoding::isAsciiCompatible(m_codec)
+            && openLargeFile(file->fileName())) {
+        return true;
+    }
+    closeLargeFile();
+
+    if (size <= TextLoader::FirstChunkSize) {
+        const QByteArray data = file->readAll();
+        m_textDocument->setPlainText(m_codec->toUnicode(data.constData() + bomLength,
+                                                        data.size() - bomLength));
+        setModified(false);
+        return true;
+    }
+
+    m_textDocument->setUndoRedoEnabled(false);
+    m_textDocument->clear();
+    setModified(false);
+    setState(OpenningState);
+    m_loader->start(file->fileName(), file->pos() + bomLength, m_codec);
+    emit loadingChanged(true);
+    return true;
+}
+
+void PlainTextDocument::appendText(const QString &text)
+{
+    QTextCursor cursor(m_textDocument);
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(text);
+    m_textDocument->setModified(false);
+}
+
+void PlainTextDocument::handleLoadFinished()
+{
+    // A canceled load leaves what was read so far.
+    if (!m_loader->errorString().isEmpty())
+        qWarning() << "PlainTextDocument::read" << m_loader->errorString();
+    m_textDocument->setUndoRedoEnabled(true);
+    m_textDocument->setModified(false);
+    setState(NoState);
+    emit loadingChanged(false);
+}
+
+void PlainTextDocument::handleIndexFinished()
+{
+    setState(NoState);
+}
+
+bool PlainTextDocument::openLargeFile(const QString &fileName)
+{
+    const bool wasLarge = isLargeFile();
+    m_lineIndex->setCodec(m_codec);
+    // 32 bit systems may not be able to map the file, it is loaded then.
+    if (!m_lineIndex->open(fileName)) {
+        qWarning() << "PlainTextDocument::read" << "Cannot map" << fileName
+                   << m_lineIndex->errorString();
+        if (wasLarge)
+            emit largeFileChanged(false);
+        return false;
+    }
+
+    m_textDocument->clear();
     setModified(false);
+    if (!m_lineIndex->isComplete())
+        setState(OpenningState);
+    emit largeFileChanged(true);
     return true;
 }
 
+/*
+    Picks the codec for a file starting with \a sample and returns the
+    length of its byte order mark.
+*/
+int PlainTextDocument::detectCodec(const QByteArray &sample, bool atEnd)
+{
+    int bomLength = 0;
+    QTextCodec *codec = m_forcedCodec;
+    if (codec)
+        bomLength = TextEncoding::bomLength(sample, codec);
+    else
+        codec = TextEncoding::detect(sample, atEnd, &bomLength);
+    setCodec(codec ? codec : QTextCodec::codecForName("UTF-8"), bomLength > 0);
+    return bomLength;
+}
+
+void PlainTextDocument::setCodec(QTextCodec *codec, bool bom)
+{
+    m_bom = bom;
+    if (codec == m_codec)
+        return;
+
+    m_codec = codec;
+    emit encodingChanged(encoding());
+}
+
+void PlainTextDocument::closeLargeFile()
+{
+    if (!isLargeFile())
+        return;
+
+    m_lineIndex->close();
+    setState(NoState);
+    emit largeFileChanged(false);
+}
+
 /*!
     \reimp
 */
 bool PlainTextDocument::write(QIODevice *device, const QString &/*fileName*/)
 {
-    device->write(m_textDocument->toPlainText().toUtf8());
+    // A partly loaded document would truncate the file, a large one is
+    // read from the file being written.
+    if (isLoading() || isLargeFile())
+        return false;
+
+    return writeBlocks(m_textDocument, device, m_codec, m_bom);
+}
+
+/*!
+    \reimp
+
+    The text is streamed into a temporary file next to the target, which
+    replaces the target once it is on disk. A failed save leaves the old
+    file as it was, and saveFailed() tells why.
+*/
+bool PlainTextDocument::saveUrl(const QUrl &url)
+{
+    const QString fileName = url.isEmpty() ? this->url().toLocalFile() : url.toLocalFile();
+
+    QString errorString;
+    if (!saveFile(fileName, &errorString)) {
+        emit saveFailed(errorString);
+        return false;
+    }
+    m_textDocument->setModified(false);
+    return true;
+}
+
+bool PlainTextDocument::saveFile(const QString &fileName, QString *errorString)
+{
+    // Links are kept, the file they point to is replaced.
+    const QFileInfo linkInfo(fileName);
+    const QFileInfo info(linkInfo.isSymLink() ? linkInfo.symLinkTarget() : fileName);
+    const QString nativeName = QDir::toNativeSeparators(fileName);
+    if (isLoading()) {
+        *errorString = tr("Cannot save %1 before it is loaded completely.").arg(nativeName);
+        return false;
+    }
+
+    // Large files are read-only, only copies of them are written.
+    if (isLargeFile() && info.canonicalFilePath()
+            == QFileInfo(m_lineIndex->fileName()).canonicalFilePath()) {
+        return true;
+    }
+
+    QTemporaryFile file(info.absolutePath() + QLatin1String("/.")
+                        + info.fileName() + QLatin1String(".XXXXXX"));
+    if (!file.open()) {
+        *errorString = tr("Cannot write %1: %2").arg(nativeName, file.errorString());
+        return false;
+    }
+
+    bool ok = true;
+    bool lossy = false;
+    if (isLargeFile()) {
+        const qint64 size = m_lineIndex->size();
+        for (qint64 offset = 0; ok && offset < size; offset += TextLineIndex::ChunkSize) {
+            const qint64 length = qMin<qint64>(TextLineIndex::ChunkSize, size - offset);
+            ok = file.write(m_lineIndex->data() + offset, length) == length;
+        }
+    } else {
+        ok = writeBlocks(m_textDocument, &file, m_codec, m_bom, &lossy);
+    }
+    if (lossy) {
+        *errorString = tr("Cannot save %1: some characters cannot be encoded in %2.")
+                .arg(nativeName, QString::fromLatin1(encoding()));
+        return false;
+    }
+    if (!ok || !file.flush() || !syncFile(&file)) {
+        *errorString = tr("Cannot write %1: %2").arg(nativeName, file.errorString());
+        return false;
+    }
+
+    if (info.exists())
+        file.setPermissions(QFile::permissions(info.filePath()));
+    else
+        file.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
+    file.close();
+
+    if (!replaceFile(file.fileName(), info.filePath())) {
+        *errorString = tr("Cannot write %1: %2").arg(nativeName, tr("Cannot replace the file."));
+        return false;
+    }
+    file.setAutoRemove(false);
     return true;
 }
 
@@ -4,26 +4,65 @@
 #include <Parts/AbstractDocumentFactory>
 #include <Parts/FileDocument>
 
+class QTextCodec;
 class QTextDocument;
 
 namespace TextEditor {
 
+class TextLineIndex;
+class TextLoader;
+
 class PlainTextDocument : public Parts::FileDocument
 {
     Q_OBJECT
     Q_DISABLE_COPY(PlainTextDocument)
 
 public:
+    // Larger files are shown read-only from a mapping instead of being
+    // loaded into textDocument().
+    static const qint64 LargeFileSize = Q_INT64_C(256) * 1024 * 1024;
+
     explicit PlainTextDocument(QObject *parent = 0);
 
     QTextDocument *textDocument() const;
+    TextLineIndex *lineIndex() const;
+
+    bool isLoading() const;
+    bool isLargeFile() const;
+
+    QByteArray encoding() const;
+    void setEncoding(const QByteArray &encoding);
+
+signals:
+    void loadingChanged(bool loading);
+    void largeFileChanged(bool large);
+    void encodingChanged(const QByteArray &encoding);
+    void saveFailed(const QString &errorString);
 
 protected:
     bool read(QIODevice *device, const QString &fileName);
     bool write(QIODevice *device, const QString &fileName);
+    bool saveUrl(const QUrl &url);
+
+private slots:
+    void appendText(const QString &text);
+    void handleLoadFinished();
+    void handleIndexFinished();
+
+private:
+    bool saveFile(const QString &fileName, QString *errorString);
+    bool openLargeFile(const QString &fileName);
+    void closeLargeFile();
+    int detectCodec(const QByteArray &sample, bool atEnd);
+    void setCodec(QTextCodec *codec, bool bom);
 
 protected:
     QTextDocument *m_textDocument;
+    TextLoader *m_loader;
+    TextLineIndex *m_lineIndex;
+    QTextCodec *m_codec;
+    QTextCodec *m_forcedCodec;
+    bool m_bom;
 };
 
 class PlainTextDocumentFactory : public Parts::AbstractDocumentFactory
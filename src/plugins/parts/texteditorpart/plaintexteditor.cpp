@@ -1,16 +1,30 @@
 #include "plaintexteditor.h"
 
+#include <QtCore/QScopedPointer>
+#include <QtCore/QTextCodec>
+
 #if QT_VERSION >= 0x050000
+#include <QtWidgets/QAction>
+#include <QtWidgets/QActionGroup>
+#include <QtWidgets/QMenu>
+#include <QtWidgets/QMessageBox>
 #include <QtWidgets/QToolBar>
 #include <QtWidgets/QVBoxLayout>
 #else
+#include <QtGui/QAction>
+#include <QtGui/QActionGroup>
+#include <QtGui/QMenu>
+#include <QtGui/QMessageBox>
 #include <QtGui/QToolBar>
 #include <QtGui/QVBoxLayout>
 #endif
 
+#include "largetextview.h"
 #include "plaintextdocument.h"
 #include "plaintextedit.h"
+#include "textencoding.h"
 #include "textfind.h"
+#include "textlineindex.h"
 
 using namespace Parts;
 using namespace TextEditor;
@@ -35,6 +49,11 @@ PlainTextEditor::PlainTextEditor(QWidget *parent) :
     PlainTextDocument *doc = static_cast<PlainTextDocument *>(document());
     m_editor->setDocument(doc->textDocument());
     m_find->setDocument(doc->textDocument());
+    connect(doc, SIGNAL(loadingChanged(bool)), SLOT(onLoadingChanged(bool)));
+    connect(doc, SIGNAL(largeFileChanged(bool)), SLOT(onLargeFileChanged(bool)));
+    connect(doc, SIGNAL(encodingChanged(QByteArray)), SLOT(onEncodingChanged(QByteArray)));
+    connect(doc, SIGNAL(saveFailed(QString)), SLOT(onSaveFailed(QString)));
+    onEncodingChanged(doc->encoding());
 }
 
 void PlainTextEditor::setDocument(AbstractDocument *document)
@@ -43,10 +62,28 @@ void PlainTextEditor::setDocument(AbstractDocument *document)
     if (!textEditorDocument)
         return;
 
+    PlainTextDocument *oldDocument = qobject_cast<PlainTextDocument *>(this->document());
+    if (oldDocument) {
+        disconnect(oldDocument, SIGNAL(loadingChanged(bool)), this, SLOT(onLoadingChanged(bool)));
+        disconnect(oldDocument, SIGNAL(largeFileChanged(bool)), this, SLOT(onLargeFileChanged(bool)));
+        disconnect(oldDocument, SIGNAL(encodingChanged(QByteArray)),
+                   this, SLOT(onEncodingChanged(QByteArray)));
+        disconnect(oldDocument, SIGNAL(saveFailed(QString)), this, SLOT(onSaveFailed(QString)));
+    }
+
     m_editor->setDocument(textEditorDocument->textDocument());
     m_find->setDocument(textEditorDocument->textDocument());
+    connect(textEditorDocument, SIGNAL(loadingChanged(bool)), SLOT(onLoadingChanged(bool)));
+    connect(textEditorDocument, SIGNAL(largeFileChanged(bool)), SLOT(onLargeFileChanged(bool)));
+    connect(textEditorDocument, SIGNAL(encodingChanged(QByteArray)),
+            SLOT(onEncodingChanged(QByteArray)));
+    connect(textEditorDocument, SIGNAL(saveFailed(QString)), SLOT(onSaveFailed(QString)));
 
     AbstractEditor::setDocument(document);
+
+    onLoadingChanged(textEditorDocument->isLoading());
+    onLargeFileChanged(textEditorDocument->isLargeFile());
+    onEncodingChanged(textEditorDocument->encoding());
 }
 
 IFind * PlainTextEditor::find() const
@@ -66,14 +103,85 @@ void PlainTextEditor::onFindCursorChanged()
     m_editor->setTextCursor(m_find->textCursor());
 }
 
+// The file is appended to while it loads.
+void PlainTextEditor::onLoadingChanged(bool loading)
+{
+    m_editor->setReadOnly(loading);
+    m_find->setReadOnly(loading);
+}
+
+// Large files are shown by a view of their own.
+void PlainTextEditor::onLargeFileChanged(bool large)
+{
+    PlainTextDocument *doc = static_cast<PlainTextDocument *>(document());
+    m_largeView->setLineIndex(large ? doc->lineIndex() : 0);
+    m_find->setLargeTextView(large ? m_largeView : 0);
+    m_editor->setVisible(!large);
+    m_largeView->setVisible(large);
+}
+
+void PlainTextEditor::onEncodingChanged(const QByteArray &encoding)
+{
+    QTextCodec *codec = QTextCodec::codecForName(encoding);
+    foreach (QAction *action, m_encodingMenu->actions())
+        action->setChecked(QTextCodec::codecForName(action->data().toByteArray()) == codec);
+}
+
+void PlainTextEditor::onSaveFailed(const QString &errorString)
+{
+    QMessageBox::warning(this, tr("Save failed"), errorString);
+}
+
+// Choosing an encoding reads the file again with it, or converts the
+// modified text when it is saved.
+void PlainTextEditor::onEncodingTriggered(QAction *action)
+{
+    PlainTextDocument *doc = static_cast<PlainTextDocument *>(document());
+    doc->setEncoding(action->data().toByteArray());
+    onEncodingChanged(doc->encoding());
+}
+
+void PlainTextEditor::showContextMenu(const QPoint &pos)
+{
+    QScopedPointer<QMenu> menu(m_editor->createStandardContextMenu());
+    menu->addSeparator();
+    menu->addMenu(m_encodingMenu);
+    menu->exec(m_editor->mapToGlobal(pos));
+}
+
+void PlainTextEditor::createEncodingMenu()
+{
+    m_encodingMenu = new QMenu(tr("Encoding"), this);
+    QActionGroup *group = new QActionGroup(m_encodingMenu);
+    foreach (const QByteArray &encoding, TextEncoding::encodings()) {
+        QAction *action = m_encodingMenu->addAction(QString::fromLatin1(encoding));
+        action->setCheckable(true);
+        action->setData(encoding);
+        group->addAction(action);
+    }
+    connect(group, SIGNAL(triggered(QAction*)), SLOT(onEncodingTriggered(QAction*)));
+}
+
 void PlainTextEditor::setupUi()
 {
     QVBoxLayout *layout = new QVBoxLayout(this);
     layout->setSpacing(0);
     layout->setContentsMargins(0, 0, 0, 0);
 
+    createEncodingMenu();
+
     m_editor = new PlainTextEdit(this);
+    m_editor->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(m_editor, SIGNAL(customContextMenuRequested(QPoint)), SLOT(showContextMenu(QPoint)));
     layout->addWidget(m_editor);
+
+    m_largeView = new LargeTextView(this);
+    m_largeView->hide();
+    QAction *separator = new QAction(m_largeView);
+    separator->setSeparator(true);
+    m_largeView->addAction(separator);
+    m_largeView->addAction(m_encodingMenu->menuAction());
+    layout->addWidget(m_largeView);
 }
 
 /*!
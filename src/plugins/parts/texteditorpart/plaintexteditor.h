@@ -4,11 +4,14 @@
 #include <Parts/AbstractEditor>
 #include <Parts/AbstractEditorFactory>
 
+class QAction;
+class QMenu;
 class QVBoxLayout;
 class QToolBar;
 
 namespace TextEditor {
 
+class LargeTextView;
 class PlainTextEdit;
 class TextFind;
 
@@ -28,12 +31,21 @@ public:
 private slots:
     void onCursorChanged();
     void onFindCursorChanged();
+    void onLoadingChanged(bool loading);
+    void onLargeFileChanged(bool large);
+    void onEncodingChanged(const QByteArray &encoding);
+    void onSaveFailed(const QString &errorString);
+    void onEncodingTriggered(QAction *action);
+    void showContextMenu(const QPoint &pos);
 
 private:
     void setupUi();
+    void createEncodingMenu();
 
     TextFind *m_find;
     PlainTextEdit *m_editor;
+    LargeTextView *m_largeView;
+    QMenu *m_encodingMenu;
     QString m_currentFile;
 };
 
@@ -0,0 +1,321 @@
+#include "textencoding.h"
+
+#include <QtCore/QTextCodec>
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define TEXTEDITOR_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+using namespace TextEditor;
+
+// Bytes looked at for zero bytes of UTF-16 text without byte order mark.
+static const int Utf16SampleSize = 4096;
+// Bytes counted to tell legacy code pages apart.
+static const int LegacySampleSize = 64 * 1024;
+
+static const char utf8Bom[] = "\xef\xbb\xbf";
+static const char utf16LeBom[] = "\xff\xfe";
+static const char utf16BeBom[] = "\xfe\xff";
+
+#if defined(TEXTEDITOR_HAVE_SSE2)
+// Returns bytes of \a x that are at least \a min as 0xff.
+static inline __m128i atLeast(__m128i x, uchar min)
+{
+    return _mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8(char(min))), x);
+}
+
+/*
+    Checks the structure of UTF-8 16 bytes at a time: a byte has to be a
+    continuation byte exactly if a lead byte up to three bytes before asks
+    for it. Returns a character boundary before the first block that
+    doesn't fit, or near the end; the rest is left to the scalar check.
+*/
+static qint64 validUtf8BlocksLength(const uchar *data, qint64 size)
+{
+    __m128i previous = _mm_setzero_si128();
+    qint64 i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        if (!_mm_movemask_epi8(_mm_or_si128(bytes, previous))) {
+            // ASCII after ASCII.
+            previous = bytes;
+            continue;
+        }
+        const __m128i previous1 = _mm_or_si128(_mm_slli_si128(bytes, 1), _mm_srli_si128(previous, 15));
+        const __m128i previous2 = _mm_or_si128(_mm_slli_si128(bytes, 2), _mm_srli_si128(previous, 14));
+        const __m128i previous3 = _mm_or_si128(_mm_slli_si128(bytes, 3), _mm_srli_si128(previous, 13));
+
+        const __m128i needed = _mm_or_si128(atLeast(previous1, 0xc0),
+                                            _mm_or_si128(atLeast(previous2, 0xe0),
+                                                         atLeast(previous3, 0xf0)));
+        const __m128i lead = atLeast(bytes, 0xc0);
+        const __m128i continuation = _mm_andnot_si128(lead, atLeast(bytes, 0x80));
+        // C0 and C1 only start overlong forms, F5 and above nothing.
+        const __m128i invalid = _mm_or_si128(atLeast(bytes, 0xf5),
+                                             _mm_cmpeq_epi8(_mm_and_si128(bytes, _mm_set1_epi8(char(0xfe))),
+                                                            _mm_set1_epi8(char(0xc0))));
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_xor_si128(needed, continuation), invalid)))
+            break;
+        previous = bytes;
+    }
+
+    // The characters of the last three bytes may not be complete.
+    qint64 start = qMax<qint64>(0, i - 3);
+    while (start < i && (data[start] & 0xc0) == 0x80)
+        ++start;
+    return start;
+}
+#endif
+
+/*
+    Returns the length of the valid UTF-8 at the start of \a data. With
+    SSE2 only the structure is checked up to the last few bytes, which
+    tells UTF-8 from other encodings as well.
+*/
+static qint64 validUtf8Length(const uchar *data, qint64 size)
+{
+    qint64 i = 0;
+#if defined(TEXTEDITOR_HAVE_SSE2)
+    i = validUtf8BlocksLength(data, size);
+#endif
+    while (i < size) {
+        if (data[i] < 0x80) {
+            ++i;
+            continue;
+        }
+        const int length = TextEncoding::utf8SequenceLength(data + i, size - i);
+        if (!length)
+            return i;
+        i += length;
+    }
+    return size;
+}
+
+/*
+    Returns the codec of a legacy 8 bit encoding that fits \a data.
+    Cyrillic text has most of its letters above 0x7f; which code page it is
+    in is told by where its most frequent letters are. Other text is taken
+    as Windows-1252, which shows Latin-1 as well.
+*/
+static QTextCodec *detectLegacy(const uchar *data, qint64 size)
+{
+    quint32 histogram[256];
+    ::memset(histogram, 0, sizeof(histogram));
+    size = qMin<qint64>(size, LegacySampleSize);
+    for (qint64 i = 0; i < size; ++i)
+        ++histogram[data[i]];
+
+    quint32 asciiLetters = 0;
+    for (int c = 'A'; c <= 'Z'; ++c)
+        asciiLetters += histogram[c] + histogram[c + ('a' - 'A')];
+    quint32 high = 0;
+    for (int c = 0x80; c < 0x100; ++c)
+        high += histogram[c];
+
+    if (high > asciiLetters) {
+        // о е а и н т с р в
+        static const uchar windows1251[] = { 0xee, 0xe5, 0xe0, 0xe8, 0xed, 0xf2, 0xf1, 0xf0, 0xe2 };
+        static const uchar koi8r[] = { 0xcf, 0xc5, 0xc1, 0xc9, 0xce, 0xd4, 0xd3, 0xd2, 0xd7 };
+        quint32 windows1251Score = 0;
+        quint32 koi8rScore = 0;
+        for (size_t i = 0; i < sizeof(windows1251); ++i) {
+            windows1251Score += histogram[windows1251[i]];
+            koi8rScore += histogram[koi8r[i]];
+        }
+        if (qMax(windows1251Score, koi8rScore) > high / 4) {
+            QTextCodec *codec = QTextCodec::codecForName(windows1251Score >= koi8rScore
+                                                         ? "windows-1251" : "KOI8-R");
+            if (codec)
+                return codec;
+        }
+    }
+
+    QTextCodec *codec = QTextCodec::codecForName("windows-1252");
+    return codec ? codec : QTextCodec::codecForName("ISO-8859-1");
+}
+
+/*!
+    \class TextEncoding
+
+    Detects the encoding of text files.
+
+    detect() looks for a byte order mark first, then for the zero bytes of
+    UTF-16 text without one. Otherwise text that is valid UTF-8 is taken as
+    UTF-8 and anything else as the legacy code page that fits the byte
+    statistics best. Most text is ASCII, which is validated at memory speed,
+    so detection costs a fraction of reading the file.
+*/
+
+/*!
+    Returns the codec of \a sample, the start of a file, and sets
+    \a bomLength to the length of its byte order mark. \a atEnd tells if
+    the sample is the whole file, otherwise it may end inside a character.
+*/
+QTextCodec *TextEncoding::detect(const QByteArray &sample, bool atEnd, int *bomLength)
+{
+    const uchar *data = reinterpret_cast<const uchar *>(sample.constData());
+    const qint64 size = sample.size();
+    if (bomLength)
+        *bomLength = 0;
+
+    if (sample.startsWith(utf8Bom)) {
+        if (bomLength)
+            *bomLength = 3;
+        return QTextCodec::codecForName("UTF-8");
+    }
+    if (sample.startsWith(utf16LeBom) || sample.startsWith(utf16BeBom)) {
+        if (bomLength)
+            *bomLength = 2;
+        return QTextCodec::codecForName(data[0] == 0xff ? "UTF-16LE" : "UTF-16BE");
+    }
+
+    // Mostly ASCII UTF-16 text has every other byte zero.
+    const int pairs = int(qMin<qint64>(Utf16SampleSize, size) / 2);
+    int evenZeros = 0;
+    int oddZeros = 0;
+    for (int i = 0; i < pairs; ++i) {
+        evenZeros += data[2 * i] == 0;
+        oddZeros += data[2 * i + 1] == 0;
+    }
+    if (pairs >= 2) {
+        if (oddZeros > pairs * 2 / 5 && evenZeros < pairs / 20)
+            return QTextCodec::codecForName("UTF-16LE");
+        if (evenZeros > pairs * 2 / 5 && oddZeros < pairs / 20)
+            return QTextCodec::codecForName("UTF-16BE");
+    }
+
+    if (isUtf8(sample.constData(), size, atEnd))
+        return QTextCodec::codecForName("UTF-8");
+    return detectLegacy(data, size);
+}
+
+/*!
+    Returns the length of the byte order mark of \a codec at the start of
+    \a sample, 0 if there is none.
+*/
+int TextEncoding::bomLength(const QByteArray &sample, QTextCodec *codec)
+{
+    const QByteArray mark = bom(codec);
+    return !mark.isEmpty() && sample.startsWith(mark) ? mark.size() : 0;
+}
+
+/*!
+    Returns the byte order mark of \a codec, empty if it has none.
+*/
+QByteArray TextEncoding::bom(QTextCodec *codec)
+{
+    if (!codec)
+        return QByteArray();
+
+    const QByteArray name = codec->name();
+    if (name == "UTF-8")
+        return QByteArray(utf8Bom);
+    if (name == "UTF-16LE")
+        return QByteArray(utf16LeBom);
+    if (name == "UTF-16BE")
+        return QByteArray(utf16BeBom);
+    return QByteArray();
+}
+
+/*!
+    Returns true if \a size bytes of \a data are valid UTF-8. Unless
+    \a atEnd is true, the data may end inside a character.
+*/
+bool TextEncoding::isUtf8(const char *data, qint64 size, bool atEnd)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    const qint64 valid = validUtf8Length(bytes, size);
+    if (valid == size)
+        return true;
+    if (atEnd || size - valid >= 4)
+        return false;
+
+    const uchar c = bytes[valid];
+    const int length = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : 2;
+    if (c < 0xc2 || c > 0xf4 || size - valid >= length)
+        return false;
+    for (qint64 i = valid + 1; i < size; ++i) {
+        if ((bytes[i] & 0xc0) != 0x80)
+            return false;
+    }
+    return true;
+}
+
+/*!
+    Returns the length of the valid UTF-8 sequence of one character at the
+    start of \a size bytes of \a data, 0 if it is invalid or incomplete.
+    Overlong forms, surrogates and code points above U+10FFFF are invalid.
+*/
+int TextEncoding::utf8SequenceLength(const uchar *data, qint64 size)
+{
+    if (size <= 0)
+        return 0;
+
+    const uchar c = data[0];
+    if (c < 0x80)
+        return 1;
+
+    int length;
+    uchar min = 0x80;
+    uchar max = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf) {
+        length = 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        length = 3;
+        if (c == 0xe0)
+            min = 0xa0;
+        else if (c == 0xed)
+            max = 0x9f;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        length = 4;
+        if (c == 0xf0)
+            min = 0x90;
+        else if (c == 0xf4)
+            max = 0x8f;
+    } else {
+        return 0;
+    }
+
+    if (length > size || data[1] < min || data[1] > max)
+        return 0;
+    for (int i = 2; i < length; ++i) {
+        if ((data[i] & 0xc0) != 0x80)
+            return 0;
+    }
+    return length;
+}
+
+/*!
+    Returns true if ASCII, and so line feeds, are single bytes in
+    \a codec.
+*/
+bool TextEncoding::isAsciiCompatible(QTextCodec *codec)
+{
+    return codec && !codec->name().startsWith("UTF-16") && !codec->name().startsWith("UTF-32");
+}
+
+/*!
+    Returns the names of the encodings that can be chosen for a document.
+*/
+QList<QByteArray> TextEncoding::encodings()
+{
+    static const char * const names[] = {
+        "UTF-8", "UTF-16LE", "UTF-16BE",
+        "ISO-8859-1", "ISO-8859-15", "windows-1252",
+        "ISO-8859-2", "windows-1250",
+        "ISO-8859-5", "windows-1251", "KOI8-R", "KOI8-U",
+        "ISO-8859-7", "windows-1253",
+        "ISO-8859-9", "windows-1254",
+        "Shift_JIS", "EUC-JP", "GB18030", "Big5", "EUC-KR"
+    };
+
+    QList<QByteArray> result;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        if (QTextCodec::codecForName(names[i]))
+            result.append(names[i]);
+    }
+    return result;
+}
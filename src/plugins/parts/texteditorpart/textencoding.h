@@ -0,0 +1,30 @@
+#ifndef TEXTENCODING_H
+#define TEXTENCODING_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+
+class QTextCodec;
+
+namespace TextEditor {
+
+class TextEncoding
+{
+public:
+    // Bytes looked at to detect the encoding of a file.
+    static const int SampleSize = 4 * 1024 * 1024;
+
+    static QTextCodec *detect(const QByteArray &sample, bool atEnd, int *bomLength = 0);
+    static int bomLength(const QByteArray &sample, QTextCodec *codec);
+    static QByteArray bom(QTextCodec *codec);
+
+    static bool isUtf8(const char *data, qint64 size, bool atEnd);
+    static int utf8SequenceLength(const uchar *data, qint64 size);
+    static bool isAsciiCompatible(QTextCodec *codec);
+
+    static QList<QByteArray> encodings();
+};
+
+} // namespace TextEditor
+
+#endif // TEXTENCODING_H
@@ -1,7 +1,11 @@
 #include "textfind.h"
 
+#include <QtCore/QVector>
+#include <QtGui/QTextBlock>
 #include <QtGui/QTextDocument>
 
+#include "largetextview.h"
+
 using namespace Parts;
 using namespace TextEditor;
 
@@ -18,15 +22,41 @@ static QTextDocument::FindFlags iFind2TextDocumentFlags(IFind::FindFlags flags)
     return result;
 }
 
+/*
+    Appends the positions of \a text in \a block to \a positions, the way
+    QTextDocument::find() finds them front to back.
+*/
+static void findInBlock(const QTextBlock &block, const QString &text,
+                        QTextDocument::FindFlags flags, QVector<int> *positions)
+{
+    const QString blockText = block.text();
+    const Qt::CaseSensitivity cs = (flags & QTextDocument::FindCaseSensitively)
+            ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    int index = blockText.indexOf(text, 0, cs);
+    while (index >= 0) {
+        const int end = index + text.length();
+        if ((flags & QTextDocument::FindWholeWords)
+                && ((index > 0 && blockText.at(index - 1).isLetterOrNumber())
+                    || (end < blockText.length() && blockText.at(end).isLetterOrNumber()))) {
+            index = blockText.indexOf(text, index + 1, cs);
+            continue;
+        }
+        positions->append(block.position() + index);
+        index = blockText.indexOf(text, end, cs);
+    }
+}
+
 TextFind::TextFind(QObject *parent) :
     IFind(parent),
-    m_document(0)
+    m_document(0),
+    m_largeView(0),
+    m_readOnly(false)
 {
 }
 
 bool TextFind::supportsReplace() const
 {
-    return true;
+    return !m_largeView && !m_readOnly;
 }
 
 IFind::FindFlags TextFind::supportedFindFlags() const
@@ -52,6 +82,10 @@ QString TextFind::completedFindString() const
 void TextFind::findIncremental(const QString &text, IFind::FindFlags findFlags)
 {
     QTextDocument::FindFlags flags = iFind2TextDocumentFlags(findFlags);
+    if (m_largeView) {
+        m_largeView->find(text, flags, true);
+        return;
+    }
 
     QTextCursor cursor = textCursor();
     if (cursor.hasSelection())
@@ -74,6 +108,10 @@ void TextFind::findIncremental(const QString &text, IFind::FindFlags findFlags)
 void TextFind::findStep(const QString &text, IFind::FindFlags findFlags)
 {
     QTextDocument::FindFlags flags = iFind2TextDocumentFlags(findFlags);
+    if (m_largeView) {
+        m_largeView->find(text, flags, false);
+        return;
+    }
     QTextCursor cursor = textCursor();
 
     cursor = m_document->find(text, cursor, flags);
@@ -90,6 +128,9 @@ void TextFind::findStep(const QString &text, IFind::FindFlags findFlags)
 
 void TextFind::replace(const QString &before, const QString &after, IFind::FindFlags /*findFlags*/)
 {
+    if (!supportsReplace())
+        return;
+
     QTextCursor cursor = textCursor();
     if (cursor.hasSelection() && cursor.selectedText() == before ) {
         cursor.removeSelectedText();
@@ -104,27 +145,35 @@ bool TextFind::replaceStep(const QString &before, const QString &after, IFind::F
     return true;
 }
 
+/*
+    All matches are found in one pass over the blocks before anything is
+    changed, then replaced from the last one back so the positions of the
+    others stay valid. The replacements are a single undo step and the
+    document is laid out once, when the edit block ends.
+*/
 int TextFind::replaceAll(const QString &before, const QString &after, IFind::FindFlags findFlags)
 {
-    QTextDocument::FindFlags flags = iFind2TextDocumentFlags(findFlags);
-    QTextCursor cursor = QTextCursor(m_document);
-    cursor.movePosition(QTextCursor::Start);
-    cursor = m_document->find(before, cursor, flags);
-
-    int count = 0;
-    while (!cursor.isNull()) {
-        count++;
-        if (count == 0)
-            cursor.beginEditBlock();
-        else
-            cursor.joinPreviousEditBlock();
-        cursor.removeSelectedText();
+    if (!supportsReplace() || !m_document || before.isEmpty())
+        return 0;
+
+    // The whole document is searched, whichever direction is asked for.
+    const QTextDocument::FindFlags flags = iFind2TextDocumentFlags(findFlags);
+    QVector<int> positions;
+    for (QTextBlock block = m_document->begin(); block.isValid(); block = block.next())
+        findInBlock(block, before, flags, &positions);
+    if (positions.isEmpty())
+        return 0;
+
+    QTextCursor cursor(m_document);
+    cursor.beginEditBlock();
+    for (int i = positions.size() - 1; i >= 0; --i) {
+        cursor.setPosition(positions.at(i));
+        cursor.setPosition(positions.at(i) + before.length(), QTextCursor::KeepAnchor);
         cursor.insertText(after);
-        cursor.endEditBlock();
-        cursor = m_document->find(before, cursor, flags);
     }
+    cursor.endEditBlock();
 
-    return count;
+    return positions.size();
 }
 
 void TextFind::setDocument(QTextDocument *document)
@@ -132,6 +181,18 @@ void TextFind::setDocument(QTextDocument *document)
     m_document = document;
 }
 
+// Large files are searched in their view, which can't replace.
+void TextFind::setLargeTextView(LargeTextView *view)
+{
+    m_largeView = view;
+}
+
+// The document is appended to while it loads and can't be replaced in.
+void TextFind::setReadOnly(bool readOnly)
+{
+    m_readOnly = readOnly;
+}
+
 QTextCursor TextFind::textCursor() const
 {
     return m_cursor;
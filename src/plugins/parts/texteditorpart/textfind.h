@@ -8,6 +8,8 @@ class QTextDocument;
 
 namespace TextEditor {
 
+class LargeTextView;
+
 class TextFind : public Parts::IFind
 {
     Q_OBJECT
@@ -29,6 +31,8 @@ public:
     int replaceAll(const QString &before, const QString &after, FindFlags findFlags);
 
     void setDocument(QTextDocument *document);
+    void setLargeTextView(LargeTextView *view);
+    void setReadOnly(bool readOnly);
 
     QTextCursor textCursor() const;
     void setTextCursor(const QTextCursor &textCursor);
@@ -39,6 +43,8 @@ signals:
 private:
     QString m_text;
     QTextDocument *m_document;
+    LargeTextView *m_largeView;
+    bool m_readOnly;
     QTextCursor m_cursor;
 };
 
@@ -0,0 +1,802 @@
+#include "textlineindex.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMetaType>
+#include <QtCore/QRunnable>
+#include <QtCore/QTextCodec>
+#include <QtCore/QTextDecoder>
+#include <QtCore/QtAlgorithms>
+
+#include <string.h>
+
+#include "textencoding.h"
+#include "textmapguard.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define TEXTEDITOR_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+using namespace TextEditor;
+
+// The first chunk is small so the first lines are known at once.
+static const int FirstChunkSize = 1024 * 1024;
+
+static inline int popCount(quint64 x)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & Q_UINT64_C(0x5555555555555555));
+    x = (x & Q_UINT64_C(0x3333333333333333)) + ((x >> 2) & Q_UINT64_C(0x3333333333333333));
+    x = (x + (x >> 4)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+    return int((x * Q_UINT64_C(0x0101010101010101)) >> 56);
+#endif
+}
+
+static inline int lowestBit(quint64 mask)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(mask);
+#else
+    int result = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++result;
+    }
+    return result;
+#endif
+}
+
+#if defined(TEXTEDITOR_HAVE_SSE2)
+// Bit i is set if data[i] is a line feed.
+static inline quint64 newlineMask(const uchar *data, __m128i newline)
+{
+    const __m128i *p = reinterpret_cast<const __m128i *>(data);
+    const quint64 m0 = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p), newline)));
+    const quint64 m1 = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 1), newline)));
+    const quint64 m2 = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 2), newline)));
+    const quint64 m3 = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 3), newline)));
+    return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+#endif
+
+/*
+    Counts the line feeds in \a length bytes of \a data, which start at
+    \a base in the file, and appends the start of every IndexStep-th line to
+    \a checkpoints. \a newlines is the number of line feeds before \a data.
+    Line feeds are found 64 bytes at a time with SSE2; the positions are
+    only looked at in blocks where a checkpoint is due.
+*/
+static void indexLines(const uchar *data, int length, qint64 base,
+                       qint64 *newlines, QVector<qint64> *checkpoints)
+{
+    qint64 count = *newlines;
+    qint64 next = (count / TextLineIndex::IndexStep + 1) * TextLineIndex::IndexStep;
+    int i = 0;
+#if defined(TEXTEDITOR_HAVE_SSE2)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 64 <= length; i += 64) {
+        quint64 mask = newlineMask(data + i, newline);
+        if (!mask)
+            continue;
+        const int n = popCount(mask);
+        if (count + n < next) {
+            count += n;
+            continue;
+        }
+        while (mask) {
+            const int bit = lowestBit(mask);
+            mask &= mask - 1;
+            if (++count == next) {
+                checkpoints->append(base + i + bit + 1);
+                next += TextLineIndex::IndexStep;
+            }
+        }
+    }
+#endif
+    for (; i < length; ++i) {
+        if (data[i] == '\n' && ++count == next) {
+            checkpoints->append(base + i + 1);
+            next += TextLineIndex::IndexStep;
+        }
+    }
+    *newlines = count;
+}
+
+static inline uchar toLowerAscii(uchar c)
+{
+    return (c >= 'A' && c <= 'Z') ? uchar(c + ('a' - 'A')) : c;
+}
+
+static inline uchar toUpperAscii(uchar c)
+{
+    return (c >= 'a' && c <= 'z') ? uchar(c - ('a' - 'A')) : c;
+}
+
+// Bytes of non-ASCII characters count as word characters.
+static inline bool isWordByte(uchar c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || c == '_' || c >= 0x80;
+}
+
+// Bytes searched between checks whether a search was canceled.
+static const qint64 FindChunkSize = 4 * 1024 * 1024;
+
+static inline int highestBit(quint32 mask)
+{
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(mask);
+#else
+    int result = 31;
+    while (!(mask & 0x80000000u)) {
+        mask <<= 1;
+        --result;
+    }
+    return result;
+#endif
+}
+
+/*
+    Returns the offset of the first byte in [from, to) that is \a a or
+    \a b, or of the last one if \a backward is true; -1 if there is none.
+    SSE2 compares 16 bytes at a time in either direction.
+*/
+static qint64 scanBytes(const uchar *data, qint64 from, qint64 to, uchar a, uchar b, bool backward)
+{
+    if (!backward) {
+        qint64 i = from;
+#if defined(TEXTEDITOR_HAVE_SSE2)
+        const __m128i va = _mm_set1_epi8(char(a));
+        const __m128i vb = _mm_set1_epi8(char(b));
+        for (; i + 16 <= to; i += 16) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)));
+            if (mask)
+                return i + lowestBit(quint64(mask));
+        }
+#endif
+        for (; i < to; ++i) {
+            if (data[i] == a || data[i] == b)
+                return i;
+        }
+        return -1;
+    }
+
+    qint64 i = to;
+#if defined(TEXTEDITOR_HAVE_SSE2)
+    const __m128i va = _mm_set1_epi8(char(a));
+    const __m128i vb = _mm_set1_epi8(char(b));
+    for (; i - 16 >= from; i -= 16) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i - 16));
+        const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)));
+        if (mask)
+            return i - 16 + highestBit(quint32(mask));
+    }
+#endif
+    for (; i > from; --i) {
+        if (data[i - 1] == a || data[i - 1] == b)
+            return i - 1;
+    }
+    return -1;
+}
+
+static bool matchesAt(const uchar *data, qint64 size, qint64 offset, const QByteArray &needle,
+                      bool caseSensitive, bool wholeWords)
+{
+    const uchar *bytes = data + offset;
+    const uchar *pattern = reinterpret_cast<const uchar *>(needle.constData());
+    const int length = needle.size();
+    if (caseSensitive) {
+        if (::memcmp(bytes, pattern, size_t(length)) != 0)
+            return false;
+    } else {
+        for (int i = 0; i < length; ++i) {
+            if (toLowerAscii(bytes[i]) != toLowerAscii(pattern[i]))
+                return false;
+        }
+    }
+
+    if (wholeWords) {
+        if (offset > 0 && isWordByte(bytes[-1]))
+            return false;
+        if (offset + length < size && isWordByte(bytes[length]))
+            return false;
+    }
+    return true;
+}
+
+namespace TextEditor {
+
+class TextLineIndexJob
+{
+public:
+    const uchar *data;
+    qint64 size;
+    int generation;
+    QAtomicInt stopped;
+
+    bool isStopped() const
+    {
+#if QT_VERSION >= 0x050000
+        return stopped.load();
+#else
+        return stopped;
+#endif
+    }
+};
+
+class TextLineIndexFindJob
+{
+public:
+    const uchar *data;
+    qint64 size;
+    QByteArray needle;
+    qint64 from;
+    bool backward;
+    bool caseSensitive;
+    bool wholeWords;
+    int generation;
+    QAtomicInt stopped;
+
+    bool isStopped() const
+    {
+#if QT_VERSION >= 0x050000
+        return stopped.load();
+#else
+        return stopped;
+#endif
+    }
+
+    qint64 find(qint64 from) const;
+};
+
+} // namespace TextEditor
+
+/*
+    Returns the offset of the first occurrence of the needle at or after
+    \a from, or at or before \a from if searching backward; -1 if there is
+    none or the search was stopped. Candidates are found by scanning for
+    both cases of the first byte.
+*/
+qint64 TextLineIndexFindJob::find(qint64 from) const
+{
+    const qint64 length = needle.size();
+    if (length == 0 || length > size)
+        return -1;
+
+    const qint64 last = size - length;
+    const uchar first = uchar(needle.at(0));
+    const uchar a = caseSensitive ? first : toLowerAscii(first);
+    const uchar b = caseSensitive ? first : toUpperAscii(first);
+
+    if (!backward) {
+        for (qint64 start = qMax<qint64>(0, from); start <= last; start += FindChunkSize) {
+            if (isStopped())
+                return -1;
+            const qint64 end = qMin(last + 1, start + FindChunkSize);
+            for (qint64 offset = scanBytes(data, start, end, a, b, false); offset >= 0;
+                 offset = scanBytes(data, offset + 1, end, a, b, false)) {
+                if (matchesAt(data, size, offset, needle, caseSensitive, wholeWords))
+                    return offset;
+            }
+        }
+        return -1;
+    }
+
+    for (qint64 end = qMin(from, last) + 1; end > 0; end -= FindChunkSize) {
+        if (isStopped())
+            return -1;
+        const qint64 start = qMax<qint64>(0, end - FindChunkSize);
+        for (qint64 offset = scanBytes(data, start, end, a, b, true); offset >= 0;
+             offset = scanBytes(data, start, offset, a, b, true)) {
+            if (matchesAt(data, size, offset, needle, caseSensitive, wholeWords))
+                return offset;
+        }
+    }
+    return -1;
+}
+
+class TextLineIndexFindTask : public QRunnable
+{
+public:
+    TextLineIndexFindTask(const QSharedPointer<TextLineIndexFindJob> &job, QObject *receiver) :
+        m_job(job),
+        m_receiver(receiver)
+    {
+    }
+
+    void run();
+
+private:
+    QSharedPointer<TextLineIndexFindJob> m_job;
+    QObject *m_receiver;
+};
+
+// Wraps around at the end, or the start of a backward search.
+void TextLineIndexFindTask::run()
+{
+    const TextLineIndexFindJob &job = *m_job;
+    qint64 offset = job.find(job.from);
+    if (offset < 0)
+        offset = job.find(job.backward ? job.size : 0);
+    if (job.isStopped())
+        return;
+
+    QMetaObject::invokeMethod(m_receiver, "handleFound", Qt::QueuedConnection,
+                              Q_ARG(int, job.generation), Q_ARG(qint64, offset));
+}
+
+class TextLineIndexTask : public QRunnable
+{
+public:
+    TextLineIndexTask(const QSharedPointer<TextLineIndexJob> &job, QObject *receiver) :
+        m_job(job),
+        m_receiver(receiver)
+    {
+    }
+
+    void run();
+
+private:
+    QSharedPointer<TextLineIndexJob> m_job;
+    QObject *m_receiver;
+};
+
+void TextLineIndexTask::run()
+{
+    const TextLineIndexJob &job = *m_job;
+    qint64 newlines = 0;
+    qint64 offset = 0;
+    int chunkSize = FirstChunkSize;
+    while (offset < job.size && !job.isStopped()) {
+        const int length = int(qMin<qint64>(chunkSize, job.size - offset));
+        QVector<qint64> checkpoints;
+        indexLines(job.data + offset, length, offset, &newlines, &checkpoints);
+        offset += length;
+        chunkSize = TextLineIndex::ChunkSize;
+        QMetaObject::invokeMethod(m_receiver, "handleIndexed", Qt::QueuedConnection,
+                                  Q_ARG(int, job.generation),
+                                  Q_ARG(QVector<qint64>, checkpoints),
+                                  Q_ARG(qint64, newlines), Q_ARG(qint64, offset));
+    }
+
+    QMetaObject::invokeMethod(m_receiver, "handleDone", Qt::QueuedConnection,
+                              Q_ARG(int, job.generation));
+}
+
+/*!
+    \class TextLineIndex
+
+    Maps a text file into memory and finds its lines.
+
+    The line index is built on a worker thread; lineCount() grows while it
+    runs and linesChanged() is emitted as lines become known. Only the
+    start of every IndexStep-th line is stored, so the index takes a few
+    bytes per IndexStep lines no matter how long they are, and the file
+    itself is only read through the mapping.
+
+    Logs are often truncated in place while they are open. The mapping is
+    guarded by TextMapGuard, so its part past the new end of the file reads
+    as zeroes, and the file is mapped and indexed again as soon as it is
+    seen to shrink.
+*/
+
+/*!
+    Creates TextLineIndex with the given \a parent.
+*/
+TextLineIndex::TextLineIndex(QObject *parent) :
+    QObject(parent),
+    m_data(0),
+    m_size(0),
+    m_codec(QTextCodec::codecForName("UTF-8")),
+    m_decoding(Utf8Decoding),
+    m_generation(0),
+    m_complete(false),
+    m_newlines(0),
+    m_indexedSize(0),
+    m_lastLine(-1),
+    m_lastStart(0),
+    m_findGeneration(0)
+{
+    connect(&m_watcher, SIGNAL(fileChanged(QString)), SLOT(handleFileChanged()));
+    qRegisterMetaType<qint64>("qint64");
+    qRegisterMetaType<QVector<qint64> >("QVector<qint64>");
+    m_pool.setMaxThreadCount(1);
+    m_findPool.setMaxThreadCount(1);
+}
+
+TextLineIndex::~TextLineIndex()
+{
+    close();
+}
+
+/*!
+    Maps \a fileName and starts indexing its lines. Returns false if the
+    file can't be mapped.
+*/
+bool TextLineIndex::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    if (m_size > 0) {
+        m_data = m_file.map(0, m_size);
+        m_errorString = m_file.errorString();
+        if (m_data && !TextMapGuard::add(m_data, m_size)) {
+            m_file.unmap(m_data);
+            m_data = 0;
+            m_errorString = tr("Too many large files are open.");
+        }
+        if (!m_data) {
+            m_file.close();
+            m_size = 0;
+            return false;
+        }
+    }
+
+    m_errorString.clear();
+    m_watcher.addPath(fileName);
+    m_checkpoints.append(0);
+    m_complete = m_size == 0;
+    if (m_complete)
+        return true;
+
+    QSharedPointer<TextLineIndexJob> job(new TextLineIndexJob);
+    job->data = m_data;
+    job->size = m_size;
+    job->generation = m_generation;
+    m_job = job;
+    emit progressChanged(0);
+    m_pool.start(new TextLineIndexTask(job, this));
+    return true;
+}
+
+/*!
+    Stops indexing and unmaps the file.
+*/
+void TextLineIndex::close()
+{
+    cancelFind();
+    cancel();
+    if (!m_watcher.files().isEmpty())
+        m_watcher.removePaths(m_watcher.files());
+    if (m_data) {
+        TextMapGuard::remove(m_data);
+        m_file.unmap(m_data);
+    }
+    m_file.close();
+    m_data = 0;
+    m_size = 0;
+    m_complete = false;
+    m_checkpoints.clear();
+    m_newlines = 0;
+    m_indexedSize = 0;
+    m_lastLine = -1;
+    m_lastStart = 0;
+}
+
+/*!
+    Returns the offset of the first byte of \a line, or -1 if the line is
+    not known (yet).
+*/
+qint64 TextLineIndex::lineStart(qint64 line) const
+{
+    if (line < 0 || line > m_newlines)
+        return -1;
+
+    const int checkpoint = int(line / IndexStep);
+    qint64 current = qint64(checkpoint) * IndexStep;
+    qint64 offset = m_checkpoints.at(checkpoint);
+    if (m_lastLine >= current && m_lastLine <= line) {
+        current = m_lastLine;
+        offset = m_lastStart;
+    }
+    for (; current < line; ++current) {
+        const void *newline = ::memchr(m_data + offset, '\n', size_t(m_size - offset));
+        offset = static_cast<const uchar *>(newline) - m_data + 1;
+    }
+
+    m_lastLine = line;
+    m_lastStart = offset;
+    return offset;
+}
+
+/*!
+    Returns the offset of the line feed that ends the line starting at
+    \a start, the end of the file or the end of the part shown of longer
+    lines, whatever comes first.
+*/
+qint64 TextLineIndex::lineEnd(qint64 start) const
+{
+    const qint64 limit = qMin(m_size, start + MaxLineLength);
+    if (start >= limit)
+        return start;
+
+    const void *newline = ::memchr(m_data + start, '\n', size_t(limit - start));
+    return newline ? static_cast<const uchar *>(newline) - m_data : limit;
+}
+
+/*!
+    Returns the line that contains \a offset. Offsets past the indexed part
+    are counted from the last known line.
+*/
+qint64 TextLineIndex::lineAt(qint64 offset) const
+{
+    if (m_checkpoints.isEmpty())
+        return 0;
+
+    offset = qBound<qint64>(0, offset, m_size);
+    const int checkpoint = int(qUpperBound(m_checkpoints.constBegin(), m_checkpoints.constEnd(), offset)
+                               - m_checkpoints.constBegin()) - 1;
+    const qint64 start = m_checkpoints.at(checkpoint);
+    return qint64(checkpoint) * IndexStep + countNewlines(data() + start, offset - start);
+}
+
+/*!
+    Returns the text of \a line without the line break.
+*/
+QString TextLineIndex::lineText(qint64 line, QVector<qint64> *offsets) const
+{
+    const qint64 start = lineStart(line);
+    if (start < 0) {
+        if (offsets) {
+            offsets->clear();
+            offsets->append(m_size);
+        }
+        return QString();
+    }
+
+    qint64 end = lineEnd(start);
+    if (end > start && m_data[end - 1] == '\r')
+        --end;
+    return text(start, end, offsets);
+}
+
+/*!
+    Returns the bytes from \a from to \a to decoded with codec(). If
+    \a offsets is given, it is set to the offset of the first byte of every
+    character, followed by \a to, so that columns map to bytes exactly
+    even where the text doesn't encode back to the same bytes. Invalid
+    UTF-8 bytes are shown as one replacement character each.
+*/
+QString TextLineIndex::text(qint64 from, qint64 to, QVector<qint64> *offsets) const
+{
+    from = qBound<qint64>(0, from, m_size);
+    to = qBound<qint64>(from, to, m_size);
+    const uchar *bytes = m_data + from;
+    const int length = int(to - from);
+    if (offsets) {
+        offsets->clear();
+        offsets->reserve(length + 1);
+    }
+
+    QString result;
+    if (m_decoding == Utf8Decoding) {
+        result.reserve(length);
+        for (int i = 0; i < length; ) {
+            const uchar c = bytes[i];
+            if (c < 0x80) {
+                result += QLatin1Char(char(c));
+                if (offsets)
+                    offsets->append(from + i);
+                ++i;
+                continue;
+            }
+
+            const int sequence = TextEncoding::utf8SequenceLength(bytes + i, length - i);
+            if (!sequence) {
+                result += QChar(QChar::ReplacementCharacter);
+                if (offsets)
+                    offsets->append(from + i);
+                ++i;
+                continue;
+            }
+
+            uint ucs4 = c & (0x7f >> sequence);
+            for (int j = 1; j < sequence; ++j)
+                ucs4 = (ucs4 << 6) | (bytes[i + j] & 0x3f);
+            if (QChar::requiresSurrogates(ucs4)) {
+                result += QChar(QChar::highSurrogate(ucs4));
+                result += QChar(QChar::lowSurrogate(ucs4));
+                if (offsets)
+                    offsets->append(from + i);
+            } else {
+                result += QChar(ushort(ucs4));
+            }
+            if (offsets)
+                offsets->append(from + i);
+            i += sequence;
+        }
+    } else if (m_decoding == SingleByteDecoding) {
+        result = m_codec->toUnicode(data() + from, length);
+        if (offsets) {
+            for (int i = 0; i < length; ++i)
+                offsets->append(from + i);
+        }
+    } else {
+        // Bytes are fed one at a time, the characters that come out start
+        // where the previous ones ended.
+        QTextDecoder decoder(m_codec);
+        qint64 start = from;
+        for (int i = 0; i < length; ++i) {
+            const QString part = decoder.toUnicode(data() + from + i, 1);
+            if (part.isEmpty())
+                continue;
+
+            result += part;
+            if (offsets) {
+                for (int j = 0; j < part.size(); ++j)
+                    offsets->append(start);
+            }
+            start = from + i + 1;
+        }
+    }
+
+    if (offsets)
+        offsets->append(to);
+    return result;
+}
+
+/*!
+    Sets the encoding of the file to \a codec, UTF-8 if it is 0. Line
+    breaks are found byte-wise, so it has to encode ASCII as single bytes.
+*/
+void TextLineIndex::setCodec(QTextCodec *codec)
+{
+    m_codec = codec ? codec : QTextCodec::codecForName("UTF-8");
+
+    // Single byte encodings decode every byte to one character.
+    QByteArray bytes(256, 0);
+    for (int i = 0; i < 256; ++i)
+        bytes[i] = char(i);
+    if (m_codec->name() == "UTF-8")
+        m_decoding = Utf8Decoding;
+    else if (m_codec->toUnicode(bytes).size() == bytes.size())
+        m_decoding = SingleByteDecoding;
+    else
+        m_decoding = MultiByteDecoding;
+}
+
+/*!
+    Returns \a text encoded with codec(), as it would be in the file.
+*/
+QByteArray TextLineIndex::encode(const QString &text) const
+{
+    return m_codec->fromUnicode(text);
+}
+
+/*!
+    Starts searching for \a needle from \a from, or backward from it if
+    \a backward is true, wrapping around at the end of the file. Case is
+    only ignored for ASCII letters. findFinished() is emitted with the
+    offset of the occurrence, or -1 if there is none. A search that is
+    already running is canceled.
+
+    The search runs on a worker thread, files much larger than memory take
+    as long as reading them from disk.
+*/
+void TextLineIndex::startFind(const QByteArray &needle, qint64 from, bool backward,
+                              bool caseSensitive, bool wholeWords)
+{
+    cancelFind();
+    if (!m_data || needle.isEmpty()) {
+        emit findFinished(-1);
+        return;
+    }
+
+    QSharedPointer<TextLineIndexFindJob> job(new TextLineIndexFindJob);
+    job->data = m_data;
+    job->size = m_size;
+    job->needle = needle;
+    job->from = from;
+    job->backward = backward;
+    job->caseSensitive = caseSensitive;
+    job->wholeWords = wholeWords;
+    job->generation = m_findGeneration;
+    m_findJob = job;
+    m_findPool.start(new TextLineIndexFindTask(job, this));
+}
+
+/*!
+    Stops the running search without emitting findFinished().
+*/
+void TextLineIndex::cancelFind()
+{
+    if (m_findJob) {
+        m_findJob->stopped.fetchAndStoreRelaxed(1);
+        m_findPool.waitForDone();
+        m_findJob.clear();
+    }
+    ++m_findGeneration;
+}
+
+/*!
+    Returns the number of line feeds in \a length bytes of \a data. SSE2
+    counts 16 bytes at a time in byte counters that are summed up before
+    they can overflow.
+*/
+qint64 TextLineIndex::countNewlines(const char *data, qint64 length)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    qint64 count = 0;
+    qint64 i = 0;
+#if defined(TEXTEDITOR_HAVE_SSE2)
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= length) {
+        const qint64 end = i + qMin<qint64>(255 * 16, (length - i) & ~qint64(15));
+        __m128i counts = zero;
+        for (; i < end; i += 16) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+            counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(x, newline));
+        }
+        const __m128i sums = _mm_sad_epu8(counts, zero);
+        count += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+#endif
+    for (; i < length; ++i)
+        count += bytes[i] == '\n';
+    return count;
+}
+
+void TextLineIndex::handleIndexed(int generation, const QVector<qint64> &checkpoints,
+                                  qint64 newlines, qint64 indexedSize)
+{
+    if (generation != m_generation || !m_job)
+        return;
+
+    m_checkpoints += checkpoints;
+    m_newlines = newlines;
+    m_indexedSize = indexedSize;
+    emit linesChanged();
+    emit progressChanged(int(indexedSize * 100 / m_size));
+}
+
+void TextLineIndex::handleFound(int generation, qint64 offset)
+{
+    if (generation != m_findGeneration || !m_findJob)
+        return;
+
+    m_findJob.clear();
+    emit findFinished(offset);
+}
+
+// A file that shrank is mapped again before its old tail is read more.
+void TextLineIndex::handleFileChanged()
+{
+    const QString fileName = m_file.fileName();
+    if (QFileInfo(fileName).size() >= m_size)
+        return;
+
+    open(fileName);
+    emit linesChanged();
+}
+
+void TextLineIndex::handleDone(int generation)
+{
+    if (generation != m_generation || !m_job)
+        return;
+
+    m_job.clear();
+    m_complete = true;
+    emit finished();
+}
+
+void TextLineIndex::cancel()
+{
+    if (m_job) {
+        m_job->stopped.fetchAndStoreRelaxed(1);
+        m_pool.waitForDone();
+        m_job.clear();
+    }
+    ++m_generation;
+}
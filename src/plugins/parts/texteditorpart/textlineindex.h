@@ -0,0 +1,110 @@
+#ifndef TEXTLINEINDEX_H
+#define TEXTLINEINDEX_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QFileSystemWatcher>
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+
+class QTextCodec;
+
+namespace TextEditor {
+
+class TextLineIndexFindJob;
+class TextLineIndexJob;
+
+class TextLineIndex : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(TextLineIndex)
+
+public:
+    // The start of every IndexStep-th line is kept, the lines between are
+    // found by scanning from there.
+    static const int IndexStep = 64;
+    static const int ChunkSize = 16 * 1024 * 1024;
+    // Longer lines are cut when shown.
+    static const int MaxLineLength = 64 * 1024;
+
+    explicit TextLineIndex(QObject *parent = 0);
+    ~TextLineIndex();
+
+    bool open(const QString &fileName);
+    void close();
+
+    bool isOpen() const { return m_file.isOpen(); }
+    bool isComplete() const { return m_complete; }
+    QString fileName() const { return m_file.fileName(); }
+    QString errorString() const { return m_errorString; }
+
+    QTextCodec *codec() const { return m_codec; }
+    void setCodec(QTextCodec *codec);
+    QByteArray encode(const QString &text) const;
+
+    const char *data() const { return reinterpret_cast<const char *>(m_data); }
+    qint64 size() const { return m_size; }
+
+    qint64 lineCount() const { return m_newlines + 1; }
+    qint64 lineStart(qint64 line) const;
+    qint64 lineEnd(qint64 start) const;
+    qint64 lineAt(qint64 offset) const;
+    QString lineText(qint64 line, QVector<qint64> *offsets = 0) const;
+
+    QString text(qint64 from, qint64 to, QVector<qint64> *offsets = 0) const;
+
+    void startFind(const QByteArray &needle, qint64 from, bool backward,
+                   bool caseSensitive, bool wholeWords);
+    void cancelFind();
+
+    static qint64 countNewlines(const char *data, qint64 length);
+
+signals:
+    void linesChanged();
+    void progressChanged(int percent);
+    void finished();
+    void findFinished(qint64 offset);
+
+private slots:
+    void handleIndexed(int generation, const QVector<qint64> &checkpoints,
+                       qint64 newlines, qint64 indexedSize);
+    void handleDone(int generation);
+    void handleFound(int generation, qint64 offset);
+    void handleFileChanged();
+
+private:
+    enum Decoding { Utf8Decoding, SingleByteDecoding, MultiByteDecoding };
+
+    void cancel();
+
+    QFile m_file;
+    QFileSystemWatcher m_watcher;
+    uchar *m_data;
+    qint64 m_size;
+    QString m_errorString;
+    QTextCodec *m_codec;
+    Decoding m_decoding;
+
+    QThreadPool m_pool;
+    QSharedPointer<TextLineIndexJob> m_job;
+    int m_generation;
+    bool m_complete;
+    QVector<qint64> m_checkpoints;
+    qint64 m_newlines;
+    qint64 m_indexedSize;
+
+    // Lines are usually asked for in order, continue from the last one.
+    mutable qint64 m_lastLine;
+    mutable qint64 m_lastStart;
+
+    QThreadPool m_findPool;
+    QSharedPointer<TextLineIndexFindJob> m_findJob;
+    int m_findGeneration;
+};
+
+} // namespace TextEditor
+
+#endif // TEXTLINEINDEX_H
@@ -0,0 +1,204 @@
+#include "textloader.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QFile>
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QTextCodec>
+#include <QtCore/QTextDecoder>
+
+using namespace TextEditor;
+
+namespace TextEditor {
+
+class TextLoaderJob
+{
+public:
+    QString fileName;
+    qint64 offset;
+    QTextCodec *codec;
+    int generation;
+    QAtomicInt stopped;
+    QSemaphore pending;
+
+    bool isStopped() const
+    {
+#if QT_VERSION >= 0x050000
+        return stopped.load();
+#else
+        return stopped;
+#endif
+    }
+};
+
+} // namespace TextEditor
+
+class TextLoaderTask : public QRunnable
+{
+public:
+    TextLoaderTask(const QSharedPointer<TextLoaderJob> &job, QObject *receiver) :
+        m_job(job),
+        m_receiver(receiver)
+    {
+    }
+
+    void run();
+
+private:
+    bool post(const QString &text, int percent);
+
+    QSharedPointer<TextLoaderJob> m_job;
+    QObject *m_receiver;
+};
+
+void TextLoaderTask::run()
+{
+    TextLoaderJob &job = *m_job;
+    QFile file(job.fileName);
+    QString errorString;
+    if (file.open(QIODevice::ReadOnly) && file.seek(job.offset)) {
+        const qint64 size = qMax<qint64>(1, file.size() - job.offset);
+        qint64 done = 0;
+        QTextDecoder decoder(job.codec);
+        QString text;
+        int chunkSize = TextLoader::FirstChunkSize;
+        while (!job.isStopped()) {
+            const QByteArray data = file.read(chunkSize);
+            if (data.isEmpty()) {
+                if (file.error() != QFile::NoError)
+                    errorString = file.errorString();
+                break;
+            }
+            done += data.size();
+            chunkSize = TextLoader::ChunkSize;
+
+            // Chunks end after a line break where possible, so appending
+            // one doesn't lay out the last line again.
+            text += decoder.toUnicode(data);
+            const int lineEnd = text.lastIndexOf(QLatin1Char('\n')) + 1;
+            if (lineEnd > 0 && lineEnd < text.size()) {
+                if (!post(text.left(lineEnd), int(done * 100 / size)))
+                    break;
+                text.remove(0, lineEnd);
+            } else {
+                if (!post(text, int(done * 100 / size)))
+                    break;
+                text.clear();
+            }
+        }
+        if (!text.isEmpty())
+            post(text, 100);
+    } else {
+        errorString = file.errorString();
+    }
+
+    QMetaObject::invokeMethod(m_receiver, "handleDone", Qt::QueuedConnection,
+                              Q_ARG(int, job.generation), Q_ARG(QString, errorString));
+}
+
+/*
+    Hands \a text to the GUI thread, waiting while it is behind. Returns
+    false if the job was stopped meanwhile.
+*/
+bool TextLoaderTask::post(const QString &text, int percent)
+{
+    m_job->pending.acquire();
+    if (m_job->isStopped())
+        return false;
+
+    QMetaObject::invokeMethod(m_receiver, "handleChunk", Qt::QueuedConnection,
+                              Q_ARG(int, m_job->generation), Q_ARG(QString, text),
+                              Q_ARG(int, percent));
+    return true;
+}
+
+/*!
+    \class TextLoader
+
+    Reads and decodes a text file on a worker thread.
+
+    The file is read in chunks that are handed to the GUI thread with
+    textLoaded() as they are decoded, so a large file shows up at once and
+    fills in while the event loop keeps running. The worker stays at most
+    MaxPendingChunks ahead of the receiver, so memory use doesn't depend on
+    the file size.
+*/
+
+/*!
+    Creates TextLoader with the given \a parent.
+*/
+TextLoader::TextLoader(QObject *parent) :
+    QObject(parent),
+    m_generation(0),
+    m_running(false)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+TextLoader::~TextLoader()
+{
+    cancel();
+}
+
+/*!
+    Starts loading \a fileName from \a offset decoded with \a codec, UTF-8
+    if it is 0. A load that is already running is canceled.
+*/
+void TextLoader::start(const QString &fileName, qint64 offset, QTextCodec *codec)
+{
+    cancel();
+    QSharedPointer<TextLoaderJob> job(new TextLoaderJob);
+    job->fileName = fileName;
+    job->offset = offset;
+    job->codec = codec ? codec : QTextCodec::codecForName("UTF-8");
+    job->generation = m_generation;
+    job->pending.release(MaxPendingChunks);
+    m_job = job;
+    m_running = true;
+    m_errorString.clear();
+    emit started();
+    emit progressChanged(0);
+    m_pool.start(new TextLoaderTask(job, this));
+}
+
+/*!
+    Stops the running load and waits for the worker. Chunks that were
+    decoded but not yet delivered are dropped.
+*/
+void TextLoader::cancel()
+{
+    if (m_job) {
+        m_job->stopped.fetchAndStoreRelaxed(1);
+        m_job->pending.release(MaxPendingChunks);
+        m_pool.waitForDone();
+        m_job.clear();
+    }
+    ++m_generation;
+    if (m_running) {
+        m_running = false;
+        emit finished(false);
+    }
+}
+
+void TextLoader::handleChunk(int generation, const QString &text, int percent)
+{
+    if (generation != m_generation || !m_job)
+        return;
+
+    emit textLoaded(text);
+    emit progressChanged(percent);
+    // The job may have been canceled by a receiver of textLoaded().
+    if (m_job && generation == m_generation)
+        m_job->pending.release();
+}
+
+void TextLoader::handleDone(int generation, const QString &errorString)
+{
+    if (generation != m_generation || !m_job)
+        return;
+
+    m_job.clear();
+    m_running = false;
+    m_errorString = errorString;
+    emit finished(errorString.isEmpty());
+}
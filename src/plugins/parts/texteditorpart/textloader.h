@@ -0,0 +1,59 @@
+#ifndef TEXTLOADER_H
+#define TEXTLOADER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QThreadPool>
+
+class QTextCodec;
+
+namespace TextEditor {
+
+class TextLoaderJob;
+
+class TextLoader : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(TextLoader)
+
+public:
+    // The first chunk is small so the first screen shows up at once.
+    static const int FirstChunkSize = 64 * 1024;
+    static const int ChunkSize = 512 * 1024;
+    // Decoded chunks waiting for the GUI thread, the worker waits when
+    // there are more.
+    static const int MaxPendingChunks = 4;
+
+    explicit TextLoader(QObject *parent = 0);
+    ~TextLoader();
+
+    bool isRunning() const { return m_running; }
+    QString errorString() const { return m_errorString; }
+
+    void start(const QString &fileName, qint64 offset = 0, QTextCodec *codec = 0);
+
+public slots:
+    void cancel();
+
+signals:
+    void started();
+    void textLoaded(const QString &text);
+    void progressChanged(int percent);
+    void finished(bool ok);
+
+private slots:
+    void handleChunk(int generation, const QString &text, int percent);
+    void handleDone(int generation, const QString &errorString);
+
+private:
+    QThreadPool m_pool;
+    QSharedPointer<TextLoaderJob> m_job;
+    int m_generation;
+    bool m_running;
+    QString m_errorString;
+};
+
+} // namespace TextEditor
+
+#endif // TEXTLOADER_H
@@ -0,0 +1,127 @@
+#include "textmapguard.h"
+
+#include <QtCore/QMutex>
+
+#include <string.h>
+
+#if defined(Q_OS_UNIX)
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace TextEditor;
+
+/*!
+    \class TextEditor::TextMapGuard
+
+    Keeps reads of a truncated file mapping from crashing.
+
+    Log files are often truncated in place while they are open, and reading
+    the pages of a mapping past the new end of its file raises SIGBUS. The
+    guard's handler maps a page of zeroes over the faulting page of a
+    registered mapping instead, so painting, finding and indexing read
+    zeroes until the file is mapped again. Other faults are passed to the
+    handler that was installed before.
+
+    Other systems don't let files be truncated while they are mapped.
+*/
+
+#if defined(Q_OS_UNIX)
+struct GuardedMapping
+{
+    volatile quintptr start;
+    volatile quintptr size;
+};
+
+static GuardedMapping guardedMappings[TextMapGuard::MaxMappings];
+static QMutex guardedMappingsMutex;
+static quintptr pageSize = 0;
+static struct sigaction previousAction;
+
+// Runs in the signal handler, only async-signal-safe calls may be used.
+static void handleBusError(int number, siginfo_t *info, void *context)
+{
+    const quintptr address = quintptr(info->si_addr);
+    for (int i = 0; i < TextMapGuard::MaxMappings; ++i) {
+        const quintptr start = guardedMappings[i].start;
+        if (start == 0 || address < start || address - start >= guardedMappings[i].size)
+            continue;
+
+        void *page = reinterpret_cast<void *>(address & ~(pageSize - 1));
+        if (::mmap(page, size_t(pageSize), PROT_READ,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            return;
+        }
+        break;
+    }
+
+    if (previousAction.sa_flags & SA_SIGINFO) {
+        previousAction.sa_sigaction(number, info, context);
+    } else if (previousAction.sa_handler != SIG_DFL && previousAction.sa_handler != SIG_IGN) {
+        previousAction.sa_handler(number);
+    } else {
+        // The read faults again and takes the default action.
+        ::sigaction(SIGBUS, &previousAction, 0);
+    }
+}
+
+static void installHandler()
+{
+    pageSize = quintptr(::sysconf(_SC_PAGESIZE));
+
+    struct sigaction action;
+    ::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handleBusError;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    ::sigemptyset(&action.sa_mask);
+    ::sigaction(SIGBUS, &action, &previousAction);
+}
+#endif
+
+/*!
+    Guards the \a size bytes mapped at \a data. Returns false if they can't
+    be guarded, the mapping shouldn't be used then.
+*/
+bool TextMapGuard::add(const uchar *data, qint64 size)
+{
+#if defined(Q_OS_UNIX)
+    QMutexLocker locker(&guardedMappingsMutex);
+    if (!pageSize)
+        installHandler();
+
+    for (int i = 0; i < MaxMappings; ++i) {
+        if (guardedMappings[i].start == 0) {
+            // The handler looks at the start, so it is set last.
+            guardedMappings[i].size = quintptr(size);
+            guardedMappings[i].start = quintptr(data);
+            return true;
+        }
+    }
+    return false;
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(size);
+    return true;
+#endif
+}
+
+/*!
+    Stops guarding the mapping at \a data. It has to be called before the
+    mapping is unmapped.
+*/
+void TextMapGuard::remove(const uchar *data)
+{
+#if defined(Q_OS_UNIX)
+    QMutexLocker locker(&guardedMappingsMutex);
+    for (int i = 0; i < MaxMappings; ++i) {
+        if (guardedMappings[i].start == quintptr(data)) {
+            guardedMappings[i].start = 0;
+            guardedMappings[i].size = 0;
+            return;
+        }
+    }
+#else
+    Q_UNUSED(data);
+#endif
+}
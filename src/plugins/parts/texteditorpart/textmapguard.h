@@ -0,0 +1,20 @@
+#ifndef TEXTMAPGUARD_H
+#define TEXTMAPGUARD_H
+
+#include <QtCore/qglobal.h>
+
+namespace TextEditor {
+
+class TextMapGuard
+{
+public:
+    // At most this many mappings are guarded at once.
+    static const int MaxMappings = 16;
+
+    static bool add(const uchar *data, qint64 size);
+    static void remove(const uchar *data);
+};
+
+} // namespace TextEditor
+
+#endif // TEXTMAPGUARD_H